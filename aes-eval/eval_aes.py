@@ -5,9 +5,31 @@ AES-128 FPGA Accelerator Benchmark Script
 This script benchmarks an AES-128 hardware accelerator on a MicroBlaze FPGA
 by sending test vectors over UART and measuring encryption time.
 
-Protocol:
-    TX: [16 bytes key] + [16 bytes plaintext] + [0xFF 0xFF] = 34 bytes
-    RX: [16 bytes ciphertext] + [4 bytes cycle_count] = 20 bytes
+Protocol (version 2, same frame in both directions):
+    [0xA5] [seq] [cmd] [len16 LE] [payload] [CRC-16/CCITT-FALSE LE]
+    The CRC covers seq, cmd, len and payload. Responses echo seq with
+    cmd | 0x80, so requests can be pipelined without flushing buffers.
+    
+    PING     (0x00): -> [protocol version]
+    ECB      (0x01): [16B key] + [16B plaintext] -> [16B ciphertext] + [4B cycles]
+    KEY_LOAD (0x02): [16B key] + [key slot] -> [4B cycles]
+    CTR      (0x03): [key slot] + [12B nonce] + [4B counter BE] + [4B count N]
+                     -> [N x 16B keystream] + [4B cycles]
+    BATCH    (0x04): [mode] + [key slot] + [flags] + [reserved] + [16B IV]
+                     + [16B key if flags bit0] + [N x 16B data]
+                     -> [N x 16B result] + [4B cycles]
+    MCT      (0x05): [mode] + [key slot] + [2B iterations] + [16B IV] + [16B key]
+                     + [16B text] -> [iterations x (16B result + 16B next text)]
+                     + [4B cycles]
+    BENCH    (0x06): [4B block count N] + [key slot] -> [5 x 4B cycles]
+                     (polled, interrupt, queued, write-only, read-only)
+    STATS    (0x07): -> [seq] + [cmd] + [2B valid mask] + [8 x 4B phase stamps]
+                     + [4B frames] + [7 x 4B average cycles between phases]
+                     (last frame before this one; averages reset after reading)
+    KEY_STORE(0x08): [16B key] + [key id] -> [4B cycles]
+    ECB_ID   (0x09): [16B plaintext] + [key id] -> [16B ciphertext] + [4B cycles]
+                     (key from the firmware key table, kept expanded in a slot)
+    NAK      (0xFF response): [reason] + [request cmd]
 
 Usage:
     Auto-detect:  python aes_benchmark.py --auto
@@ -22,12 +44,14 @@ Requirements:
 """
 
 import argparse
+import binascii
 import time
 import struct
 import sys
 import platform
 import os
-from typing import Optional, Tuple, List
+import threading
+from typing import Callable, Optional, Tuple, List
 import serial
 import serial.tools.list_ports
 from Crypto.Cipher import AES
@@ -72,11 +96,51 @@ def print_available_ports():
 class AESBenchmark:
     """AES-128 FPGA Accelerator Benchmark Class"""
     
-    FRAME_MARKER = bytes([0xFF, 0xFF])
+    # Frame format (protocol version 2)
+    PROTOCOL_VERSION = 2
+    SOF = 0xA5
+    HEADER_SIZE = 5     # SOF, seq, cmd, len16
+    CRC_SIZE = 2
+    
+    CMD_PING = 0x00
+    CMD_ECB = 0x01
+    CMD_KEY_LOAD = 0x02
+    CMD_CTR = 0x03
+    CMD_BATCH = 0x04
+    CMD_MCT = 0x05
+    CMD_BENCH = 0x06
+    CMD_STATS = 0x07
+    CMD_KEY_STORE = 0x08
+    CMD_ECB_ID = 0x09
+    CMD_NAK = 0x7F
+    CMD_RESPONSE = 0x80
+    
+    NAK_CRC = 0x01
+    NAK_LENGTH = 0x02
+    NAK_PARAM = 0x03
+    NAK_RETRIES = 3     # Resends of a request NAKed for a bad CRC
+    
+    NUM_KEY_SLOTS = 4
+    NONCE_SIZE = 12
+    CTR_MAX_BLOCKS = 4095
+    
+    # Batch command
+    BATCH_MODE_ECB_ENC = 0
+    BATCH_MODE_ECB_DEC = 1
+    BATCH_MODE_CBC_ENC = 2
+    BATCH_MODE_CBC_DEC = 3
+    BATCH_FLAG_KEY = 0x01
+    BATCH_HEADER_SIZE = 20
+    BATCH_MAX_BLOCKS = 32
+    MCT_MAX_ITERATIONS = 100
+    MCT_INNER_BLOCKS = 1000
+    BENCH_MAX_BLOCKS = 1 << 20
+    BENCH_VARIANTS = ('polled', 'interrupt', 'queued', 'write_only', 'read_only')
+    PHASES = ('sof', 'key_written', 'plaintext_written', 'frame_verified',
+              'start', 'done', 'ciphertext_read', 'last_tx_queued')
+    KEY_CACHE_IDS = 16
     KEY_SIZE = 16
     BLOCK_SIZE = 16
-    TX_FRAME_SIZE = KEY_SIZE + BLOCK_SIZE + 2  # 34 bytes
-    RX_FRAME_SIZE = BLOCK_SIZE + 4              # 20 bytes
     
     # NIST test vector for validation
     NIST_KEY = bytes.fromhex('2b7e151628aed2a6abf7158809cf4f3c')
@@ -89,6 +153,8 @@ class AESBenchmark:
         self.baudrate = baudrate
         self.timeout = timeout
         self.ser: Optional[serial.Serial] = None
+        self.seq = 0
+        self.rx_buf = bytearray()
         
     def connect(self) -> bool:
         """Open serial connection."""
@@ -114,6 +180,208 @@ class AESBenchmark:
         if self.ser and self.ser.is_open:
             self.ser.close()
     
+    @staticmethod
+    def crc16(data: bytes) -> int:
+        """CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)."""
+        return binascii.crc_hqx(data, 0xFFFF)
+    
+    def build_frame(self, seq: int, cmd: int, payload: bytes) -> bytes:
+        """Build a request frame: [SOF][seq][cmd][len16][payload][crc16]."""
+        body = bytes([seq, cmd]) + struct.pack('<H', len(payload)) + payload
+        return bytes([self.SOF]) + body + struct.pack('<H', self.crc16(body))
+    
+    def send_request(self, cmd: int, payload: bytes = b'') -> int:
+        """Send a request frame without waiting. Returns its sequence number."""
+        seq = self.seq
+        self.seq = (self.seq + 1) & 0xFF
+        self.ser.write(self.build_frame(seq, cmd, payload))
+        return seq
+    
+    def read_response(self, expected_len: int = 0) -> Optional[Tuple[int, int, bytes]]:
+        """
+        Read the next valid response frame.
+        
+        Bytes before a SOF and frames failing their CRC are skipped by
+        resuming the search one byte after the SOF, as the firmware does.
+        Bytes read past the frame are kept for the next call.
+        
+        Args:
+            expected_len: Payload length expected, used to extend the timeout
+            
+        Returns:
+            Tuple of (seq, cmd, payload), or None on timeout
+        """
+        buf = self.rx_buf
+        
+        # Allow for the response's transmission time (10 bits per byte)
+        self.ser.timeout = self.timeout + expected_len * 10 / self.baudrate
+        try:
+            while True:
+                # Drop everything before the next SOF
+                sof = buf.find(self.SOF)
+                del buf[:sof if sof >= 0 else len(buf)]
+                
+                if len(buf) >= self.HEADER_SIZE:
+                    length = struct.unpack('<H', buf[3:5])[0]
+                    frame_size = self.HEADER_SIZE + length + self.CRC_SIZE
+                    if len(buf) >= frame_size:
+                        body = bytes(buf[1:self.HEADER_SIZE + length])
+                        crc = struct.unpack('<H', buf[frame_size - 2:frame_size])[0]
+                        if crc == self.crc16(body):
+                            del buf[:frame_size]
+                            return body[0], body[1], body[4:]
+                        # False SOF: resume after it
+                        del buf[:1]
+                        continue
+                    need = frame_size - len(buf)
+                else:
+                    need = max(self.HEADER_SIZE - len(buf), 1)
+                
+                data = self.ser.read(max(need, self.ser.in_waiting))
+                if not data:
+                    return None
+                buf.extend(data)
+        finally:
+            self.ser.timeout = self.timeout
+    
+    def transact(self, cmd: int, payload: bytes = b'',
+                 expected_len: int = 0) -> Optional[bytes]:
+        """
+        Send one request and wait for its response.
+        
+        Responses to other sequence numbers (late answers to earlier
+        requests) are discarded, so no input flushing is needed.
+        
+        Returns:
+            Response payload, or None on timeout or NAK
+        """
+        if not self.ser or not self.ser.is_open:
+            return None
+        
+        seq = self.send_request(cmd, payload)
+        self.ser.flush()
+        
+        while True:
+            response = self.read_response(expected_len)
+            if response is None:
+                return None
+            rsp_seq, rsp_cmd, rsp_payload = response
+            if rsp_seq != seq:
+                continue
+            if rsp_cmd != (cmd | self.CMD_RESPONSE):
+                return None
+            return rsp_payload
+    
+    def submit_pipelined(self, requests: List[Tuple[int, bytes, int]],
+                         window: int = 8,
+                         progress: Optional[Callable[[int], None]] = None) -> List[Optional[bytes]]:
+        """
+        Run requests with up to `window` frames in flight.
+        
+        A new request is sent whenever a response arrives, so the link stays
+        busy in both directions instead of idling for a USB-serial round trip
+        per request. Keep window x request size within the firmware RX ring
+        (1024 bytes).
+        
+        A response is matched only to a sequence number this call has in
+        flight, and only if it answers that request's command; anything else
+        is a late answer to an earlier call and is skipped. The window stays
+        below half the 8-bit sequence space so the numbers in flight are
+        never ambiguous. A request NAKed for a bad CRC was corrupted on the
+        way in and is sent again under a new sequence number, up to
+        NAK_RETRIES times; any other NAK fails only the request it names.
+        
+        Args:
+            requests: List of (cmd, payload, expected_response_len)
+            window: Maximum requests in flight (1-127)
+            progress: Optional callback with the number of completed requests
+            
+        Returns:
+            Response payloads in request order; None for a request that was
+            NAKed or timed out
+        """
+        if not 1 <= window < 128:
+            raise ValueError("Window must be 1-127")
+        
+        results: List[Optional[bytes]] = [None] * len(requests)
+        if not self.ser or not self.ser.is_open:
+            return results
+        
+        inflight = {}  # seq -> request index, for the requests this call sent
+        retries = [0] * len(requests)
+        next_index = 0
+        completed = 0
+        
+        while next_index < len(requests) or inflight:
+            # Top up the window
+            while next_index < len(requests) and len(inflight) < window:
+                cmd, payload, _ = requests[next_index]
+                inflight[self.send_request(cmd, payload)] = next_index
+                next_index += 1
+            self.ser.flush()
+            
+            expected_len = max(requests[i][2] for i in inflight.values())
+            response = self.read_response(expected_len)
+            if response is None:
+                break  # Timed out: the remaining in-flight requests stay None
+            
+            rsp_seq, rsp_cmd, rsp_payload = response
+            index = inflight.get(rsp_seq)
+            if index is None:
+                continue  # Stale response to an earlier call
+            cmd, payload, _ = requests[index]
+            if rsp_cmd == (cmd | self.CMD_RESPONSE):
+                results[index] = rsp_payload
+            elif (rsp_cmd == (self.CMD_NAK | self.CMD_RESPONSE) and len(rsp_payload) == 2
+                  and rsp_payload[1] == cmd):
+                if rsp_payload[0] == self.NAK_CRC and retries[index] < self.NAK_RETRIES:
+                    del inflight[rsp_seq]
+                    retries[index] += 1
+                    inflight[self.send_request(cmd, payload)] = index
+                    continue
+                # Any other NAK: this request failed, the rest carry on
+            else:
+                continue  # Same seq, other command: stale response to an earlier call
+            del inflight[rsp_seq]
+            
+            completed += 1
+            if progress:
+                progress(completed)
+        
+        return results
+    
+    def encrypt_blocks(self, key: bytes, blocks: List[bytes], window: int = 8,
+                       progress: Optional[Callable[[int], None]] = None
+                       ) -> List[Tuple[Optional[bytes], Optional[int]]]:
+        """
+        Encrypt blocks with ECB requests pipelined `window` deep.
+        
+        Returns:
+            List of (ciphertext, cycle_count), (None, None) for failed blocks
+        """
+        if len(key) != self.KEY_SIZE:
+            raise ValueError(f"Key must be {self.KEY_SIZE} bytes")
+        for block in blocks:
+            if len(block) != self.BLOCK_SIZE:
+                raise ValueError(f"Plaintext must be {self.BLOCK_SIZE} bytes")
+        
+        requests = [(self.CMD_ECB, key + block, self.BLOCK_SIZE + 4) for block in blocks]
+        results = []
+        for payload in self.submit_pipelined(requests, window, progress):
+            if payload is None or len(payload) != self.BLOCK_SIZE + 4:
+                results.append((None, None))
+            else:
+                results.append((payload[:self.BLOCK_SIZE],
+                                struct.unpack('<I', payload[self.BLOCK_SIZE:])[0]))
+        return results
+    
+    def ping(self) -> Optional[int]:
+        """Return the firmware protocol version, or None if there is no answer."""
+        payload = self.transact(self.CMD_PING, b'', 1)
+        if payload is None or len(payload) != 1:
+            return None
+        return payload[0]
+    
     def encrypt_block(self, key: bytes, plaintext: bytes) -> Tuple[Optional[bytes], Optional[int]]:
         """
         Send key and plaintext to FPGA, receive ciphertext and cycle count.
@@ -125,35 +393,403 @@ class AESBenchmark:
         Returns:
             Tuple of (ciphertext, cycle_count) or (None, None) on error
         """
-        if not self.ser or not self.ser.is_open:
+        if len(key) != self.KEY_SIZE:
+            raise ValueError(f"Key must be {self.KEY_SIZE} bytes")
+        if len(plaintext) != self.BLOCK_SIZE:
+            raise ValueError(f"Plaintext must be {self.BLOCK_SIZE} bytes")
+        
+        payload = self.transact(self.CMD_ECB, key + plaintext, self.BLOCK_SIZE + 4)
+        if payload is None or len(payload) != self.BLOCK_SIZE + 4:
             return None, None
         
+        # Parse response
+        ciphertext = payload[:self.BLOCK_SIZE]
+        cycle_count = struct.unpack('<I', payload[self.BLOCK_SIZE:])[0]
+        
+        return ciphertext, cycle_count
+    
+    def load_key(self, slot: int, key: bytes) -> Optional[int]:
+        """
+        Expand a key into a key slot on the FPGA for later CTR and batch requests.
+        
+        Returns:
+            Key load cycle count, or None on error
+        """
         if len(key) != self.KEY_SIZE:
             raise ValueError(f"Key must be {self.KEY_SIZE} bytes")
+        if not 0 <= slot < self.NUM_KEY_SLOTS:
+            raise ValueError(f"Key slot must be 0-{self.NUM_KEY_SLOTS - 1}")
+        
+        payload = self.transact(self.CMD_KEY_LOAD, key + bytes([slot]), 4)
+        if payload is None or len(payload) != 4:
+            return None
+        return struct.unpack('<I', payload)[0]
+    
+    def store_key(self, key_id: int, key: bytes) -> Optional[int]:
+        """
+        Store a key under an id in the firmware key table for ECB_ID requests.
+        The firmware keeps it expanded in a key slot while it is in use.
+        
+        Returns:
+            Key store cycle count, or None on error
+        """
+        if len(key) != self.KEY_SIZE:
+            raise ValueError(f"Key must be {self.KEY_SIZE} bytes")
+        if not 0 <= key_id < self.KEY_CACHE_IDS:
+            raise ValueError(f"Key id must be 0-{self.KEY_CACHE_IDS - 1}")
+        
+        payload = self.transact(self.CMD_KEY_STORE, key + bytes([key_id]), 4)
+        if payload is None or len(payload) != 4:
+            return None
+        return struct.unpack('<I', payload)[0]
+    
+    def encrypt_block_id(self, key_id: int, plaintext: bytes) -> Tuple[Optional[bytes], Optional[int]]:
+        """
+        Encrypt one block with a stored key.
+        
+        Returns:
+            Tuple of (ciphertext, cycle_count) or (None, None) on error
+        """
         if len(plaintext) != self.BLOCK_SIZE:
             raise ValueError(f"Plaintext must be {self.BLOCK_SIZE} bytes")
         
-        # Build TX frame
-        tx_frame = key + plaintext + self.FRAME_MARKER
+        payload = self.transact(self.CMD_ECB_ID, plaintext + bytes([key_id]), self.BLOCK_SIZE + 4)
+        if payload is None or len(payload) != self.BLOCK_SIZE + 4:
+            return None, None
+        return payload[:self.BLOCK_SIZE], struct.unpack('<I', payload[self.BLOCK_SIZE:])[0]
+    
+    def ctr_keystream(self, slot: int, nonce: bytes, counter: int,
+                      num_blocks: int) -> Tuple[Optional[bytes], Optional[int]]:
+        """
+        Request CTR keystream AES_K(nonce || counter + i) for i < num_blocks.
         
-        # Clear input buffer
-        self.ser.reset_input_buffer()
+        Only a short request crosses the link upstream per CTR_MAX_BLOCKS
+        blocks; the FPGA streams back the keystream and a cycle count.
         
-        # Send frame
-        self.ser.write(tx_frame)
-        self.ser.flush()
+        Returns:
+            Tuple of (keystream, total_cycle_count) or (None, None) on error
+        """
+        if len(nonce) != self.NONCE_SIZE:
+            raise ValueError(f"Nonce must be {self.NONCE_SIZE} bytes")
+        if not 0 <= slot < self.NUM_KEY_SLOTS:
+            raise ValueError(f"Key slot must be 0-{self.NUM_KEY_SLOTS - 1}")
         
-        # Receive response
-        rx_data = self.ser.read(self.RX_FRAME_SIZE)
+        keystream = bytearray()
+        total_cycles = 0
+        done = 0
+        while done < num_blocks:
+            count = min(num_blocks - done, self.CTR_MAX_BLOCKS)
+            request = (bytes([slot]) + nonce +
+                       struct.pack('>I', (counter + done) & 0xFFFFFFFF) +
+                       struct.pack('<I', count))
+            rx_len = count * self.BLOCK_SIZE + 4
+            payload = self.transact(self.CMD_CTR, request, rx_len)
+            if payload is None or len(payload) != rx_len:
+                return None, None
+            keystream.extend(payload[:-4])
+            total_cycles += struct.unpack('<I', payload[-4:])[0]
+            done += count
         
-        if len(rx_data) != self.RX_FRAME_SIZE:
+        return bytes(keystream), total_cycles
+    
+    def ctr_crypt(self, slot: int, nonce: bytes, counter: int,
+                  data: bytes) -> Tuple[Optional[bytes], Optional[int]]:
+        """Encrypt or decrypt data in CTR mode with FPGA keystream XORed locally."""
+        num_blocks = (len(data) + self.BLOCK_SIZE - 1) // self.BLOCK_SIZE
+        keystream, cycles = self.ctr_keystream(slot, nonce, counter, num_blocks)
+        if keystream is None:
             return None, None
+        return bytes(d ^ k for d, k in zip(data, keystream)), cycles
+    
+    def process_batch(self, mode: int, data: bytes, slot: int = 0,
+                      key: Optional[bytes] = None,
+                      iv: bytes = bytes(16)) -> Tuple[Optional[bytes], Optional[int]]:
+        """
+        Process data with batch requests of up to BATCH_MAX_BLOCKS blocks each.
         
-        # Parse response
-        ciphertext = rx_data[:self.BLOCK_SIZE]
-        cycle_count = struct.unpack('<I', rx_data[self.BLOCK_SIZE:])[0]
+        CBC chaining is carried across requests by passing the last
+        ciphertext block on as the next request's IV.
         
-        return ciphertext, cycle_count
+        Args:
+            mode: BATCH_MODE_* value
+            data: N x 16 bytes
+            slot: Key slot to use
+            key: If given, sent inline with the first request and loaded into the slot
+            iv: CBC initialization vector
+            
+        Returns:
+            Tuple of (result, total_cycle_count) or (None, None) on error
+        """
+        if len(data) % self.BLOCK_SIZE != 0:
+            raise ValueError(f"Data must be a multiple of {self.BLOCK_SIZE} bytes")
+        if len(iv) != self.BLOCK_SIZE:
+            raise ValueError(f"IV must be {self.BLOCK_SIZE} bytes")
+        if key is not None and len(key) != self.KEY_SIZE:
+            raise ValueError(f"Key must be {self.KEY_SIZE} bytes")
+        if not 0 <= slot < self.NUM_KEY_SLOTS:
+            raise ValueError(f"Key slot must be 0-{self.NUM_KEY_SLOTS - 1}")
+        
+        result = bytearray()
+        total_cycles = 0
+        chunk_size = self.BATCH_MAX_BLOCKS * self.BLOCK_SIZE
+        
+        for offset in range(0, len(data), chunk_size):
+            chunk = data[offset:offset + chunk_size]
+            flags = self.BATCH_FLAG_KEY if key is not None else 0
+            request = bytes([mode, slot, flags, 0]) + iv + (key or b'') + chunk
+            
+            rx_len = len(chunk) + 4
+            payload = self.transact(self.CMD_BATCH, request, rx_len)
+            if payload is None or len(payload) != rx_len:
+                return None, None
+            result.extend(payload[:-4])
+            total_cycles += struct.unpack('<I', payload[-4:])[0]
+            
+            # Carry the CBC chain into the next request; the key is loaded now
+            if mode == self.BATCH_MODE_CBC_ENC:
+                iv = payload[-4 - self.BLOCK_SIZE:-4]
+            elif mode == self.BATCH_MODE_CBC_DEC:
+                iv = chunk[-self.BLOCK_SIZE:]
+            key = None
+        
+        return bytes(result), total_cycles
+    
+    def hybrid_ecb(self, key: bytes, data: bytes, slot: int = 0,
+                   decrypt: bool = False) -> Tuple[Optional[bytes], Optional[dict]]:
+        """
+        ECB over data shared between the board and pycryptodome (AES-NI
+        when the CPU has it), as HybridEcb does in libaesfpga.
+        
+        Software takes BATCH-sized chunks from the front on this thread; a
+        worker thread sends chunks from the back, one at a time, only when
+        the board should return one before software could finish everything
+        else still unclaimed. Both rates are moving averages updated as the
+        job runs. Once software runs out of chunks it takes back the chunk
+        on the wire if it can finish it sooner, or if it is overdue, so the
+        board can only make the job slower by about one chunk of software
+        time.
+        
+        Args:
+            key: Loaded into slot first
+            data: N x 16 bytes
+            slot: Key slot the board uses
+            decrypt: Decrypt instead of encrypt
+            
+        Returns:
+            Tuple of (result, stats) or (None, None) if the key cannot be
+            loaded. Elapsed time stops when the result is complete; a
+            response still on the wire is waited for after that.
+        """
+        if len(data) % self.BLOCK_SIZE != 0:
+            raise ValueError(f"Data must be a multiple of {self.BLOCK_SIZE} bytes")
+        if self.load_key(slot, key) is None:
+            return None, None
+        
+        cipher = AES.new(key, AES.MODE_ECB)
+        soft = cipher.decrypt if decrypt else cipher.encrypt
+        mode = self.BATCH_MODE_ECB_DEC if decrypt else self.BATCH_MODE_ECB_ENC
+        chunk_size = self.BATCH_MAX_BLOCKS * self.BLOCK_SIZE
+        num_chunks = (len(data) + chunk_size - 1) // chunk_size
+        result = bytearray(len(data))
+        
+        def chunk_blocks(k: int) -> int:
+            return min(chunk_size, len(data) - k * chunk_size) // self.BLOCK_SIZE
+        
+        # Software per-block time from a short probe; the board's from both
+        # frames on the wire until its first response
+        probe_start = time.perf_counter()
+        soft(bytes(64 * chunk_size))
+        frame_bytes = (self.HEADER_SIZE + self.BATCH_HEADER_SIZE + chunk_size + self.CRC_SIZE +
+                       self.HEADER_SIZE + chunk_size + 4 + self.CRC_SIZE)
+        job = {
+            'soft_spb': max(time.perf_counter() - probe_start, 1e-9) / (64 * self.BATCH_MAX_BLOCKS),
+            'fpga_spb': frame_bytes * 10 / self.baudrate / self.BATCH_MAX_BLOCKS,
+            'front': 0, 'back': num_chunks, 'done': 0,
+            'pending': None, 'sent': 0.0, 'failed': False,
+            'fpga_blocks': 0, 'soft_blocks': 0, 'reclaimed_blocks': 0,
+        }
+        claimed = {}    # Chunk -> 'soft', 'fpga' or 'done'
+        cond = threading.Condition()
+        ewma = 0.25     # Weight of the newest sample
+        
+        def fpga_worker():
+            while True:
+                with cond:
+                    while True:
+                        if job['failed'] or job['front'] >= job['back']:
+                            return
+                        k = job['back'] - 1
+                        blocks = chunk_blocks(k)
+                        unclaimed = (min(job['back'] * chunk_size, len(data)) -
+                                     job['front'] * chunk_size) // self.BLOCK_SIZE
+                        if job['fpga_spb'] * blocks <= job['soft_spb'] * (unclaimed - blocks):
+                            break
+                        # Not worth it until software's estimate changes
+                        cond.wait()
+                    job['back'] = k
+                    job['pending'] = k
+                    job['sent'] = time.perf_counter()
+                    claimed[k] = 'fpga'
+                
+                chunk = data[k * chunk_size:(k + 1) * chunk_size]
+                rsp, _ = self.process_batch(mode, chunk, slot)
+                
+                with cond:
+                    if rsp is None:
+                        # Left pending for software to take back
+                        job['failed'] = True
+                    else:
+                        job['pending'] = None
+                        spb = (time.perf_counter() - job['sent']) / blocks
+                        job['fpga_spb'] += ewma * (spb - job['fpga_spb'])
+                        if claimed[k] == 'fpga':
+                            result[k * chunk_size:k * chunk_size + len(rsp)] = rsp
+                            claimed[k] = 'done'
+                            job['done'] += 1
+                            job['fpga_blocks'] += blocks
+                    cond.notify_all()
+        
+        start = time.perf_counter()
+        worker = threading.Thread(target=fpga_worker, daemon=True)
+        worker.start()
+        
+        while True:
+            with cond:
+                if job['done'] == num_chunks:
+                    break
+                if job['front'] < job['back']:
+                    # Enough at once that claiming costs little
+                    grab = int(1e-3 / (job['soft_spb'] * self.BATCH_MAX_BLOCKS)) + 1
+                    first = job['front']
+                    count = min(grab, job['back'] - first)
+                    job['front'] += count
+                elif job['pending'] is not None and claimed[job['pending']] == 'fpga':
+                    k = job['pending']
+                    now = time.perf_counter()
+                    due = job['sent'] + job['fpga_spb'] * chunk_blocks(k)
+                    if (job['failed'] or now >= due or
+                            due - now > job['soft_spb'] * chunk_blocks(k)):
+                        job['reclaimed_blocks'] += chunk_blocks(k)
+                        first, count = k, 1
+                    else:
+                        cond.wait(due - now)
+                        continue
+                else:
+                    cond.wait(0.01)
+                    continue
+                for k in range(first, first + count):
+                    claimed[k] = 'soft'
+            
+            lo = first * chunk_size
+            hi = min((first + count) * chunk_size, len(data))
+            soft_start = time.perf_counter()
+            result[lo:hi] = soft(data[lo:hi])
+            spb = (time.perf_counter() - soft_start) / ((hi - lo) // self.BLOCK_SIZE)
+            
+            with cond:
+                job['soft_spb'] += ewma * (max(spb, 1e-12) - job['soft_spb'])
+                for k in range(first, first + count):
+                    claimed[k] = 'done'
+                job['done'] += count
+                job['soft_blocks'] += (hi - lo) // self.BLOCK_SIZE
+                cond.notify_all()
+        
+        elapsed = time.perf_counter() - start
+        worker.join()
+        
+        total = job['fpga_blocks'] + job['soft_blocks']
+        stats = {
+            'blocks': total,
+            'fpga_blocks': job['fpga_blocks'],
+            'soft_blocks': job['soft_blocks'],
+            'reclaimed_blocks': job['reclaimed_blocks'],
+            'fpga_share_pct': job['fpga_blocks'] / total * 100 if total else 0.0,
+            'elapsed_sec': elapsed,
+            'soft_blocks_per_sec': 1 / job['soft_spb'],
+            'fpga_blocks_per_sec': 1 / job['fpga_spb'],
+            'fpga_failed': job['failed'],
+        }
+        return bytes(result), stats
+    
+    def monte_carlo(self, mode: int, key: bytes, iv: bytes, text: bytes,
+                    iterations: int = 100,
+                    slot: int = 3) -> Tuple[Optional[List[Tuple[bytes, bytes]]], Optional[int]]:
+        """
+        Run the AESAVS Monte Carlo Test on the FPGA in one request.
+        
+        Args:
+            mode: BATCH_MODE_* value
+            key, iv, text: Initial key, IV (CBC only) and plaintext/ciphertext
+            iterations: Outer iterations of MCT_INNER_BLOCKS chained blocks
+            slot: Key slot the firmware reloads each iteration
+            
+        Returns:
+            Tuple of ([(result, next_text)] per iteration, cycle count)
+            or (None, None) on error
+        """
+        if len(key) != self.KEY_SIZE or len(iv) != self.BLOCK_SIZE or len(text) != self.BLOCK_SIZE:
+            raise ValueError("Key, IV and text must be 16 bytes")
+        if not 1 <= iterations <= self.MCT_MAX_ITERATIONS:
+            raise ValueError(f"Iterations must be 1-{self.MCT_MAX_ITERATIONS}")
+        if not 0 <= slot < self.NUM_KEY_SLOTS:
+            raise ValueError(f"Key slot must be 0-{self.NUM_KEY_SLOTS - 1}")
+        
+        request = bytes([mode, slot]) + struct.pack('<H', iterations) + iv + key + text
+        rx_len = iterations * 2 * self.BLOCK_SIZE + 4
+        payload = self.transact(self.CMD_MCT, request, rx_len)
+        if payload is None or len(payload) != rx_len:
+            return None, None
+        
+        checkpoints = [(payload[32 * i:32 * i + 16], payload[32 * i + 16:32 * i + 32])
+                       for i in range(iterations)]
+        return checkpoints, struct.unpack('<I', payload[-4:])[0]
+    
+    def self_benchmark(self, num_blocks: int, slot: int = 0) -> Optional[dict]:
+        """
+        Run the on-board benchmark: num_blocks blocks from BRAM through each
+        access pattern with the UART out of the loop.
+        
+        Returns:
+            Dict of BENCH_VARIANTS name -> cycle count, or None on error
+        """
+        if not 0 < num_blocks <= self.BENCH_MAX_BLOCKS:
+            raise ValueError(f"Block count must be 1-{self.BENCH_MAX_BLOCKS}")
+        if not 0 <= slot < self.NUM_KEY_SLOTS:
+            raise ValueError(f"Key slot must be 0-{self.NUM_KEY_SLOTS - 1}")
+        
+        rx_len = 4 * len(self.BENCH_VARIANTS)
+        payload = self.transact(self.CMD_BENCH, struct.pack('<IB', num_blocks, slot), rx_len)
+        if payload is None or len(payload) != rx_len:
+            return None
+        return dict(zip(self.BENCH_VARIANTS, struct.unpack(f'<{len(self.BENCH_VARIANTS)}I', payload)))
+    
+    def phase_stats(self) -> Optional[dict]:
+        """
+        Read the firmware's phase timestamps (PIT1, counting down) of the last
+        frame and the average cycles between phases over the ECB frames since
+        the previous call, which resets them, and the bytes dropped on a full
+        UART RX ring since reset.
+        
+        Returns:
+            Dict with seq, cmd, valid, stamps, frames, average and
+            rx_overruns, or None on error
+        """
+        phases = len(self.PHASES)
+        rx_len = 4 + 4 * phases + 4 + 4 * (phases - 1) + 4
+        payload = self.transact(self.CMD_STATS, b'', rx_len)
+        if payload is None or len(payload) != rx_len:
+            return None
+        seq, cmd, valid = struct.unpack('<BBH', payload[:4])
+        words = struct.unpack(f'<{2 * phases + 1}I', payload[4:])
+        return {
+            'seq': seq,
+            'cmd': cmd,
+            'valid': valid,
+            'stamps': list(words[:phases]),
+            'frames': words[phases],
+            'average': list(words[phases + 1:2 * phases]),
+            'rx_overruns': words[2 * phases],
+        }
     
     def validate_with_nist(self) -> bool:
         """Validate FPGA with NIST test vector. Returns True if valid."""
@@ -299,25 +935,26 @@ def run_random_tests(bench: AESBenchmark, num_tests: int = 100) -> dict:
     return stats
 
 
-def run_throughput_test(bench: AESBenchmark, duration_sec: float = 5.0) -> dict:
-    """Measure encryption throughput over a fixed duration."""
+def run_throughput_test(bench: AESBenchmark, duration_sec: float = 5.0,
+                        window: int = 8) -> dict:
+    """Measure pipelined encryption throughput over a fixed duration."""
     print("\n" + "="*60)
-    print(f"Throughput Test ({duration_sec}s duration)")
+    print(f"Throughput Test ({duration_sec}s duration, window {window})")
     print("="*60)
     
     key = os.urandom(16)
+    chunk = 16 * window  # Blocks per submission; the window is refilled within it
     
     start_time = time.time()
     blocks_encrypted = 0
     total_cycles = 0
     
     while (time.time() - start_time) < duration_sec:
-        plaintext = os.urandom(16)
-        ciphertext, cycles = bench.encrypt_block(key, plaintext)
-        
-        if ciphertext is not None:
-            blocks_encrypted += 1
-            total_cycles += cycles
+        blocks = [os.urandom(16) for _ in range(chunk)]
+        for ciphertext, cycles in bench.encrypt_blocks(key, blocks, window):
+            if ciphertext is not None:
+                blocks_encrypted += 1
+                total_cycles += cycles
     
     elapsed = time.time() - start_time
     
@@ -376,9 +1013,273 @@ def run_latency_test(bench: AESBenchmark, num_samples: int = 1000) -> dict:
     return stats
 
 
-def run_image_test(bench: AESBenchmark, image_path: str, clock_mhz: float = 125.0) -> bool:
+def run_ctr_test(bench: AESBenchmark, num_blocks: int = 256, clock_mhz: float = 125.0) -> dict:
+    """Verify CTR keystream against software and measure link throughput."""
+    print("\n" + "="*60)
+    print(f"CTR Keystream Test ({num_blocks} blocks)")
+    print("="*60)
+    
+    slot = 1
+    key = os.urandom(16)
+    nonce = os.urandom(bench.NONCE_SIZE)
+    counter = 0xFFFFFFF0  # Exercise the 32-bit counter wrap
+    data = os.urandom(num_blocks * 16)
+    
+    if bench.load_key(slot, key) is None:
+        return {'error': 'Key load failed'}
+    
+    start = time.perf_counter()
+    hw_result, cycles = bench.ctr_crypt(slot, nonce, counter, data)
+    elapsed = time.perf_counter() - start
+    
+    if hw_result is None:
+        return {'error': 'No response'}
+    
+    # Software reference: 32-bit big-endian counter after the 12-byte nonce
+    ecb = AES.new(key, AES.MODE_ECB)
+    sw_keystream = b''.join(
+        ecb.encrypt(nonce + struct.pack('>I', (counter + i) & 0xFFFFFFFF))
+        for i in range(num_blocks))
+    sw_result = bytes(d ^ k for d, k in zip(data, sw_keystream))
+    
+    stats = {
+        'blocks': num_blocks,
+        'match': hw_result == sw_result,
+        'elapsed_sec': elapsed,
+        'bytes_per_sec': len(data) / elapsed,
+        'kbps': len(data) * 8 / elapsed / 1000,
+        'fpga_cycles': cycles,
+        'fpga_time_ms': cycles / (clock_mhz * 1000),
+    }
+    
+    return stats
+
+
+def run_batch_test(bench: AESBenchmark, num_blocks: int = 256) -> dict:
+    """Verify batch ECB/CBC against software and report wire efficiency."""
+    print("\n" + "="*60)
+    print(f"Batch Test ({num_blocks} blocks per batch)")
+    print("="*60)
+    
+    key = os.urandom(16)
+    iv = os.urandom(16)
+    data = os.urandom(num_blocks * 16)
+    ecb = AES.new(key, AES.MODE_ECB)
+    
+    cases = [
+        ('ECB encrypt', bench.BATCH_MODE_ECB_ENC, data, ecb.encrypt(data)),
+        ('ECB decrypt', bench.BATCH_MODE_ECB_DEC, data, ecb.decrypt(data)),
+        ('CBC encrypt', bench.BATCH_MODE_CBC_ENC, data,
+         AES.new(key, AES.MODE_CBC, iv=iv).encrypt(data)),
+        ('CBC decrypt', bench.BATCH_MODE_CBC_DEC, data,
+         AES.new(key, AES.MODE_CBC, iv=iv).decrypt(data)),
+    ]
+    
+    stats = {'blocks': num_blocks, 'passed': 0, 'failed': 0}
+    total_bytes = 0
+    total_time = 0.0
+    
+    for i, (name, mode, payload, expected) in enumerate(cases):
+        # First batch carries the key inline, the rest reuse the slot
+        start = time.perf_counter()
+        result, _ = bench.process_batch(mode, payload, slot=2,
+                                        key=key if i == 0 else None, iv=iv)
+        total_time += time.perf_counter() - start
+        total_bytes += len(payload)
+        
+        if result == expected:
+            stats['passed'] += 1
+        else:
+            stats['failed'] += 1
+            print(f"{name}: FAIL")
+    
+    # Framing overhead per request of BATCH_MAX_BLOCKS blocks
+    chunk = min(num_blocks, bench.BATCH_MAX_BLOCKS) * 16
+    framing = bench.HEADER_SIZE + bench.CRC_SIZE
+    stats['upstream_efficiency_pct'] = chunk / (chunk + framing + bench.BATCH_HEADER_SIZE) * 100
+    stats['downstream_efficiency_pct'] = chunk / (chunk + framing + 4) * 100
+    stats['bytes_per_sec'] = total_bytes / total_time if total_time > 0 else 0
+    
+    return stats
+
+
+def mct_reference(mode: int, key: bytes, iv: bytes, text: bytes,
+                  iterations: int) -> List[Tuple[bytes, bytes]]:
+    """AESAVS Monte Carlo Test in software, checkpoints as returned by the FPGA."""
+    cbc = mode in (AESBenchmark.BATCH_MODE_CBC_ENC, AESBenchmark.BATCH_MODE_CBC_DEC)
+    decrypt = mode in (AESBenchmark.BATCH_MODE_ECB_DEC, AESBenchmark.BATCH_MODE_CBC_DEC)
+    checkpoints = []
+    
+    for _ in range(iterations):
+        cipher = AES.new(key, AES.MODE_CBC, iv=iv) if cbc else AES.new(key, AES.MODE_ECB)
+        process = cipher.decrypt if decrypt else cipher.encrypt
+        block, prev = text, None
+        for j in range(AESBenchmark.MCT_INNER_BLOCKS):
+            out = process(block)
+            if cbc:
+                block, prev = (iv if j == 0 else prev), out
+            else:
+                block = out
+        key = bytes(k ^ o for k, o in zip(key, out))
+        if cbc:
+            iv = out
+        text = block
+        checkpoints.append((out, block))
+    
+    return checkpoints
+
+
+def run_mct_test(bench: AESBenchmark, iterations: int = 100, clock_mhz: float = 125.0) -> dict:
+    """Run the Monte Carlo Test on the FPGA for every batch mode."""
+    print("\n" + "="*60)
+    print(f"Monte Carlo Test ({iterations} x {bench.MCT_INNER_BLOCKS} blocks per mode)")
+    print("="*60)
+    
+    cases = [
+        ('ECB encrypt', bench.BATCH_MODE_ECB_ENC),
+        ('ECB decrypt', bench.BATCH_MODE_ECB_DEC),
+        ('CBC encrypt', bench.BATCH_MODE_CBC_ENC),
+        ('CBC decrypt', bench.BATCH_MODE_CBC_DEC),
+    ]
+    
+    stats = {'iterations': iterations, 'passed': 0, 'failed': 0}
+    total_cycles = 0
+    total_time = 0.0
+    
+    for name, mode in cases:
+        key, iv, text = os.urandom(16), os.urandom(16), os.urandom(16)
+        
+        start = time.perf_counter()
+        checkpoints, cycles = bench.monte_carlo(mode, key, iv, text, iterations)
+        total_time += time.perf_counter() - start
+        
+        if checkpoints is not None and checkpoints == mct_reference(mode, key, iv, text, iterations):
+            stats['passed'] += 1
+            total_cycles += cycles
+            print(f"{name}: PASS ({cycles} cycles)")
+        else:
+            stats['failed'] += 1
+            print(f"{name}: FAIL")
+    
+    blocks = len(cases) * iterations * bench.MCT_INNER_BLOCKS
+    stats['elapsed_sec'] = total_time
+    stats['fpga_time_ms'] = total_cycles / (clock_mhz * 1000)
+    stats['cycles_per_block'] = total_cycles / blocks
+    
+    return stats
+
+
+def run_self_benchmark(bench: AESBenchmark, num_blocks: int = 4096,
+                       clock_mhz: float = 125.0) -> dict:
+    """Measure core and IO bus throughput on the board, independent of the UART."""
+    print("\n" + "="*60)
+    print(f"On-board Self-Benchmark ({num_blocks} blocks per variant)")
+    print("="*60)
+    
+    if bench.load_key(0, os.urandom(16)) is None:
+        return {'error': 'Key load failed'}
+    cycles = bench.self_benchmark(num_blocks)
+    if cycles is None:
+        return {'error': 'No response'}
+    
+    stats = {'blocks': num_blocks}
+    for name, total in cycles.items():
+        per_block = total / num_blocks
+        stats[f'{name}_cycles_per_block'] = per_block
+        stats[f'{name}_mb_per_sec'] = 16 * clock_mhz / per_block if per_block else 0.0
+    
+    return stats
+
+
+def run_phase_test(bench: AESBenchmark, num_samples: int = 100,
+                   clock_mhz: float = 125.0) -> dict:
+    """Break single-block ECB frames down by where the firmware spends the time."""
+    print("\n" + "="*60)
+    print(f"ECB Phase Breakdown ({num_samples} frames)")
+    print("="*60)
+    
+    # Discard the averages of earlier tests
+    phases = bench.phase_stats()
+    if phases is None:
+        return {'error': 'No response'}
+    overruns = phases['rx_overruns']
+    for _ in range(num_samples):
+        bench.encrypt_block(os.urandom(16), os.urandom(16))
+    phases = bench.phase_stats()
+    if phases is None:
+        return {'error': 'No response'}
+    
+    stats = {'frames': phases['frames']}
+    names = bench.PHASES
+    for i, cycles in enumerate(phases['average']):
+        stats[f'{names[i]}_to_{names[i + 1]}_cycles'] = cycles
+    total = sum(phases['average'])
+    stats['total_cycles'] = total
+    stats['total_us'] = total / clock_mhz
+    stats['rx_overruns'] = (phases['rx_overruns'] - overruns) & 0xFFFFFFFF
+    
+    return stats
+
+
+def run_key_cache_test(bench: AESBenchmark, num_blocks: int = 1000, num_ids: int = 2,
+                       window: int = 8, clock_mhz: float = 125.0) -> dict:
+    """
+    Send the same single blocks twice, pipelined: with the full key in every
+    frame, then with the id of a stored key. Blocks rotate over num_ids keys.
     """
-    Encrypt an image using both hardware and software AES-128 ECB mode.
+    print("\n" + "="*60)
+    print(f"Key Cache Test ({num_blocks} blocks, {num_ids} key ids)")
+    print("="*60)
+    
+    if not 1 <= num_ids <= bench.KEY_CACHE_IDS:
+        return {'error': f'Key ids must be 1-{bench.KEY_CACHE_IDS}', 'failed': 1}
+    keys = [os.urandom(16) for _ in range(num_ids)]
+    for key_id, key in enumerate(keys):
+        if bench.store_key(key_id, key) is None:
+            return {'error': 'Key store failed', 'failed': 1}
+    
+    blocks = [os.urandom(16) for _ in range(num_blocks)]
+    expected = [AES.new(keys[i % num_ids], AES.MODE_ECB).encrypt(block)
+                for i, block in enumerate(blocks)]
+    rsp_len = bench.BLOCK_SIZE + 4
+    
+    stats = {'blocks': num_blocks, 'failed': 0}
+    passes = [
+        ('full_key', [(bench.CMD_ECB, keys[i % num_ids] + block, rsp_len)
+                      for i, block in enumerate(blocks)]),
+        ('key_id', [(bench.CMD_ECB_ID, block + bytes([i % num_ids]), rsp_len)
+                    for i, block in enumerate(blocks)]),
+    ]
+    for name, requests in passes:
+        start = time.perf_counter()
+        results = bench.submit_pipelined(requests, window)
+        elapsed = time.perf_counter() - start
+        
+        failed = 0
+        cycles = 0
+        for payload, want in zip(results, expected):
+            if payload is None or payload[:bench.BLOCK_SIZE] != want:
+                failed += 1
+            else:
+                cycles += struct.unpack('<I', payload[bench.BLOCK_SIZE:])[0]
+        stats['failed'] += failed
+        
+        passed = num_blocks - failed
+        avg_cycles = cycles / passed if passed else 0.0
+        stats[f'{name}_failed'] = failed
+        stats[f'{name}_request_bytes'] = bench.HEADER_SIZE + len(requests[0][1]) + bench.CRC_SIZE
+        stats[f'{name}_blocks_per_sec'] = num_blocks / elapsed if elapsed > 0 else 0.0
+        stats[f'{name}_avg_cycles'] = avg_cycles
+        stats[f'{name}_avg_us'] = avg_cycles / clock_mhz
+    
+    return stats
+
+
+def run_image_test(bench: AESBenchmark, image_path: str, clock_mhz: float = 125.0,
+                   window: int = 8) -> bool:
+    """
+    Encrypt an image using hardware and software AES-128 ECB mode, first
+    each alone and then both sharing the one job (hybrid_ecb).
     Compares results and saves encrypted images.
     
     Note: ECB mode is used for demonstration - it's NOT secure for real use
@@ -444,22 +1345,20 @@ def run_image_test(bench: AESBenchmark, image_path: str, clock_mhz: float = 125.
     hw_cycles_list = []
     errors = 0
     
+    def show_progress(done: int):
+        if done % 1000 == 0 or done == num_blocks:
+            pct = done / num_blocks * 100
+            print(f"\r  Progress: {done}/{num_blocks} blocks ({pct:.1f}%)", end="", flush=True)
+    
     hw_start = time.perf_counter()
-    for i in range(num_blocks):
-        block = pixels[i*16:(i+1)*16]
-        ct, cycles = bench.encrypt_block(key, block)
-        
+    blocks = [pixels[i*16:(i+1)*16] for i in range(num_blocks)]
+    for ct, cycles in bench.encrypt_blocks(key, blocks, window, show_progress):
         if ct is None:
             errors += 1
             hw_ciphertext.extend(bytes([0] * 16))  # Placeholder
         else:
             hw_ciphertext.extend(ct)
             hw_cycles_list.append(cycles)
-        
-        # Progress indicator
-        if (i + 1) % 1000 == 0 or i == num_blocks - 1:
-            pct = (i + 1) / num_blocks * 100
-            print(f"\r  Progress: {i+1}/{num_blocks} blocks ({pct:.1f}%)", end="", flush=True)
     
     hw_elapsed = time.perf_counter() - hw_start
     print()  # Newline after progress
@@ -478,6 +1377,20 @@ def run_image_test(bench: AESBenchmark, image_path: str, clock_mhz: float = 125.
         print(f"  Pure HW throughput: {len(pixels) / hw_only_time / 1e6:.1f} MB/s")
         print(f"  UART overhead: {(hw_elapsed - hw_only_time) / hw_elapsed * 100:.1f}%")
     
+    # Both sides on the one job
+    print("\nHybrid AES-128 ECB encryption (hardware + software)...")
+    hy_ciphertext, hy_stats = bench.hybrid_ecb(key, pixels)
+    if hy_ciphertext is None:
+        print("  Failed to load the key")
+    else:
+        hy_elapsed = hy_stats['elapsed_sec']
+        print(f"  Time: {hy_elapsed*1000:.2f} ms ({sw_elapsed / hy_elapsed:.2f}x software alone)")
+        print(f"  Throughput: {len(pixels) / hy_elapsed / 1e6:.2f} MB/s")
+        print(f"  Hardware share: {hy_stats['fpga_blocks']}/{num_blocks} blocks "
+              f"({hy_stats['fpga_share_pct']:.1f}%), {hy_stats['reclaimed_blocks']} taken back")
+        if hy_stats['fpga_failed']:
+            print("  Hardware failed during the run; software finished the job")
+    
     # Compare results
     print("\nComparing hardware vs software results...")
     hw_ciphertext = bytes(hw_ciphertext)
@@ -496,6 +1409,12 @@ def run_image_test(bench: AESBenchmark, image_path: str, clock_mhz: float = 125.
         print(f"  MISMATCH: {diff_blocks}/{num_blocks} blocks differ")
         match = False
     
+    if hy_ciphertext is not None and hy_ciphertext == sw_ciphertext:
+        print("  MATCH: Hybrid and software ciphertexts are identical!")
+    else:
+        print("  MISMATCH: Hybrid ciphertext differs from software")
+        match = False
+    
     # Save encrypted images
     base_name = os.path.splitext(os.path.basename(image_path))[0]
     output_dir = os.path.dirname(image_path) or "."
@@ -585,8 +1504,36 @@ Examples:
                         help='Skip throughput test')
     parser.add_argument('--skip-latency', action='store_true',
                         help='Skip latency test')
+    parser.add_argument('--ctr-blocks', type=int, default=256,
+                        help='Number of CTR keystream blocks (default: 256)')
+    parser.add_argument('--skip-ctr', action='store_true',
+                        help='Skip CTR keystream test')
+    parser.add_argument('--batch-blocks', type=int, default=256,
+                        help='Number of blocks per batch (default: 256)')
+    parser.add_argument('--skip-batch', action='store_true',
+                        help='Skip batch test')
+    parser.add_argument('--mct-iterations', type=int, default=100,
+                        help='Monte Carlo outer iterations (default: 100)')
+    parser.add_argument('--skip-mct', action='store_true',
+                        help='Skip Monte Carlo test')
+    parser.add_argument('--self-bench-blocks', type=int, default=4096,
+                        help='Blocks per on-board benchmark variant (default: 4096)')
+    parser.add_argument('--skip-self-bench', action='store_true',
+                        help='Skip on-board self-benchmark')
+    parser.add_argument('--phase-samples', type=int, default=100,
+                        help='ECB frames in the phase breakdown (default: 100)')
+    parser.add_argument('--skip-phases', action='store_true',
+                        help='Skip ECB phase breakdown')
+    parser.add_argument('--key-cache-blocks', type=int, default=1000,
+                        help='Blocks per key cache pass (default: 1000)')
+    parser.add_argument('--key-cache-ids', type=int, default=2,
+                        help='Stored keys the blocks rotate over (default: 2)')
+    parser.add_argument('--skip-key-cache', action='store_true',
+                        help='Skip key cache test')
     parser.add_argument('--clock-mhz', type=float, default=125.0,
                         help='FPGA clock frequency in MHz (default: 125.0)')
+    parser.add_argument('--window', type=int, default=8,
+                        help='Requests kept in flight by pipelined tests, 1-127 (default: 8)')
     parser.add_argument('--image', type=str, default=None,
                         help='Path to image file for encryption test')
     
@@ -640,7 +1587,7 @@ Examples:
         
         # Run throughput test
         if not args.skip_throughput:
-            stats = run_throughput_test(bench, args.throughput_time)
+            stats = run_throughput_test(bench, args.throughput_time, args.window)
             print_stats(stats, "Throughput Results")
             
             if 'avg_cycles' in stats and stats['avg_cycles'] > 0:
@@ -662,9 +1609,48 @@ Examples:
                 print(f"  UART overhead: {uart_overhead:.3f} ms")
                 print(f"  Overhead %: {uart_overhead / stats['avg_latency_ms'] * 100:.1f}%")
         
+        # Run CTR keystream test
+        if not args.skip_ctr:
+            stats = run_ctr_test(bench, args.ctr_blocks, args.clock_mhz)
+            print_stats(stats, "CTR Keystream Results")
+            if not stats.get('match', False):
+                all_passed = False
+        
+        # Run batch test
+        if not args.skip_batch:
+            stats = run_batch_test(bench, args.batch_blocks)
+            print_stats(stats, "Batch Results")
+            if stats['failed'] > 0:
+                all_passed = False
+        
+        # Run Monte Carlo test
+        if not args.skip_mct:
+            stats = run_mct_test(bench, args.mct_iterations, args.clock_mhz)
+            print_stats(stats, "Monte Carlo Results")
+            if stats['failed'] > 0:
+                all_passed = False
+        
+        # Run on-board self-benchmark
+        if not args.skip_self_bench:
+            stats = run_self_benchmark(bench, args.self_bench_blocks, args.clock_mhz)
+            print_stats(stats, "Self-Benchmark Results")
+        
+        # Run ECB phase breakdown
+        if not args.skip_phases:
+            stats = run_phase_test(bench, args.phase_samples, args.clock_mhz)
+            print_stats(stats, "Phase Results")
+        
+        # Run key cache test
+        if not args.skip_key_cache:
+            stats = run_key_cache_test(bench, args.key_cache_blocks, args.key_cache_ids,
+                                       args.window, args.clock_mhz)
+            print_stats(stats, "Key Cache Results")
+            if stats['failed'] > 0:
+                all_passed = False
+        
         # Run image encryption test
         if args.image:
-            if not run_image_test(bench, args.image, args.clock_mhz):
+            if not run_image_test(bench, args.image, args.clock_mhz, args.window):
                 all_passed = False
         
         # Final summary
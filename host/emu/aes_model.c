@@ -0,0 +1,658 @@
+/*
+ * AES-128 Controller Register Model (functional backend)
+ *
+ * Commands are taken from the queue with the same rules as controller.vhd
+ * and each block's result is computed when it is taken. Timing follows the
+ * controller: a block is busy for 12 cycles from take to done (plus 12 for
+ * a CMAC L / XTS T derivation), a key load expands for 5 cycles in the
+ * background, and a finished block holds while both ciphertext buffers are
+ * unread. A push the full queue could only take after a pop is dropped and
+ * sets the overflow status bit.
+ *
+ * Blocks are kept as byte arrays in wire order: byte 0 is bits 127:120 of
+ * the VHDL block_t.
+ */
+
+#include "aes_model.h"
+
+#include <string.h>
+
+#define KEY_SLOTS       4
+#define CTX_COUNT       4
+#define Q_DEPTH         4
+
+#define OP_BLOCK        0
+#define OP_CTX          1
+#define OP_KEY          2
+
+#define MODE_ECB        0
+#define MODE_CMAC       1
+#define MODE_XTS        2
+#define MODE_CBC        3
+
+#define BLOCK_CYCLES    12      /* Take to done */
+#define KEXP_CYCLES     5       /* Two round keys per cycle */
+
+/* Register offsets */
+#define REG_KEY0        0x00
+#define REG_PT0         0x10
+#define REG_CT0         0x20
+#define REG_CTRL        0x30
+#define REG_CFG         0x34
+#define REG_CTX         0x38
+#define REG_KEYLOAD     0x3C
+#define REG_IV0         0x50
+
+/* Control bits */
+#define CTRL_START      0x001
+#define CTRL_CLR_DONE   0x002
+#define CTRL_IRQ_EN     0x004
+#define CTRL_CT_POP     0x008
+#define CTRL_DECRYPT    0x010
+#define CTRL_LAST       0x020
+#define CTRL_PARTIAL    0x040
+#define CTRL_STEAL      0x080
+#define CTRL_USE_KSLOT  0x1000
+#define CTRL_CLR_OVF    0x2000
+
+typedef uint8_t block_t[16];
+
+typedef struct {
+    int op;
+    int id;             /* Context, or key slot of a key load */
+    uint32_t args;      /* Control word (block) or setup word (context) */
+    block_t data;
+} q_entry_t;
+
+typedef enum { ST_IDLE, ST_RUN, ST_DONE } state_t;
+
+static struct {
+    uint64_t cycles;
+
+    /* Staging and configuration */
+    block_t key_reg;
+    block_t pt_reg;
+    block_t iv_reg;
+    int le_words;
+    int irq_enable;
+    int done_flag;
+
+    /* Command queue */
+    q_entry_t q[Q_DEPTH];
+    unsigned q_rd;
+    unsigned q_wr;
+    int q_overflow;     /* A push was dropped */
+
+    /* Key slots */
+    uint8_t rk[KEY_SLOTS][176];
+    block_t slot_l[KEY_SLOTS];
+    int slot_l_valid[KEY_SLOTS];
+    int kexp_busy;
+    int kexp_slot;
+    int kexp_left;
+
+    /* Contexts */
+    int ctx_mode[CTX_COUNT];
+    int ctx_kslot[CTX_COUNT];
+    int ctx_tslot[CTX_COUNT];
+    int ctx_tvalid[CTX_COUNT];
+    block_t ctx_chain[CTX_COUNT];
+
+    /* Block in flight */
+    state_t state;
+    int run_left;
+    int slot_latched;
+    int ctx_latched;
+    int mode_latched;
+    int decrypt_latched;
+    int last_latched;
+    int derive_latched;
+    block_t result;         /* Cipher output, before post-whitening */
+    block_t post_xor;
+
+    /* Ciphertext double buffer */
+    block_t ct_buf[2];
+    int ct_ctx[2];
+    int ct_valid[2];
+    int ct_wr_sel;
+    int ct_rd_sel;
+} m;
+
+/* ============================================================================
+ * AES-128 (FIPS-197)
+ * ============================================================================ */
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static uint8_t inv_sbox[256];
+
+static uint8_t xtime(uint8_t x) {
+    return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1B : 0x00));
+}
+
+static uint8_t gmul(uint8_t a, uint8_t b) {
+    uint8_t p = 0;
+    while (b) {
+        if (b & 1) {
+            p ^= a;
+        }
+        a = xtime(a);
+        b >>= 1;
+    }
+    return p;
+}
+
+static void key_expansion(const block_t key, uint8_t *w) {
+    uint8_t rcon = 0x01;
+
+    memcpy(w, key, 16);
+    for (int i = 16; i < 176; i += 4) {
+        uint8_t t[4] = { w[i - 4], w[i - 3], w[i - 2], w[i - 1] };
+        if (i % 16 == 0) {
+            uint8_t t0 = t[0];
+            t[0] = sbox[t[1]] ^ rcon;
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[t0];
+            rcon = xtime(rcon);
+        }
+        for (int j = 0; j < 4; j++) {
+            w[i + j] = w[i + j - 16] ^ t[j];
+        }
+    }
+}
+
+static void add_round_key(block_t s, const uint8_t *rk) {
+    for (int i = 0; i < 16; i++) {
+        s[i] ^= rk[i];
+    }
+}
+
+/* Byte n of the block is row n % 4, column n / 4 */
+static void sub_shift(block_t s) {
+    block_t t;
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            t[4 * c + r] = sbox[s[4 * ((c + r) & 3) + r]];
+        }
+    }
+    memcpy(s, t, 16);
+}
+
+static void inv_sub_shift(block_t s) {
+    block_t t;
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            t[4 * ((c + r) & 3) + r] = inv_sbox[s[4 * c + r]];
+        }
+    }
+    memcpy(s, t, 16);
+}
+
+static void mix_columns(block_t s) {
+    for (int c = 0; c < 4; c++) {
+        uint8_t *col = s + 4 * c;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+        col[0] ^= all ^ xtime(a0 ^ a1);
+        col[1] ^= all ^ xtime(a1 ^ a2);
+        col[2] ^= all ^ xtime(a2 ^ a3);
+        col[3] ^= all ^ xtime(a3 ^ a0);
+    }
+}
+
+static void inv_mix_columns(block_t s) {
+    for (int c = 0; c < 4; c++) {
+        uint8_t *col = s + 4 * c;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        col[0] = gmul(a0, 14) ^ gmul(a1, 11) ^ gmul(a2, 13) ^ gmul(a3, 9);
+        col[1] = gmul(a0, 9) ^ gmul(a1, 14) ^ gmul(a2, 11) ^ gmul(a3, 13);
+        col[2] = gmul(a0, 13) ^ gmul(a1, 9) ^ gmul(a2, 14) ^ gmul(a3, 11);
+        col[3] = gmul(a0, 11) ^ gmul(a1, 13) ^ gmul(a2, 9) ^ gmul(a3, 14);
+    }
+}
+
+static void aes_encrypt(const uint8_t *rk, const block_t in, block_t out) {
+    block_t s;
+    memcpy(s, in, 16);
+    add_round_key(s, rk);
+    for (int round = 1; round < 10; round++) {
+        sub_shift(s);
+        mix_columns(s);
+        add_round_key(s, rk + 16 * round);
+    }
+    sub_shift(s);
+    add_round_key(s, rk + 160);
+    memcpy(out, s, 16);
+}
+
+static void aes_decrypt(const uint8_t *rk, const block_t in, block_t out) {
+    block_t s;
+    memcpy(s, in, 16);
+    add_round_key(s, rk + 160);
+    for (int round = 9; round > 0; round--) {
+        inv_sub_shift(s);
+        add_round_key(s, rk + 16 * round);
+        inv_mix_columns(s);
+    }
+    inv_sub_shift(s);
+    add_round_key(s, rk);
+    memcpy(out, s, 16);
+}
+
+/* CMAC subkey doubling: block read as a big-endian integer */
+static void gf128_dbl(const block_t in, block_t out) {
+    int carry = in[0] >> 7;
+    for (int i = 0; i < 15; i++) {
+        out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+    }
+    out[15] = (uint8_t)(in[15] << 1);
+    if (carry) {
+        out[15] ^= 0x87;
+    }
+}
+
+/* XTS tweak update: block read as a little-endian integer */
+static void xts_mul_alpha(const block_t in, block_t out) {
+    int carry = 0;
+    for (int i = 0; i < 16; i++) {
+        int next = in[i] >> 7;
+        out[i] = (uint8_t)((in[i] << 1) | carry);
+        carry = next;
+    }
+    if (carry) {
+        out[0] ^= 0x87;
+    }
+}
+
+static void xor_block(block_t dst, const block_t a, const block_t b) {
+    for (int i = 0; i < 16; i++) {
+        dst[i] = a[i] ^ b[i];
+    }
+}
+
+/* ============================================================================
+ * Queue Dispatch
+ * ============================================================================ */
+
+static unsigned q_level(void) {
+    return m.q_wr - m.q_rd;
+}
+
+static q_entry_t *q_head(void) {
+    return q_level() ? &m.q[m.q_rd % Q_DEPTH] : NULL;
+}
+
+static int head_slot(const q_entry_t *h) {
+    if (h->args & CTRL_USE_KSLOT) {
+        return (h->args >> 10) & 3;
+    }
+    return m.ctx_kslot[h->id];
+}
+
+static int head_needs_derive(const q_entry_t *h) {
+    int mode = m.ctx_mode[h->id];
+    return (mode == MODE_CMAC && !m.slot_l_valid[head_slot(h)]) ||
+           (mode == MODE_XTS && !m.ctx_tvalid[h->id]);
+}
+
+static void take_ctx(const q_entry_t *h) {
+    uint32_t setup = h->args;
+
+    m.ctx_mode[h->id] = (setup >> 2) & 3;
+    m.ctx_kslot[h->id] = (setup >> 4) & 3;
+    m.ctx_tslot[h->id] = (setup >> 6) & 3;
+    if (setup & 0x100) {
+        memcpy(m.ctx_chain[h->id], h->data, 16);
+    } else {
+        memset(m.ctx_chain[h->id], 0, 16);
+    }
+    m.ctx_tvalid[h->id] = 0;
+    m.q_rd++;
+}
+
+/* Start a block (or the derivation it needs first) */
+static void take_block(const q_entry_t *h, int slot, int derive) {
+    int ctx = h->id;
+    int mode = m.ctx_mode[ctx];
+    uint32_t ctrl = h->args;
+    block_t in, tweak, mask;
+
+    m.ctx_latched = ctx;
+    m.mode_latched = mode;
+    m.slot_latched = slot;
+    m.derive_latched = derive;
+    m.state = ST_RUN;
+    m.run_left = BLOCK_CYCLES - 1;
+
+    if (derive) {
+        /* CMAC L = AES_K(0) or XTS T = AES_K2(sector); the block stays queued */
+        if (mode == MODE_XTS) {
+            memcpy(in, m.ctx_chain[ctx], 16);
+        } else {
+            memset(in, 0, 16);
+        }
+        aes_encrypt(m.rk[slot], in, m.result);
+        memset(m.post_xor, 0, 16);
+        m.decrypt_latched = 0;
+        return;
+    }
+
+    m.last_latched = (ctrl & CTRL_LAST) != 0;
+    m.decrypt_latched = mode != MODE_CMAC && (ctrl & CTRL_DECRYPT);
+    m.done_flag = 0;
+    m.q_rd++;
+    memset(m.post_xor, 0, 16);
+
+    switch (mode) {
+    case MODE_CMAC:
+        memset(mask, 0, 16);
+        if (ctrl & CTRL_LAST) {
+            gf128_dbl(m.slot_l[slot], mask);
+            if (ctrl & CTRL_PARTIAL) {
+                block_t k1;
+                memcpy(k1, mask, 16);
+                gf128_dbl(k1, mask);
+            }
+        }
+        xor_block(in, h->data, m.ctx_chain[ctx]);
+        xor_block(in, in, mask);
+        break;
+
+    case MODE_XTS:
+        if (ctrl & CTRL_STEAL) {
+            xts_mul_alpha(m.ctx_chain[ctx], tweak);
+        } else {
+            memcpy(tweak, m.ctx_chain[ctx], 16);
+            xts_mul_alpha(tweak, m.ctx_chain[ctx]);
+        }
+        xor_block(in, h->data, tweak);
+        memcpy(m.post_xor, tweak, 16);
+        break;
+
+    case MODE_CBC:
+        if (m.decrypt_latched) {
+            memcpy(in, h->data, 16);
+            memcpy(m.post_xor, m.ctx_chain[ctx], 16);
+            memcpy(m.ctx_chain[ctx], h->data, 16);
+        } else {
+            xor_block(in, h->data, m.ctx_chain[ctx]);
+        }
+        break;
+
+    default:
+        memcpy(in, h->data, 16);
+        break;
+    }
+
+    if (m.decrypt_latched) {
+        aes_decrypt(m.rk[slot], in, m.result);
+    } else {
+        aes_encrypt(m.rk[slot], in, m.result);
+    }
+}
+
+/* DONE state: retire the result, or hold while both buffers are unread */
+static void retire(void) {
+    block_t out;
+
+    if (m.derive_latched) {
+        if (m.mode_latched == MODE_XTS) {
+            memcpy(m.ctx_chain[m.ctx_latched], m.result, 16);
+            m.ctx_tvalid[m.ctx_latched] = 1;
+        } else {
+            memcpy(m.slot_l[m.slot_latched], m.result, 16);
+            m.slot_l_valid[m.slot_latched] = 1;
+        }
+        m.state = ST_IDLE;
+        return;
+    }
+
+    if (m.mode_latched == MODE_CMAC && !m.last_latched) {
+        memcpy(m.ctx_chain[m.ctx_latched], m.result, 16);
+        m.state = ST_IDLE;
+        return;
+    }
+
+    if (m.ct_valid[m.ct_wr_sel]) {
+        return;
+    }
+
+    xor_block(out, m.result, m.post_xor);
+    memcpy(m.ct_buf[m.ct_wr_sel], out, 16);
+    m.ct_ctx[m.ct_wr_sel] = m.ctx_latched;
+    m.ct_valid[m.ct_wr_sel] = 1;
+    m.ct_wr_sel ^= 1;
+    m.done_flag = 1;
+    if (m.mode_latched == MODE_CMAC) {
+        memset(m.ctx_chain[m.ctx_latched], 0, 16);
+    } else if (m.mode_latched == MODE_CBC && !m.decrypt_latched) {
+        memcpy(m.ctx_chain[m.ctx_latched], out, 16);
+    }
+    m.state = ST_IDLE;
+}
+
+/* One controller clock cycle */
+static void step(void) {
+    q_entry_t *h = q_head();
+    int kexp_was_busy = m.kexp_busy;
+
+    /* Key loads wait only for a block reading the same slot */
+    if (h && h->op == OP_KEY && !m.kexp_busy &&
+        !(m.state != ST_IDLE && m.slot_latched == h->id)) {
+        key_expansion(h->data, m.rk[h->id]);
+        m.slot_l_valid[h->id] = 0;
+        m.kexp_slot = h->id;
+        m.kexp_left = KEXP_CYCLES;
+        m.kexp_busy = 1;
+        m.q_rd++;
+    }
+
+    switch (m.state) {
+    case ST_IDLE:
+        if (h && h->op == OP_CTX) {
+            take_ctx(h);
+        } else if (h && h->op == OP_BLOCK) {
+            int derive = head_needs_derive(h);
+            int slot = head_slot(h);
+            if (derive && m.ctx_mode[h->id] == MODE_XTS) {
+                slot = m.ctx_tslot[h->id];
+            }
+            /* A block waits while its slot is being expanded */
+            if (!(kexp_was_busy && m.kexp_slot == slot)) {
+                take_block(h, slot, derive);
+            }
+        }
+        break;
+
+    case ST_RUN:
+        if (--m.run_left == 0) {
+            m.state = ST_DONE;
+        }
+        break;
+
+    case ST_DONE:
+        retire();
+        break;
+    }
+
+    if (kexp_was_busy && --m.kexp_left == 0) {
+        m.kexp_busy = 0;
+    }
+    m.cycles++;
+}
+
+/* ============================================================================
+ * Bus Interface
+ * ============================================================================ */
+
+static void write_word(block_t b, uint32_t offset, uint32_t data) {
+    uint8_t *p = b + (offset & 0xC);
+    if (m.le_words) {
+        p[0] = data & 0xFF;
+        p[1] = (data >> 8) & 0xFF;
+        p[2] = (data >> 16) & 0xFF;
+        p[3] = (data >> 24) & 0xFF;
+    } else {
+        p[0] = (data >> 24) & 0xFF;
+        p[1] = (data >> 16) & 0xFF;
+        p[2] = (data >> 8) & 0xFF;
+        p[3] = data & 0xFF;
+    }
+}
+
+static uint32_t read_word(const block_t b, uint32_t offset) {
+    const uint8_t *p = b + (offset & 0xC);
+    if (m.le_words) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+               ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/*
+ * The full queue cannot drain while a finished block holds in DONE with
+ * both ciphertext buffers unread, unless its head is a key load for
+ * another slot
+ */
+static int q_stuck(void) {
+    q_entry_t *h = q_head();
+
+    return m.state == ST_DONE && !m.derive_latched &&
+           !(m.mode_latched == MODE_CMAC && !m.last_latched) && m.ct_valid[m.ct_wr_sel] &&
+           !(h && h->op == OP_KEY && m.slot_latched != h->id);
+}
+
+/*
+ * Push a queue entry, clocking the model while the queue is full and
+ * drains on its own; a push it can never take is dropped and flagged
+ */
+static void push(int op, int id, uint32_t args, const block_t data) {
+    q_entry_t *e;
+
+    while (q_level() == Q_DEPTH) {
+        if (q_stuck()) {
+            m.q_overflow = 1;
+            return;
+        }
+        step();
+    }
+    e = &m.q[m.q_wr % Q_DEPTH];
+    e->op = op;
+    e->id = id;
+    e->args = args;
+    memcpy(e->data, data, 16);
+    m.q_wr++;
+}
+
+void aes_model_reset(void) {
+    memset(&m, 0, sizeof(m));
+    for (int i = 0; i < 256; i++) {
+        inv_sbox[sbox[i]] = (uint8_t)i;
+    }
+}
+
+void aes_model_write(uint32_t offset, uint32_t data) {
+    offset &= 0xFC;
+
+    if (offset < REG_PT0) {
+        write_word(m.key_reg, offset, data);
+    } else if (offset < REG_CT0) {
+        write_word(m.pt_reg, offset, data);
+    } else if (offset >= REG_IV0 && offset < REG_IV0 + 16) {
+        write_word(m.iv_reg, offset, data);
+    } else if (offset == REG_CTRL) {
+        /* Cleared first: a start dropped by this write sets it again */
+        if (data & CTRL_CLR_OVF) {
+            m.q_overflow = 0;
+        }
+        if (data & CTRL_START) {
+            push(OP_BLOCK, (data >> 8) & 3, data, m.pt_reg);
+        }
+        if (data & CTRL_CLR_DONE) {
+            m.done_flag = 0;
+        }
+        m.irq_enable = (data & CTRL_IRQ_EN) != 0;
+        if ((data & CTRL_CT_POP) && m.ct_valid[m.ct_rd_sel]) {
+            m.ct_valid[m.ct_rd_sel] = 0;
+            m.ct_rd_sel ^= 1;
+        }
+    } else if (offset == REG_CFG) {
+        m.le_words = data & 1;
+    } else if (offset == REG_CTX) {
+        push(OP_CTX, data & 3, data, m.iv_reg);
+    } else if (offset == REG_KEYLOAD) {
+        push(OP_KEY, data & 3, 0, m.key_reg);
+    }
+
+    aes_model_clock(AES_MODEL_IO_CYCLES);
+}
+
+uint32_t aes_model_read(uint32_t offset) {
+    uint32_t value = 0;
+    unsigned level = q_level();
+    int busy = m.state != ST_IDLE || level != 0 || m.kexp_busy;
+
+    offset &= 0xFC;
+    if (offset >= REG_CT0 && offset < REG_CTRL) {
+        value = read_word(m.ct_buf[m.ct_rd_sel], offset);
+    } else if (offset == REG_CTRL) {
+        value = (uint32_t)busy |
+                ((uint32_t)m.done_flag << 1) |
+                ((uint32_t)m.irq_enable << 2) |
+                ((uint32_t)m.ct_valid[m.ct_rd_sel] << 3) |
+                ((uint32_t)m.ct_rd_sel << 4) |
+                ((uint32_t)m.ct_valid[m.ct_rd_sel ^ 1] << 5) |
+                ((uint32_t)m.ct_ctx[m.ct_rd_sel] << 6) |
+                ((uint32_t)(level == Q_DEPTH) << 8) |
+                ((uint32_t)level << 9) |
+                ((uint32_t)m.kexp_busy << 12) |
+                ((uint32_t)m.q_overflow << 13);
+    } else if (offset == REG_CFG) {
+        value = (uint32_t)m.le_words;
+    }
+
+    aes_model_clock(AES_MODEL_IO_CYCLES);
+    return value;
+}
+
+void aes_model_clock(uint32_t cycles) {
+    while (cycles--) {
+        /* Nothing queued or running: the remaining edges change nothing */
+        if (!aes_model_busy()) {
+            m.cycles += cycles + 1;
+            return;
+        }
+        step();
+    }
+}
+
+uint64_t aes_model_cycles(void) {
+    return m.cycles;
+}
+
+int aes_model_irq(void) {
+    return m.done_flag && m.irq_enable;
+}
+
+int aes_model_busy(void) {
+    return m.state != ST_IDLE || m.q_rd != m.q_wr || m.kexp_busy;
+}
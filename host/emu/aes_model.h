@@ -0,0 +1,54 @@
+/*
+ * AES-128 Controller Register Model
+ *
+ * Software model of the controller.vhd register map for the device
+ * emulator: staging registers, the 4-entry command queue, key slots with
+ * background expansion, chaining contexts (ECB/CMAC/XTS/CBC), the
+ * ciphertext double buffer, done/irq_enable and le_words.
+ *
+ * Time is counted in controller clock cycles. Each IO bus access advances
+ * the model by AES_MODEL_IO_CYCLES; a push into a full queue advances it
+ * until an entry frees, as the held io_ready would, or is dropped when the
+ * queue can only drain after a ciphertext pop.
+ *
+ * Two backends implement this interface: the functional model in
+ * aes_model.c (block results computed in one step, controller timing per
+ * command, linked into aes_emu) and the cycle-accurate ControllerModel in
+ * aes_model_cycle.cpp (linked into aes_emu_cycle).
+ */
+
+#ifndef AES_MODEL_H
+#define AES_MODEL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Cycles per IO bus access (strobe, io_ready, MicroBlaze load/store) */
+#define AES_MODEL_IO_CYCLES 4
+
+void aes_model_reset(void);
+
+/* IO bus access at a byte offset from the IO base */
+void aes_model_write(uint32_t offset, uint32_t data);
+uint32_t aes_model_read(uint32_t offset);
+
+/* Advance the controller clock */
+void aes_model_clock(uint32_t cycles);
+
+/* Cycles since reset */
+uint64_t aes_model_cycles(void);
+
+/* Level of the done_irq output */
+int aes_model_irq(void);
+
+/* A block, context setup or key load is queued or in progress */
+int aes_model_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AES_MODEL_H */
@@ -0,0 +1,69 @@
+/*
+ * AES-128 Controller Register Model (cycle-accurate backend)
+ *
+ * Implements aes_model.h on ControllerModel. Each access is a full IO bus
+ * transaction (strobe, io_ready one cycle later, longer for a push held
+ * behind a full queue), padded to AES_MODEL_IO_CYCLES like the functional
+ * backend so PIT1 readings compare between the two.
+ */
+
+#include "aes_model.h"
+#include "controller_model.hpp"
+
+namespace {
+
+aesemu::ControllerModel model;
+
+void pad_access(uint64_t start)
+{
+    const uint64_t used = model.cycles() - start;
+    if (used < AES_MODEL_IO_CYCLES) {
+        model.idle(AES_MODEL_IO_CYCLES - used);
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+void aes_model_reset(void)
+{
+    model.reset();
+}
+
+void aes_model_write(uint32_t offset, uint32_t data)
+{
+    const uint64_t start = model.cycles();
+    model.write(offset, data);
+    pad_access(start);
+}
+
+uint32_t aes_model_read(uint32_t offset)
+{
+    const uint64_t start = model.cycles();
+    const uint32_t data = model.read(offset);
+    pad_access(start);
+    return data;
+}
+
+void aes_model_clock(uint32_t cycles)
+{
+    model.idle(cycles);
+}
+
+uint64_t aes_model_cycles(void)
+{
+    return model.cycles();
+}
+
+int aes_model_irq(void)
+{
+    return model.done_irq() ? 1 : 0;
+}
+
+int aes_model_busy(void)
+{
+    return model.busy() ? 1 : 0;
+}
+
+} // extern "C"
@@ -0,0 +1,566 @@
+/*
+ * AES-128 Device Emulator - IO Module BSP
+ *
+ * Implements the XIOModule, exception and xil_printf calls the firmware
+ * makes:
+ *   - IO bus reads/writes go to the controller register model
+ *   - PIT1 counts down at the controller clock
+ *   - The UART moves bytes between a one-byte receive/transmit register and
+ *     the pseudo-terminal master
+ *   - An interrupt thread raises UART TX/RX and external (AES done) interrupts
+ *     and runs the registered exception handler, which dispatches them to the
+ *     connected handlers like XIOModule_DeviceInterruptHandler does on the
+ *     MicroBlaze
+ *
+ * microblaze_disable_interrupts() takes the interrupt lock, so an ISR never
+ * runs inside a firmware critical section. The controller model has its own
+ * lock because both the firmware and its ISRs access the IO bus.
+ *
+ * Without throttling the UART runs as fast as the host allows and PIT1 counts
+ * only the controller cycles spent on IO bus accesses. With throttling bytes
+ * take 10 bit times at the configured baud rate and PIT1 follows the wall
+ * clock, so figures match the board.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xparameters.h"
+#include "xiomodule.h"
+#include "xiomodule_l.h"
+#include "xil_exception.h"
+#include "xil_printf.h"
+#include "mb_interface.h"
+
+#include "aes_model.h"
+#include "emu.h"
+
+#define RX_BUFFER_SIZE      4096
+#define TX_BUFFER_SIZE      4096
+#define IDLE_POLL_MS        10
+#define IRQ_WAIT_CYCLES     256         /* Longest run towards done_irq per pass */
+#define IRQ_WAIT_POLL_NS    1000
+#define TX_STALL_MS         100
+
+static struct emu_options opts;
+static uint64_t byte_ns;                /* One UART character, when throttled */
+static uint64_t start_ns;
+
+static int pty_master = -1;
+static int pty_slave = -1;              /* Held open so the master never hangs up */
+static int wake_pipe[2] = { -1, -1 };
+
+static pthread_mutex_t model_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t irq_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t irq_thread;
+
+/* Interrupt controller */
+static XInterruptHandler handlers[XIN_IOMODULE_INTR_COUNT];
+static void *handler_refs[XIN_IOMODULE_INTR_COUNT];
+static u32 intr_enabled;
+static u32 intr_pending;
+static int intr_started;
+static Xil_ExceptionHandler exception_handler;
+static void *exception_data;
+static int exceptions_enabled;
+
+/* PIT1 */
+static u32 timer_reset_value = 0xFFFFFFFF;
+static uint64_t timer_start_cycles;
+static int timer_running;
+
+/* UART state, guarded by irq_lock */
+static uint8_t rx_buffer[RX_BUFFER_SIZE];   /* Read from the terminal, not yet received */
+static uint32_t rx_head, rx_tail;
+static uint8_t rx_data;
+static int rx_valid;
+static uint64_t rx_next_ns;
+
+static uint8_t tx_data;
+static int tx_busy;
+static uint64_t tx_done_ns;
+
+static uint8_t tx_buffer[TX_BUFFER_SIZE];   /* Transmitted, not yet written out */
+static uint32_t tx_len;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void wake(void) {
+    char c = 0;
+    if (write(wake_pipe[1], &c, 1) < 0) {
+        /* Pipe already full: a wakeup is pending */
+    }
+}
+
+/* The done interrupt is enabled, so the CPU may be waiting for it */
+static int done_irq_awaited(void) {
+    return (__atomic_load_n(&intr_enabled, __ATOMIC_RELAXED) &
+            (1u << XIN_IOMODULE_EXTERNAL_INTERRUPT_INTR)) != 0;
+}
+
+/* ============================================================================
+ * Controller model and PIT1
+ * ============================================================================ */
+
+/* When throttled the controller clock follows the wall clock */
+static uint64_t model_sync(void) {
+    uint64_t cycles = aes_model_cycles();
+    if (opts.throttle) {
+        uint64_t target = (now_ns() - start_ns) * opts.clock_hz / 1000000000ull;
+        if (target > cycles) {
+            aes_model_clock((uint32_t)(target - cycles > 0xFFFFFFFFu ? 0xFFFFFFFFu : target - cycles));
+            cycles = aes_model_cycles();
+        }
+    }
+    return cycles;
+}
+
+void XIOModule_IoWriteWord(XIOModule *InstancePtr, u32 ByteOffset, u32 Data) {
+    int irq;
+    (void)InstancePtr;
+    pthread_mutex_lock(&model_lock);
+    model_sync();
+    aes_model_write(ByteOffset, Data);
+    irq = aes_model_irq() || (aes_model_busy() && done_irq_awaited());
+    pthread_mutex_unlock(&model_lock);
+    if (irq) {
+        wake();
+    }
+}
+
+u32 XIOModule_IoReadWord(XIOModule *InstancePtr, u32 ByteOffset) {
+    u32 data;
+    (void)InstancePtr;
+    pthread_mutex_lock(&model_lock);
+    model_sync();
+    data = aes_model_read(ByteOffset);
+    pthread_mutex_unlock(&model_lock);
+    return data;
+}
+
+void XIOModule_SetResetValue(XIOModule *InstancePtr, u8 TimerNumber, u32 ResetValue) {
+    (void)InstancePtr;
+    (void)TimerNumber;
+    timer_reset_value = ResetValue;
+}
+
+void XIOModule_Timer_SetOptions(XIOModule *InstancePtr, u8 TimerNumber, u32 Options) {
+    (void)InstancePtr;
+    (void)TimerNumber;
+    (void)Options;      /* Always free-running with auto-reload */
+}
+
+void XIOModule_Timer_Start(XIOModule *InstancePtr, u8 TimerNumber) {
+    (void)InstancePtr;
+    (void)TimerNumber;
+    pthread_mutex_lock(&model_lock);
+    timer_start_cycles = model_sync();
+    timer_running = 1;
+    pthread_mutex_unlock(&model_lock);
+}
+
+u32 XIOModule_GetValue(XIOModule *InstancePtr, u8 TimerNumber) {
+    uint64_t elapsed;
+    (void)InstancePtr;
+    (void)TimerNumber;
+    if (!timer_running) {
+        return timer_reset_value;
+    }
+    pthread_mutex_lock(&model_lock);
+    aes_model_clock(AES_MODEL_IO_CYCLES);
+    elapsed = model_sync() - timer_start_cycles;
+    pthread_mutex_unlock(&model_lock);
+    if (timer_reset_value == 0xFFFFFFFF) {
+        return (u32)(0xFFFFFFFFu - (u32)elapsed);
+    }
+    return timer_reset_value - (u32)(elapsed % ((uint64_t)timer_reset_value + 1));
+}
+
+void XIOModule_DiscreteWrite(XIOModule *InstancePtr, unsigned Channel, u32 Data) {
+    (void)InstancePtr;
+    (void)Channel;
+    (void)Data;         /* GPO1 drives the activity LED only */
+}
+
+/* ============================================================================
+ * UART
+ * ============================================================================ */
+
+/* Move the next buffered byte into the receive register (irq_lock held) */
+static void rx_load(uint64_t now) {
+    if (rx_valid || rx_head == rx_tail || now < rx_next_ns) {
+        return;
+    }
+    rx_data = rx_buffer[rx_tail % RX_BUFFER_SIZE];
+    rx_tail++;
+    rx_valid = 1;
+    if (opts.throttle) {
+        /* Back-to-back characters keep the exact line rate despite late wakeups */
+        rx_next_ns = (now - rx_next_ns < byte_ns) ? rx_next_ns + byte_ns : now + byte_ns;
+    }
+    intr_pending |= 1u << XIN_IOMODULE_UART_RX_INTR;
+}
+
+u32 XIOModule_GetStatusReg(UINTPTR BaseAddress) {
+    u32 status = 0;
+    (void)BaseAddress;
+    if (rx_valid) {
+        status |= XUL_SR_RX_FIFO_VALID_DATA;
+    }
+    if (tx_busy) {
+        status |= XUL_SR_TX_FIFO_FULL;
+    }
+    return status;
+}
+
+u8 XIOModule_RecvByte(UINTPTR BaseAddress) {
+    u8 data;
+    (void)BaseAddress;
+    data = rx_data;
+    rx_valid = 0;
+    /* Without throttling the next byte is already there; the ISR keeps reading */
+    if (!opts.throttle) {
+        rx_load(0);
+        intr_pending &= ~(1u << XIN_IOMODULE_UART_RX_INTR);
+    }
+    return data;
+}
+
+void XIOModule_SendByte(UINTPTR BaseAddress, u8 Data) {
+    uint64_t now = now_ns();
+    (void)BaseAddress;
+    tx_data = Data;
+    if (opts.throttle) {
+        /* Back-to-back characters keep the exact line rate despite late wakeups */
+        uint64_t start = (now - tx_done_ns < byte_ns) ? tx_done_ns : now;
+        tx_done_ns = start + byte_ns;
+    } else {
+        tx_done_ns = 0;
+    }
+    tx_busy = 1;
+    wake();
+}
+
+/* Write transmitted bytes to the terminal (irq_lock not held) */
+static void tx_flush(const uint8_t *data, uint32_t len) {
+    while (len > 0) {
+        ssize_t n = write(pty_master, data, len);
+        if (n > 0) {
+            data += n;
+            len -= (uint32_t)n;
+        } else if (n < 0 && errno == EAGAIN) {
+            /* Nobody reading: like an unconnected line, drop after a while */
+            struct pollfd pfd = { pty_master, POLLOUT, 0 };
+            if (poll(&pfd, 1, TX_STALL_MS) <= 0) {
+                return;
+            }
+        } else if (n < 0 && errno != EINTR) {
+            return;
+        }
+    }
+}
+
+/* ============================================================================
+ * Interrupts
+ * ============================================================================ */
+
+void microblaze_disable_interrupts(void) {
+    pthread_mutex_lock(&irq_lock);
+}
+
+void microblaze_enable_interrupts(void) {
+    pthread_mutex_unlock(&irq_lock);
+}
+
+void Xil_ExceptionInit(void) {
+}
+
+void Xil_ExceptionRegisterHandler(u32 id, Xil_ExceptionHandler handler, void *data) {
+    if (id == XIL_EXCEPTION_ID_INT) {
+        pthread_mutex_lock(&irq_lock);
+        exception_handler = handler;
+        exception_data = data;
+        pthread_mutex_unlock(&irq_lock);
+    }
+}
+
+void Xil_ExceptionEnable(void) {
+    pthread_mutex_lock(&irq_lock);
+    exceptions_enabled = 1;
+    pthread_mutex_unlock(&irq_lock);
+    wake();
+}
+
+void Xil_ExceptionDisable(void) {
+    pthread_mutex_lock(&irq_lock);
+    exceptions_enabled = 0;
+    pthread_mutex_unlock(&irq_lock);
+}
+
+int XIOModule_Initialize(XIOModule *InstancePtr, u16 DeviceId) {
+    (void)DeviceId;
+    InstancePtr->BaseAddress = XPAR_IOMODULE_0_BASEADDR;
+    InstancePtr->IoBaseAddress = XPAR_IOMODULE_0_IO_BASEADDR;
+    InstancePtr->IsReady = 1;
+    return XST_SUCCESS;
+}
+
+int XIOModule_Start(XIOModule *InstancePtr) {
+    (void)InstancePtr;
+    pthread_mutex_lock(&irq_lock);
+    intr_started = 1;
+    pthread_mutex_unlock(&irq_lock);
+    wake();
+    return XST_SUCCESS;
+}
+
+int XIOModule_Connect(XIOModule *InstancePtr, u8 Id, XInterruptHandler Handler, void *CallBackRef) {
+    (void)InstancePtr;
+    if (Id >= XIN_IOMODULE_INTR_COUNT) {
+        return XST_FAILURE;
+    }
+    pthread_mutex_lock(&irq_lock);
+    handlers[Id] = Handler;
+    handler_refs[Id] = CallBackRef;
+    pthread_mutex_unlock(&irq_lock);
+    return XST_SUCCESS;
+}
+
+void XIOModule_Enable(XIOModule *InstancePtr, u8 Id) {
+    (void)InstancePtr;
+    pthread_mutex_lock(&irq_lock);
+    intr_enabled |= 1u << Id;
+    pthread_mutex_unlock(&irq_lock);
+    wake();
+}
+
+void XIOModule_Disable(XIOModule *InstancePtr, u8 Id) {
+    (void)InstancePtr;
+    pthread_mutex_lock(&irq_lock);
+    intr_enabled &= ~(1u << Id);
+    pthread_mutex_unlock(&irq_lock);
+}
+
+/* Acknowledge and dispatch each pending, enabled interrupt (irq_lock held) */
+void XIOModule_DeviceInterruptHandler(void *DeviceId) {
+    u32 active;
+    (void)DeviceId;
+    while ((active = intr_pending & intr_enabled) != 0) {
+        unsigned id = (unsigned)__builtin_ctz(active);
+        intr_pending &= ~(1u << id);
+        if (handlers[id]) {
+            handlers[id](handler_refs[id]);
+        }
+    }
+}
+
+/* Advance the UART and raise interrupts that are due (irq_lock held) */
+static void irq_service(uint64_t now) {
+    int deliver = exceptions_enabled && intr_started && exception_handler;
+    int irq;
+
+    /* Transmit complete: the TX ISR may start the next byte straight away */
+    while (tx_busy && now >= tx_done_ns && tx_len < TX_BUFFER_SIZE) {
+        tx_buffer[tx_len++] = tx_data;
+        tx_busy = 0;
+        intr_pending |= 1u << XIN_IOMODULE_UART_TX_INTR;
+        if (!deliver) {
+            break;
+        }
+        exception_handler(exception_data);
+    }
+
+    /* Receive: the next byte waits until the last has been read */
+    rx_load(now);
+
+    /*
+     * The controller's done_irq is a level. Unthrottled, the model only
+     * advances with bus accesses, and a CPU spinning on a flag set by the
+     * done ISR makes none, so run the controller towards done here.
+     */
+    pthread_mutex_lock(&model_lock);
+    if (done_irq_awaited()) {
+        model_sync();
+    }
+    irq = aes_model_irq();
+    if (!opts.throttle && done_irq_awaited()) {
+        for (int i = 0; i < IRQ_WAIT_CYCLES && !irq && aes_model_busy(); i++) {
+            aes_model_clock(1);
+            irq = aes_model_irq();
+        }
+    }
+    pthread_mutex_unlock(&model_lock);
+    if (irq) {
+        intr_pending |= 1u << XIN_IOMODULE_EXTERNAL_INTERRUPT_INTR;
+    }
+
+    if (deliver && (intr_pending & intr_enabled)) {
+        exception_handler(exception_data);
+    }
+}
+
+static void *irq_thread_main(void *arg) {
+    (void)arg;
+    prctl(PR_SET_TIMERSLACK, 1UL);
+    for (;;) {
+        uint8_t out[TX_BUFFER_SIZE];
+        uint32_t out_len;
+        uint64_t now = now_ns();
+        uint64_t next = now + IDLE_POLL_MS * 1000000ull;
+        int space;
+        struct timespec timeout;
+        struct pollfd fds[2];
+
+        pthread_mutex_lock(&irq_lock);
+        irq_service(now);
+        if (tx_busy && tx_done_ns < next) {
+            next = tx_done_ns;
+        }
+        if (!rx_valid && rx_head != rx_tail && rx_next_ns < next) {
+            next = rx_next_ns;
+        }
+        if (opts.throttle && done_irq_awaited()) {
+            /* Follow the controller in real time until done */
+            pthread_mutex_lock(&model_lock);
+            if (aes_model_busy()) {
+                next = now + IRQ_WAIT_POLL_NS;
+            }
+            pthread_mutex_unlock(&model_lock);
+        }
+        out_len = tx_len;
+        memcpy(out, tx_buffer, tx_len);
+        tx_len = 0;
+        space = (rx_head - rx_tail) < RX_BUFFER_SIZE;
+        pthread_mutex_unlock(&irq_lock);
+
+        if (out_len > 0) {
+            tx_flush(out, out_len);
+            if (opts.verbose) {
+                fwrite(out, 1, out_len, stderr);
+            }
+        }
+
+        fds[0].fd = pty_master;
+        fds[0].events = space ? POLLIN : 0;
+        fds[1].fd = wake_pipe[0];
+        fds[1].events = POLLIN;
+        now = now_ns();
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = next > now ? (long)(next - now) : 0;
+        if (timeout.tv_nsec >= 1000000000L) {
+            timeout.tv_sec = timeout.tv_nsec / 1000000000L;
+            timeout.tv_nsec %= 1000000000L;
+        }
+        if (ppoll(fds, 2, &timeout, NULL) <= 0) {
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            uint8_t in[RX_BUFFER_SIZE];
+            ssize_t n;
+            pthread_mutex_lock(&irq_lock);
+            n = read(pty_master, in, RX_BUFFER_SIZE - (rx_head - rx_tail));
+            for (ssize_t i = 0; i < n; i++) {
+                rx_buffer[rx_head % RX_BUFFER_SIZE] = in[i];
+                rx_head++;
+            }
+            pthread_mutex_unlock(&irq_lock);
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * xil_printf
+ * ============================================================================ */
+
+/* Polled output before the UART interrupts are running */
+void xil_printf(const char *fmt, ...) {
+    char text[256];
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (len < 0) {
+        return;
+    }
+    if (len > (int)sizeof(text) - 1) {
+        len = (int)sizeof(text) - 1;
+    }
+    tx_flush((const uint8_t *)text, (uint32_t)len);
+    fwrite(text, 1, (size_t)len, stderr);
+}
+
+/* ============================================================================
+ * Setup
+ * ============================================================================ */
+
+int emu_init(const struct emu_options *options) {
+    struct termios tio;
+    const char *name;
+
+    opts = *options;
+    byte_ns = 10ull * 1000000000ull / opts.baudrate;
+    start_ns = now_ns();
+
+    pty_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty_master < 0 || grantpt(pty_master) < 0 || unlockpt(pty_master) < 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    name = ptsname(pty_master);
+    pty_slave = open(name, O_RDWR | O_NOCTTY);
+    if (pty_slave < 0) {
+        perror(name);
+        return -1;
+    }
+    /* Raw line discipline: no echo back into the firmware, no translation */
+    tcgetattr(pty_slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty_slave, TCSANOW, &tio);
+    fcntl(pty_master, F_SETFL, fcntl(pty_master, F_GETFL) | O_NONBLOCK);
+
+    if (pipe2(wake_pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    if (opts.link) {
+        unlink(opts.link);
+        if (symlink(name, opts.link) < 0) {
+            perror(opts.link);
+            return -1;
+        }
+    }
+    printf("%s\n", name);
+    fflush(stdout);
+
+    aes_model_reset();
+    if (pthread_create(&irq_thread, NULL, irq_thread_main, NULL) != 0) {
+        perror("pthread_create");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,14 @@
+/*
+ * Emulator BSP: MicroBlaze interrupt enable
+ *
+ * Disabling interrupts holds off the emulated interrupt thread, so the
+ * firmware's critical sections keep their meaning.
+ */
+
+#ifndef MB_INTERFACE_H
+#define MB_INTERFACE_H
+
+void microblaze_enable_interrupts(void);
+void microblaze_disable_interrupts(void);
+
+#endif /* MB_INTERFACE_H */
@@ -0,0 +1,19 @@
+/*
+ * Emulator BSP: exception handler registration
+ */
+
+#ifndef XIL_EXCEPTION_H
+#define XIL_EXCEPTION_H
+
+#include "xil_types.h"
+
+#define XIL_EXCEPTION_ID_INT    16
+
+typedef void (*Xil_ExceptionHandler)(void *data);
+
+void Xil_ExceptionInit(void);
+void Xil_ExceptionRegisterHandler(u32 id, Xil_ExceptionHandler handler, void *data);
+void Xil_ExceptionEnable(void);
+void Xil_ExceptionDisable(void);
+
+#endif /* XIL_EXCEPTION_H */
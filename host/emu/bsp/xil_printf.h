@@ -0,0 +1,10 @@
+/*
+ * Emulator BSP: xil_printf writes to the emulated UART
+ */
+
+#ifndef XIL_PRINTF_H
+#define XIL_PRINTF_H
+
+void xil_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif /* XIL_PRINTF_H */
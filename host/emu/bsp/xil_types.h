@@ -0,0 +1,17 @@
+/*
+ * Emulator BSP: Xilinx basic types
+ */
+
+#ifndef XIL_TYPES_H
+#define XIL_TYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef uintptr_t UINTPTR;
+
+#endif /* XIL_TYPES_H */
@@ -0,0 +1,52 @@
+/*
+ * Emulator BSP: IO Module driver
+ *
+ * The subset of the XIOModule API the firmware uses. IO bus accesses go to
+ * the controller register model, PIT1 counts controller cycles and the UART
+ * is backed by a pseudo-terminal.
+ */
+
+#ifndef XIOMODULE_H
+#define XIOMODULE_H
+
+#include "xil_types.h"
+#include "xstatus.h"
+#include "xiomodule_l.h"
+
+/* Interrupt IDs */
+#define XIN_IOMODULE_UART_ERROR_INTR            0
+#define XIN_IOMODULE_UART_TX_INTR               1
+#define XIN_IOMODULE_UART_RX_INTR               2
+#define XIN_IOMODULE_PIT_1_INTR                 3
+#define XIN_IOMODULE_EXTERNAL_INTERRUPT_INTR    16
+#define XIN_IOMODULE_INTR_COUNT                 32
+
+/* Timer options */
+#define XTC_AUTO_RELOAD_OPTION                  0x00000010UL
+
+typedef void (*XInterruptHandler)(void *CallBackRef);
+
+typedef struct {
+    UINTPTR BaseAddress;
+    UINTPTR IoBaseAddress;
+    u32 IsReady;
+} XIOModule;
+
+int XIOModule_Initialize(XIOModule *InstancePtr, u16 DeviceId);
+int XIOModule_Start(XIOModule *InstancePtr);
+int XIOModule_Connect(XIOModule *InstancePtr, u8 Id, XInterruptHandler Handler, void *CallBackRef);
+void XIOModule_Enable(XIOModule *InstancePtr, u8 Id);
+void XIOModule_Disable(XIOModule *InstancePtr, u8 Id);
+void XIOModule_DeviceInterruptHandler(void *DeviceId);
+
+void XIOModule_DiscreteWrite(XIOModule *InstancePtr, unsigned Channel, u32 Data);
+
+void XIOModule_SetResetValue(XIOModule *InstancePtr, u8 TimerNumber, u32 ResetValue);
+void XIOModule_Timer_SetOptions(XIOModule *InstancePtr, u8 TimerNumber, u32 Options);
+void XIOModule_Timer_Start(XIOModule *InstancePtr, u8 TimerNumber);
+u32 XIOModule_GetValue(XIOModule *InstancePtr, u8 TimerNumber);
+
+void XIOModule_IoWriteWord(XIOModule *InstancePtr, u32 ByteOffset, u32 Data);
+u32 XIOModule_IoReadWord(XIOModule *InstancePtr, u32 ByteOffset);
+
+#endif /* XIOMODULE_H */
@@ -0,0 +1,21 @@
+/*
+ * Emulator BSP: IO Module low-level UART access
+ */
+
+#ifndef XIOMODULE_L_H
+#define XIOMODULE_L_H
+
+#include "xil_types.h"
+
+/* UART status register bits */
+#define XUL_SR_RX_FIFO_VALID_DATA   0x01
+#define XUL_SR_TX_FIFO_FULL         0x08
+#define XUL_SR_OVERRUN_ERROR        0x20
+#define XUL_SR_FRAMING_ERROR        0x40
+#define XUL_SR_PARITY_ERROR         0x80
+
+u32 XIOModule_GetStatusReg(UINTPTR BaseAddress);
+void XIOModule_SendByte(UINTPTR BaseAddress, u8 Data);
+u8 XIOModule_RecvByte(UINTPTR BaseAddress);
+
+#endif /* XIOMODULE_L_H */
@@ -0,0 +1,15 @@
+/*
+ * Emulator BSP: design parameters of the MicroBlaze MCS configuration
+ * described in the README (125 MHz, UART at 115200 baud, PIT1, GPO1)
+ */
+
+#ifndef XPARAMETERS_H
+#define XPARAMETERS_H
+
+#define XPAR_IOMODULE_0_DEVICE_ID       0
+#define XPAR_IOMODULE_0_BASEADDR        0x80000000
+#define XPAR_IOMODULE_0_IO_BASEADDR     0xC0000000
+#define XPAR_IOMODULE_0_UART_BAUDRATE   115200
+#define XPAR_CPU_CORE_CLOCK_FREQ_HZ     125000000
+
+#endif /* XPARAMETERS_H */
@@ -0,0 +1,11 @@
+/*
+ * Emulator BSP: status codes
+ */
+
+#ifndef XSTATUS_H
+#define XSTATUS_H
+
+#define XST_SUCCESS         0
+#define XST_FAILURE         1
+
+#endif /* XSTATUS_H */
@@ -0,0 +1,768 @@
+/*
+ * AES-128 Controller - Cycle-Accurate Model
+ */
+
+#include "controller_model.hpp"
+
+namespace aesemu {
+
+namespace {
+
+constexpr uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+constexpr uint8_t GF_INV[256] = {
+    0x00, 0x01, 0x8d, 0xf6, 0xcb, 0x52, 0x7b, 0xd1, 0xe8, 0x4f, 0x29, 0xc0, 0xb0, 0xe1, 0xe5, 0xc7,
+    0x74, 0xb4, 0xaa, 0x4b, 0x99, 0x2b, 0x60, 0x5f, 0x58, 0x3f, 0xfd, 0xcc, 0xff, 0x40, 0xee, 0xb2,
+    0x3a, 0x6e, 0x5a, 0xf1, 0x55, 0x4d, 0xa8, 0xc9, 0xc1, 0x0a, 0x98, 0x15, 0x30, 0x44, 0xa2, 0xc2,
+    0x2c, 0x45, 0x92, 0x6c, 0xf3, 0x39, 0x66, 0x42, 0xf2, 0x35, 0x20, 0x6f, 0x77, 0xbb, 0x59, 0x19,
+    0x1d, 0xfe, 0x37, 0x67, 0x2d, 0x31, 0xf5, 0x69, 0xa7, 0x64, 0xab, 0x13, 0x54, 0x25, 0xe9, 0x09,
+    0xed, 0x5c, 0x05, 0xca, 0x4c, 0x24, 0x87, 0xbf, 0x18, 0x3e, 0x22, 0xf0, 0x51, 0xec, 0x61, 0x17,
+    0x16, 0x5e, 0xaf, 0xd3, 0x49, 0xa6, 0x36, 0x43, 0xf4, 0x47, 0x91, 0xdf, 0x33, 0x93, 0x21, 0x3b,
+    0x79, 0xb7, 0x97, 0x85, 0x10, 0xb5, 0xba, 0x3c, 0xb6, 0x70, 0xd0, 0x06, 0xa1, 0xfa, 0x81, 0x82,
+    0x83, 0x7e, 0x7f, 0x80, 0x96, 0x73, 0xbe, 0x56, 0x9b, 0x9e, 0x95, 0xd9, 0xf7, 0x02, 0xb9, 0xa4,
+    0xde, 0x6a, 0x32, 0x6d, 0xd8, 0x8a, 0x84, 0x72, 0x2a, 0x14, 0x9f, 0x88, 0xf9, 0xdc, 0x89, 0x9a,
+    0xfb, 0x7c, 0x2e, 0xc3, 0x8f, 0xb8, 0x65, 0x48, 0x26, 0xc8, 0x12, 0x4a, 0xce, 0xe7, 0xd2, 0x62,
+    0x0c, 0xe0, 0x1f, 0xef, 0x11, 0x75, 0x78, 0x71, 0xa5, 0x8e, 0x76, 0x3d, 0xbd, 0xbc, 0x86, 0x57,
+    0x0b, 0x28, 0x2f, 0xa3, 0xda, 0xd4, 0xe4, 0x0f, 0xa9, 0x27, 0x53, 0x04, 0x1b, 0xfc, 0xac, 0xe6,
+    0x7a, 0x07, 0xae, 0x63, 0xc5, 0xdb, 0xe2, 0xea, 0x94, 0x8b, 0xc4, 0xd5, 0x9d, 0xf8, 0x90, 0x6b,
+    0xb1, 0x0d, 0xd6, 0xeb, 0xc6, 0x0e, 0xcf, 0xad, 0x08, 0x4e, 0xd7, 0xe3, 0x5d, 0x50, 0x1e, 0xb3,
+    0x5b, 0x23, 0x38, 0x34, 0x68, 0x46, 0x03, 0x8c, 0xdd, 0x9c, 0x7d, 0xa0, 0xcd, 0x1a, 0x41, 0x1c
+};
+
+constexpr uint8_t RCON[11] = { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+constexpr uint8_t MODE_ECB = 0;
+constexpr uint8_t MODE_CMAC = 1;
+constexpr uint8_t MODE_XTS = 2;
+constexpr uint8_t MODE_CBC = 3;
+
+constexpr unsigned OP_BLOCK = 0;
+constexpr unsigned OP_CTX = 1;
+constexpr unsigned OP_KEY = 2;
+
+constexpr uint8_t bit(uint8_t b, int i)
+{
+    return (b >> (i & 7)) & 1;
+}
+
+constexpr uint8_t affine_impl(uint8_t b)
+{
+    constexpr uint8_t C = 0x63;
+    uint8_t result = 0;
+    for (int i = 0; i < 8; i++) {
+        result |= (bit(b, i) ^ bit(b, i + 4) ^ bit(b, i + 5) ^ bit(b, i + 6) ^ bit(b, i + 7) ^
+                   bit(C, i)) << i;
+    }
+    return result;
+}
+
+constexpr uint8_t inv_affine_impl(uint8_t b)
+{
+    constexpr uint8_t D = 0x05;
+    uint8_t result = 0;
+    for (int i = 0; i < 8; i++) {
+        result |= (bit(b, i + 2) ^ bit(b, i + 5) ^ bit(b, i + 7) ^ bit(D, i)) << i;
+    }
+    return result;
+}
+
+constexpr uint8_t xtime_impl(uint8_t b)
+{
+    return static_cast<uint8_t>((b << 1) ^ ((b & 0x80) ? 0x1b : 0x00));
+}
+
+// sub_byte_dir for every input, both directions, and xtime: the same
+// inversion table and transforms as the RTL, evaluated once
+struct SubTables {
+    uint8_t enc[256];
+    uint8_t dec[256];
+    uint8_t x2[256];
+    constexpr SubTables() : enc(), dec(), x2()
+    {
+        for (int i = 0; i < 256; i++) {
+            enc[i] = affine_impl(GF_INV[i]);
+            dec[i] = GF_INV[inv_affine_impl(static_cast<uint8_t>(i))];
+            x2[i] = xtime_impl(static_cast<uint8_t>(i));
+        }
+    }
+};
+
+constexpr SubTables SUB;
+
+} // namespace
+
+namespace aes_pkg {
+
+uint8_t sub_byte(uint8_t b)
+{
+    return SBOX[b];
+}
+
+uint8_t xtime(uint8_t b)
+{
+    return xtime_impl(b);
+}
+
+uint8_t affine(uint8_t b)
+{
+    return affine_impl(b);
+}
+
+uint8_t inv_affine(uint8_t b)
+{
+    return inv_affine_impl(b);
+}
+
+uint8_t sub_byte_dir(uint8_t b, bool decrypt)
+{
+    return decrypt ? SUB.dec[b] : SUB.enc[b];
+}
+
+Block sub_bytes_dir(const Block& state, bool decrypt)
+{
+    const uint8_t* table = decrypt ? SUB.dec : SUB.enc;
+    Block result;
+    for (int i = 0; i < 16; i++) {
+        result[i] = table[state[i]];
+    }
+    return result;
+}
+
+// Byte 4*col+row of the block is state matrix entry (row, col)
+Block shift_rows(const Block& state)
+{
+    Block result;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            result[4 * col + row] = state[4 * ((col + row) % 4) + row];
+        }
+    }
+    return result;
+}
+
+Block inv_shift_rows(const Block& state)
+{
+    Block result;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            result[4 * ((col + row) % 4) + row] = state[4 * col + row];
+        }
+    }
+    return result;
+}
+
+Block mix_columns(const Block& state)
+{
+    Block result;
+    for (int i = 0; i < 4; i++) {
+        const uint8_t s0 = state[4 * i];
+        const uint8_t s1 = state[4 * i + 1];
+        const uint8_t s2 = state[4 * i + 2];
+        const uint8_t s3 = state[4 * i + 3];
+        const uint8_t t0 = SUB.x2[s0];
+        const uint8_t t1 = SUB.x2[s1];
+        const uint8_t t2 = SUB.x2[s2];
+        const uint8_t t3 = SUB.x2[s3];
+        result[4 * i] = t0 ^ (t1 ^ s1) ^ s2 ^ s3;
+        result[4 * i + 1] = s0 ^ t1 ^ (t2 ^ s2) ^ s3;
+        result[4 * i + 2] = s0 ^ s1 ^ t2 ^ (t3 ^ s3);
+        result[4 * i + 3] = (t0 ^ s0) ^ s1 ^ s2 ^ t3;
+    }
+    return result;
+}
+
+Block inv_mix_pre(const Block& state)
+{
+    Block result;
+    for (int i = 0; i < 4; i++) {
+        const uint8_t u = SUB.x2[SUB.x2[state[4 * i] ^ state[4 * i + 2]]];
+        const uint8_t v = SUB.x2[SUB.x2[state[4 * i + 1] ^ state[4 * i + 3]]];
+        result[4 * i] = state[4 * i] ^ u;
+        result[4 * i + 1] = state[4 * i + 1] ^ v;
+        result[4 * i + 2] = state[4 * i + 2] ^ u;
+        result[4 * i + 3] = state[4 * i + 3] ^ v;
+    }
+    return result;
+}
+
+Block add_round_key(const Block& state, const Block& key)
+{
+    Block result;
+    for (int i = 0; i < 16; i++) {
+        result[i] = state[i] ^ key[i];
+    }
+    return result;
+}
+
+Block aes_round_dir(const Block& state, const Block& round_key, bool is_final, bool decrypt)
+{
+    Block temp = sub_bytes_dir(state, decrypt);
+    temp = decrypt ? inv_shift_rows(temp) : shift_rows(temp);
+    if (is_final) {
+        return add_round_key(temp, round_key);
+    }
+    if (decrypt) {
+        return mix_columns(inv_mix_pre(add_round_key(temp, round_key)));
+    }
+    return add_round_key(mix_columns(temp), round_key);
+}
+
+Word sub_word(Word w)
+{
+    return (Word(SBOX[w >> 24]) << 24) | (Word(SBOX[(w >> 16) & 0xFF]) << 16) |
+           (Word(SBOX[(w >> 8) & 0xFF]) << 8) | Word(SBOX[w & 0xFF]);
+}
+
+Word rot_word(Word w)
+{
+    return (w << 8) | (w >> 24);
+}
+
+Block expand_round_key(const Block& prev_key, int rcon_idx)
+{
+    Block result;
+    Word w = sub_word(rot_word(get_word(prev_key, 3))) ^ (Word(RCON[rcon_idx]) << 24);
+    for (int i = 0; i < 4; i++) {
+        w ^= get_word(prev_key, i);
+        set_word(result, i, w);
+    }
+    return result;
+}
+
+std::array<Block, 11> key_expansion(const Block& key)
+{
+    std::array<Block, 11> w;
+    w[0] = key;
+    for (int r = 1; r <= 10; r++) {
+        w[r] = expand_round_key(w[r - 1], r);
+    }
+    return w;
+}
+
+Block gf128_dbl(const Block& b)
+{
+    Block result;
+    for (int i = 0; i < 15; i++) {
+        result[i] = static_cast<uint8_t>((b[i] << 1) | (b[i + 1] >> 7));
+    }
+    result[15] = static_cast<uint8_t>(b[15] << 1);
+    if (b[0] & 0x80) {
+        result[15] ^= 0x87;
+    }
+    return result;
+}
+
+Block xts_mul_alpha(const Block& b)
+{
+    Block result;
+    uint8_t carry = 0;
+    for (int i = 0; i < 16; i++) {
+        result[i] = static_cast<uint8_t>((b[i] << 1) | carry);
+        carry = b[i] >> 7;
+    }
+    if (carry) {
+        result[0] ^= 0x87;
+    }
+    return result;
+}
+
+Word byte_swap(Word w)
+{
+    return (w >> 24) | ((w >> 8) & 0xFF00) | ((w << 8) & 0xFF0000) | (w << 24);
+}
+
+Block byte_swap_words(const Block& b)
+{
+    Block result;
+    for (int i = 0; i < 4; i++) {
+        set_word(result, i, byte_swap(get_word(b, i)));
+    }
+    return result;
+}
+
+Word get_word(const Block& b, int i)
+{
+    return (Word(b[4 * i]) << 24) | (Word(b[4 * i + 1]) << 16) |
+           (Word(b[4 * i + 2]) << 8) | Word(b[4 * i + 3]);
+}
+
+void set_word(Block& b, int i, Word w)
+{
+    b[4 * i] = static_cast<uint8_t>(w >> 24);
+    b[4 * i + 1] = static_cast<uint8_t>(w >> 16);
+    b[4 * i + 2] = static_cast<uint8_t>(w >> 8);
+    b[4 * i + 3] = static_cast<uint8_t>(w);
+}
+
+} // namespace aes_pkg
+
+using namespace aes_pkg;
+
+ControllerModel::ControllerModel()
+{
+    reset();
+}
+
+void ControllerModel::reset()
+{
+    // Every register the RTL resets; the round key RAM has no reset
+    key_reg_ = {};
+    plaintext_reg_ = {};
+    iv_reg_ = {};
+    q_wr_ptr_ = 0;
+    irq_enable_ = false;
+    cfg_le_words_ = false;
+    irq_clear_ = false;
+    ct_pop_ = false;
+    hold_valid_ = false;
+    hold_addr_ = 0;
+    hold_data_ = 0;
+    q_overflow_ = false;
+    io_read_data_ = 0;
+    io_ready_ = false;
+
+    kexp_busy_ = false;
+    kexp_slot_ = 0;
+    kexp_idx_ = 0;
+    rk_last_ = {};
+
+    state_ = State::IDLE;
+    round_cnt_ = 0;
+    cipher_state_ = {};
+    ct_buf_ = {};
+    ct_ctx_ = {};
+    ct_valid_ = {};
+    ct_wr_sel_ = 0;
+    ct_rd_sel_ = 0;
+    done_flag_ = false;
+    q_rd_ptr_ = 0;
+    decrypt_latched_ = false;
+    mode_latched_ = MODE_ECB;
+    last_latched_ = false;
+    derive_latched_ = false;
+    ctx_latched_ = 0;
+    slot_latched_ = 0;
+    post_xor_ = {};
+    ctx_chain_ = {};
+    ctx_mode_ = {};
+    ctx_kslot_ = {};
+    ctx_tslot_ = {};
+    ctx_tvalid_ = {};
+    slot_l_ = {};
+    slot_l_valid_ = {};
+
+    cycles_ = 0;
+}
+
+bool ControllerModel::busy() const
+{
+    return !(state_ == State::IDLE && q_wr_ptr_ == q_rd_ptr_ && !kexp_busy_);
+}
+
+const Block& ControllerModel::round_key_entry(int slot, int round) const
+{
+    const int addr = 8 * slot + round / 2;
+    return (round & 1) ? rk_ram_odd_[addr] : rk_ram_even_[addr];
+}
+
+uint32_t ControllerModel::status() const
+{
+    const unsigned level = q_level();
+    return (uint32_t(q_overflow_) << 13) | (uint32_t(kexp_busy_) << 12) | (level << 9) |
+           (uint32_t((level >> 2) & 1) << 8) |
+           (uint32_t(ct_ctx_[ct_rd_sel_]) << 6) | (uint32_t(ct_valid_[1 - ct_rd_sel_]) << 5) |
+           (uint32_t(ct_rd_sel_) << 4) | (uint32_t(ct_valid_[ct_rd_sel_]) << 3) |
+           (uint32_t(irq_enable_) << 2) | (uint32_t(done_flag_) << 1) | uint32_t(busy());
+}
+
+// No register can change until the next bus request: nothing queued, no
+// expansion running and the core idle or holding a result in DONE
+bool ControllerModel::quiescent() const
+{
+    if (hold_valid_ || irq_clear_ || ct_pop_ || io_ready_ || kexp_busy_ || q_wr_ptr_ != q_rd_ptr_) {
+        return false;
+    }
+    if (state_ == State::IDLE) {
+        return true;
+    }
+    return state_ == State::DONE && !derive_latched_ &&
+           !(mode_latched_ == MODE_CMAC && !last_latched_) && ct_valid_[ct_wr_sel_];
+}
+
+void ControllerModel::clock(const Inputs& in)
+{
+    cycles_++;
+
+    // ------------------------------------------------------------------------
+    // Combinational signals, all from the registers before the edge
+    // ------------------------------------------------------------------------
+
+    // Bus request, either a new strobe or a push held behind a full queue
+    const unsigned addr_word = (in.io_addr >> 2) & 0x3F;
+    const bool req_write = (in.io_addr_strobe && in.io_write_strobe) || hold_valid_;
+    const bool req_read = in.io_addr_strobe && in.io_read_strobe && !hold_valid_;
+    const unsigned req_addr = hold_valid_ ? hold_addr_ : addr_word;
+    const Word req_data = hold_valid_ ? hold_data_ : in.io_write_data;
+    const bool req_push = (req_addr == 12 && (req_data & 1)) || req_addr == 14 || req_addr == 15;
+
+    const bool q_empty = q_wr_ptr_ == q_rd_ptr_;
+    const bool q_full = (q_level() & 4) != 0;
+
+    Word read_data = 0;
+    if (req_read) {
+        switch (req_addr) {
+        case 8: case 9: case 10: case 11: {
+            const Word w = get_word(ct_buf_[ct_rd_sel_], static_cast<int>(req_addr - 8));
+            read_data = cfg_le_words_ ? byte_swap(w) : w;
+            break;
+        }
+        case 12:
+            read_data = status();
+            break;
+        case 13:
+            read_data = cfg_le_words_ ? 1 : 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Queue head decode
+    const int head_idx = q_rd_ptr_ & 3;
+    const Block& head_data = q_data_[head_idx];
+    const Meta head_meta = q_meta_[head_idx];
+    const unsigned head_op = (head_meta >> 10) & 3;
+    const int head_id = (head_meta >> 8) & 3;
+    const bool head_dir = head_meta & 0x01;
+    const bool head_last = head_meta & 0x02;
+    const bool head_part = head_meta & 0x04;
+    const bool head_steal = head_meta & 0x08;
+    const uint8_t head_mode = ctx_mode_[head_id];
+    const int head_slot = (head_meta & 0x10) ? (head_meta >> 5) & 3 : ctx_kslot_[head_id];
+
+    const bool need_derive = (head_mode == MODE_CMAC && !slot_l_valid_[head_slot]) ||
+                             (head_mode == MODE_XTS && !ctx_tvalid_[head_id]);
+    const int blk_slot = (head_mode == MODE_XTS && need_derive) ? ctx_tslot_[head_id] : head_slot;
+
+    // Hold a push into a full queue only while the queue drains on its own: not
+    // while the core holds a result in DONE with both ciphertext buffers unread,
+    // unless the head is a key load for another slot
+    const bool q_stuck = state_ == State::DONE && !derive_latched_ &&
+                         !(mode_latched_ == MODE_CMAC && !last_latched_) && ct_valid_[ct_wr_sel_] &&
+                         !(head_op == OP_KEY && slot_latched_ != head_id);
+    const bool req_stall = req_push && q_full && !q_stuck;
+
+    const bool take_key = !q_empty && head_op == OP_KEY && !kexp_busy_ &&
+                          !(state_ != State::IDLE && slot_latched_ == head_id);
+    const bool take_block = state_ == State::IDLE && !q_empty && head_op == OP_BLOCK &&
+                            !(kexp_busy_ && kexp_slot_ == blk_slot);
+    const bool take_ctx = state_ == State::IDLE && !q_empty && head_op == OP_CTX;
+
+    // Round key addressed by the registered round_cnt (reversed for decryption)
+    Block round_key{};
+    if (state_ == State::ROUND_0 || state_ == State::ROUNDS_1_9 || state_ == State::ROUND_10) {
+        const unsigned rk_addr = (decrypt_latched_ ? 10 - round_cnt_ : round_cnt_) & 0xF;
+        const int rk_rd_addr = 8 * slot_latched_ + static_cast<int>(rk_addr >> 1);
+        round_key = (rk_addr & 1) ? rk_ram_odd_[rk_rd_addr] : rk_ram_even_[rk_rd_addr];
+    }
+
+    // Expansion datapath
+    Block rk_exp_odd{};
+    Block rk_exp_even{};
+    if (kexp_busy_) {
+        rk_exp_odd = expand_round_key(rk_last_, 2 * kexp_idx_ + 1);
+        rk_exp_even = expand_round_key(rk_exp_odd, 2 * kexp_idx_ + 2);
+    }
+
+    // ------------------------------------------------------------------------
+    // AES state machine
+    // ------------------------------------------------------------------------
+    const bool ct_valid_wr = ct_valid_[ct_wr_sel_];
+
+    if (irq_clear_) {
+        done_flag_ = false;
+    }
+
+    if (ct_pop_ && ct_valid_[ct_rd_sel_]) {
+        ct_valid_[ct_rd_sel_] = false;
+        ct_rd_sel_ = 1 - ct_rd_sel_;
+    }
+
+    if (take_key) {
+        slot_l_valid_[head_id] = false;
+        q_rd_ptr_ = (q_rd_ptr_ + 1) & 7;
+    }
+
+    switch (state_) {
+    case State::IDLE:
+        if (take_ctx) {
+            ctx_mode_[head_id] = head_meta & 3;
+            ctx_kslot_[head_id] = (head_meta >> 2) & 3;
+            ctx_tslot_[head_id] = (head_meta >> 4) & 3;
+            if (head_meta & 0x40) {
+                ctx_chain_[head_id] = head_data;
+            } else {
+                ctx_chain_[head_id] = {};
+            }
+            ctx_tvalid_[head_id] = false;
+            q_rd_ptr_ = (q_rd_ptr_ + 1) & 7;
+        } else if (take_block) {
+            const Block head_chain = ctx_chain_[head_id];
+            ctx_latched_ = head_id;
+            mode_latched_ = head_mode;
+            slot_latched_ = blk_slot;
+            round_cnt_ = 0;
+            if (need_derive) {
+                // CMAC encrypts zero, XTS the sector number in the chain
+                cipher_state_ = (head_mode == MODE_XTS) ? head_chain : Block{};
+                decrypt_latched_ = false;
+                derive_latched_ = true;
+                post_xor_ = {};
+            } else {
+                const Block xts_tweak = head_steal ? xts_mul_alpha(head_chain) : head_chain;
+                Block block_in = head_data;
+                if (head_mode == MODE_CMAC) {
+                    Block cmac_mask{};
+                    if (head_last) {
+                        const Block k1 = gf128_dbl(slot_l_[head_slot]);
+                        cmac_mask = head_part ? gf128_dbl(k1) : k1;
+                    }
+                    block_in = add_round_key(add_round_key(head_data, head_chain), cmac_mask);
+                } else if (head_mode == MODE_XTS) {
+                    block_in = add_round_key(head_data, xts_tweak);
+                } else if (head_mode == MODE_CBC && !head_dir) {
+                    block_in = add_round_key(head_data, head_chain);
+                }
+
+                cipher_state_ = block_in;
+                derive_latched_ = false;
+                last_latched_ = head_last;
+                done_flag_ = false;
+                q_rd_ptr_ = (q_rd_ptr_ + 1) & 7;
+                decrypt_latched_ = (head_mode == MODE_CMAC) ? false : head_dir;
+                if (head_mode == MODE_XTS) {
+                    post_xor_ = xts_tweak;
+                    if (!head_steal) {
+                        ctx_chain_[head_id] = xts_mul_alpha(head_chain);
+                    }
+                } else if (head_mode == MODE_CBC && head_dir) {
+                    post_xor_ = head_chain;
+                    ctx_chain_[head_id] = head_data;
+                } else {
+                    post_xor_ = {};
+                }
+            }
+            state_ = State::ROUND_0;
+        }
+        break;
+
+    case State::ROUND_0:
+        cipher_state_ = add_round_key(cipher_state_, round_key);
+        round_cnt_ = 1;
+        state_ = State::ROUNDS_1_9;
+        break;
+
+    case State::ROUNDS_1_9:
+        cipher_state_ = aes_round_dir(cipher_state_, round_key, false, decrypt_latched_);
+        if (round_cnt_ == 9) {
+            state_ = State::ROUND_10;
+        }
+        round_cnt_ = (round_cnt_ + 1) & 0xF;
+        break;
+
+    case State::ROUND_10:
+        cipher_state_ = aes_round_dir(cipher_state_, round_key, true, decrypt_latched_);
+        state_ = State::DONE;
+        break;
+
+    case State::DONE:
+        if (derive_latched_) {
+            if (mode_latched_ == MODE_XTS) {
+                ctx_chain_[ctx_latched_] = cipher_state_;
+                ctx_tvalid_[ctx_latched_] = true;
+            } else {
+                slot_l_[slot_latched_] = cipher_state_;
+                slot_l_valid_[slot_latched_] = true;
+            }
+            state_ = State::IDLE;
+        } else if (mode_latched_ == MODE_CMAC && !last_latched_) {
+            ctx_chain_[ctx_latched_] = cipher_state_;
+            state_ = State::IDLE;
+        } else if (!ct_valid_wr) {
+            const Block cipher_out = add_round_key(cipher_state_, post_xor_);
+            ct_buf_[ct_wr_sel_] = cipher_out;
+            ct_ctx_[ct_wr_sel_] = static_cast<uint8_t>(ctx_latched_);
+            ct_valid_[ct_wr_sel_] = true;
+            ct_wr_sel_ = 1 - ct_wr_sel_;
+            done_flag_ = true;
+            if (mode_latched_ == MODE_CMAC) {
+                ctx_chain_[ctx_latched_] = {};
+            } else if (mode_latched_ == MODE_CBC && !decrypt_latched_) {
+                ctx_chain_[ctx_latched_] = cipher_out;
+            }
+            state_ = State::IDLE;
+        }
+        break;
+    }
+
+    // ------------------------------------------------------------------------
+    // Key schedule RAM and expansion engine
+    // ------------------------------------------------------------------------
+    if (kexp_busy_) {
+        rk_ram_even_[8 * kexp_slot_ + kexp_idx_ + 1] = rk_exp_even;
+        rk_ram_odd_[8 * kexp_slot_ + kexp_idx_] = rk_exp_odd;
+        rk_last_ = rk_exp_even;
+        if (kexp_idx_ == 4) {
+            kexp_busy_ = false;
+        } else {
+            kexp_idx_++;
+        }
+    } else if (take_key) {
+        // Round key 0 is written to the RAM in parallel
+        rk_ram_even_[8 * head_id] = head_data;
+        rk_last_ = head_data;
+        kexp_slot_ = head_id;
+        kexp_idx_ = 0;
+        kexp_busy_ = true;
+    }
+
+    // ------------------------------------------------------------------------
+    // IO bus process (last: it rewrites queue entries the head decode read)
+    // ------------------------------------------------------------------------
+    irq_clear_ = false;
+    ct_pop_ = false;
+    io_ready_ = false;
+
+    const int wr_idx = q_wr_ptr_ & 3;
+
+    if (req_write) {
+        if (req_stall) {
+            // Wait for a free queue entry
+            hold_valid_ = true;
+            hold_addr_ = static_cast<uint8_t>(req_addr);
+            hold_data_ = req_data;
+        } else {
+            hold_valid_ = false;
+            io_ready_ = true;
+            const Word wr_data_word = cfg_le_words_ ? byte_swap(req_data) : req_data;
+            switch (req_addr) {
+            case 0: case 1: case 2: case 3:
+                set_word(key_reg_, static_cast<int>(req_addr), wr_data_word);
+                break;
+            case 4: case 5: case 6: case 7:
+                set_word(plaintext_reg_, static_cast<int>(req_addr - 4), wr_data_word);
+                break;
+            case 12:
+                if ((req_data & 0x001) && !q_full) {
+                    q_data_[wr_idx] = plaintext_reg_;
+                    q_meta_[wr_idx] = static_cast<Meta>((OP_BLOCK << 10) | (((req_data >> 8) & 3) << 8) |
+                                                        (((req_data >> 10) & 3) << 5) |
+                                                        (((req_data >> 12) & 1) << 4) |
+                                                        ((req_data >> 4) & 0xF));
+                    q_wr_ptr_ = (q_wr_ptr_ + 1) & 7;
+                }
+                if (req_data & 0x002) {
+                    irq_clear_ = true;
+                }
+                irq_enable_ = (req_data & 0x004) != 0;
+                if (req_data & 0x008) {
+                    ct_pop_ = true;
+                }
+                if (req_data & 0x2000) {
+                    q_overflow_ = false;
+                }
+                break;
+            case 13:
+                cfg_le_words_ = req_data & 1;
+                break;
+            case 14:
+                if (!q_full) {
+                    q_data_[wr_idx] = iv_reg_;
+                    q_meta_[wr_idx] = static_cast<Meta>((OP_CTX << 10) | ((req_data & 3) << 8) |
+                                                        ((req_data >> 2) & 0x7F));
+                    q_wr_ptr_ = (q_wr_ptr_ + 1) & 7;
+                }
+                break;
+            case 15:
+                if (!q_full) {
+                    q_data_[wr_idx] = key_reg_;
+                    q_meta_[wr_idx] = static_cast<Meta>((OP_KEY << 10) | ((req_data & 3) << 8));
+                    q_wr_ptr_ = (q_wr_ptr_ + 1) & 7;
+                }
+                break;
+            case 20: case 21: case 22: case 23:
+                set_word(iv_reg_, static_cast<int>(req_addr - 20), wr_data_word);
+                break;
+            default:
+                break;
+            }
+            if (req_push && q_full) {
+                // Stuck behind unread results: drop the push
+                q_overflow_ = true;
+            }
+        }
+    } else if (req_read) {
+        io_ready_ = true;
+        io_read_data_ = read_data;
+    }
+}
+
+void ControllerModel::idle(uint64_t cycles)
+{
+    const Inputs none;
+    while (cycles > 0) {
+        if (quiescent()) {
+            cycles_ += cycles;
+            return;
+        }
+        clock(none);
+        cycles--;
+    }
+}
+
+void ControllerModel::write(uint32_t offset, uint32_t data)
+{
+    Inputs in;
+    in.io_addr = offset;
+    in.io_write_data = data;
+    in.io_addr_strobe = true;
+    in.io_write_strobe = true;
+    clock(in);
+
+    const Inputs none;
+    while (!io_ready_) {
+        clock(none);
+    }
+    clock(none);
+}
+
+uint32_t ControllerModel::read(uint32_t offset)
+{
+    Inputs in;
+    in.io_addr = offset;
+    in.io_addr_strobe = true;
+    in.io_read_strobe = true;
+    clock(in);
+    const uint32_t data = io_read_data_;
+    clock(Inputs());
+    return data;
+}
+
+} // namespace aesemu
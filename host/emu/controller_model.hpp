@@ -0,0 +1,186 @@
+/*
+ * AES-128 Controller - Cycle-Accurate Model
+ *
+ * A clock-by-clock model of controller.vhd for differential testing against
+ * the RTL and for estimating the effect of datapath or queue changes before
+ * synthesis. Each call to clock() is one rising edge: the combinational
+ * signals are evaluated from the current registers, then every process of
+ * the architecture updates its registers with the values the VHDL would
+ * assign, so register contents match the RTL after every cycle:
+ *   - IO bus process: staging registers, queue push, held or dropped
+ *     writes, io_ready one cycle after the strobe, registered io_read_data
+ *   - Key expansion engine and the even/odd round key RAM banks
+ *   - State machine IDLE, ROUND_0, ROUNDS_1_9, ROUND_10, DONE, with the
+ *     queue take rules, contexts, CMAC L / XTS T derivation and the
+ *     ciphertext double buffer
+ *   - done_flag, irq_enable and done_irq
+ *
+ * The aes_pkg functions are reproduced bit for bit on blocks held in VHDL
+ * order: byte 0 is bits 127:120 of block_t.
+ */
+
+#ifndef AESEMU_CONTROLLER_MODEL_HPP
+#define AESEMU_CONTROLLER_MODEL_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace aesemu {
+
+using Block = std::array<uint8_t, 16>;
+using Word = uint32_t;
+
+/* aes_pkg and the controller's helper functions */
+namespace aes_pkg {
+
+uint8_t sub_byte(uint8_t b);
+uint8_t xtime(uint8_t b);
+uint8_t affine(uint8_t b);
+uint8_t inv_affine(uint8_t b);
+uint8_t sub_byte_dir(uint8_t b, bool decrypt);
+
+Block sub_bytes_dir(const Block& state, bool decrypt);
+Block shift_rows(const Block& state);
+Block inv_shift_rows(const Block& state);
+Block mix_columns(const Block& state);
+Block inv_mix_pre(const Block& state);
+Block add_round_key(const Block& state, const Block& key);
+Block aes_round_dir(const Block& state, const Block& round_key, bool is_final, bool decrypt);
+
+Word sub_word(Word w);
+Word rot_word(Word w);
+Block expand_round_key(const Block& prev_key, int rcon_idx);
+std::array<Block, 11> key_expansion(const Block& key);
+
+Block gf128_dbl(const Block& b);
+Block xts_mul_alpha(const Block& b);
+
+Word byte_swap(Word w);
+Block byte_swap_words(const Block& b);
+
+/* Word i of a block: bits 127-32i downto 96-32i */
+Word get_word(const Block& b, int i);
+void set_word(Block& b, int i, Word w);
+
+} // namespace aes_pkg
+
+class ControllerModel {
+public:
+    static constexpr int KEY_SLOTS = 4;
+    static constexpr int CTX_COUNT = 4;
+    static constexpr int Q_DEPTH = 4;
+
+    enum class State : uint8_t { IDLE, ROUND_0, ROUNDS_1_9, ROUND_10, DONE };
+
+    /* Port inputs sampled at the rising edge */
+    struct Inputs {
+        uint32_t io_addr = 0;
+        uint32_t io_write_data = 0;
+        bool io_addr_strobe = false;
+        bool io_write_strobe = false;
+        bool io_read_strobe = false;
+    };
+
+    ControllerModel();
+
+    /* Synchronous reset (rst held for one edge) */
+    void reset();
+
+    /* One rising edge */
+    void clock(const Inputs& in);
+
+    /* Edges with no bus request; skipped in bulk while nothing is pending */
+    void idle(uint64_t cycles);
+
+    /*
+     * MicroBlaze IO bus transactions: strobe for one cycle, wait for io_ready,
+     * then one cycle in which the CPU completes the access and cannot strobe
+     * again. Pulses written with an access (ct_pop, irq_clear) have therefore
+     * taken effect before the next access is sampled.
+     */
+    void write(uint32_t offset, uint32_t data);
+    uint32_t read(uint32_t offset);
+
+    /* Registered outputs after the last edge */
+    uint32_t io_read_data() const { return io_read_data_; }
+    bool io_ready() const { return io_ready_; }
+    bool done_irq() const { return done_flag_ && irq_enable_; }
+
+    uint64_t cycles() const { return cycles_; }
+
+    /* Internal state for differential checks against the RTL */
+    State state() const { return state_; }
+    bool busy() const;
+    bool kexp_busy() const { return kexp_busy_; }
+    unsigned q_level() const { return static_cast<uint8_t>(q_wr_ptr_ - q_rd_ptr_) & 7u; }
+    const Block& cipher_state() const { return cipher_state_; }
+    const Block& ctx_chain(int ctx) const { return ctx_chain_[ctx]; }
+    const Block& round_key_entry(int slot, int round) const;
+    uint32_t status() const;
+
+private:
+    // Queue meta fields (bits11:10=op, bits9:8=id, bits7:0=args)
+    using Meta = uint16_t;
+
+    bool quiescent() const;
+
+    uint64_t cycles_ = 0;
+
+    // IO bus process
+    Block key_reg_{};
+    Block plaintext_reg_{};
+    Block iv_reg_{};
+    uint8_t q_wr_ptr_ = 0;
+    bool irq_enable_ = false;
+    bool cfg_le_words_ = false;
+    bool irq_clear_ = false;
+    bool ct_pop_ = false;
+    bool hold_valid_ = false;
+    uint8_t hold_addr_ = 0;
+    Word hold_data_ = 0;
+    bool q_overflow_ = false;
+    Word io_read_data_ = 0;
+    bool io_ready_ = false;
+
+    // Command queue storage (written by the bus process)
+    std::array<Block, Q_DEPTH> q_data_{};
+    std::array<Meta, Q_DEPTH> q_meta_{};
+
+    // Key expansion engine and round key RAM
+    bool kexp_busy_ = false;
+    int kexp_slot_ = 0;
+    int kexp_idx_ = 0;
+    Block rk_last_{};
+    std::array<Block, 8 * KEY_SLOTS> rk_ram_even_{};
+    std::array<Block, 8 * KEY_SLOTS> rk_ram_odd_{};
+
+    // State machine
+    State state_ = State::IDLE;
+    unsigned round_cnt_ = 0;
+    Block cipher_state_{};
+    std::array<Block, 2> ct_buf_{};
+    std::array<uint8_t, 2> ct_ctx_{};
+    std::array<bool, 2> ct_valid_{};
+    int ct_wr_sel_ = 0;
+    int ct_rd_sel_ = 0;
+    bool done_flag_ = false;
+    uint8_t q_rd_ptr_ = 0;
+    bool decrypt_latched_ = false;
+    uint8_t mode_latched_ = 0;
+    bool last_latched_ = false;
+    bool derive_latched_ = false;
+    int ctx_latched_ = 0;
+    int slot_latched_ = 0;
+    Block post_xor_{};
+    std::array<Block, CTX_COUNT> ctx_chain_{};
+    std::array<uint8_t, CTX_COUNT> ctx_mode_{};
+    std::array<uint8_t, CTX_COUNT> ctx_kslot_{};
+    std::array<uint8_t, CTX_COUNT> ctx_tslot_{};
+    std::array<bool, CTX_COUNT> ctx_tvalid_{};
+    std::array<Block, KEY_SLOTS> slot_l_{};
+    std::array<bool, KEY_SLOTS> slot_l_valid_{};
+};
+
+} // namespace aesemu
+
+#endif // AESEMU_CONTROLLER_MODEL_HPP
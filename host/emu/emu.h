@@ -0,0 +1,29 @@
+/*
+ * AES-128 Device Emulator
+ *
+ * Runs the MicroBlaze firmware (src/main.c) on the host. The UART is a
+ * pseudo-terminal that any client can open like the board's serial port;
+ * interrupts are delivered by a separate thread that is held off while the
+ * firmware has them disabled.
+ */
+
+#ifndef EMU_H
+#define EMU_H
+
+#include <stdint.h>
+
+struct emu_options {
+    unsigned baudrate;      /* UART rate used when throttling */
+    int throttle;           /* Pace the UART at baudrate, 10 bits per byte */
+    uint32_t clock_hz;      /* Controller and PIT1 clock */
+    const char *link;       /* Optional symlink to the pseudo-terminal */
+    int verbose;
+};
+
+/* Open the pseudo-terminal and start the interrupt thread */
+int emu_init(const struct emu_options *options);
+
+/* Firmware entry point (src/main.c built with main renamed) */
+int firmware_main(void);
+
+#endif /* EMU_H */
@@ -0,0 +1,70 @@
+/*
+ * AES-128 Device Emulator
+ *
+ * Runs the firmware against the controller model behind a pseudo-terminal.
+ * The terminal path is printed on stdout; point eval_aes.py, aesfpga_bench
+ * or any other client at it in place of the board's serial port.
+ *
+ * Usage:
+ *   aes_emu [--throttle] [--baud 115200] [--clock-mhz 125] [--link PATH] [--verbose]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xparameters.h"
+#include "emu.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --throttle        Pace the UART at the baud rate and PIT1 at the wall clock\n"
+            "  --baud N          UART baud rate when throttled (default %d)\n"
+            "  --clock-mhz F     Controller clock (default %d)\n"
+            "  --link PATH       Symlink PATH to the pseudo-terminal\n"
+            "  --verbose         Copy device output to stderr\n",
+            prog, XPAR_IOMODULE_0_UART_BAUDRATE, XPAR_CPU_CORE_CLOCK_FREQ_HZ / 1000000);
+}
+
+int main(int argc, char **argv) {
+    struct emu_options options = {
+        .baudrate = XPAR_IOMODULE_0_UART_BAUDRATE,
+        .throttle = 0,
+        .clock_hz = XPAR_CPU_CORE_CLOCK_FREQ_HZ,
+        .link = NULL,
+        .verbose = 0,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--throttle") == 0) {
+            options.throttle = 1;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            options.verbose = 1;
+        } else if (strcmp(arg, "--baud") == 0 && value) {
+            options.baudrate = (unsigned)strtoul(value, NULL, 0);
+            i++;
+        } else if (strcmp(arg, "--clock-mhz") == 0 && value) {
+            options.clock_hz = (uint32_t)(strtod(value, NULL) * 1e6);
+            i++;
+        } else if (strcmp(arg, "--link") == 0 && value) {
+            options.link = value;
+            i++;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.baudrate == 0 || options.clock_hz == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (emu_init(&options) != 0) {
+        return 1;
+    }
+    return firmware_main();
+}
@@ -0,0 +1,1155 @@
+/*
+ * AES-128 FPGA Accelerator - Native Benchmark
+ *
+ * Reproduces the metrics of aes-eval/eval_aes.py (see aes_benchmark.txt):
+ * NIST vector, random vectors checked against software, pipelined
+ * throughput and round-trip latency, plus batch throughput, the on-board
+ * Monte Carlo Test, the on-board self-benchmark (no UART in the loop), the
+ * firmware's per-phase breakdown of single-block ECB frames, single
+ * blocks sent with a stored key id instead of the key, the same
+ * frames answered by the hardware frame bridge and one ECB job shared
+ * between the board and software AES, IEEE 1619 XTS and RFC 4493 CMAC
+ * vectors through the firmware's XTS and CMAC commands. Requests naming a key slot that does not
+ * exist are checked to be rejected.
+ *
+ * Usage:
+ *   aesfpga_bench --port /dev/ttyUSB1 [--baud 115200] [--window 8]
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "aesfpga/client.hpp"
+#include "aesfpga/hybrid.hpp"
+#include "aesfpga/soft_aes.hpp"
+
+using namespace aesfpga;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Args {
+    std::string port = "/dev/ttyUSB1";
+    unsigned baud = 115200;
+    unsigned window = 8;
+    int random_tests = 100;
+    double throughput_time = 5.0;
+    int latency_samples = 1000;
+    size_t batch_blocks = 256;
+    unsigned mct_iterations = proto::MCT_MAX_ITERATIONS;
+    uint32_t self_bench_blocks = 4096;
+    int phase_samples = 100;
+    size_t key_cache_blocks = 1000;
+    unsigned key_cache_ids = 2;
+    size_t bridge_blocks = 1000;
+    unsigned bridge_baud = 0;
+    size_t hybrid_blocks = 65536;
+    SoftAes::Backend hybrid_soft = SoftAes::best_backend();
+    double hybrid_min_speedup = 0.9;
+    double clock_mhz = 125.0;
+    bool skip_nist = false;
+    bool skip_random = false;
+    bool skip_throughput = false;
+    bool skip_latency = false;
+    bool skip_batch = false;
+    bool skip_mct = false;
+    bool skip_self_bench = false;
+    bool skip_phases = false;
+    bool skip_key_cache = false;
+    bool skip_bridge = false;
+    bool skip_hybrid = false;
+    bool skip_xts = false;
+    bool skip_cmac = false;
+    bool skip_slot_range = false;
+};
+
+/* Ordered name/value list, printed like eval_aes.py's print_stats() */
+class Stats {
+public:
+    void add(const char* name, double value)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%.3f", value);
+        items_.emplace_back(name, buf);
+    }
+
+    void add(const char* name, uint64_t value)
+    {
+        items_.emplace_back(name, std::to_string(value));
+    }
+
+    void print(const char* title) const
+    {
+        std::printf("\n%s:\n", title);
+        std::printf("----------------------------------------\n");
+        for (const auto& [name, value] : items_) {
+            std::printf("  %s: %s\n", name.c_str(), value.c_str());
+        }
+    }
+
+private:
+    std::vector<std::pair<std::string, std::string>> items_;
+};
+
+std::mt19937_64 rng{std::random_device{}()};
+
+template <size_t N>
+std::array<std::byte, N> random_bytes()
+{
+    std::array<std::byte, N> out;
+    for (auto& b : out) {
+        b = static_cast<std::byte>(rng());
+    }
+    return out;
+}
+
+void fill_random(std::vector<std::byte>& data)
+{
+    for (auto& b : data) {
+        b = static_cast<std::byte>(rng());
+    }
+}
+
+template <size_t N>
+std::array<std::byte, N> from_hex(const char* hex)
+{
+    std::array<std::byte, N> out;
+    for (size_t i = 0; i < N; i++) {
+        out[i] = static_cast<std::byte>(std::strtoul(std::string(hex + 2 * i, 2).c_str(), nullptr, 16));
+    }
+    return out;
+}
+
+std::vector<std::byte> from_hex(const char* hex)
+{
+    std::vector<std::byte> out(std::strlen(hex) / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = static_cast<std::byte>(std::strtoul(std::string(hex + 2 * i, 2).c_str(), nullptr, 16));
+    }
+    return out;
+}
+
+std::string to_hex(std::span<const std::byte> data)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (std::byte b : data) {
+        out += digits[std::to_integer<unsigned>(b) >> 4];
+        out += digits[std::to_integer<unsigned>(b) & 0xF];
+    }
+    return out;
+}
+
+const uint8_t* u8(const std::byte* p)
+{
+    return reinterpret_cast<const uint8_t*>(p);
+}
+
+void banner(const std::string& title)
+{
+    std::printf("\n============================================================\n");
+    std::printf("%s\n", title.c_str());
+    std::printf("============================================================\n");
+}
+
+double seconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool run_nist_test_vector(Client& client)
+{
+    banner("NIST FIPS-197 Test Vector");
+
+    auto key = from_hex<16>("2b7e151628aed2a6abf7158809cf4f3c");
+    auto pt = from_hex<16>("3243f6a8885a308d313198a2e0370734");
+    auto expected = from_hex<16>("3925841d02dc09fbdc118597196a0b32");
+    std::array<std::byte, 16> ct;
+
+    std::printf("Key:       %s\n", to_hex(key).c_str());
+    std::printf("Plaintext: %s\n", to_hex(pt).c_str());
+    std::printf("Expected:  %s\n", to_hex(expected).c_str());
+
+    uint32_t cycles = client.encrypt_block(key, pt, ct);
+
+    std::printf("Got:       %s\n", to_hex(ct).c_str());
+    std::printf("Cycles:    %u\n", cycles);
+
+    bool pass = ct == expected;
+    std::printf("RESULT: %s\n", pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+bool run_random_tests(Client& client, int num_tests)
+{
+    banner("Random Test Vectors (" + std::to_string(num_tests) + " iterations)");
+
+    uint64_t passed = 0, failed = 0;
+    std::vector<uint32_t> cycle_counts;
+
+    for (int i = 0; i < num_tests; i++) {
+        auto key = random_bytes<16>();
+        auto pt = random_bytes<16>();
+        std::array<std::byte, 16> ct;
+        uint32_t cycles;
+
+        try {
+            cycles = client.encrypt_block(key, pt, ct);
+        } catch (const Error& e) {
+            std::printf("Test %d: ERROR - %s\n", i + 1, e.what());
+            failed++;
+            continue;
+        }
+
+        std::array<uint8_t, 16> expected;
+        SoftAes(u8(key.data())).encrypt_block(u8(pt.data()), expected.data());
+        if (std::memcmp(ct.data(), expected.data(), 16) == 0) {
+            passed++;
+            cycle_counts.push_back(cycles);
+            if ((i + 1) % 10 == 0) {
+                std::printf("Test %d: PASS (%u cycles)\n", i + 1, cycles);
+            }
+        } else {
+            failed++;
+            std::printf("Test %d: FAIL\n", i + 1);
+            std::printf("  Key: %s\n", to_hex(key).c_str());
+            std::printf("  PT:  %s\n", to_hex(pt).c_str());
+            std::printf("  HW:  %s\n", to_hex(ct).c_str());
+            std::printf("  SW:  %s\n", to_hex(std::as_bytes(std::span(expected))).c_str());
+        }
+    }
+
+    Stats stats;
+    stats.add("passed", passed);
+    stats.add("failed", failed);
+    stats.add("total", static_cast<uint64_t>(num_tests));
+    stats.add("pass_rate", num_tests > 0 ? passed * 100.0 / num_tests : 0.0);
+    if (!cycle_counts.empty()) {
+        uint64_t sum = 0;
+        for (uint32_t c : cycle_counts) {
+            sum += c;
+        }
+        stats.add("min_cycles", static_cast<uint64_t>(*std::min_element(cycle_counts.begin(), cycle_counts.end())));
+        stats.add("max_cycles", static_cast<uint64_t>(*std::max_element(cycle_counts.begin(), cycle_counts.end())));
+        stats.add("avg_cycles", static_cast<double>(sum) / cycle_counts.size());
+    }
+    stats.print("Random Test Results");
+    return failed == 0;
+}
+
+/* Single-block ECB requests kept `window` deep, as eval_aes.py does */
+void run_throughput_test(Client& client, double duration_sec, double clock_mhz)
+{
+    char title[96];
+    std::snprintf(title, sizeof(title), "Throughput Test (%.1fs duration, window %u)",
+                  duration_sec, client.options().window);
+    banner(title);
+
+    auto key = random_bytes<16>();
+    auto pt = random_bytes<16>();
+    std::atomic<uint64_t> blocks{0}, total_cycles{0};
+
+    Clock::time_point start = Clock::now();
+    while (seconds_since(start) < duration_sec) {
+        client.submit(proto::CMD_ECB, {u8(key.data()), 16}, {u8(pt.data()), 16},
+                      proto::BLOCK_SIZE + proto::CYCLES_SIZE,
+                      [&](std::exception_ptr error, std::span<const uint8_t> rsp) {
+                          if (!error && rsp.size() == proto::BLOCK_SIZE + proto::CYCLES_SIZE) {
+                              uint32_t cycles;
+                              std::memcpy(&cycles, &rsp[16], 4);
+                              blocks++;
+                              total_cycles += cycles;
+                          }
+                      });
+    }
+    client.wait_idle();
+    double elapsed = seconds_since(start);
+
+    Stats stats;
+    double avg_cycles = blocks ? static_cast<double>(total_cycles) / blocks : 0.0;
+    stats.add("blocks", blocks.load());
+    stats.add("elapsed_sec", elapsed);
+    stats.add("blocks_per_sec", blocks / elapsed);
+    stats.add("bytes_per_sec", blocks * 16 / elapsed);
+    stats.add("kbps", blocks * 16 * 8 / elapsed / 1000);
+    stats.add("avg_cycles", avg_cycles);
+    stats.print("Throughput Results");
+
+    if (avg_cycles > 0) {
+        double time_per_block_us = avg_cycles / clock_mhz;
+        std::printf("\nHardware timing (at %.1f MHz):\n", clock_mhz);
+        std::printf("  Time per block: %.3f us\n", time_per_block_us);
+        std::printf("  Theoretical throughput: %.3f MB/s\n", 16 / (time_per_block_us / 1e6) / 1e6);
+    }
+}
+
+void run_latency_test(Client& client, int num_samples, double clock_mhz)
+{
+    banner("Latency Test (" + std::to_string(num_samples) + " samples)");
+
+    auto key = random_bytes<16>();
+    std::vector<double> latencies;
+    std::vector<uint32_t> hw_cycles;
+
+    for (int i = 0; i < num_samples; i++) {
+        auto pt = random_bytes<16>();
+        std::array<std::byte, 16> ct;
+
+        Clock::time_point start = Clock::now();
+        try {
+            hw_cycles.push_back(client.encrypt_block(key, pt, ct));
+        } catch (const Error&) {
+            continue;
+        }
+        latencies.push_back(seconds_since(start) * 1000);
+    }
+
+    if (latencies.empty()) {
+        std::printf("\nLatency Results:\n----------------------------------------\n");
+        std::printf("  error: No successful measurements\n");
+        return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(hw_cycles.begin(), hw_cycles.end());
+    double sum = 0, cycle_sum = 0;
+    for (double l : latencies) {
+        sum += l;
+    }
+    for (uint32_t c : hw_cycles) {
+        cycle_sum += c;
+    }
+    double avg_latency = sum / latencies.size();
+    double avg_cycles = cycle_sum / hw_cycles.size();
+
+    Stats stats;
+    stats.add("samples", static_cast<uint64_t>(latencies.size()));
+    stats.add("min_latency_ms", latencies.front());
+    stats.add("max_latency_ms", latencies.back());
+    stats.add("avg_latency_ms", avg_latency);
+    stats.add("median_latency_ms", latencies[latencies.size() / 2]);
+    stats.add("p95_latency_ms", latencies[static_cast<size_t>(latencies.size() * 0.95)]);
+    stats.add("p99_latency_ms", latencies[static_cast<size_t>(latencies.size() * 0.99)]);
+    stats.add("min_hw_cycles", static_cast<uint64_t>(hw_cycles.front()));
+    stats.add("max_hw_cycles", static_cast<uint64_t>(hw_cycles.back()));
+    stats.add("avg_hw_cycles", avg_cycles);
+    stats.print("Latency Results");
+
+    double hw_time_ms = avg_cycles / (clock_mhz * 1000);
+    double uart_overhead = avg_latency - hw_time_ms;
+    std::printf("\nOverhead analysis:\n");
+    std::printf("  HW execution time: %.6f ms\n", hw_time_ms);
+    std::printf("  UART overhead: %.3f ms\n", uart_overhead);
+    std::printf("  Overhead %%: %.1f%%\n", uart_overhead / avg_latency * 100);
+}
+
+/* Bulk ECB through BATCH frames from a loaded key slot */
+bool run_batch_test(Client& client, size_t num_blocks, double duration_sec)
+{
+    banner("Batch Throughput Test (" + std::to_string(num_blocks) + " blocks per call)");
+
+    auto key = random_bytes<16>();
+    client.load_key(0, key);
+    SoftAes soft(u8(key.data()));
+
+    std::vector<std::byte> pt(num_blocks * proto::BLOCK_SIZE), ct(pt.size());
+    std::vector<uint8_t> expected(pt.size());
+    uint64_t blocks = 0, failed = 0, total_cycles = 0;
+
+    Clock::time_point start = Clock::now();
+    while (seconds_since(start) < duration_sec) {
+        fill_random(pt);
+        total_cycles += client.encrypt(0, pt, ct);
+        blocks += num_blocks;
+
+        soft.encrypt_ecb(u8(pt.data()), expected.data(), pt.size());
+        if (std::memcmp(ct.data(), expected.data(), ct.size()) != 0) {
+            failed++;
+        }
+    }
+    double elapsed = seconds_since(start);
+
+    Stats stats;
+    stats.add("blocks", blocks);
+    stats.add("failed_calls", failed);
+    stats.add("elapsed_sec", elapsed);
+    stats.add("blocks_per_sec", blocks / elapsed);
+    stats.add("bytes_per_sec", blocks * 16 / elapsed);
+    stats.add("kbps", blocks * 16 * 8 / elapsed / 1000);
+    stats.add("cycles_per_block", blocks ? static_cast<double>(total_cycles) / blocks : 0.0);
+    stats.add("link_utilization_pct",
+              blocks * 16 * 10 / elapsed / client.baudrate() * 100);
+    stats.print("Batch Results");
+    return failed == 0;
+}
+
+/*
+ * AESAVS Monte Carlo reference: same chaining and checkpoint layout as the
+ * firmware (last output, then the next iteration's first input).
+ */
+std::vector<uint8_t> mct_reference(BatchMode mode, const uint8_t* key_in, const uint8_t* iv_in,
+                                   const uint8_t* text_in, unsigned iterations)
+{
+    const bool cbc = mode == BatchMode::CbcEncrypt || mode == BatchMode::CbcDecrypt;
+    const bool decrypt = mode == BatchMode::EcbDecrypt || mode == BatchMode::CbcDecrypt;
+    uint8_t key[16], iv[16], block[16], chain[16], prev[16], out[16];
+    std::memcpy(key, key_in, 16);
+    std::memcpy(iv, iv_in, 16);
+    std::memcpy(block, text_in, 16);
+    std::vector<uint8_t> checkpoints;
+
+    for (unsigned i = 0; i < iterations; i++) {
+        SoftAes soft(key);
+        std::memcpy(chain, iv, 16);
+        for (unsigned j = 0; j < proto::MCT_INNER_BLOCKS; j++) {
+            uint8_t in[16];
+            if (cbc && !decrypt) {
+                for (int b = 0; b < 16; b++) {
+                    in[b] = block[b] ^ chain[b];
+                }
+                soft.encrypt_block(in, out);
+                std::memcpy(chain, out, 16);
+            } else if (cbc) {
+                soft.decrypt_block(block, out);
+                for (int b = 0; b < 16; b++) {
+                    out[b] ^= chain[b];
+                }
+                std::memcpy(chain, block, 16);
+            } else if (decrypt) {
+                soft.decrypt_block(block, out);
+            } else {
+                soft.encrypt_block(block, out);
+            }
+
+            if (cbc) {
+                std::memcpy(block, j == 0 ? iv : prev, 16);
+                std::memcpy(prev, out, 16);
+            } else {
+                std::memcpy(block, out, 16);
+            }
+        }
+        for (int b = 0; b < 16; b++) {
+            key[b] ^= out[b];
+        }
+        if (cbc) {
+            std::memcpy(iv, out, 16);
+        }
+        checkpoints.insert(checkpoints.end(), out, out + 16);
+        checkpoints.insert(checkpoints.end(), block, block + 16);
+    }
+    return checkpoints;
+}
+
+/* AESAVS MCT for every batch mode, run on the board in one request each */
+bool run_mct_test(Client& client, unsigned iterations, double clock_mhz)
+{
+    banner("Monte Carlo Test (" + std::to_string(iterations) + " x " +
+           std::to_string(proto::MCT_INNER_BLOCKS) + " blocks per mode)");
+
+    const std::pair<const char*, BatchMode> modes[] = {
+        {"ECB encrypt", BatchMode::EcbEncrypt},
+        {"ECB decrypt", BatchMode::EcbDecrypt},
+        {"CBC encrypt", BatchMode::CbcEncrypt},
+        {"CBC decrypt", BatchMode::CbcDecrypt},
+    };
+
+    Stats stats;
+    uint64_t failed = 0, total_cycles = 0;
+    double total_elapsed = 0;
+    std::vector<std::byte> checkpoints(iterations * proto::MCT_CHECKPOINT_SIZE);
+
+    for (const auto& [name, mode] : modes) {
+        auto key = random_bytes<16>();
+        auto iv = random_bytes<16>();
+        auto text = random_bytes<16>();
+
+        Clock::time_point start = Clock::now();
+        uint32_t cycles = client.monte_carlo(mode, 3, key, iv, text, checkpoints);
+        total_elapsed += seconds_since(start);
+        total_cycles += cycles;
+
+        auto expected = mct_reference(mode, u8(key.data()), u8(iv.data()), u8(text.data()), iterations);
+        bool pass = std::memcmp(checkpoints.data(), expected.data(), expected.size()) == 0;
+        std::printf("%-12s %s  %u cycles\n", name, pass ? "PASS" : "FAIL", cycles);
+        if (!pass) {
+            failed++;
+        }
+    }
+
+    uint64_t blocks = uint64_t(4) * iterations * proto::MCT_INNER_BLOCKS;
+    stats.add("blocks", blocks);
+    stats.add("failed_modes", failed);
+    stats.add("elapsed_sec", total_elapsed);
+    stats.add("fpga_time_ms", total_cycles / (clock_mhz * 1000));
+    stats.add("cycles_per_block", static_cast<double>(total_cycles) / blocks);
+    stats.print("Monte Carlo Results");
+    return failed == 0;
+}
+
+/* Core and IO bus ceilings measured on the board, UART excluded */
+void run_self_benchmark(Client& client, uint32_t blocks, double clock_mhz)
+{
+    banner("On-board Self-Benchmark (" + std::to_string(blocks) + " blocks per variant)");
+
+    client.load_key(0, random_bytes<16>());
+    auto cycles = client.self_benchmark(0, blocks);
+
+    static const char* const names[proto::BENCH_VARIANTS] = {
+        "polled", "interrupt", "queued", "write_only", "read_only",
+    };
+    Stats stats;
+    for (size_t i = 0; i < proto::BENCH_VARIANTS; i++) {
+        double per_block = static_cast<double>(cycles[i]) / blocks;
+        std::string name = names[i];
+        stats.add((name + "_cycles_per_block").c_str(), per_block);
+        stats.add((name + "_mb_per_sec").c_str(), per_block > 0 ? 16 * clock_mhz / per_block : 0.0);
+    }
+    stats.print("Self-Benchmark Results");
+}
+
+/* Where an ECB frame's time goes, from the firmware's phase timestamps */
+void run_phase_test(Client& client, int num_samples, double clock_mhz)
+{
+    banner("ECB Phase Breakdown (" + std::to_string(num_samples) + " frames)");
+
+    static const char* const gaps[proto::PHASE_COUNT - 1] = {
+        "sof_to_key_written",
+        "key_to_plaintext_written",
+        "plaintext_to_frame_verified",
+        "verified_to_start",
+        "start_to_done",
+        "done_to_ciphertext_read",
+        "ciphertext_to_last_tx_queued",
+    };
+
+    // Discard the averages of earlier tests
+    uint32_t overruns = client.phase_stats().rx_overruns;
+    for (int i = 0; i < num_samples; i++) {
+        auto key = random_bytes<16>();
+        auto pt = random_bytes<16>();
+        std::array<std::byte, 16> ct;
+        client.encrypt_block(key, pt, ct);
+    }
+    PhaseStats phases = client.phase_stats();
+
+    Stats stats;
+    stats.add("frames", uint64_t(phases.frames));
+    uint64_t total = 0;
+    for (size_t i = 0; i < proto::PHASE_COUNT - 1; i++) {
+        stats.add((std::string(gaps[i]) + "_cycles").c_str(), uint64_t(phases.average[i]));
+        total += phases.average[i];
+    }
+    stats.add("total_cycles", total);
+    stats.add("total_us", total / clock_mhz);
+    stats.add("rx_overruns", uint64_t(phases.rx_overruns - overruns));
+    stats.print("Phase Results");
+}
+
+/*
+ * The same single-block frames twice, pipelined: full key in every frame,
+ * then the id of a stored key. Blocks rotate over num_ids keys; beyond
+ * the four key slots every id change costs a key expansion.
+ */
+bool run_key_cache_test(Client& client, size_t num_blocks, unsigned num_ids, double clock_mhz)
+{
+    banner("Key Cache Test (" + std::to_string(num_blocks) + " blocks, " +
+           std::to_string(num_ids) + " key ids)");
+
+    if (num_ids == 0 || num_ids > proto::KEY_CACHE_IDS) {
+        std::printf("Key ids must be 1-%u\n", proto::KEY_CACHE_IDS);
+        return false;
+    }
+    std::vector<std::array<std::byte, 16>> keys(num_ids);
+    std::vector<SoftAes> soft;
+    for (unsigned id = 0; id < num_ids; id++) {
+        keys[id] = random_bytes<16>();
+        client.store_key(id, keys[id]);
+        soft.emplace_back(u8(keys[id].data()));
+    }
+
+    std::vector<std::byte> pt(num_blocks * proto::BLOCK_SIZE);
+    fill_random(pt);
+    const size_t rsp_len = proto::BLOCK_SIZE + proto::CYCLES_SIZE;
+
+    Stats stats;
+    stats.add("blocks", uint64_t(num_blocks));
+    bool passed = true;
+    for (bool by_id : {false, true}) {
+        std::vector<std::byte> ct(pt.size());
+        std::atomic<uint64_t> total_cycles{0};
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < num_blocks; i++) {
+            unsigned id = static_cast<unsigned>(i % num_ids);
+            uint8_t id_byte = static_cast<uint8_t>(id);
+            std::byte* out = &ct[i * proto::BLOCK_SIZE];
+            auto done = [&total_cycles, out](std::exception_ptr error, std::span<const uint8_t> rsp) {
+                if (!error && rsp.size() == proto::BLOCK_SIZE + proto::CYCLES_SIZE) {
+                    uint32_t cycles;
+                    std::memcpy(out, rsp.data(), proto::BLOCK_SIZE);
+                    std::memcpy(&cycles, &rsp[proto::BLOCK_SIZE], 4);
+                    total_cycles += cycles;
+                }
+            };
+            std::span<const uint8_t> block{u8(&pt[i * proto::BLOCK_SIZE]), proto::BLOCK_SIZE};
+            if (by_id) {
+                client.submit(proto::CMD_ECB_ID, block, {&id_byte, 1}, rsp_len, done);
+            } else {
+                client.submit(proto::CMD_ECB, {u8(keys[id].data()), 16}, block, rsp_len, done);
+            }
+        }
+        client.wait_idle();
+        double elapsed = seconds_since(start);
+
+        uint64_t failed = 0;
+        for (size_t i = 0; i < num_blocks; i++) {
+            uint8_t expected[16];
+            soft[i % num_ids].encrypt_block(u8(&pt[i * proto::BLOCK_SIZE]), expected);
+            if (std::memcmp(&ct[i * proto::BLOCK_SIZE], expected, 16) != 0) {
+                failed++;
+            }
+        }
+        passed = passed && failed == 0;
+
+        // Request frame: header, key or id, plaintext, CRC
+        std::string name = by_id ? "key_id" : "full_key";
+        size_t frame_bytes = proto::HEADER_SIZE + (by_id ? 1 : proto::KEY_SIZE) + proto::BLOCK_SIZE +
+                             proto::CRC_SIZE;
+        double avg_cycles = static_cast<double>(total_cycles) / num_blocks;
+        stats.add((name + "_failed").c_str(), failed);
+        stats.add((name + "_request_bytes").c_str(), uint64_t(frame_bytes));
+        stats.add((name + "_blocks_per_sec").c_str(), num_blocks / elapsed);
+        stats.add((name + "_avg_cycles").c_str(), avg_cycles);
+        stats.add((name + "_avg_us").c_str(), avg_cycles / clock_mhz);
+    }
+    stats.print("Key Cache Results");
+    return passed;
+}
+
+/*
+ * Single-block ECB frames, pipelined, while the hardware frame bridge owns
+ * the link, at baud if non-zero; then the link is handed back and the
+ * bridge's counters are checked. Skipped when the design has no bridge.
+ */
+bool run_bridge_test(Client& client, size_t num_blocks, unsigned baud, double clock_mhz)
+{
+    banner("Frame Bridge Test (" + std::to_string(num_blocks) + " blocks)");
+
+    try {
+        client.bridge(true);
+    } catch (const NakError& e) {
+        if (e.reason() != proto::NAK_PARAM) {
+            throw;
+        }
+        std::printf("No frame bridge in this design, skipped\n");
+        return true;
+    }
+    if (baud != 0) {
+        client.set_baudrate(baud);
+    }
+    unsigned line_baud = client.baudrate();
+
+    auto key = random_bytes<16>();
+    SoftAes soft(u8(key.data()));
+    std::vector<std::byte> pt(num_blocks * proto::BLOCK_SIZE);
+    fill_random(pt);
+    std::vector<std::byte> ct(pt.size());
+    std::atomic<uint64_t> total_cycles{0};
+    const size_t rsp_len = proto::BLOCK_SIZE + proto::CYCLES_SIZE;
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < num_blocks; i++) {
+        std::byte* out = &ct[i * proto::BLOCK_SIZE];
+        client.submit(proto::CMD_ECB, {u8(key.data()), 16},
+                      {u8(&pt[i * proto::BLOCK_SIZE]), proto::BLOCK_SIZE}, rsp_len,
+                      [&total_cycles, out](std::exception_ptr error, std::span<const uint8_t> rsp) {
+                          if (!error && rsp.size() == proto::BLOCK_SIZE + proto::CYCLES_SIZE) {
+                              uint32_t cycles;
+                              std::memcpy(out, rsp.data(), proto::BLOCK_SIZE);
+                              std::memcpy(&cycles, &rsp[proto::BLOCK_SIZE], 4);
+                              total_cycles += cycles;
+                          }
+                      });
+    }
+    client.wait_idle();
+    double elapsed = seconds_since(start);
+    BridgeStats bridge = client.bridge(false);
+
+    uint64_t failed = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+        uint8_t expected[16];
+        soft.encrypt_block(u8(&pt[i * proto::BLOCK_SIZE]), expected);
+        if (std::memcmp(&ct[i * proto::BLOCK_SIZE], expected, 16) != 0) {
+            failed++;
+        }
+    }
+    double avg_cycles = static_cast<double>(total_cycles) / num_blocks;
+
+    Stats stats;
+    stats.add("blocks", uint64_t(num_blocks));
+    stats.add("baud", uint64_t(line_baud));
+    stats.add("failed", failed);
+    stats.add("blocks_per_sec", num_blocks / elapsed);
+    stats.add("avg_cycles", avg_cycles);
+    stats.add("avg_us", avg_cycles / clock_mhz);
+    stats.add("bridge_frames", uint64_t(bridge.frames));
+    stats.add("bridge_crc_errors", uint64_t(bridge.crc_errors));
+    stats.add("bridge_naks", uint64_t(bridge.naks));
+    stats.print("Frame Bridge Results");
+
+    // Every block plus the closing BRIDGE went through the bridge
+    return failed == 0 && bridge.frames == num_blocks + 1 && bridge.crc_errors == 0 && bridge.naks == 0;
+}
+
+/*
+ * Offloading is meant to cost at most about one chunk of software time, so
+ * the hybrid pass must keep up with software alone on the same data: its
+ * speedup may fall below 1 only by min_speedup's margin for timing noise.
+ */
+bool run_hybrid_test(Client& client, size_t num_blocks, SoftAes::Backend backend, double min_speedup)
+{
+    banner("Hybrid ECB Test (" + std::to_string(num_blocks) + " blocks, " +
+           SoftAes::backend_name(backend) + ")");
+
+    auto key = random_bytes<16>();
+    HybridEcb hybrid(client, 0, key, backend);
+    std::vector<std::byte> pt(num_blocks * proto::BLOCK_SIZE), ct(pt.size()), back(pt.size());
+    std::vector<uint8_t> expected(pt.size());
+    fill_random(pt);
+
+    // Best of a few passes on each side; later hybrid passes also start
+    // from the estimates the earlier ones settled on
+    const int passes = 5;
+    double soft_elapsed = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        Clock::time_point start = Clock::now();
+        hybrid.soft().encrypt_ecb(u8(pt.data()), expected.data(), pt.size());
+        double elapsed = seconds_since(start);
+        soft_elapsed = pass == 0 ? elapsed : std::min(soft_elapsed, elapsed);
+    }
+
+    HybridStats enc;
+    double hybrid_elapsed = 0;
+    uint64_t failed = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        enc = hybrid.encrypt(pt, ct);
+        hybrid_elapsed = pass == 0 ? enc.seconds : std::min(hybrid_elapsed, enc.seconds);
+        if (std::memcmp(ct.data(), expected.data(), ct.size()) != 0) {
+            failed++;
+        }
+    }
+    HybridStats dec = hybrid.decrypt(ct, back);
+    if (back != pt) {
+        failed++;
+    }
+    double speedup = soft_elapsed / hybrid_elapsed;
+
+    Stats stats;
+    stats.add("blocks", uint64_t(num_blocks));
+    stats.add("failed", failed);
+    stats.add("soft_only_ms", soft_elapsed * 1000);
+    stats.add("hybrid_ms", hybrid_elapsed * 1000);
+    stats.add("speedup", speedup);
+    stats.add("fpga_blocks", enc.fpga_blocks);
+    stats.add("soft_blocks", enc.soft_blocks);
+    stats.add("reclaimed_blocks", enc.reclaimed_blocks);
+    stats.add("fpga_share_pct", enc.fpga_share() * 100);
+    stats.add("decrypt_ms", dec.seconds * 1000);
+    stats.add("decrypt_fpga_share_pct", dec.fpga_share() * 100);
+    stats.add("soft_blocks_per_sec", hybrid.soft_rate());
+    stats.add("fpga_blocks_per_sec", hybrid.fpga_rate());
+    stats.add("fpga_failed", uint64_t(enc.fpga_failed || dec.fpga_failed));
+    stats.print("Hybrid ECB Results");
+
+    bool fast_enough = speedup >= min_speedup;
+    std::printf("\nSpeedup over software only: %.3f (at least %.2f): %s\n", speedup, min_speedup,
+                fast_enough ? "PASS" : "FAIL");
+    return failed == 0 && fast_enough;
+}
+
+/* Requests naming a slot past the last must be NAKed, not wrapped onto another slot */
+/*
+ * IEEE 1619 XTS-AES-128 vectors 1, 2, 15 and 18 (the last two end in a
+ * partial block), each encrypted and decrypted back, then a round trip of
+ * a random data unit of XTS_MAX_SIZE - 1 bytes: a full stream of blocks
+ * ending in ciphertext stealing.
+ */
+bool run_xts_test(Client& client)
+{
+    banner("XTS Test (IEEE 1619)");
+
+    const struct {
+        const char* name;
+        const char* key1;
+        const char* key2;
+        const char* tweak;
+        const char* pt;
+        const char* ct;
+    } vectors[] = {
+        {"vector 1", "00000000000000000000000000000000", "00000000000000000000000000000000",
+         "00000000000000000000000000000000",
+         "0000000000000000000000000000000000000000000000000000000000000000",
+         "917cf69ebd68b2ec9b9fe9a3eadda692cd43d2f59598ed858c02c2652fbf922e"},
+        {"vector 2", "11111111111111111111111111111111", "22222222222222222222222222222222",
+         "33333333330000000000000000000000",
+         "4444444444444444444444444444444444444444444444444444444444444444",
+         "c454185e6a16936e39334038acef838bfb186fff7480adc4289382ecd6d394f0"},
+        {"vector 15", "fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0", "bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0",
+         "9a785634120000000000000000000000", "000102030405060708090a0b0c0d0e0f10",
+         "6c1625db4671522d3d7599601de7ca09ed"},
+        {"vector 18", "fffefdfcfbfaf9f8f7f6f5f4f3f2f1f0", "bfbebdbcbbbab9b8b7b6b5b4b3b2b1b0",
+         "9a785634120000000000000000000000", "000102030405060708090a0b0c0d0e0f10111213",
+         "9d84c813f719aa2c7be3f66171c7c5c2edbf9dac"},
+    };
+
+    uint64_t failed = 0;
+    for (const auto& v : vectors) {
+        auto pt = from_hex(v.pt);
+        std::vector<std::byte> ct(pt.size()), back(pt.size());
+        client.load_key(2, from_hex<16>(v.key1));
+        client.load_key(3, from_hex<16>(v.key2));
+        client.xts_encrypt(2, 3, from_hex<16>(v.tweak), pt, ct);
+        client.xts_decrypt(2, 3, from_hex<16>(v.tweak), ct, back);
+
+        bool pass = to_hex(ct) == v.ct && back == pt;
+        std::printf("%-10s %2zu bytes: %s\n", v.name, pt.size(), pass ? "PASS" : "FAIL");
+        if (!pass) {
+            std::printf("  Expected: %s\n  Got:      %s\n", v.ct, to_hex(ct).c_str());
+            failed++;
+        }
+    }
+
+    std::vector<std::byte> data(proto::XTS_MAX_SIZE - 1), ct(data.size()), back(data.size());
+    fill_random(data);
+    auto tweak = random_bytes<16>();
+    client.load_key(2, random_bytes<16>());
+    client.load_key(3, random_bytes<16>());
+    uint32_t cycles = client.xts_encrypt(2, 3, tweak, data, ct);
+    client.xts_decrypt(2, 3, tweak, ct, back);
+    bool pass = back == data && ct != data;
+    std::printf("%-10s %zu bytes: %s  %u cycles\n", "round trip", data.size(), pass ? "PASS" : "FAIL",
+                cycles);
+    if (!pass) {
+        failed++;
+    }
+
+    std::printf("RESULT: %s\n", failed == 0 ? "PASS" : "FAIL");
+    return failed == 0;
+}
+
+/* RFC 4493 examples 1-4: the empty message, one block, a partial last block, four blocks */
+bool run_cmac_test(Client& client)
+{
+    banner("CMAC Test (RFC 4493)");
+
+    const char* const message =
+        "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+        "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+    const struct {
+        size_t len;
+        const char* tag;
+    } examples[] = {
+        {0, "bb1d6929e95937287fa37d129b756746"},
+        {16, "070a16b46b4d4144f79bdd9dd04a287c"},
+        {40, "dfa66747de9ae63030ca32611497c827"},
+        {64, "51f0bebf7e3b9d92fc49741779363cfe"},
+    };
+
+    client.load_key(1, from_hex<16>("2b7e151628aed2a6abf7158809cf4f3c"));
+    auto msg = from_hex(message);
+
+    uint64_t failed = 0;
+    for (const auto& e : examples) {
+        std::array<std::byte, 16> tag;
+        uint32_t cycles = client.cmac(1, std::span(msg).first(e.len), tag);
+        bool pass = to_hex(tag) == e.tag;
+        std::printf("%2zu bytes: %s  %u cycles\n", e.len, pass ? "PASS" : "FAIL", cycles);
+        if (!pass) {
+            std::printf("  Expected: %s\n  Got:      %s\n", e.tag, to_hex(tag).c_str());
+            failed++;
+        }
+    }
+
+    std::printf("RESULT: %s\n", failed == 0 ? "PASS" : "FAIL");
+    return failed == 0;
+}
+
+bool run_slot_range_test(Client& client)
+{
+    banner("Key Slot Range Test");
+
+    const uint8_t slot = proto::NUM_KEY_SLOTS;
+
+    // KEY_LOAD: [key] [slot]
+    std::vector<uint8_t> key_load(proto::KEY_SIZE + 1);
+    key_load[proto::KEY_SIZE] = slot;
+
+    // CTR: [slot] [nonce] [counter32 BE] [count32], one block
+    std::vector<uint8_t> ctr(1 + proto::NONCE_SIZE + 8);
+    ctr[0] = slot;
+    ctr[1 + proto::NONCE_SIZE + 4] = 1;
+
+    // BATCH: [mode] [slot] [flags] [reserved] [IV], no blocks
+    std::vector<uint8_t> batch(proto::BATCH_HEADER_SIZE);
+    batch[1] = slot;
+
+    // MCT: [mode] [slot] [iterations16] [IV] [key] [text], one iteration
+    std::vector<uint8_t> mct(proto::MCT_PAYLOAD_SIZE);
+    mct[1] = slot;
+    mct[2] = 1;
+
+    // BENCH: [count32] [slot], one block
+    std::vector<uint8_t> bench(proto::BENCH_PAYLOAD_SIZE);
+    bench[0] = 1;
+    bench[4] = slot;
+
+    // CMAC: [slot], empty message
+    std::vector<uint8_t> cmac = {slot};
+
+    // XTS: [direction] [slot] [tweak slot] [reserved] [tweak] [data], one block
+    std::vector<uint8_t> xts(proto::XTS_HEADER_SIZE + proto::BLOCK_SIZE);
+    xts[1] = slot;
+
+    const struct {
+        const char* name;
+        uint8_t cmd;
+        const std::vector<uint8_t>& payload;
+    } cases[] = {
+        {"KEY_LOAD", proto::CMD_KEY_LOAD, key_load},
+        {"CTR", proto::CMD_CTR, ctr},
+        {"BATCH", proto::CMD_BATCH, batch},
+        {"MCT", proto::CMD_MCT, mct},
+        {"BENCH", proto::CMD_BENCH, bench},
+        {"XTS", proto::CMD_XTS, xts},
+        {"CMAC", proto::CMD_CMAC, cmac},
+    };
+
+    uint64_t failed = 0;
+    for (const auto& c : cases) {
+        bool pass = false;
+        const char* detail = "accepted";
+        try {
+            client.request(c.cmd, c.payload).get();
+        } catch (const NakError& e) {
+            pass = e.reason() == proto::NAK_PARAM && e.cmd() == c.cmd;
+            detail = pass ? "bad parameter" : e.what();
+        }
+        std::printf("%-10s slot %u: %s (%s)\n", c.name, slot, pass ? "PASS" : "FAIL", detail);
+        if (!pass) {
+            failed++;
+        }
+    }
+    std::printf("RESULT: %s\n", failed == 0 ? "PASS" : "FAIL");
+    return failed == 0;
+}
+
+void usage(const char* prog)
+{
+    std::printf("Usage: %s [options]\n"
+                "  --port PATH             Serial port (default: /dev/ttyUSB1)\n"
+                "  --baud N                Baud rate (default: 115200)\n"
+                "  --window N              Requests kept in flight (default: 8)\n"
+                "  --random-tests N        Random test vectors (default: 100)\n"
+                "  --throughput-time SEC   Throughput test duration (default: 5.0)\n"
+                "  --latency-samples N     Latency samples (default: 1000)\n"
+                "  --batch-blocks N        Blocks per batch call (default: 256)\n"
+                "  --mct-iterations N      Monte Carlo outer iterations (default: 100)\n"
+                "  --self-bench-blocks N   Blocks per on-board benchmark variant (default: 4096)\n"
+                "  --phase-samples N       ECB frames in the phase breakdown (default: 100)\n"
+                "  --key-cache-blocks N    Blocks per key cache pass (default: 1000)\n"
+                "  --key-cache-ids N       Stored keys the blocks rotate over (default: 2)\n"
+                "  --bridge-blocks N       Blocks sent through the frame bridge (default: 1000)\n"
+                "  --bridge-baud N         Line rate negotiated with the frame bridge (default: --baud)\n"
+                "  --hybrid-blocks N       Blocks in the shared hybrid job (default: 65536)\n"
+                "  --hybrid-soft NAME      Software side: aesni, bitsliced or reference (default: best)\n"
+                "  --hybrid-min-speedup X  Hybrid time may be at most software-only / X (default: 0.9)\n"
+                "  --clock-mhz MHZ         FPGA clock (default: 125.0)\n"
+                "  --skip-nist --skip-random --skip-throughput --skip-latency --skip-batch\n"
+                "  --skip-mct --skip-self-bench --skip-phases --skip-key-cache --skip-bridge\n"
+                "  --skip-hybrid --skip-xts --skip-cmac --skip-slot-range\n",
+                prog);
+}
+
+bool parse_args(int argc, char** argv, Args& args)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "%s needs a value\n", arg.c_str());
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--port") {
+            args.port = value();
+        } else if (arg == "--baud") {
+            args.baud = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--window") {
+            args.window = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--random-tests") {
+            args.random_tests = std::atoi(value());
+        } else if (arg == "--throughput-time") {
+            args.throughput_time = std::atof(value());
+        } else if (arg == "--latency-samples") {
+            args.latency_samples = std::atoi(value());
+        } else if (arg == "--batch-blocks") {
+            args.batch_blocks = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--mct-iterations") {
+            args.mct_iterations = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--self-bench-blocks") {
+            args.self_bench_blocks = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--phase-samples") {
+            args.phase_samples = std::atoi(value());
+        } else if (arg == "--key-cache-blocks") {
+            args.key_cache_blocks = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--key-cache-ids") {
+            args.key_cache_ids = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--bridge-blocks") {
+            args.bridge_blocks = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--bridge-baud") {
+            args.bridge_baud = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--hybrid-blocks") {
+            args.hybrid_blocks = std::strtoul(value(), nullptr, 10);
+        } else if (arg == "--hybrid-soft") {
+            std::string name = value();
+            if (name == "aesni") {
+                args.hybrid_soft = SoftAes::Backend::AesNi;
+            } else if (name == "bitsliced") {
+                args.hybrid_soft = SoftAes::Backend::Bitsliced;
+            } else if (name == "reference") {
+                args.hybrid_soft = SoftAes::Backend::Reference;
+            } else {
+                usage(argv[0]);
+                return false;
+            }
+        } else if (arg == "--hybrid-min-speedup") {
+            args.hybrid_min_speedup = std::atof(value());
+        } else if (arg == "--clock-mhz") {
+            args.clock_mhz = std::atof(value());
+        } else if (arg == "--skip-nist") {
+            args.skip_nist = true;
+        } else if (arg == "--skip-random") {
+            args.skip_random = true;
+        } else if (arg == "--skip-throughput") {
+            args.skip_throughput = true;
+        } else if (arg == "--skip-latency") {
+            args.skip_latency = true;
+        } else if (arg == "--skip-batch") {
+            args.skip_batch = true;
+        } else if (arg == "--skip-mct") {
+            args.skip_mct = true;
+        } else if (arg == "--skip-self-bench") {
+            args.skip_self_bench = true;
+        } else if (arg == "--skip-phases") {
+            args.skip_phases = true;
+        } else if (arg == "--skip-key-cache") {
+            args.skip_key_cache = true;
+        } else if (arg == "--skip-bridge") {
+            args.skip_bridge = true;
+        } else if (arg == "--skip-hybrid") {
+            args.skip_hybrid = true;
+        } else if (arg == "--skip-xts") {
+            args.skip_xts = true;
+        } else if (arg == "--skip-cmac") {
+            args.skip_cmac = true;
+        } else if (arg == "--skip-slot-range") {
+            args.skip_slot_range = true;
+        } else {
+            usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Args args;
+    if (!parse_args(argc, argv, args)) {
+        return 2;
+    }
+
+    std::printf("============================================================\n");
+    std::printf("AES-128 FPGA Accelerator Benchmark (libaesfpga)\n");
+    std::printf("============================================================\n");
+    std::printf("Port:  %s\n", args.port.c_str());
+    std::printf("Clock: %.1f MHz\n", args.clock_mhz);
+
+    try {
+        Client::Options options;
+        options.window = args.window;
+        Client client(args.port, args.baud, options);
+
+        unsigned version = client.ping();
+        std::printf("\nConnected to: %s (protocol v%u)\n", args.port.c_str(), version);
+        if (version != proto::PROTOCOL_VERSION) {
+            std::printf("Unsupported protocol version\n");
+            return 1;
+        }
+
+        bool all_passed = true;
+        if (!args.skip_nist && !run_nist_test_vector(client)) {
+            all_passed = false;
+        }
+        if (!args.skip_random && !run_random_tests(client, args.random_tests)) {
+            all_passed = false;
+        }
+        if (!args.skip_throughput) {
+            run_throughput_test(client, args.throughput_time, args.clock_mhz);
+        }
+        if (!args.skip_latency) {
+            run_latency_test(client, args.latency_samples, args.clock_mhz);
+        }
+        if (!args.skip_batch && !run_batch_test(client, args.batch_blocks, args.throughput_time)) {
+            all_passed = false;
+        }
+        if (!args.skip_mct && !run_mct_test(client, args.mct_iterations, args.clock_mhz)) {
+            all_passed = false;
+        }
+        if (!args.skip_self_bench) {
+            run_self_benchmark(client, args.self_bench_blocks, args.clock_mhz);
+        }
+        if (!args.skip_phases) {
+            run_phase_test(client, args.phase_samples, args.clock_mhz);
+        }
+        if (!args.skip_key_cache &&
+            !run_key_cache_test(client, args.key_cache_blocks, args.key_cache_ids, args.clock_mhz)) {
+            all_passed = false;
+        }
+        if (!args.skip_bridge && !run_bridge_test(client, args.bridge_blocks, args.bridge_baud, args.clock_mhz)) {
+            all_passed = false;
+        }
+        if (!args.skip_hybrid && !run_hybrid_test(client, args.hybrid_blocks, args.hybrid_soft,
+                                                   args.hybrid_min_speedup)) {
+            all_passed = false;
+        }
+        if (!args.skip_xts && !run_xts_test(client)) {
+            all_passed = false;
+        }
+        if (!args.skip_cmac && !run_cmac_test(client)) {
+            all_passed = false;
+        }
+        if (!args.skip_slot_range && !run_slot_range_test(client)) {
+            all_passed = false;
+        }
+
+        banner(all_passed ? "ALL TESTS PASSED" : "SOME TESTS FAILED");
+        return all_passed ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "\nError: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,274 @@
+/*
+ * AES-128 FPGA Accelerator - Host Client
+ *
+ * Requests are pipelined: up to Options::window frames are in flight at
+ * once and responses are matched by sequence number on a reader thread,
+ * so throughput is bound by the UART rather than by the USB-serial round
+ * trip. Each sequence number owns a frame buffer allocated up front, so
+ * submitting a request copies its payload once and allocates nothing.
+ *
+ * Bulk calls split data into BATCH frames of up to 32 blocks and write
+ * results straight into the caller's output span. Callbacks run on the
+ * reader thread: they must not block or submit further requests.
+ */
+
+#ifndef AESFPGA_CLIENT_HPP
+#define AESFPGA_CLIENT_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "aesfpga/protocol.hpp"
+#include "aesfpga/serial_port.hpp"
+
+namespace aesfpga {
+
+using ByteSpan = std::span<const std::byte>;
+using MutableByteSpan = std::span<std::byte>;
+using KeySpan = std::span<const std::byte, proto::KEY_SIZE>;
+using BlockSpan = std::span<const std::byte, proto::BLOCK_SIZE>;
+
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/** The firmware rejected a request. */
+class NakError : public Error {
+public:
+    NakError(uint8_t reason, uint8_t cmd);
+    uint8_t reason() const { return reason_; }
+    uint8_t cmd() const { return cmd_; }
+
+private:
+    uint8_t reason_;
+    uint8_t cmd_;
+};
+
+/** No response arrived within Options::timeout. */
+class TimeoutError : public Error {
+public:
+    using Error::Error;
+};
+
+enum class BatchMode : uint8_t {
+    EcbEncrypt = proto::BATCH_MODE_ECB_ENC,
+    EcbDecrypt = proto::BATCH_MODE_ECB_DEC,
+    CbcEncrypt = proto::BATCH_MODE_CBC_ENC,
+    CbcDecrypt = proto::BATCH_MODE_CBC_DEC,
+};
+
+/** Firmware phase timestamps (STATS); PIT1 counts down. */
+struct PhaseStats {
+    uint8_t seq;                                            // Last frame before STATS
+    uint8_t cmd;
+    uint16_t valid;                                         // Bit i: stamps[i] taken
+    std::array<uint32_t, proto::PHASE_COUNT> stamps;
+    uint32_t frames;                                        // Frames averaged
+    std::array<uint32_t, proto::PHASE_COUNT - 1> average;   // Cycles from phase i to i + 1
+    uint32_t rx_overruns;                                   // Bytes dropped on a full RX ring since reset
+};
+
+/** Hardware frame bridge counters (BRIDGE) for its last session. */
+struct BridgeStats {
+    uint32_t frames;        // Frames with a good CRC, the closing BRIDGE included
+    uint32_t crc_errors;
+    uint32_t naks;
+};
+
+class Client {
+public:
+    struct Options {
+        unsigned window = 8;                                 // Requests in flight (1-255)
+        size_t max_inflight_bytes = proto::DEVICE_RX_RING_SIZE;
+        std::chrono::milliseconds timeout{2000};             // Per request, plus transfer time
+    };
+
+    /** Completion callback: error is null on success. */
+    using Callback = std::function<void(std::exception_ptr error,
+                                        std::span<const uint8_t> payload)>;
+
+    Client(const std::string& port, unsigned baudrate = 115200);
+    Client(const std::string& port, unsigned baudrate, const Options& options);
+    ~Client();
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /*
+     * Raw requests. The payload is head followed by tail; both are copied
+     * before submit() returns. Blocks while the window is full.
+     * response_len sizes the timeout for long responses.
+     */
+    void submit(uint8_t cmd, std::span<const uint8_t> head, std::span<const uint8_t> tail,
+                size_t response_len, Callback callback);
+    std::future<std::vector<uint8_t>> request(uint8_t cmd, std::span<const uint8_t> payload = {},
+                                              size_t response_len = 0);
+
+    /** Returns the firmware protocol version. */
+    unsigned ping();
+
+    /** Single-block ECB with a one-off key; returns the cycle count. */
+    uint32_t encrypt_block(KeySpan key, BlockSpan in, std::span<std::byte, proto::BLOCK_SIZE> out);
+
+    /** Expand key into a slot; returns the cycle count. */
+    uint32_t load_key(unsigned slot, KeySpan key);
+
+    /**
+     * Keep key in the firmware key table under id (below KEY_CACHE_IDS);
+     * returns the cycle count. The firmware keeps ids expanded in the key
+     * slots, evicting the least recently used, and takes slots loaded
+     * with load_key() or a batch key only when every other slot is in use.
+     */
+    uint32_t store_key(unsigned id, KeySpan key);
+
+    /** Single-block ECB with a stored key; returns the cycle count. */
+    uint32_t encrypt_block(unsigned key_id, BlockSpan in, std::span<std::byte, proto::BLOCK_SIZE> out);
+
+    /*
+     * Bulk processing with a key already loaded in slot. in.size() must be
+     * a multiple of 16 and out at least as large; out may be the same
+     * buffer as in.
+     * Futures yield the total cycle count reported by the firmware.
+     */
+    std::future<uint32_t> process_async(BatchMode mode, unsigned slot, ByteSpan in,
+                                        MutableByteSpan out, BlockSpan iv);
+    std::future<uint32_t> encrypt_async(unsigned slot, ByteSpan in, MutableByteSpan out);
+    std::future<uint32_t> decrypt_async(unsigned slot, ByteSpan in, MutableByteSpan out);
+
+    uint32_t encrypt(unsigned slot, ByteSpan in, MutableByteSpan out);
+    uint32_t decrypt(unsigned slot, ByteSpan in, MutableByteSpan out);
+    uint32_t process(BatchMode mode, unsigned slot, ByteSpan in, MutableByteSpan out, BlockSpan iv);
+
+    /**
+     * CTR keystream from a slot key: block i is E(nonce || counter + i).
+     * out.size() must be a multiple of 16.
+     */
+    std::future<uint32_t> ctr_keystream_async(unsigned slot, std::span<const std::byte, proto::NONCE_SIZE> nonce,
+                                              uint32_t counter, MutableByteSpan out);
+
+    /**
+     * AESAVS Monte Carlo Test run on the board with slot as scratch.
+     * checkpoints.size() / 32 iterations (at most MCT_MAX_ITERATIONS) are
+     * run; each writes its last output and the next iteration's first
+     * input. Returns the cycle count of the chained encryptions.
+     */
+    uint32_t monte_carlo(BatchMode mode, unsigned slot, KeySpan key, BlockSpan iv, BlockSpan text,
+                         MutableByteSpan checkpoints);
+
+    /**
+     * IEEE 1619 XTS-AES over one data unit, with the data key in slot and
+     * the tweak key in tweak_slot; tweak is the 16-byte data unit number
+     * (little-endian). in.size() must be 16 to XTS_MAX_SIZE bytes and need
+     * not be whole blocks: a final partial block uses ciphertext stealing.
+     * out must be at least as large and may be the same buffer as in.
+     * Returns the cycle count.
+     */
+    uint32_t xts_encrypt(unsigned slot, unsigned tweak_slot, BlockSpan tweak, ByteSpan in,
+                         MutableByteSpan out);
+    uint32_t xts_decrypt(unsigned slot, unsigned tweak_slot, BlockSpan tweak, ByteSpan in,
+                         MutableByteSpan out);
+
+    /**
+     * RFC 4493 AES-CMAC of message (0 to CMAC_MAX_SIZE bytes) under the key
+     * in slot, written to tag. Returns the cycle count.
+     */
+    uint32_t cmac(unsigned slot, ByteSpan message, std::span<std::byte, proto::BLOCK_SIZE> tag);
+
+    /**
+     * On-board benchmark of blocks blocks from the key in slot, UART
+     * excluded. Returns cycles for each variant: polled, interrupt, queued,
+     * plaintext writes only, ciphertext reads only. The whole run must
+     * fit in Options::timeout.
+     */
+    std::array<uint32_t, proto::BENCH_VARIANTS> self_benchmark(unsigned slot, uint32_t blocks);
+
+    /**
+     * Phase timestamps of the last frame, and average phase-to-phase
+     * cycles over the ECB frames since the previous call (which resets them).
+     */
+    PhaseStats phase_stats();
+
+    /**
+     * Counters of the hardware frame bridge's last session. With enable the
+     * link is then handed to the bridge, which answers ping(), the one-off
+     * key encrypt_block(), load_key() and set_baudrate() in fabric; anything
+     * else is NAKed as unsupported until bridge(false) hands the link back,
+     * and the port back to the rate the client was opened at. Throws
+     * NakError (bad parameter) when the design has no bridge.
+     */
+    BridgeStats bridge(bool enable);
+
+    /**
+     * Move the link to baudrate (BAUD). The device switches once its
+     * response has been sent, the port follows and a PING confirms the new
+     * rate; the frame bridge falls back to the MCS UART rate if no frame
+     * arrives within its timeout. Throws NakError (bad parameter) with the
+     * link unchanged when the device cannot run the rate: the firmware only
+     * runs its own, the bridge also proto::BRIDGE_BAUD_RATES. Waits for
+     * outstanding requests first.
+     */
+    void set_baudrate(unsigned baudrate);
+
+    /** Wait until every submitted request has completed and its callback returned. */
+    void wait_idle();
+
+    const Options& options() const { return options_; }
+    unsigned baudrate() const { return port_.baudrate(); }
+    uint64_t bytes_dropped() const { return dropped_.load(); }
+
+private:
+    struct Slot;
+    struct Transfer;
+
+    void reader_loop();
+    void complete(const proto::Frame& frame);
+    void expire(std::chrono::steady_clock::time_point now);
+    void fail_all(std::exception_ptr error);
+    void callbacks_done(unsigned count);
+    std::chrono::microseconds transfer_time(size_t bytes) const;
+    uint32_t xts(uint8_t direction, unsigned slot, unsigned tweak_slot, BlockSpan tweak,
+                 ByteSpan in, MutableByteSpan out);
+    void submit_chunk(const std::shared_ptr<Transfer>& transfer, uint8_t cmd,
+                      std::span<const uint8_t> head, std::span<const uint8_t> tail,
+                      MutableByteSpan out);
+
+    Options options_;
+    SerialPort port_;
+    unsigned link_baudrate_;            // Rate the client was opened at
+    proto::FrameParser parser_;
+
+    std::unique_ptr<Slot[]> slots_;     // Indexed by sequence number
+    std::mutex mutex_;
+    std::condition_variable space_cv_;
+    std::condition_variable idle_cv_;
+    uint8_t next_seq_ = 0;
+    unsigned inflight_ = 0;
+    unsigned callbacks_running_ = 0;    // Taken off a slot, not yet returned
+    size_t inflight_bytes_ = 0;
+    std::chrono::steady_clock::time_point last_rx_;
+    std::exception_ptr fatal_;
+
+    std::mutex write_mutex_;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> running_{true};
+    std::thread reader_;
+};
+
+} // namespace aesfpga
+
+#endif // AESFPGA_CLIENT_HPP
@@ -0,0 +1,109 @@
+/*
+ * AES-128 FPGA Accelerator - Hybrid ECB
+ *
+ * Shares one bulk ECB job between the board and SoftAes on the host.
+ * The buffer is cut into BATCH-sized chunks: the calling thread takes
+ * chunks from the front in software while a dispatcher thread sends
+ * chunks from the back to the board, so results land in place and the
+ * two sides meet somewhere in the middle.
+ *
+ * Each side's time per block is tracked as a moving average: software
+ * from the chunks it runs, the board from the spacing of its responses.
+ * The dispatcher only sends a chunk when the board is predicted to
+ * return it before software could work through what is left, and once
+ * software runs out of chunks it takes back any chunk still on the wire
+ * that it can finish sooner, or that is overdue. A board that is slow,
+ * busy or gone therefore costs at most about one chunk of software time.
+ */
+
+#ifndef AESFPGA_HYBRID_HPP
+#define AESFPGA_HYBRID_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "aesfpga/client.hpp"
+#include "aesfpga/soft_aes.hpp"
+
+namespace aesfpga {
+
+/** How one hybrid call was shared out. */
+struct HybridStats {
+    uint64_t fpga_blocks = 0;       // Blocks whose results came from the board
+    uint64_t soft_blocks = 0;       // Blocks run in software, reclaimed ones included
+    uint64_t reclaimed_blocks = 0;  // Sent to the board, then run in software
+    double seconds = 0;
+    bool fpga_failed = false;       // The board has returned an error; software only
+
+    double fpga_share() const
+    {
+        uint64_t total = fpga_blocks + soft_blocks;
+        return total ? static_cast<double>(fpga_blocks) / total : 0.0;
+    }
+};
+
+class HybridEcb {
+public:
+    /**
+     * Loads key into slot on the board and keys a SoftAes with backend,
+     * by default the best one. The client must outlive this object and
+     * should not carry other traffic while a call runs, or the board's
+     * estimate suffers.
+     */
+    HybridEcb(Client& client, unsigned slot, KeySpan key);
+    HybridEcb(Client& client, unsigned slot, KeySpan key, SoftAes::Backend backend);
+    ~HybridEcb();
+
+    HybridEcb(const HybridEcb&) = delete;
+    HybridEcb& operator=(const HybridEcb&) = delete;
+
+    /*
+     * ECB over in into out, which must be at least as large; in.size()
+     * must be a multiple of 16. out may be the same buffer as in. Returns
+     * when every block is done; board responses still on the wire for
+     * chunks software took back are discarded when they arrive.
+     */
+    HybridStats encrypt(ByteSpan in, MutableByteSpan out);
+    HybridStats decrypt(ByteSpan in, MutableByteSpan out);
+
+    const SoftAes& soft() const { return soft_; }
+
+    /** Current estimates, in blocks per second. */
+    double soft_rate() const;
+    double fpga_rate() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Job;
+
+    HybridStats run(bool decrypt, ByteSpan in, MutableByteSpan out);
+    void dispatch_loop();
+    void fpga_done(const std::shared_ptr<Job>& job, size_t chunk, std::exception_ptr error,
+                   std::span<const uint8_t> rsp);
+
+    Client& client_;
+    unsigned slot_;
+    SoftAes soft_;
+    unsigned max_inflight_;             // Chunks the client takes without blocking
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::shared_ptr<Job> job_;          // Call in progress, if any
+    unsigned inflight_ = 0;             // Chunks on the wire, any job
+    double soft_spb_;                   // Seconds per block
+    double fpga_spb_;
+    Clock::time_point fpga_last_;       // Last board response
+    uint64_t events_ = 0;               // Bumped when the dispatcher's inputs change
+    bool fpga_failed_ = false;
+    bool stop_ = false;
+    std::thread dispatcher_;
+};
+
+} // namespace aesfpga
+
+#endif // AESFPGA_HYBRID_HPP
@@ -0,0 +1,172 @@
+/*
+ * AES-128 FPGA Accelerator - Host Protocol Definitions
+ *
+ * Frame format (protocol version 2, same in both directions):
+ *   [0xA5] [seq] [cmd] [len16 LE] [payload] [CRC-16/CCITT-FALSE LE]
+ *
+ * The CRC covers seq, cmd, len and payload. Responses echo seq with
+ * cmd | 0x80; a rejected request is answered with cmd 0xFF and payload
+ * [reason] [request cmd]. Constants mirror src/main.c.
+ */
+
+#ifndef AESFPGA_PROTOCOL_HPP
+#define AESFPGA_PROTOCOL_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace aesfpga::proto {
+
+constexpr uint8_t  PROTOCOL_VERSION = 2;
+constexpr uint8_t  SOF              = 0xA5;
+constexpr size_t   HEADER_SIZE      = 5;    // SOF, seq, cmd, len16
+constexpr size_t   CRC_SIZE         = 2;
+
+constexpr uint8_t  CMD_PING         = 0x00;
+constexpr uint8_t  CMD_ECB          = 0x01;
+constexpr uint8_t  CMD_KEY_LOAD     = 0x02;
+constexpr uint8_t  CMD_CTR          = 0x03;
+constexpr uint8_t  CMD_BATCH        = 0x04;
+constexpr uint8_t  CMD_MCT          = 0x05;
+constexpr uint8_t  CMD_BENCH        = 0x06;
+constexpr uint8_t  CMD_STATS        = 0x07;
+constexpr uint8_t  CMD_KEY_STORE    = 0x08;
+constexpr uint8_t  CMD_ECB_ID       = 0x09;
+constexpr uint8_t  CMD_BRIDGE       = 0x0A;
+constexpr uint8_t  CMD_BAUD         = 0x0B;
+constexpr uint8_t  CMD_XTS          = 0x0C;
+constexpr uint8_t  CMD_CMAC         = 0x0D;
+constexpr uint8_t  CMD_NAK          = 0x7F;
+constexpr uint8_t  CMD_RESPONSE     = 0x80;
+
+constexpr uint8_t  NAK_CRC          = 0x01;
+constexpr uint8_t  NAK_LENGTH       = 0x02;
+constexpr uint8_t  NAK_PARAM        = 0x03;
+constexpr uint8_t  NAK_UNSUPPORTED  = 0x04;  // Frame bridge: command left to the firmware
+
+constexpr size_t   KEY_SIZE         = 16;
+constexpr size_t   BLOCK_SIZE       = 16;
+constexpr size_t   CYCLES_SIZE      = 4;
+constexpr unsigned NUM_KEY_SLOTS    = 4;
+constexpr size_t   NONCE_SIZE       = 12;
+constexpr uint32_t CTR_MAX_BLOCKS   = 4095;
+
+constexpr uint8_t  BATCH_MODE_ECB_ENC = 0;
+constexpr uint8_t  BATCH_MODE_ECB_DEC = 1;
+constexpr uint8_t  BATCH_MODE_CBC_ENC = 2;
+constexpr uint8_t  BATCH_MODE_CBC_DEC = 3;
+constexpr uint8_t  BATCH_FLAG_KEY     = 0x01;
+constexpr size_t   BATCH_HEADER_SIZE  = 20;
+constexpr size_t   BATCH_MAX_BLOCKS   = 32;
+
+// MCT: [mode] [key slot] [iterations16] [IV] [key] [text]
+//   -> iterations x ([result] [next text]) + cycles
+constexpr size_t   MCT_HEADER_SIZE    = 20;
+constexpr size_t   MCT_PAYLOAD_SIZE   = MCT_HEADER_SIZE + KEY_SIZE + BLOCK_SIZE;
+constexpr size_t   MCT_CHECKPOINT_SIZE = 2 * BLOCK_SIZE;
+constexpr unsigned MCT_MAX_ITERATIONS = 100;
+constexpr unsigned MCT_INNER_BLOCKS   = 1000;
+
+// XTS: [direction] [key slot] [tweak key slot] [reserved] [tweak] [data]
+//   -> [result] + cycles; data is 16 to XTS_MAX_SIZE bytes
+constexpr uint8_t  XTS_DIR_ENCRYPT    = 0;
+constexpr uint8_t  XTS_DIR_DECRYPT    = 1;
+constexpr size_t   XTS_HEADER_SIZE    = 20;
+constexpr size_t   XTS_MAX_SIZE       = BATCH_MAX_BLOCKS * BLOCK_SIZE;
+
+// CMAC: [key slot] [message] -> [tag] + cycles; message is 0 to CMAC_MAX_SIZE bytes
+constexpr size_t   CMAC_MAX_SIZE      = BATCH_MAX_BLOCKS * BLOCK_SIZE;
+
+// BENCH: [block count32] [key slot] -> cycles per variant
+constexpr size_t   BENCH_PAYLOAD_SIZE = 5;
+constexpr uint32_t BENCH_MAX_BLOCKS   = 1u << 20;
+constexpr size_t   BENCH_VARIANTS     = 5;  // Polled, interrupt, queued, write-only, read-only
+
+// STATS: [seq] [cmd] [valid16] [stamps] [frames] [average gaps] [rx overruns32]
+constexpr size_t   PHASE_COUNT        = 8;  // SOF, key, plaintext, verified, start, done, ct, TX
+constexpr size_t   STATS_RESPONSE_SIZE = 4 + PHASE_COUNT * 4 + 4 + (PHASE_COUNT - 1) * 4 + 4;
+
+// KEY_STORE: [key] [id] -> cycles; ECB_ID: [plaintext] [id] -> [ciphertext] cycles
+constexpr unsigned KEY_CACHE_IDS      = 16;
+
+// BRIDGE: [enable] -> [frames32] [crc errors32] [naks32]
+constexpr size_t   BRIDGE_RESPONSE_SIZE = 12;
+
+// BAUD: [rate32] -> [rate32]. The firmware accepts only the MCS UART rate;
+// the frame bridge also these (BAUD_RATES in src/uart.vhd)
+constexpr size_t   BAUD_PAYLOAD_SIZE  = 4;
+constexpr size_t   BAUD_RESPONSE_SIZE = 4;
+constexpr std::array<unsigned, 9> BRIDGE_BAUD_RATES = {
+    115200, 921600, 1000000, 2000000, 3000000, 4000000, 6000000, 8000000, 12000000,
+};
+
+constexpr size_t   MAX_PAYLOAD_SIZE = BATCH_HEADER_SIZE + KEY_SIZE + BATCH_MAX_BLOCKS * BLOCK_SIZE;
+constexpr size_t   MAX_FRAME_SIZE   = HEADER_SIZE + MAX_PAYLOAD_SIZE + CRC_SIZE;
+
+// Largest response: a full CTR keystream
+constexpr size_t   MAX_RESPONSE_PAYLOAD = CTR_MAX_BLOCKS * BLOCK_SIZE + CYCLES_SIZE;
+
+// Firmware UART receive ring; bytes in flight towards the board stay below this
+constexpr size_t   DEVICE_RX_RING_SIZE = 1024;
+
+/** CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF). */
+uint16_t crc16(std::span<const uint8_t> data, uint16_t crc = 0xFFFF);
+
+/**
+ * Build a frame into out whose payload is head followed by tail, so a
+ * request header and bulk data need not be joined first. out must hold
+ * HEADER_SIZE + payload + CRC_SIZE bytes. Returns the frame size.
+ */
+size_t build_frame(std::span<uint8_t> out, uint8_t seq, uint8_t cmd,
+                   std::span<const uint8_t> head,
+                   std::span<const uint8_t> tail = {});
+
+/** A received frame; payload points into the parser's buffer. */
+struct Frame {
+    uint8_t seq;
+    uint8_t cmd;
+    std::span<const uint8_t> payload;
+};
+
+/**
+ * Incremental frame parser.
+ *
+ * Bytes are appended with fill()/commit() directly into a fixed buffer.
+ * A SOF whose frame fails its CRC (or whose length is out of range) is
+ * dropped by resuming the search one byte after it, as the firmware does.
+ */
+class FrameParser {
+public:
+    FrameParser();
+
+    /** Space to read new bytes into; call commit() with the count read. */
+    std::span<uint8_t> fill();
+    void commit(size_t count);
+
+    /**
+     * Extract the next valid frame. The returned payload stays valid until
+     * the next call to next() or fill().
+     */
+    bool next(Frame& frame);
+
+    /** Count of bytes discarded while searching for a valid frame. */
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 2 * (HEADER_SIZE + MAX_RESPONSE_PAYLOAD + CRC_SIZE);
+
+    void compact();
+
+    std::unique_ptr<uint8_t[]> buf_;
+    size_t   head_ = 0;     // First unparsed byte
+    size_t   tail_ = 0;     // One past the last received byte
+    size_t   consumed_ = 0; // Bytes of the previously returned frame
+    uint64_t dropped_ = 0;
+};
+
+} // namespace aesfpga::proto
+
+#endif // AESFPGA_PROTOCOL_HPP
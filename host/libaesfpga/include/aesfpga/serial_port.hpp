@@ -0,0 +1,63 @@
+/*
+ * AES-128 FPGA Accelerator - POSIX Serial Transport
+ *
+ * Opens the port in raw 8N1 mode with no flow control, and requests the
+ * driver's low-latency mode where supported (Linux ASYNC_LOW_LATENCY), so
+ * USB-serial adapters hand received bytes over without their usual
+ * 16 ms latency timer. Rates without a Bxxx constant, such as the 6, 8
+ * and 12 Mbaud of the frame bridge, are set through Linux termios2.
+ */
+
+#ifndef AESFPGA_SERIAL_PORT_HPP
+#define AESFPGA_SERIAL_PORT_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace aesfpga {
+
+class SerialPort {
+public:
+    SerialPort(const std::string& path, unsigned baudrate);
+    ~SerialPort();
+
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    /** Write all of data, blocking until it is queued. */
+    void write(std::span<const uint8_t> data);
+
+    /**
+     * Read whatever is available, waiting up to timeout for the first byte.
+     * Returns the number of bytes read (0 on timeout).
+     */
+    size_t read(std::span<uint8_t> data, std::chrono::milliseconds timeout);
+
+    /** Wait until all written data has been transmitted. */
+    void drain();
+
+    /** Discard unread input. */
+    void flush_input();
+
+    /**
+     * Change the line rate once written data has been transmitted. Throws
+     * std::invalid_argument when neither termios nor the driver takes it.
+     */
+    void set_baudrate(unsigned baudrate);
+
+    const std::string& path() const { return path_; }
+    unsigned baudrate() const { return baudrate_.load(); }
+
+private:
+    std::string path_;
+    std::atomic<unsigned> baudrate_;
+    int fd_ = -1;
+};
+
+} // namespace aesfpga
+
+#endif // AESFPGA_SERIAL_PORT_HPP
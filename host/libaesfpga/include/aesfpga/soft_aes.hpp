@@ -0,0 +1,53 @@
+/*
+ * AES-128 FPGA Accelerator - Software Reference
+ *
+ * AES-128 (FIPS-197) used to check hardware results and, through
+ * HybridEcb, to share bulk work with the board. The single-block calls
+ * and the Reference backend are byte-wise and table-driven: not
+ * constant-time. The ECB calls otherwise use AES-NI where the CPU has it
+ * and a portable bitsliced implementation (four blocks per pass, no
+ * table lookups) where it does not.
+ */
+
+#ifndef AESFPGA_SOFT_AES_HPP
+#define AESFPGA_SOFT_AES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace aesfpga {
+
+class SoftAes {
+public:
+    enum class Backend { Reference, Bitsliced, AesNi };
+
+    /** AesNi when the CPU supports it, Bitsliced otherwise. */
+    static Backend best_backend();
+    static const char* backend_name(Backend backend);
+
+    explicit SoftAes(const uint8_t key[16]);
+    /** Throws std::invalid_argument for AesNi on a CPU without it. */
+    SoftAes(const uint8_t key[16], Backend backend);
+
+    Backend backend() const { return backend_; }
+
+    void encrypt_block(const uint8_t in[16], uint8_t out[16]) const;
+    void decrypt_block(const uint8_t in[16], uint8_t out[16]) const;
+
+    /** ECB over whole blocks with the backend; len must be a multiple of 16. */
+    void encrypt_ecb(const uint8_t* in, uint8_t* out, size_t len) const;
+    void decrypt_ecb(const uint8_t* in, uint8_t* out, size_t len) const;
+
+private:
+    void process_ecb(bool decrypt, const uint8_t* in, uint8_t* out, size_t len) const;
+
+    Backend backend_;
+    std::array<uint8_t, 176> round_keys_;
+    std::array<uint8_t, 176> inv_round_keys_ = {};  // AES-NI equivalent inverse cipher
+    std::array<uint64_t, 88> sliced_keys_;          // 8 bit planes per round
+};
+
+} // namespace aesfpga
+
+#endif // AESFPGA_SOFT_AES_HPP
@@ -0,0 +1,753 @@
+/*
+ * AES-128 FPGA Accelerator - Host Client
+ */
+
+#include "aesfpga/client.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace aesfpga {
+
+using namespace proto;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr size_t BATCH_CHUNK_SIZE = BATCH_MAX_BLOCKS * BLOCK_SIZE;
+
+uint32_t read_u32_le(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void write_u32_le(uint8_t* p, uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+void write_u32_be(uint8_t* p, uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+std::span<const uint8_t> as_u8(ByteSpan s)
+{
+    return {reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+}
+
+std::string nak_message(uint8_t reason, uint8_t cmd)
+{
+    const char* what = reason == NAK_CRC    ? "CRC error" :
+                       reason == NAK_LENGTH ? "bad length" :
+                       reason == NAK_PARAM  ? "bad parameter" :
+                       reason == NAK_UNSUPPORTED ? "not supported by the frame bridge" : "unknown reason";
+    return "aesfpga: command " + std::to_string(cmd) + " rejected (" + what + ")";
+}
+
+void check_bulk(ByteSpan in, MutableByteSpan out)
+{
+    if (in.size() % BLOCK_SIZE != 0) {
+        throw std::invalid_argument("aesfpga: data must be whole 16-byte blocks");
+    }
+    if (out.size() < in.size()) {
+        throw std::invalid_argument("aesfpga: output smaller than input");
+    }
+}
+
+} // namespace
+
+NakError::NakError(uint8_t reason, uint8_t cmd)
+    : Error(nak_message(reason, cmd)), reason_(reason), cmd_(cmd)
+{
+}
+
+struct Client::Slot {
+    bool active = false;
+    uint8_t cmd = 0;
+    size_t frame_size = 0;
+    Clock::time_point sent;
+    std::chrono::microseconds allowance{0};     // Timeout plus transfer time
+    Callback callback;
+    std::array<uint8_t, MAX_FRAME_SIZE> frame;
+};
+
+/* One bulk call split over several requests, completed by the last one. */
+struct Client::Transfer {
+    std::promise<uint32_t> promise;
+    std::atomic<size_t> remaining{1};           // Held at 1 until all are submitted
+    std::atomic<uint32_t> cycles{0};
+    std::atomic<bool> failed{false};
+
+    void fail(std::exception_ptr error)
+    {
+        if (!failed.exchange(true)) {
+            promise.set_exception(error);
+        }
+    }
+
+    void release()
+    {
+        if (--remaining == 0 && !failed.exchange(true)) {
+            promise.set_value(cycles.load());
+        }
+    }
+};
+
+Client::Client(const std::string& port, unsigned baudrate)
+    : Client(port, baudrate, Options())
+{
+}
+
+Client::Client(const std::string& port, unsigned baudrate, const Options& options)
+    : options_(options), port_(port, baudrate), link_baudrate_(baudrate), slots_(new Slot[256])
+{
+    options_.window = std::clamp(options_.window, 1u, 255u);
+    options_.max_inflight_bytes = std::max(options_.max_inflight_bytes, MAX_FRAME_SIZE);
+    last_rx_ = Clock::now();
+    reader_ = std::thread(&Client::reader_loop, this);
+}
+
+Client::~Client()
+{
+    running_ = false;
+    reader_.join();
+    fail_all(std::make_exception_ptr(Error("aesfpga: client closed")));
+}
+
+std::chrono::microseconds Client::transfer_time(size_t bytes) const
+{
+    // 10 bits per byte on the wire
+    return std::chrono::microseconds(bytes * 10 * 1000000ull / port_.baudrate());
+}
+
+void Client::submit(uint8_t cmd, std::span<const uint8_t> head, std::span<const uint8_t> tail,
+                    size_t response_len, Callback callback)
+{
+    size_t frame_size = HEADER_SIZE + head.size() + tail.size() + CRC_SIZE;
+    if (frame_size > MAX_FRAME_SIZE) {
+        throw std::length_error("aesfpga: request exceeds maximum frame size");
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_cv_.wait(lock, [&] {
+        return fatal_ ||
+               (inflight_ < options_.window &&
+                inflight_bytes_ + frame_size <= options_.max_inflight_bytes &&
+                !slots_[next_seq_].active);
+    });
+    if (fatal_) {
+        std::rethrow_exception(fatal_);
+    }
+
+    uint8_t seq = next_seq_++;
+    Slot& slot = slots_[seq];
+    build_frame(slot.frame, seq, cmd, head, tail);
+    slot.active = true;
+    slot.cmd = cmd;
+    slot.frame_size = frame_size;
+    slot.sent = Clock::now();
+    slot.allowance = options_.timeout +
+                     transfer_time(frame_size + HEADER_SIZE + response_len + CRC_SIZE);
+    slot.callback = std::move(callback);
+    inflight_++;
+    inflight_bytes_ += frame_size;
+
+    // Take the write lock before releasing the state lock so frames go out in order
+    std::unique_lock<std::mutex> write_lock(write_mutex_);
+    lock.unlock();
+    try {
+        port_.write({slot.frame.data(), frame_size});
+    } catch (...) {
+        write_lock.unlock();
+        fail_all(std::current_exception());
+        throw;
+    }
+}
+
+std::future<std::vector<uint8_t>> Client::request(uint8_t cmd, std::span<const uint8_t> payload,
+                                                  size_t response_len)
+{
+    auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+    auto future = promise->get_future();
+    submit(cmd, payload, {}, response_len,
+           [promise](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (error) {
+                   promise->set_exception(error);
+               } else {
+                   promise->set_value(std::vector<uint8_t>(rsp.begin(), rsp.end()));
+               }
+           });
+    return future;
+}
+
+void Client::reader_loop()
+{
+    try {
+        while (running_) {
+            size_t n = port_.read(parser_.fill(), std::chrono::milliseconds(20));
+            parser_.commit(n);
+            Clock::time_point now = Clock::now();
+
+            if (n > 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                last_rx_ = now;
+            }
+
+            Frame frame;
+            while (parser_.next(frame)) {
+                complete(frame);
+            }
+            dropped_ = parser_.dropped();
+            expire(now);
+        }
+    } catch (...) {
+        fail_all(std::current_exception());
+    }
+}
+
+void Client::complete(const Frame& frame)
+{
+    Callback callback;
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot& slot = slots_[frame.seq];
+        if (!slot.active) {
+            return;     // Late response to a request that timed out
+        }
+
+        if (frame.cmd == (CMD_NAK | CMD_RESPONSE)) {
+            uint8_t reason = frame.payload.size() > 0 ? frame.payload[0] : 0;
+            error = std::make_exception_ptr(NakError(reason, slot.cmd));
+        } else if (frame.cmd != (slot.cmd | CMD_RESPONSE)) {
+            error = std::make_exception_ptr(Error("aesfpga: response does not match request"));
+        }
+
+        callback = std::move(slot.callback);
+        slot.active = false;
+        callbacks_running_++;
+        inflight_--;
+        inflight_bytes_ -= slot.frame_size;
+        if (inflight_ == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+    space_cv_.notify_all();
+    callback(error, error ? std::span<const uint8_t>() : frame.payload);
+    callbacks_done(1);
+}
+
+void Client::expire(Clock::time_point now)
+{
+    std::vector<Callback> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (inflight_ == 0) {
+            return;
+        }
+        for (unsigned i = 0; i < 256; i++) {
+            Slot& slot = slots_[i];
+            // Responses queue behind each other, so time out only without progress
+            if (slot.active && now > std::max(slot.sent, last_rx_) + slot.allowance) {
+                expired.push_back(std::move(slot.callback));
+                slot.active = false;
+                inflight_--;
+                inflight_bytes_ -= slot.frame_size;
+            }
+        }
+        callbacks_running_ += static_cast<unsigned>(expired.size());
+        if (inflight_ == 0) {
+            idle_cv_.notify_all();
+        }
+    }
+    if (!expired.empty()) {
+        space_cv_.notify_all();
+        auto error = std::make_exception_ptr(TimeoutError("aesfpga: request timed out"));
+        for (auto& callback : expired) {
+            callback(error, {});
+        }
+        callbacks_done(static_cast<unsigned>(expired.size()));
+    }
+}
+
+void Client::fail_all(std::exception_ptr error)
+{
+    std::vector<Callback> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!fatal_) {
+            fatal_ = error;
+        }
+        for (unsigned i = 0; i < 256; i++) {
+            Slot& slot = slots_[i];
+            if (slot.active) {
+                failed.push_back(std::move(slot.callback));
+                slot.active = false;
+            }
+        }
+        inflight_ = 0;
+        inflight_bytes_ = 0;
+        callbacks_running_ += static_cast<unsigned>(failed.size());
+        idle_cv_.notify_all();
+    }
+    space_cv_.notify_all();
+    for (auto& callback : failed) {
+        callback(error, {});
+    }
+    callbacks_done(static_cast<unsigned>(failed.size()));
+}
+
+void Client::callbacks_done(unsigned count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    callbacks_running_ -= count;
+    if (inflight_ == 0 && callbacks_running_ == 0) {
+        idle_cv_.notify_all();
+    }
+}
+
+void Client::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Completed requests count until their callbacks have returned
+    idle_cv_.wait(lock, [&] { return inflight_ == 0 && callbacks_running_ == 0; });
+}
+
+unsigned Client::ping()
+{
+    std::vector<uint8_t> rsp = request(CMD_PING, {}, 1).get();
+    if (rsp.empty()) {
+        throw Error("aesfpga: short PING response");
+    }
+    return rsp[0];
+}
+
+uint32_t Client::encrypt_block(KeySpan key, BlockSpan in, std::span<std::byte, BLOCK_SIZE> out)
+{
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    auto future = promise->get_future();
+    submit(CMD_ECB, as_u8(key), as_u8(in), BLOCK_SIZE + CYCLES_SIZE,
+           [promise, out](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != BLOCK_SIZE + CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short ECB response"));
+               }
+               if (error) {
+                   promise->set_exception(error);
+                   return;
+               }
+               std::memcpy(out.data(), rsp.data(), BLOCK_SIZE);
+               promise->set_value(read_u32_le(&rsp[BLOCK_SIZE]));
+           });
+    return future.get();
+}
+
+uint32_t Client::load_key(unsigned slot, KeySpan key)
+{
+    if (slot >= NUM_KEY_SLOTS) {
+        throw std::invalid_argument("aesfpga: key slot out of range");
+    }
+    uint8_t slot_byte = static_cast<uint8_t>(slot);
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    auto future = promise->get_future();
+    submit(CMD_KEY_LOAD, as_u8(key), {&slot_byte, 1}, CYCLES_SIZE,
+           [promise](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short KEY_LOAD response"));
+               }
+               if (error) {
+                   promise->set_exception(error);
+               } else {
+                   promise->set_value(read_u32_le(rsp.data()));
+               }
+           });
+    return future.get();
+}
+
+uint32_t Client::store_key(unsigned id, KeySpan key)
+{
+    if (id >= KEY_CACHE_IDS) {
+        throw std::invalid_argument("aesfpga: key id out of range");
+    }
+    uint8_t id_byte = static_cast<uint8_t>(id);
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    auto future = promise->get_future();
+    submit(CMD_KEY_STORE, as_u8(key), {&id_byte, 1}, CYCLES_SIZE,
+           [promise](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short KEY_STORE response"));
+               }
+               if (error) {
+                   promise->set_exception(error);
+               } else {
+                   promise->set_value(read_u32_le(rsp.data()));
+               }
+           });
+    return future.get();
+}
+
+uint32_t Client::encrypt_block(unsigned key_id, BlockSpan in, std::span<std::byte, BLOCK_SIZE> out)
+{
+    if (key_id >= KEY_CACHE_IDS) {
+        throw std::invalid_argument("aesfpga: key id out of range");
+    }
+    uint8_t id_byte = static_cast<uint8_t>(key_id);
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    auto future = promise->get_future();
+    submit(CMD_ECB_ID, as_u8(in), {&id_byte, 1}, BLOCK_SIZE + CYCLES_SIZE,
+           [promise, out](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != BLOCK_SIZE + CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short ECB_ID response"));
+               }
+               if (error) {
+                   promise->set_exception(error);
+                   return;
+               }
+               std::memcpy(out.data(), rsp.data(), BLOCK_SIZE);
+               promise->set_value(read_u32_le(&rsp[BLOCK_SIZE]));
+           });
+    return future.get();
+}
+
+void Client::submit_chunk(const std::shared_ptr<Transfer>& transfer, uint8_t cmd,
+                          std::span<const uint8_t> head, std::span<const uint8_t> tail,
+                          MutableByteSpan out)
+{
+    transfer->remaining++;
+    submit(cmd, head, tail, out.size() + CYCLES_SIZE,
+           [transfer, out](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != out.size() + CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short response"));
+               }
+               if (error) {
+                   transfer->fail(error);
+               } else {
+                   std::memcpy(out.data(), rsp.data(), out.size());
+                   transfer->cycles += read_u32_le(&rsp[out.size()]);
+               }
+               transfer->release();
+           });
+}
+
+std::future<uint32_t> Client::process_async(BatchMode mode, unsigned slot, ByteSpan in,
+                                            MutableByteSpan out, BlockSpan iv)
+{
+    check_bulk(in, out);
+    if (slot >= NUM_KEY_SLOTS) {
+        throw std::invalid_argument("aesfpga: key slot out of range");
+    }
+
+    std::array<uint8_t, BATCH_HEADER_SIZE> header = {};
+    header[0] = static_cast<uint8_t>(mode);
+    header[1] = static_cast<uint8_t>(slot);
+    std::memcpy(&header[4], iv.data(), BLOCK_SIZE);
+
+    if (mode == BatchMode::CbcEncrypt) {
+        // Each chunk's IV is the previous chunk's last ciphertext: run them in turn
+        return std::async(std::launch::async, [this, header, in, out]() mutable {
+            uint32_t cycles = 0;
+            for (size_t offset = 0; offset < in.size(); offset += BATCH_CHUNK_SIZE) {
+                size_t len = std::min(BATCH_CHUNK_SIZE, in.size() - offset);
+                auto transfer = std::make_shared<Transfer>();
+                auto future = transfer->promise.get_future();
+                submit_chunk(transfer, CMD_BATCH, header, as_u8(in.subspan(offset, len)),
+                             out.subspan(offset, len));
+                transfer->release();
+                cycles += future.get();
+                std::memcpy(&header[4], &out[offset + len - BLOCK_SIZE], BLOCK_SIZE);
+            }
+            return cycles;
+        });
+    }
+
+    auto transfer = std::make_shared<Transfer>();
+    auto future = transfer->promise.get_future();
+    try {
+        for (size_t offset = 0; offset < in.size(); offset += BATCH_CHUNK_SIZE) {
+            size_t len = std::min(BATCH_CHUNK_SIZE, in.size() - offset);
+            // Read the next IV before this chunk's output can overwrite it
+            std::array<uint8_t, BLOCK_SIZE> next_iv;
+            std::memcpy(next_iv.data(), &in[offset + len - BLOCK_SIZE], BLOCK_SIZE);
+
+            submit_chunk(transfer, CMD_BATCH, header, as_u8(in.subspan(offset, len)),
+                         out.subspan(offset, len));
+            if (mode == BatchMode::CbcDecrypt) {
+                std::memcpy(&header[4], next_iv.data(), BLOCK_SIZE);
+            }
+        }
+    } catch (...) {
+        transfer->fail(std::current_exception());
+    }
+    transfer->release();
+    return future;
+}
+
+std::future<uint32_t> Client::encrypt_async(unsigned slot, ByteSpan in, MutableByteSpan out)
+{
+    static constexpr std::array<std::byte, BLOCK_SIZE> zero_iv = {};
+    return process_async(BatchMode::EcbEncrypt, slot, in, out, zero_iv);
+}
+
+std::future<uint32_t> Client::decrypt_async(unsigned slot, ByteSpan in, MutableByteSpan out)
+{
+    static constexpr std::array<std::byte, BLOCK_SIZE> zero_iv = {};
+    return process_async(BatchMode::EcbDecrypt, slot, in, out, zero_iv);
+}
+
+uint32_t Client::encrypt(unsigned slot, ByteSpan in, MutableByteSpan out)
+{
+    return encrypt_async(slot, in, out).get();
+}
+
+uint32_t Client::decrypt(unsigned slot, ByteSpan in, MutableByteSpan out)
+{
+    return decrypt_async(slot, in, out).get();
+}
+
+uint32_t Client::process(BatchMode mode, unsigned slot, ByteSpan in, MutableByteSpan out,
+                         BlockSpan iv)
+{
+    return process_async(mode, slot, in, out, iv).get();
+}
+
+uint32_t Client::monte_carlo(BatchMode mode, unsigned slot, KeySpan key, BlockSpan iv, BlockSpan text,
+                             MutableByteSpan checkpoints)
+{
+    size_t iterations = checkpoints.size() / MCT_CHECKPOINT_SIZE;
+    if (iterations == 0 || iterations > MCT_MAX_ITERATIONS ||
+        checkpoints.size() % MCT_CHECKPOINT_SIZE != 0) {
+        throw std::invalid_argument("aesfpga: MCT checkpoints must be 1-100 x 32 bytes");
+    }
+    if (slot >= NUM_KEY_SLOTS) {
+        throw std::invalid_argument("aesfpga: key slot out of range");
+    }
+
+    // [mode] [slot] [iterations16] [IV] [key], then the text
+    std::array<uint8_t, MCT_HEADER_SIZE + KEY_SIZE> head;
+    head[0] = static_cast<uint8_t>(mode);
+    head[1] = static_cast<uint8_t>(slot);
+    head[2] = static_cast<uint8_t>(iterations);
+    head[3] = static_cast<uint8_t>(iterations >> 8);
+    std::memcpy(&head[4], iv.data(), BLOCK_SIZE);
+    std::memcpy(&head[MCT_HEADER_SIZE], key.data(), KEY_SIZE);
+
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    auto future = promise->get_future();
+    submit(CMD_MCT, head, as_u8(text), checkpoints.size() + CYCLES_SIZE,
+           [promise, checkpoints](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != checkpoints.size() + CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short MCT response"));
+               }
+               if (error) {
+                   promise->set_exception(error);
+                   return;
+               }
+               std::memcpy(checkpoints.data(), rsp.data(), checkpoints.size());
+               promise->set_value(read_u32_le(&rsp[checkpoints.size()]));
+           });
+    return future.get();
+}
+
+uint32_t Client::xts(uint8_t direction, unsigned slot, unsigned tweak_slot, BlockSpan tweak,
+                     ByteSpan in, MutableByteSpan out)
+{
+    if (in.size() < BLOCK_SIZE || in.size() > XTS_MAX_SIZE) {
+        throw std::invalid_argument("aesfpga: XTS data must be 16-512 bytes");
+    }
+    if (out.size() < in.size()) {
+        throw std::invalid_argument("aesfpga: output smaller than input");
+    }
+    if (slot >= NUM_KEY_SLOTS || tweak_slot >= NUM_KEY_SLOTS) {
+        throw std::invalid_argument("aesfpga: key slot out of range");
+    }
+
+    // [direction] [slot] [tweak slot] [reserved] [tweak], then the data
+    std::array<uint8_t, XTS_HEADER_SIZE> head = {};
+    head[0] = direction;
+    head[1] = static_cast<uint8_t>(slot);
+    head[2] = static_cast<uint8_t>(tweak_slot);
+    std::memcpy(&head[4], tweak.data(), BLOCK_SIZE);
+
+    size_t len = in.size();
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    auto future = promise->get_future();
+    submit(CMD_XTS, head, as_u8(in), len + CYCLES_SIZE,
+           [promise, out, len](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != len + CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short XTS response"));
+               }
+               if (error) {
+                   promise->set_exception(error);
+                   return;
+               }
+               std::memcpy(out.data(), rsp.data(), len);
+               promise->set_value(read_u32_le(&rsp[len]));
+           });
+    return future.get();
+}
+
+uint32_t Client::xts_encrypt(unsigned slot, unsigned tweak_slot, BlockSpan tweak, ByteSpan in,
+                             MutableByteSpan out)
+{
+    return xts(XTS_DIR_ENCRYPT, slot, tweak_slot, tweak, in, out);
+}
+
+uint32_t Client::xts_decrypt(unsigned slot, unsigned tweak_slot, BlockSpan tweak, ByteSpan in,
+                             MutableByteSpan out)
+{
+    return xts(XTS_DIR_DECRYPT, slot, tweak_slot, tweak, in, out);
+}
+
+uint32_t Client::cmac(unsigned slot, ByteSpan message, std::span<std::byte, BLOCK_SIZE> tag)
+{
+    if (message.size() > CMAC_MAX_SIZE) {
+        throw std::invalid_argument("aesfpga: CMAC message over 512 bytes");
+    }
+    if (slot >= NUM_KEY_SLOTS) {
+        throw std::invalid_argument("aesfpga: key slot out of range");
+    }
+
+    uint8_t slot_byte = static_cast<uint8_t>(slot);
+    auto promise = std::make_shared<std::promise<uint32_t>>();
+    auto future = promise->get_future();
+    submit(CMD_CMAC, {&slot_byte, 1}, as_u8(message), BLOCK_SIZE + CYCLES_SIZE,
+           [promise, tag](std::exception_ptr error, std::span<const uint8_t> rsp) {
+               if (!error && rsp.size() != BLOCK_SIZE + CYCLES_SIZE) {
+                   error = std::make_exception_ptr(Error("aesfpga: short CMAC response"));
+               }
+               if (error) {
+                   promise->set_exception(error);
+                   return;
+               }
+               std::memcpy(tag.data(), rsp.data(), BLOCK_SIZE);
+               promise->set_value(read_u32_le(&rsp[BLOCK_SIZE]));
+           });
+    return future.get();
+}
+
+std::array<uint32_t, BENCH_VARIANTS> Client::self_benchmark(unsigned slot, uint32_t blocks)
+{
+    if (slot >= NUM_KEY_SLOTS) {
+        throw std::invalid_argument("aesfpga: key slot out of range");
+    }
+    if (blocks > BENCH_MAX_BLOCKS) {
+        throw std::invalid_argument("aesfpga: too many benchmark blocks");
+    }
+
+    std::array<uint8_t, BENCH_PAYLOAD_SIZE> payload;
+    write_u32_le(payload.data(), blocks);
+    payload[4] = static_cast<uint8_t>(slot);
+
+    std::vector<uint8_t> rsp = request(CMD_BENCH, payload, BENCH_VARIANTS * CYCLES_SIZE).get();
+    if (rsp.size() != BENCH_VARIANTS * CYCLES_SIZE) {
+        throw Error("aesfpga: short BENCH response");
+    }
+    std::array<uint32_t, BENCH_VARIANTS> cycles;
+    for (size_t i = 0; i < BENCH_VARIANTS; i++) {
+        cycles[i] = read_u32_le(&rsp[i * CYCLES_SIZE]);
+    }
+    return cycles;
+}
+
+PhaseStats Client::phase_stats()
+{
+    std::vector<uint8_t> rsp = request(CMD_STATS, {}, STATS_RESPONSE_SIZE).get();
+    if (rsp.size() != STATS_RESPONSE_SIZE) {
+        throw Error("aesfpga: short STATS response");
+    }
+    PhaseStats stats;
+    stats.seq = rsp[0];
+    stats.cmd = rsp[1];
+    stats.valid = static_cast<uint16_t>(rsp[2] | (rsp[3] << 8));
+    const uint8_t* p = &rsp[4];
+    for (auto& stamp : stats.stamps) {
+        stamp = read_u32_le(p);
+        p += 4;
+    }
+    stats.frames = read_u32_le(p);
+    p += 4;
+    for (auto& average : stats.average) {
+        average = read_u32_le(p);
+        p += 4;
+    }
+    stats.rx_overruns = read_u32_le(p);
+    return stats;
+}
+
+BridgeStats Client::bridge(bool enable)
+{
+    uint8_t enable_byte = enable ? 1 : 0;
+    std::vector<uint8_t> rsp = request(CMD_BRIDGE, {&enable_byte, 1}, BRIDGE_RESPONSE_SIZE).get();
+    if (rsp.size() != BRIDGE_RESPONSE_SIZE) {
+        throw Error("aesfpga: short BRIDGE response");
+    }
+    // The bridge hands the link back once the response has left it
+    if (!enable && port_.baudrate() != link_baudrate_) {
+        port_.set_baudrate(link_baudrate_);
+    }
+    return BridgeStats{read_u32_le(&rsp[0]), read_u32_le(&rsp[4]), read_u32_le(&rsp[8])};
+}
+
+void Client::set_baudrate(unsigned baudrate)
+{
+    wait_idle();
+    std::array<uint8_t, BAUD_PAYLOAD_SIZE> payload;
+    write_u32_le(payload.data(), baudrate);
+    std::vector<uint8_t> rsp = request(CMD_BAUD, payload, BAUD_RESPONSE_SIZE).get();
+    if (rsp.size() != BAUD_RESPONSE_SIZE || read_u32_le(rsp.data()) != baudrate) {
+        throw Error("aesfpga: bad BAUD response");
+    }
+
+    unsigned previous = port_.baudrate();
+    port_.set_baudrate(baudrate);
+    try {
+        ping();
+    } catch (const TimeoutError&) {
+        port_.set_baudrate(previous);
+        throw;
+    }
+}
+
+std::future<uint32_t> Client::ctr_keystream_async(unsigned slot,
+                                                  std::span<const std::byte, NONCE_SIZE> nonce,
+                                                  uint32_t counter, MutableByteSpan out)
+{
+    if (out.size() % BLOCK_SIZE != 0) {
+        throw std::invalid_argument("aesfpga: keystream must be whole 16-byte blocks");
+    }
+    if (slot >= NUM_KEY_SLOTS) {
+        throw std::invalid_argument("aesfpga: key slot out of range");
+    }
+
+    auto transfer = std::make_shared<Transfer>();
+    auto future = transfer->promise.get_future();
+    try {
+        size_t total = out.size() / BLOCK_SIZE;
+        for (size_t block = 0; block < total; block += CTR_MAX_BLOCKS) {
+            uint32_t count = static_cast<uint32_t>(std::min<size_t>(CTR_MAX_BLOCKS, total - block));
+
+            // [slot] [12B nonce] [counter BE] [count LE]
+            std::array<uint8_t, 1 + NONCE_SIZE + 8> request;
+            request[0] = static_cast<uint8_t>(slot);
+            std::memcpy(&request[1], nonce.data(), NONCE_SIZE);
+            write_u32_be(&request[1 + NONCE_SIZE], counter + static_cast<uint32_t>(block));
+            write_u32_le(&request[1 + NONCE_SIZE + 4], count);
+
+            submit_chunk(transfer, CMD_CTR, request, {},
+                         out.subspan(block * BLOCK_SIZE, count * BLOCK_SIZE));
+        }
+    } catch (...) {
+        transfer->fail(std::current_exception());
+    }
+    transfer->release();
+    return future;
+}
+
+} // namespace aesfpga
@@ -0,0 +1,330 @@
+/*
+ * AES-128 FPGA Accelerator - Hybrid ECB
+ */
+
+#include "aesfpga/hybrid.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace aesfpga {
+
+using namespace proto;
+
+namespace {
+
+constexpr size_t CHUNK_BLOCKS = BATCH_MAX_BLOCKS;
+constexpr size_t CHUNK_FRAME_SIZE = HEADER_SIZE + BATCH_HEADER_SIZE + CHUNK_BLOCKS * BLOCK_SIZE + CRC_SIZE;
+constexpr size_t CHUNK_RESPONSE_SIZE = HEADER_SIZE + CHUNK_BLOCKS * BLOCK_SIZE + CYCLES_SIZE + CRC_SIZE;
+
+constexpr double EWMA_WEIGHT = 0.25;                // Of the newest sample
+constexpr double SOFT_GRAB_SECONDS = 20e-6;         // Software claims at least this much at once
+constexpr size_t SOFT_PROBE_BLOCKS = 2048;          // Timed at construction
+
+enum class ChunkState : uint8_t {
+    Free,       // Not yet claimed
+    Soft,       // Being run in software
+    Fpga,       // On the wire
+    Copying,    // Board response being copied out
+    Done,
+};
+
+std::chrono::steady_clock::duration seconds(double s)
+{
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(s));
+}
+
+double elapsed(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+} // namespace
+
+struct HybridEcb::Job {
+    bool decrypt;
+    const uint8_t* in;
+    uint8_t* out;
+    size_t blocks;
+    size_t chunks;
+    std::vector<ChunkState> state;
+    std::vector<Clock::time_point> sent;
+    std::deque<size_t> pending;     // Chunks on the wire, oldest first
+    size_t front = 0;               // Unclaimed chunks are [front, back)
+    size_t back;
+    size_t done = 0;
+    HybridStats stats;
+
+    size_t chunk_blocks(size_t chunk) const
+    {
+        return std::min(CHUNK_BLOCKS, blocks - chunk * CHUNK_BLOCKS);
+    }
+
+    size_t unclaimed_blocks() const
+    {
+        return front < back ? std::min(back * CHUNK_BLOCKS, blocks) - front * CHUNK_BLOCKS : 0;
+    }
+};
+
+HybridEcb::HybridEcb(Client& client, unsigned slot, KeySpan key)
+    : HybridEcb(client, slot, key, SoftAes::best_backend())
+{
+}
+
+HybridEcb::HybridEcb(Client& client, unsigned slot, KeySpan key, SoftAes::Backend backend)
+    : client_(client), slot_(slot),
+      soft_(reinterpret_cast<const uint8_t*>(key.data()), backend)
+{
+    client_.load_key(slot_, key);
+
+    size_t by_bytes = std::max<size_t>(1, client_.options().max_inflight_bytes / CHUNK_FRAME_SIZE);
+    max_inflight_ = static_cast<unsigned>(std::min<size_t>(client_.options().window, by_bytes));
+
+    std::vector<uint8_t> probe(SOFT_PROBE_BLOCKS * BLOCK_SIZE);
+    Clock::time_point start = Clock::now();
+    soft_.encrypt_ecb(probe.data(), probe.data(), probe.size());
+    soft_spb_ = std::max(elapsed(start, Clock::now()), 1e-9) / SOFT_PROBE_BLOCKS;
+
+    // Until the first response: both frames on the wire, 10 bits per byte
+    fpga_spb_ = (CHUNK_FRAME_SIZE + CHUNK_RESPONSE_SIZE) * 10.0 / client_.baudrate() / CHUNK_BLOCKS;
+    fpga_last_ = Clock::now();
+
+    dispatcher_ = std::thread(&HybridEcb::dispatch_loop, this);
+}
+
+HybridEcb::~HybridEcb()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    dispatcher_.join();
+    // Responses for reclaimed chunks still call back into this object
+    client_.wait_idle();
+}
+
+HybridStats HybridEcb::encrypt(ByteSpan in, MutableByteSpan out)
+{
+    return run(false, in, out);
+}
+
+HybridStats HybridEcb::decrypt(ByteSpan in, MutableByteSpan out)
+{
+    return run(true, in, out);
+}
+
+double HybridEcb::soft_rate() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return 1.0 / soft_spb_;
+}
+
+double HybridEcb::fpga_rate() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return 1.0 / fpga_spb_;
+}
+
+HybridStats HybridEcb::run(bool decrypt, ByteSpan in, MutableByteSpan out)
+{
+    if (in.size() % BLOCK_SIZE != 0) {
+        throw std::invalid_argument("aesfpga: data must be whole 16-byte blocks");
+    }
+    if (out.size() < in.size()) {
+        throw std::invalid_argument("aesfpga: output smaller than input");
+    }
+
+    Clock::time_point start = Clock::now();
+    auto job = std::make_shared<Job>();
+    job->decrypt = decrypt;
+    job->in = reinterpret_cast<const uint8_t*>(in.data());
+    job->out = reinterpret_cast<uint8_t*>(out.data());
+    job->blocks = in.size() / BLOCK_SIZE;
+    job->chunks = (job->blocks + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+    job->state.assign(job->chunks, ChunkState::Free);
+    job->sent.resize(job->chunks);
+    job->back = job->chunks;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = job;
+    events_++;
+    cv_.notify_all();
+
+    while (job->done < job->chunks) {
+        size_t first = job->front;
+        size_t count = 0;
+
+        if (job->front < job->back) {
+            // From the front, enough at once that claiming costs little
+            size_t grab = static_cast<size_t>(SOFT_GRAB_SECONDS / (soft_spb_ * CHUNK_BLOCKS)) + 1;
+            count = std::min(grab, job->back - job->front);
+            job->front += count;
+        } else if (!job->pending.empty()) {
+            // Out of work: take back the newest chunk on the wire if the
+            // board is predicted to return it later than software could
+            // finish it, or it is overdue. Waiting therefore costs at most
+            // one chunk of software time over taking it back at once.
+            size_t chunk = job->pending.back();
+            Clock::time_point now = Clock::now();
+            Clock::time_point base = std::max(fpga_last_, job->sent[job->pending.front()]);
+            Clock::time_point due = base + seconds(fpga_spb_ * CHUNK_BLOCKS * job->pending.size());
+
+            if (fpga_failed_ || due - now > seconds(soft_spb_ * job->chunk_blocks(chunk)) ||
+                now >= due) {
+                job->pending.pop_back();
+                job->stats.reclaimed_blocks += job->chunk_blocks(chunk);
+                first = chunk;
+                count = 1;
+            } else {
+                cv_.wait_until(lock, due);
+                continue;
+            }
+        } else {
+            // Board responses being copied out
+            cv_.wait(lock);
+            continue;
+        }
+
+        for (size_t i = first; i < first + count; i++) {
+            job->state[i] = ChunkState::Soft;
+        }
+        lock.unlock();
+
+        size_t offset = first * CHUNK_BLOCKS * BLOCK_SIZE;
+        size_t len = std::min(count * CHUNK_BLOCKS * BLOCK_SIZE, in.size() - offset);
+        Clock::time_point soft_start = Clock::now();
+        if (decrypt) {
+            soft_.decrypt_ecb(job->in + offset, job->out + offset, len);
+        } else {
+            soft_.encrypt_ecb(job->in + offset, job->out + offset, len);
+        }
+        double spb = elapsed(soft_start, Clock::now()) / (len / BLOCK_SIZE);
+
+        lock.lock();
+        soft_spb_ += EWMA_WEIGHT * (std::max(spb, 1e-12) - soft_spb_);
+        for (size_t i = first; i < first + count; i++) {
+            job->state[i] = ChunkState::Done;
+        }
+        job->done += count;
+        job->stats.soft_blocks += len / BLOCK_SIZE;
+        events_++;
+        cv_.notify_all();
+    }
+
+    if (job_ == job) {
+        job_.reset();
+    }
+    job->stats.fpga_failed = fpga_failed_;
+    job->stats.seconds = elapsed(start, Clock::now());
+    return job->stats;
+}
+
+void HybridEcb::dispatch_loop()
+{
+    std::array<uint8_t, BATCH_HEADER_SIZE> header = {};
+    std::array<uint8_t, CHUNK_BLOCKS * BLOCK_SIZE> data;
+    header[1] = static_cast<uint8_t>(slot_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t declined = events_ - 1;
+
+    for (;;) {
+        cv_.wait(lock, [&] {
+            return stop_ || (job_ && job_->front < job_->back && inflight_ < max_inflight_ &&
+                             !fpga_failed_ && events_ != declined);
+        });
+        if (stop_) {
+            return;
+        }
+
+        // From the back, only if the board should return it before
+        // software has worked through everything else still unclaimed
+        std::shared_ptr<Job> job = job_;
+        size_t chunk = job->back - 1;
+        size_t blocks = job->chunk_blocks(chunk);
+        Clock::time_point now = Clock::now();
+        Clock::time_point free_at = now;
+        if (!job->pending.empty()) {
+            Clock::time_point base = std::max(fpga_last_, job->sent[job->pending.front()]);
+            free_at = std::max(now, base + seconds(fpga_spb_ * CHUNK_BLOCKS * job->pending.size()));
+        }
+        Clock::time_point due = free_at + seconds(fpga_spb_ * blocks);
+        if (due - now > seconds(soft_spb_ * (job->unclaimed_blocks() - blocks))) {
+            // Not worth it until the estimates or the job change
+            declined = events_;
+            continue;
+        }
+
+        job->back--;
+        job->state[chunk] = ChunkState::Fpga;
+        job->sent[chunk] = now;
+        job->pending.push_back(chunk);
+        inflight_++;
+
+        size_t len = blocks * BLOCK_SIZE;
+        std::memcpy(data.data(), job->in + chunk * CHUNK_BLOCKS * BLOCK_SIZE, len);
+        header[0] = job->decrypt ? BATCH_MODE_ECB_DEC : BATCH_MODE_ECB_ENC;
+        lock.unlock();
+
+        // A failed write also fails the request already queued: answer once
+        auto answered = std::make_shared<std::atomic<bool>>(false);
+        try {
+            client_.submit(CMD_BATCH, header, {data.data(), len}, len + CYCLES_SIZE,
+                           [this, job, chunk, answered](std::exception_ptr error,
+                                                        std::span<const uint8_t> rsp) {
+                               if (!answered->exchange(true)) {
+                                   fpga_done(job, chunk, error, rsp);
+                               }
+                           });
+        } catch (...) {
+            if (!answered->exchange(true)) {
+                fpga_done(job, chunk, std::current_exception(), {});
+            }
+        }
+        lock.lock();
+    }
+}
+
+void HybridEcb::fpga_done(const std::shared_ptr<Job>& job, size_t chunk, std::exception_ptr error,
+                          std::span<const uint8_t> rsp)
+{
+    size_t len = job->chunk_blocks(chunk) * BLOCK_SIZE;
+    std::unique_lock<std::mutex> lock(mutex_);
+    inflight_--;
+    events_++;
+
+    if (error || rsp.size() != len + CYCLES_SIZE) {
+        // Left pending: software takes it back, and everything after it
+        fpga_failed_ = true;
+        cv_.notify_all();
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    double spb = elapsed(std::max(fpga_last_, job->sent[chunk]), now) / (len / BLOCK_SIZE);
+    fpga_spb_ += EWMA_WEIGHT * (spb - fpga_spb_);
+    fpga_last_ = now;
+
+    auto it = std::find(job->pending.begin(), job->pending.end(), chunk);
+    if (it != job->pending.end()) {
+        job->pending.erase(it);
+    }
+    if (job->state[chunk] == ChunkState::Fpga) {
+        job->state[chunk] = ChunkState::Copying;
+        lock.unlock();
+        std::memcpy(job->out + chunk * CHUNK_BLOCKS * BLOCK_SIZE, rsp.data(), len);
+        lock.lock();
+        job->state[chunk] = ChunkState::Done;
+        job->done++;
+        job->stats.fpga_blocks += len / BLOCK_SIZE;
+    }
+    cv_.notify_all();
+}
+
+} // namespace aesfpga
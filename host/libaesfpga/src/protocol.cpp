@@ -0,0 +1,137 @@
+/*
+ * AES-128 FPGA Accelerator - Frame Building and Parsing
+ */
+
+#include "aesfpga/protocol.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace aesfpga::proto {
+
+namespace {
+
+// Nibble table for CRC-16/CCITT-FALSE, the same one the firmware uses
+constexpr uint16_t CRC16_TABLE[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+} // namespace
+
+uint16_t crc16(std::span<const uint8_t> data, uint16_t crc)
+{
+    for (uint8_t byte : data) {
+        crc = (crc << 4) ^ CRC16_TABLE[(crc >> 12) ^ (byte >> 4)];
+        crc = (crc << 4) ^ CRC16_TABLE[(crc >> 12) ^ (byte & 0x0F)];
+    }
+    return crc;
+}
+
+size_t build_frame(std::span<uint8_t> out, uint8_t seq, uint8_t cmd,
+                   std::span<const uint8_t> head, std::span<const uint8_t> tail)
+{
+    size_t length = head.size() + tail.size();
+    size_t size = HEADER_SIZE + length + CRC_SIZE;
+    if (length > 0xFFFF || out.size() < size) {
+        throw std::length_error("aesfpga: frame does not fit buffer");
+    }
+
+    out[0] = SOF;
+    out[1] = seq;
+    out[2] = cmd;
+    out[3] = static_cast<uint8_t>(length);
+    out[4] = static_cast<uint8_t>(length >> 8);
+    if (!head.empty()) {
+        std::memcpy(&out[HEADER_SIZE], head.data(), head.size());
+    }
+    if (!tail.empty()) {
+        std::memcpy(&out[HEADER_SIZE + head.size()], tail.data(), tail.size());
+    }
+
+    uint16_t crc = crc16(out.subspan(1, HEADER_SIZE - 1 + length));
+    out[size - 2] = static_cast<uint8_t>(crc);
+    out[size - 1] = static_cast<uint8_t>(crc >> 8);
+    return size;
+}
+
+FrameParser::FrameParser()
+    : buf_(new uint8_t[BUFFER_SIZE])
+{
+}
+
+void FrameParser::compact()
+{
+    head_ += consumed_;
+    consumed_ = 0;
+    if (head_ > 0) {
+        std::memmove(buf_.get(), buf_.get() + head_, tail_ - head_);
+        tail_ -= head_;
+        head_ = 0;
+    }
+}
+
+std::span<uint8_t> FrameParser::fill()
+{
+    compact();
+    return {buf_.get() + tail_, BUFFER_SIZE - tail_};
+}
+
+void FrameParser::commit(size_t count)
+{
+    tail_ += count;
+}
+
+bool FrameParser::next(Frame& frame)
+{
+    head_ += consumed_;
+    consumed_ = 0;
+
+    while (tail_ > head_) {
+        // Drop everything before the next SOF
+        const uint8_t* sof = static_cast<const uint8_t*>(
+            std::memchr(buf_.get() + head_, SOF, tail_ - head_));
+        size_t skip = sof ? static_cast<size_t>(sof - (buf_.get() + head_)) : tail_ - head_;
+        dropped_ += skip;
+        head_ += skip;
+
+        if (tail_ - head_ < HEADER_SIZE) {
+            return false;
+        }
+
+        size_t length = buf_[head_ + 3] | (buf_[head_ + 4] << 8);
+        if (length > MAX_RESPONSE_PAYLOAD) {
+            // No response is this long: false SOF
+            head_++;
+            dropped_++;
+            continue;
+        }
+
+        size_t frame_size = HEADER_SIZE + length + CRC_SIZE;
+        if (tail_ - head_ < frame_size) {
+            // Make room for the rest of the frame
+            if (head_ + frame_size > BUFFER_SIZE) {
+                compact();
+            }
+            return false;
+        }
+
+        const uint8_t* body = buf_.get() + head_ + 1;
+        uint16_t crc = buf_[head_ + frame_size - 2] | (buf_[head_ + frame_size - 1] << 8);
+        if (crc != crc16({body, HEADER_SIZE - 1 + length})) {
+            // False SOF: resume after it
+            head_++;
+            dropped_++;
+            continue;
+        }
+
+        frame.seq = body[0];
+        frame.cmd = body[1];
+        frame.payload = {body + HEADER_SIZE - 1, length};
+        consumed_ = frame_size;
+        return true;
+    }
+    return false;
+}
+
+} // namespace aesfpga::proto
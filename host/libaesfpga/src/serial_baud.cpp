@@ -0,0 +1,36 @@
+/*
+ * AES-128 FPGA Accelerator - Non-standard Serial Rates
+ *
+ * Sets a rate that has no Bxxx constant through the Linux termios2
+ * interface (BOTHER). It lives apart from serial_port.cpp because
+ * <asm/termbits.h> and <termios.h> declare the same types.
+ */
+
+#ifdef __linux__
+#include <asm/ioctls.h>
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace aesfpga::detail {
+
+bool set_custom_baudrate(int fd, unsigned baudrate)
+{
+#if defined(__linux__) && defined(BOTHER)
+    struct termios2 tio;
+    if (::ioctl(fd, TCGETS2, &tio) < 0) {
+        return false;
+    }
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = baudrate;
+    tio.c_ospeed = baudrate;
+    return ::ioctl(fd, TCSETS2, &tio) == 0;
+#else
+    (void)fd;
+    (void)baudrate;
+    return false;
+#endif
+}
+
+} // namespace aesfpga::detail
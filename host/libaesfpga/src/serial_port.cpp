@@ -0,0 +1,208 @@
+/*
+ * AES-128 FPGA Accelerator - POSIX Serial Transport
+ */
+
+#include "aesfpga/serial_port.hpp"
+
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+namespace aesfpga {
+
+namespace detail {
+// serial_baud.cpp
+bool set_custom_baudrate(int fd, unsigned baudrate);
+}
+
+namespace {
+
+[[noreturn]] void throw_errno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// B0 when there is no constant for the rate
+speed_t baud_constant(unsigned baudrate)
+{
+    switch (baudrate) {
+    case 9600:    return B9600;
+    case 19200:   return B19200;
+    case 38400:   return B38400;
+    case 57600:   return B57600;
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+#ifdef B460800
+    case 460800:  return B460800;
+#endif
+#ifdef B921600
+    case 921600:  return B921600;
+#endif
+#ifdef B1000000
+    case 1000000: return B1000000;
+#endif
+#ifdef B2000000
+    case 2000000: return B2000000;
+#endif
+#ifdef B3000000
+    case 3000000: return B3000000;
+#endif
+#ifdef B4000000
+    case 4000000: return B4000000;
+#endif
+    default:      return B0;
+    }
+}
+
+} // namespace
+
+SerialPort::SerialPort(const std::string& path, unsigned baudrate)
+    : path_(path), baudrate_(baudrate)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw_errno("aesfpga: open " + path);
+    }
+
+    struct termios tio;
+    if (::tcgetattr(fd_, &tio) < 0) {
+        int err = errno;
+        ::close(fd_);
+        errno = err;
+        throw_errno("aesfpga: tcgetattr " + path);
+    }
+
+    // Raw 8N1, no flow control; reads are paced with poll()
+    ::cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+
+    if (::tcsetattr(fd_, TCSANOW, &tio) < 0) {
+        int err = errno;
+        ::close(fd_);
+        errno = err;
+        throw_errno("aesfpga: tcsetattr " + path);
+    }
+    try {
+        set_baudrate(baudrate);
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+
+#ifdef __linux__
+    // Best effort: pseudo-terminals and some drivers do not support it
+    struct serial_struct ser;
+    if (::ioctl(fd_, TIOCGSERIAL, &ser) == 0) {
+        ser.flags |= ASYNC_LOW_LATENCY;
+        ::ioctl(fd_, TIOCSSERIAL, &ser);
+    }
+#endif
+
+    ::tcflush(fd_, TCIOFLUSH);
+}
+
+SerialPort::~SerialPort()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void SerialPort::write(std::span<const uint8_t> data)
+{
+    while (!data.empty()) {
+        ssize_t n = ::write(fd_, data.data(), data.size());
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                struct pollfd pfd = {fd_, POLLOUT, 0};
+                ::poll(&pfd, 1, -1);
+                continue;
+            }
+            throw_errno("aesfpga: write " + path_);
+        }
+        data = data.subspan(static_cast<size_t>(n));
+    }
+}
+
+size_t SerialPort::read(std::span<uint8_t> data, std::chrono::milliseconds timeout)
+{
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    int ready;
+    do {
+        ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+    } while (ready < 0 && errno == EINTR);
+
+    if (ready < 0) {
+        throw_errno("aesfpga: poll " + path_);
+    }
+    if (ready == 0) {
+        return 0;
+    }
+    if (pfd.revents & (POLLERR | POLLNVAL)) {
+        throw std::runtime_error("aesfpga: " + path_ + " closed");
+    }
+
+    ssize_t n = ::read(fd_, data.data(), data.size());
+    if (n < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+            return 0;
+        }
+        throw_errno("aesfpga: read " + path_);
+    }
+    if (n == 0 && (pfd.revents & POLLHUP)) {
+        // Device unplugged, or the far end of a pseudo-terminal closed
+        throw std::runtime_error("aesfpga: " + path_ + " hung up");
+    }
+    return static_cast<size_t>(n);
+}
+
+void SerialPort::drain()
+{
+    ::tcdrain(fd_);
+}
+
+void SerialPort::flush_input()
+{
+    ::tcflush(fd_, TCIFLUSH);
+}
+
+void SerialPort::set_baudrate(unsigned baudrate)
+{
+    speed_t speed = baud_constant(baudrate);
+    if (speed == B0) {
+        ::tcdrain(fd_);
+        if (!detail::set_custom_baudrate(fd_, baudrate)) {
+            throw std::invalid_argument("aesfpga: unsupported baud rate " + std::to_string(baudrate));
+        }
+    } else {
+        struct termios tio;
+        if (::tcgetattr(fd_, &tio) < 0) {
+            throw_errno("aesfpga: tcgetattr " + path_);
+        }
+        ::cfsetispeed(&tio, speed);
+        ::cfsetospeed(&tio, speed);
+        if (::tcsetattr(fd_, TCSADRAIN, &tio) < 0) {
+            throw_errno("aesfpga: tcsetattr " + path_);
+        }
+    }
+    baudrate_ = baudrate;
+}
+
+} // namespace aesfpga
@@ -0,0 +1,683 @@
+/*
+ * AES-128 FPGA Accelerator - Software Reference
+ */
+
+#include "aesfpga/soft_aes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AESFPGA_HAVE_AESNI 1
+#include <immintrin.h>
+#endif
+
+namespace aesfpga {
+
+namespace {
+
+constexpr uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+struct InvSbox {
+    uint8_t v[256];
+    constexpr InvSbox() : v()
+    {
+        for (int i = 0; i < 256; i++) {
+            v[SBOX[i]] = static_cast<uint8_t>(i);
+        }
+    }
+};
+
+constexpr InvSbox INV_SBOX;
+
+constexpr uint8_t xtime(uint8_t x)
+{
+    return static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1B : 0x00));
+}
+
+uint8_t gmul(uint8_t a, uint8_t b)
+{
+    uint8_t p = 0;
+    while (b) {
+        if (b & 1) {
+            p ^= a;
+        }
+        a = xtime(a);
+        b >>= 1;
+    }
+    return p;
+}
+
+void add_round_key(uint8_t s[16], const uint8_t* rk)
+{
+    for (int i = 0; i < 16; i++) {
+        s[i] ^= rk[i];
+    }
+}
+
+// State is column-major, as in FIPS-197: s[4 * col + row]
+void sub_shift(uint8_t s[16])
+{
+    uint8_t t[16];
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            t[4 * c + r] = SBOX[s[4 * ((c + r) & 3) + r]];
+        }
+    }
+    std::memcpy(s, t, 16);
+}
+
+void inv_sub_shift(uint8_t s[16])
+{
+    uint8_t t[16];
+    for (int c = 0; c < 4; c++) {
+        for (int r = 0; r < 4; r++) {
+            t[4 * ((c + r) & 3) + r] = INV_SBOX.v[s[4 * c + r]];
+        }
+    }
+    std::memcpy(s, t, 16);
+}
+
+void mix_columns(uint8_t s[16])
+{
+    for (int c = 0; c < 4; c++) {
+        uint8_t* col = s + 4 * c;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+        col[0] ^= all ^ xtime(a0 ^ a1);
+        col[1] ^= all ^ xtime(a1 ^ a2);
+        col[2] ^= all ^ xtime(a2 ^ a3);
+        col[3] ^= all ^ xtime(a3 ^ a0);
+    }
+}
+
+void inv_mix_columns(uint8_t s[16])
+{
+    for (int c = 0; c < 4; c++) {
+        uint8_t* col = s + 4 * c;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        col[0] = gmul(a0, 14) ^ gmul(a1, 11) ^ gmul(a2, 13) ^ gmul(a3, 9);
+        col[1] = gmul(a0, 9) ^ gmul(a1, 14) ^ gmul(a2, 11) ^ gmul(a3, 13);
+        col[2] = gmul(a0, 13) ^ gmul(a1, 9) ^ gmul(a2, 14) ^ gmul(a3, 11);
+        col[3] = gmul(a0, 11) ^ gmul(a1, 13) ^ gmul(a2, 9) ^ gmul(a3, 14);
+    }
+}
+
+/*
+ * Bitsliced AES: four blocks at a time, one 64-bit word per bit of the
+ * byte. Lane 4 * pos + blk holds byte pos (column-major, as above) of
+ * block blk, so a column is a 16-bit group of the word and a row is a
+ * nibble within it. ShiftRows is then a masked rotate of the word and
+ * MixColumns a rotate within each group. The S-box is a Boolean circuit
+ * (Boyar and Peralta, 2009): no table lookups and no branches on data.
+ */
+using Sliced = uint64_t[8];
+
+constexpr uint64_t ROW_MASK = 0x000F000F000F000FULL;
+
+constexpr uint64_t ror64(uint64_t x, unsigned n)
+{
+    return n == 0 ? x : (x >> n) | (x << (64 - n));
+}
+
+constexpr uint64_t rol64(uint64_t x, unsigned n)
+{
+    return n == 0 ? x : (x << n) | (x >> (64 - n));
+}
+
+// Row r of each column takes row r + 1 (rot1) or r + 2 (rot2)
+constexpr uint64_t rot_rows1(uint64_t x)
+{
+    return ((x >> 4) & 0x0FFF0FFF0FFF0FFFULL) | ((x << 12) & 0xF000F000F000F000ULL);
+}
+
+constexpr uint64_t rot_rows2(uint64_t x)
+{
+    return ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x << 8) & 0xFF00FF00FF00FF00ULL);
+}
+
+// Transpose the 8x8 bit matrix in x: bit j of byte i swaps with bit i of byte j
+constexpr uint64_t transpose8(uint64_t x)
+{
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+// Bit k of b to bit 4k, and back
+constexpr uint64_t spread4(uint64_t b)
+{
+    b = (b | (b << 12)) & 0x000F000FULL;
+    b = (b | (b << 6)) & 0x03030303ULL;
+    return (b | (b << 3)) & 0x11111111ULL;
+}
+
+constexpr uint64_t gather4(uint64_t x)
+{
+    x &= 0x11111111ULL;
+    x = (x | (x >> 3)) & 0x03030303ULL;
+    x = (x | (x >> 6)) & 0x000F000FULL;
+    return (x | (x >> 12)) & 0xFFULL;
+}
+
+uint64_t load_le64(const uint8_t* p)
+{
+    uint64_t x = 0;
+    for (int i = 7; i >= 0; i--) {
+        x = (x << 8) | p[i];
+    }
+    return x;
+}
+
+void store_le64(uint8_t* p, uint64_t x)
+{
+    for (int i = 0; i < 8; i++) {
+        p[i] = static_cast<uint8_t>(x >> (8 * i));
+    }
+}
+
+// Bytes 8g to 8g + 7 are positions 8 (g & 1) to 8 (g & 1) + 7 of block g / 2
+void slice(const uint8_t in[64], Sliced s)
+{
+    for (int i = 0; i < 8; i++) {
+        s[i] = 0;
+    }
+    for (int g = 0; g < 8; g++) {
+        uint64_t planes = transpose8(load_le64(in + 8 * g));
+        unsigned shift = 32 * (g & 1) + (g >> 1);
+        for (int i = 0; i < 8; i++) {
+            s[i] |= spread4((planes >> (8 * i)) & 0xFF) << shift;
+        }
+    }
+}
+
+void unslice(const Sliced s, uint8_t out[64])
+{
+    for (int g = 0; g < 8; g++) {
+        unsigned shift = 32 * (g & 1) + (g >> 1);
+        uint64_t planes = 0;
+        for (int i = 0; i < 8; i++) {
+            planes |= gather4(s[i] >> shift) << (8 * i);
+        }
+        store_le64(out + 8 * g, transpose8(planes));
+    }
+}
+
+// Boyar-Peralta S-box circuit: 32 AND, 83 XOR, 4 XNOR; planes 7..0 are x0..x7
+void sliced_sub_bytes(Sliced q)
+{
+    uint64_t x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4];
+    uint64_t x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+    // Top linear transform
+    uint64_t y14 = x3 ^ x5;
+    uint64_t y13 = x0 ^ x6;
+    uint64_t y9 = x0 ^ x3;
+    uint64_t y8 = x0 ^ x5;
+    uint64_t t0 = x1 ^ x2;
+    uint64_t y1 = t0 ^ x7;
+    uint64_t y4 = y1 ^ x3;
+    uint64_t y12 = y13 ^ y14;
+    uint64_t y2 = y1 ^ x0;
+    uint64_t y5 = y1 ^ x6;
+    uint64_t y3 = y5 ^ y8;
+    uint64_t t1 = x4 ^ y12;
+    uint64_t y15 = t1 ^ x5;
+    uint64_t y20 = t1 ^ x1;
+    uint64_t y6 = y15 ^ x7;
+    uint64_t y10 = y15 ^ t0;
+    uint64_t y11 = y20 ^ y9;
+    uint64_t y7 = x7 ^ y11;
+    uint64_t y17 = y10 ^ y11;
+    uint64_t y19 = y10 ^ y8;
+    uint64_t y16 = t0 ^ y11;
+    uint64_t y21 = y13 ^ y16;
+    uint64_t y18 = x0 ^ y16;
+
+    // Shared non-linear middle: inversion in GF(2^4)^2
+    uint64_t t2 = y12 & y15;
+    uint64_t t3 = y3 & y6;
+    uint64_t t4 = t3 ^ t2;
+    uint64_t t5 = y4 & x7;
+    uint64_t t6 = t5 ^ t2;
+    uint64_t t7 = y13 & y16;
+    uint64_t t8 = y5 & y1;
+    uint64_t t9 = t8 ^ t7;
+    uint64_t t10 = y2 & y7;
+    uint64_t t11 = t10 ^ t7;
+    uint64_t t12 = y9 & y11;
+    uint64_t t13 = y14 & y17;
+    uint64_t t14 = t13 ^ t12;
+    uint64_t t15 = y8 & y10;
+    uint64_t t16 = t15 ^ t12;
+    uint64_t t17 = t4 ^ t14;
+    uint64_t t18 = t6 ^ t16;
+    uint64_t t19 = t9 ^ t14;
+    uint64_t t20 = t11 ^ t16;
+    uint64_t t21 = t17 ^ y20;
+    uint64_t t22 = t18 ^ y19;
+    uint64_t t23 = t19 ^ y21;
+    uint64_t t24 = t20 ^ y18;
+
+    uint64_t t25 = t21 ^ t22;
+    uint64_t t26 = t21 & t23;
+    uint64_t t27 = t24 ^ t26;
+    uint64_t t28 = t25 & t27;
+    uint64_t t29 = t28 ^ t22;
+    uint64_t t30 = t23 ^ t24;
+    uint64_t t31 = t22 ^ t26;
+    uint64_t t32 = t31 & t30;
+    uint64_t t33 = t32 ^ t24;
+    uint64_t t34 = t23 ^ t33;
+    uint64_t t35 = t27 ^ t33;
+    uint64_t t36 = t24 & t35;
+    uint64_t t37 = t36 ^ t34;
+    uint64_t t38 = t27 ^ t36;
+    uint64_t t39 = t29 & t38;
+    uint64_t t40 = t25 ^ t39;
+
+    uint64_t t41 = t40 ^ t37;
+    uint64_t t42 = t29 ^ t33;
+    uint64_t t43 = t29 ^ t40;
+    uint64_t t44 = t33 ^ t37;
+    uint64_t t45 = t42 ^ t41;
+    uint64_t z0 = t44 & y15;
+    uint64_t z1 = t37 & y6;
+    uint64_t z2 = t33 & x7;
+    uint64_t z3 = t43 & y16;
+    uint64_t z4 = t40 & y1;
+    uint64_t z5 = t29 & y7;
+    uint64_t z6 = t42 & y11;
+    uint64_t z7 = t45 & y17;
+    uint64_t z8 = t41 & y10;
+    uint64_t z9 = t44 & y12;
+    uint64_t z10 = t37 & y3;
+    uint64_t z11 = t33 & y4;
+    uint64_t z12 = t43 & y13;
+    uint64_t z13 = t40 & y5;
+    uint64_t z14 = t29 & y2;
+    uint64_t z15 = t42 & y9;
+    uint64_t z16 = t45 & y14;
+    uint64_t z17 = t41 & y8;
+
+    // Bottom linear transform, affine constant included
+    uint64_t t46 = z15 ^ z16;
+    uint64_t t47 = z10 ^ z11;
+    uint64_t t48 = z5 ^ z13;
+    uint64_t t49 = z9 ^ z10;
+    uint64_t t50 = z2 ^ z12;
+    uint64_t t51 = z2 ^ z5;
+    uint64_t t52 = z7 ^ z8;
+    uint64_t t53 = z0 ^ z3;
+    uint64_t t54 = z6 ^ z7;
+    uint64_t t55 = z16 ^ z17;
+    uint64_t t56 = z12 ^ t48;
+    uint64_t t57 = t50 ^ t53;
+    uint64_t t58 = z4 ^ t46;
+    uint64_t t59 = z3 ^ t54;
+    uint64_t t60 = t46 ^ t57;
+    uint64_t t61 = z14 ^ t57;
+    uint64_t t62 = t52 ^ t58;
+    uint64_t t63 = t49 ^ t58;
+    uint64_t t64 = z4 ^ t59;
+    uint64_t t65 = t61 ^ t62;
+    uint64_t t66 = z1 ^ t63;
+    uint64_t s0 = t59 ^ t63;
+    uint64_t s6 = t56 ^ ~t62;
+    uint64_t s7 = t48 ^ ~t60;
+    uint64_t t67 = t64 ^ t65;
+    uint64_t s3 = t53 ^ t66;
+    uint64_t s4 = t51 ^ t66;
+    uint64_t s5 = t47 ^ t65;
+    uint64_t s1 = t64 ^ ~s3;
+    uint64_t s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+// Inverse of the affine map, 0x05 included
+void sliced_inv_affine(Sliced s)
+{
+    uint64_t b[8];
+    for (int i = 0; i < 8; i++) {
+        b[i] = s[(i + 2) & 7] ^ s[(i + 5) & 7] ^ s[(i + 7) & 7];
+    }
+    for (int i = 0; i < 8; i++) {
+        s[i] = (i == 0 || i == 2) ? ~b[i] : b[i];
+    }
+}
+
+// InvSubBytes(y) = inverse(A^-1(y)), and inverse(x) = A^-1(SubBytes(x))
+void sliced_inv_sub_bytes(Sliced s)
+{
+    sliced_inv_affine(s);
+    sliced_sub_bytes(s);
+    sliced_inv_affine(s);
+}
+
+void sliced_shift_rows(Sliced s)
+{
+    for (int i = 0; i < 8; i++) {
+        uint64_t x = s[i];
+        s[i] = (x & ROW_MASK) | (ror64(x, 16) & (ROW_MASK << 4)) |
+               (ror64(x, 32) & (ROW_MASK << 8)) | (ror64(x, 48) & (ROW_MASK << 12));
+    }
+}
+
+void sliced_inv_shift_rows(Sliced s)
+{
+    for (int i = 0; i < 8; i++) {
+        uint64_t x = s[i];
+        s[i] = (x & ROW_MASK) | (rol64(x, 16) & (ROW_MASK << 4)) |
+               (rol64(x, 32) & (ROW_MASK << 8)) | (rol64(x, 48) & (ROW_MASK << 12));
+    }
+}
+
+void sliced_xtime(const Sliced a, Sliced r)
+{
+    uint64_t hi = a[7];
+    r[7] = a[6];
+    r[6] = a[5];
+    r[5] = a[4];
+    r[4] = a[3] ^ hi;
+    r[3] = a[2] ^ hi;
+    r[2] = a[1];
+    r[1] = a[0] ^ hi;
+    r[0] = hi;
+}
+
+// Same as mix_columns(): a_r ^= (a0 ^ a1 ^ a2 ^ a3) ^ xtime(a_r ^ a_r+1)
+void sliced_mix_columns(Sliced s)
+{
+    uint64_t t[8], x[8];
+    for (int i = 0; i < 8; i++) {
+        t[i] = s[i] ^ rot_rows1(s[i]);
+    }
+    sliced_xtime(t, x);
+    for (int i = 0; i < 8; i++) {
+        s[i] ^= t[i] ^ rot_rows2(t[i]) ^ x[i];
+    }
+}
+
+// InvMixColumns as a pre-step into MixColumns: a_r ^= xtime^2(a_r ^ a_r+2)
+void sliced_inv_mix_columns(Sliced s)
+{
+    uint64_t u[8], x[8];
+    for (int i = 0; i < 8; i++) {
+        u[i] = s[i] ^ rot_rows2(s[i]);
+    }
+    sliced_xtime(u, x);
+    sliced_xtime(x, u);
+    for (int i = 0; i < 8; i++) {
+        s[i] ^= u[i];
+    }
+    sliced_mix_columns(s);
+}
+
+void sliced_add_round_key(Sliced s, const uint64_t* rk)
+{
+    for (int i = 0; i < 8; i++) {
+        s[i] ^= rk[i];
+    }
+}
+
+#ifdef AESFPGA_HAVE_AESNI
+
+__attribute__((target("aes,sse2")))
+void aesni_inverse_keys(const uint8_t* rk, uint8_t* dk)
+{
+    const __m128i* k = reinterpret_cast<const __m128i*>(rk);
+    __m128i* d = reinterpret_cast<__m128i*>(dk);
+    _mm_storeu_si128(&d[0], _mm_loadu_si128(&k[10]));
+    for (int i = 1; i < 10; i++) {
+        _mm_storeu_si128(&d[i], _mm_aesimc_si128(_mm_loadu_si128(&k[10 - i])));
+    }
+    _mm_storeu_si128(&d[10], _mm_loadu_si128(&k[0]));
+}
+
+// Eight blocks at a time to cover the AESENC latency
+__attribute__((target("aes,sse2")))
+void aesni_ecb(const uint8_t* keys, bool decrypt, const uint8_t* in, uint8_t* out, size_t blocks)
+{
+    __m128i k[11];
+    for (int i = 0; i < 11; i++) {
+        k[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys) + i);
+    }
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+
+    size_t i = 0;
+    for (; i + 8 <= blocks; i += 8) {
+        __m128i b[8];
+        for (int j = 0; j < 8; j++) {
+            b[j] = _mm_xor_si128(_mm_loadu_si128(&src[i + j]), k[0]);
+        }
+        for (int round = 1; round < 10; round++) {
+            for (int j = 0; j < 8; j++) {
+                b[j] = decrypt ? _mm_aesdec_si128(b[j], k[round]) : _mm_aesenc_si128(b[j], k[round]);
+            }
+        }
+        for (int j = 0; j < 8; j++) {
+            b[j] = decrypt ? _mm_aesdeclast_si128(b[j], k[10]) : _mm_aesenclast_si128(b[j], k[10]);
+            _mm_storeu_si128(&dst[i + j], b[j]);
+        }
+    }
+    for (; i < blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(&src[i]), k[0]);
+        for (int round = 1; round < 10; round++) {
+            b = decrypt ? _mm_aesdec_si128(b, k[round]) : _mm_aesenc_si128(b, k[round]);
+        }
+        b = decrypt ? _mm_aesdeclast_si128(b, k[10]) : _mm_aesenclast_si128(b, k[10]);
+        _mm_storeu_si128(&dst[i], b);
+    }
+}
+
+#endif // AESFPGA_HAVE_AESNI
+
+} // namespace
+
+SoftAes::Backend SoftAes::best_backend()
+{
+#ifdef AESFPGA_HAVE_AESNI
+    if (__builtin_cpu_supports("aes")) {
+        return Backend::AesNi;
+    }
+#endif
+    return Backend::Bitsliced;
+}
+
+const char* SoftAes::backend_name(Backend backend)
+{
+    switch (backend) {
+    case Backend::Reference: return "reference";
+    case Backend::Bitsliced: return "bitsliced";
+    case Backend::AesNi:     return "AES-NI";
+    }
+    return "unknown";
+}
+
+SoftAes::SoftAes(const uint8_t key[16])
+    : SoftAes(key, best_backend())
+{
+}
+
+SoftAes::SoftAes(const uint8_t key[16], Backend backend)
+    : backend_(backend)
+{
+    if (backend == Backend::AesNi && best_backend() != Backend::AesNi) {
+        throw std::invalid_argument("aesfpga: AES-NI not available on this CPU");
+    }
+
+    uint8_t* w = round_keys_.data();
+    std::memcpy(w, key, 16);
+
+    uint8_t rcon = 0x01;
+    for (int i = 16; i < 176; i += 4) {
+        uint8_t t[4] = {w[i - 4], w[i - 3], w[i - 2], w[i - 1]};
+        if (i % 16 == 0) {
+            // RotWord, SubWord, Rcon
+            uint8_t t0 = t[0];
+            t[0] = SBOX[t[1]] ^ rcon;
+            t[1] = SBOX[t[2]];
+            t[2] = SBOX[t[3]];
+            t[3] = SBOX[t0];
+            rcon = xtime(rcon);
+        }
+        for (int j = 0; j < 4; j++) {
+            w[i + j] = w[i + j - 16] ^ t[j];
+        }
+    }
+
+    // Each round key byte in all four lanes of its position
+    sliced_keys_.fill(0);
+    for (int round = 0; round < 11; round++) {
+        for (int pos = 0; pos < 16; pos++) {
+            for (int i = 0; i < 8; i++) {
+                if ((w[16 * round + pos] >> i) & 1) {
+                    sliced_keys_[8 * round + i] |= 0xFULL << (4 * pos);
+                }
+            }
+        }
+    }
+
+#ifdef AESFPGA_HAVE_AESNI
+    if (backend_ == Backend::AesNi) {
+        aesni_inverse_keys(round_keys_.data(), inv_round_keys_.data());
+    }
+#endif
+}
+
+void SoftAes::encrypt_block(const uint8_t in[16], uint8_t out[16]) const
+{
+    uint8_t s[16];
+    std::memcpy(s, in, 16);
+
+    add_round_key(s, &round_keys_[0]);
+    for (int round = 1; round < 10; round++) {
+        sub_shift(s);
+        mix_columns(s);
+        add_round_key(s, &round_keys_[16 * round]);
+    }
+    sub_shift(s);
+    add_round_key(s, &round_keys_[160]);
+
+    std::memcpy(out, s, 16);
+}
+
+void SoftAes::decrypt_block(const uint8_t in[16], uint8_t out[16]) const
+{
+    uint8_t s[16];
+    std::memcpy(s, in, 16);
+
+    add_round_key(s, &round_keys_[160]);
+    for (int round = 9; round > 0; round--) {
+        inv_sub_shift(s);
+        add_round_key(s, &round_keys_[16 * round]);
+        inv_mix_columns(s);
+    }
+    inv_sub_shift(s);
+    add_round_key(s, &round_keys_[0]);
+
+    std::memcpy(out, s, 16);
+}
+
+void SoftAes::encrypt_ecb(const uint8_t* in, uint8_t* out, size_t len) const
+{
+    process_ecb(false, in, out, len);
+}
+
+void SoftAes::decrypt_ecb(const uint8_t* in, uint8_t* out, size_t len) const
+{
+    process_ecb(true, in, out, len);
+}
+
+void SoftAes::process_ecb(bool decrypt, const uint8_t* in, uint8_t* out, size_t len) const
+{
+    size_t blocks = len / 16;
+
+#ifdef AESFPGA_HAVE_AESNI
+    if (backend_ == Backend::AesNi) {
+        aesni_ecb(decrypt ? inv_round_keys_.data() : round_keys_.data(), decrypt, in, out, blocks);
+        return;
+    }
+#endif
+
+    if (backend_ == Backend::Reference) {
+        for (size_t i = 0; i < blocks; i++) {
+            if (decrypt) {
+                decrypt_block(in + 16 * i, out + 16 * i);
+            } else {
+                encrypt_block(in + 16 * i, out + 16 * i);
+            }
+        }
+        return;
+    }
+
+    const uint64_t* rk = sliced_keys_.data();
+    for (size_t i = 0; i < blocks; i += 4) {
+        // A short last group is padded; the padding lanes are discarded
+        size_t n = std::min<size_t>(4, blocks - i);
+        uint8_t buf[64] = {};
+        std::memcpy(buf, in + 16 * i, 16 * n);
+
+        uint64_t s[8];
+        slice(buf, s);
+        if (decrypt) {
+            sliced_add_round_key(s, &rk[80]);
+            for (int round = 9; round > 0; round--) {
+                sliced_inv_shift_rows(s);
+                sliced_inv_sub_bytes(s);
+                sliced_add_round_key(s, &rk[8 * round]);
+                sliced_inv_mix_columns(s);
+            }
+            sliced_inv_shift_rows(s);
+            sliced_inv_sub_bytes(s);
+            sliced_add_round_key(s, &rk[0]);
+        } else {
+            sliced_add_round_key(s, &rk[0]);
+            for (int round = 1; round < 10; round++) {
+                sliced_sub_bytes(s);
+                sliced_shift_rows(s);
+                sliced_mix_columns(s);
+                sliced_add_round_key(s, &rk[8 * round]);
+            }
+            sliced_sub_bytes(s);
+            sliced_shift_rows(s);
+            sliced_add_round_key(s, &rk[80]);
+        }
+        unslice(s, buf);
+        std::memcpy(out + 16 * i, buf, 16 * n);
+    }
+}
+
+} // namespace aesfpga
@@ -0,0 +1,52 @@
+--------------------------------------------------------------------------------
+-- AES-128 Software Reference for Simulation
+--
+-- Behavioural FIPS-197 encryption built from the encrypt-only aes_pkg
+-- functions (sub_bytes, shift_rows, mix_columns, key_expansion), which the
+-- controller's shared encrypt/decrypt datapath does not use, plus random
+-- block generation for the testbenches.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+
+library work;
+use work.aes_pkg.all;
+
+package aes_ref_pkg is
+
+    function ref_encrypt(key : block_t; pt : block_t) return block_t;
+
+    -- Uniform random block from the math_real generator state
+    procedure random_block(variable seed1, seed2 : inout positive;
+                           variable result       : out block_t);
+
+end package aes_ref_pkg;
+
+package body aes_ref_pkg is
+
+    function ref_encrypt(key : block_t; pt : block_t) return block_t is
+        variable rk    : key_schedule_t;
+        variable state : block_t;
+    begin
+        rk := key_expansion(key);
+        state := add_round_key(pt, rk(0));
+        for r in 1 to 10 loop
+            state := aes_round(state, rk(r), r = 10);
+        end loop;
+        return state;
+    end function;
+
+    procedure random_block(variable seed1, seed2 : inout positive;
+                           variable result       : out block_t) is
+        variable r : real;
+    begin
+        for i in 0 to 15 loop
+            uniform(seed1, seed2, r);
+            result(127 - 8*i downto 120 - 8*i) :=
+                std_logic_vector(to_unsigned(integer(floor(r * 256.0)) mod 256, 8));
+        end loop;
+    end procedure;
+
+end package body aes_ref_pkg;
@@ -0,0 +1,259 @@
+--------------------------------------------------------------------------------
+-- MicroBlaze MCS I/O Bus Functional Model
+--
+-- Drives the controller's IO bus the way the MicroBlaze does: an access
+-- asserts io_addr_strobe with io_write_strobe or io_read_strobe for one
+-- cycle and then waits for io_ready. The CPU sees io_ready at the next edge
+-- and can strobe again one cycle later, so an access that is acknowledged
+-- immediately takes 2 cycles; a push held behind a full queue takes longer.
+--
+-- Register offsets and control bits match src/main.c and controller.vhd.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.aes_pkg.all;
+
+package io_bus_bfm_pkg is
+
+    -- Master (CPU) to slave (controller)
+    type io_bus_m2s_t is record
+        addr         : word_t;
+        write_data   : word_t;
+        addr_strobe  : std_logic;
+        write_strobe : std_logic;
+        read_strobe  : std_logic;
+    end record;
+
+    constant IO_BUS_M2S_IDLE : io_bus_m2s_t := (
+        addr => (others => '0'), write_data => (others => '0'),
+        addr_strobe => '0', write_strobe => '0', read_strobe => '0'
+    );
+
+    -- Slave to master
+    type io_bus_s2m_t is record
+        read_data : word_t;
+        ready     : std_logic;
+    end record;
+
+    -- Register offsets
+    constant REG_KEY0    : natural := 16#00#;
+    constant REG_PT0     : natural := 16#10#;
+    constant REG_CT0     : natural := 16#20#;
+    constant REG_CTRL    : natural := 16#30#;
+    constant REG_CFG     : natural := 16#34#;
+    constant REG_CTX     : natural := 16#38#;
+    constant REG_KEYLOAD : natural := 16#3C#;
+    constant REG_IV0     : natural := 16#50#;
+
+    -- Control bits (write)
+    constant CTRL_START     : natural := 16#0001#;
+    constant CTRL_CLR_DONE  : natural := 16#0002#;
+    constant CTRL_IRQ_EN    : natural := 16#0004#;
+    constant CTRL_CT_POP    : natural := 16#0008#;
+    constant CTRL_DECRYPT   : natural := 16#0010#;
+    constant CTRL_LAST      : natural := 16#0020#;
+    constant CTRL_PARTIAL   : natural := 16#0040#;
+    constant CTRL_USE_KSLOT : natural := 16#1000#;
+    constant CTRL_CLR_OVF   : natural := 16#2000#;
+
+    -- Status bits (read)
+    constant STATUS_BUSY     : natural := 0;
+    constant STATUS_DONE     : natural := 1;
+    constant STATUS_CT_VALID : natural := 3;
+    constant STATUS_Q_FULL   : natural := 8;
+    constant STATUS_Q_OVF    : natural := 13;
+
+    -- Context modes
+    constant MODE_ECB  : natural := 0;
+    constant MODE_CMAC : natural := 1;
+    constant MODE_XTS  : natural := 2;
+    constant MODE_CBC  : natural := 3;
+
+    procedure io_write(signal clk  : in  std_logic;
+                       signal m2s  : out io_bus_m2s_t;
+                       signal s2m  : in  io_bus_s2m_t;
+                       addr        : natural;
+                       data        : word_t);
+
+    procedure io_write(signal clk  : in  std_logic;
+                       signal m2s  : out io_bus_m2s_t;
+                       signal s2m  : in  io_bus_s2m_t;
+                       addr        : natural;
+                       data        : natural);
+
+    procedure io_read(signal clk   : in  std_logic;
+                      signal m2s   : out io_bus_m2s_t;
+                      signal s2m   : in  io_bus_s2m_t;
+                      addr         : natural;
+                      variable data : out word_t);
+
+    -- Four words starting at addr, word 0 = bits 127:96
+    procedure io_write_block(signal clk : in  std_logic;
+                             signal m2s : out io_bus_m2s_t;
+                             signal s2m : in  io_bus_s2m_t;
+                             addr       : natural;
+                             data       : block_t);
+
+    procedure io_read_block(signal clk    : in  std_logic;
+                            signal m2s    : out io_bus_m2s_t;
+                            signal s2m    : in  io_bus_s2m_t;
+                            addr          : natural;
+                            variable data : out block_t);
+
+    -- Firmware-level operations
+    procedure aes_load_key(signal clk : in  std_logic;
+                           signal m2s : out io_bus_m2s_t;
+                           signal s2m : in  io_bus_s2m_t;
+                           slot       : natural;
+                           key        : block_t);
+
+    procedure aes_setup_ctx(signal clk : in  std_logic;
+                            signal m2s : out io_bus_m2s_t;
+                            signal s2m : in  io_bus_s2m_t;
+                            ctx, mode, kslot, tslot : natural;
+                            load_chain : boolean;
+                            chain      : block_t);
+
+    procedure aes_start(signal clk : in  std_logic;
+                        signal m2s : out io_bus_m2s_t;
+                        signal s2m : in  io_bus_s2m_t;
+                        data       : block_t;
+                        ctrl       : natural);
+
+    -- Poll status until a result is presented, read it and pop it
+    procedure aes_wait_pop(signal clk    : in  std_logic;
+                           signal m2s    : out io_bus_m2s_t;
+                           signal s2m    : in  io_bus_s2m_t;
+                           variable data : out block_t);
+
+end package io_bus_bfm_pkg;
+
+package body io_bus_bfm_pkg is
+
+    procedure io_write(signal clk  : in  std_logic;
+                       signal m2s  : out io_bus_m2s_t;
+                       signal s2m  : in  io_bus_s2m_t;
+                       addr        : natural;
+                       data        : word_t) is
+    begin
+        m2s.addr         <= std_logic_vector(to_unsigned(addr, 32));
+        m2s.write_data   <= data;
+        m2s.addr_strobe  <= '1';
+        m2s.write_strobe <= '1';
+        m2s.read_strobe  <= '0';
+        wait until rising_edge(clk);
+        m2s.addr_strobe  <= '0';
+        m2s.write_strobe <= '0';
+        loop
+            wait until rising_edge(clk);
+            exit when s2m.ready = '1';
+        end loop;
+    end procedure;
+
+    procedure io_write(signal clk  : in  std_logic;
+                       signal m2s  : out io_bus_m2s_t;
+                       signal s2m  : in  io_bus_s2m_t;
+                       addr        : natural;
+                       data        : natural) is
+    begin
+        io_write(clk, m2s, s2m, addr, std_logic_vector(to_unsigned(data, 32)));
+    end procedure;
+
+    procedure io_read(signal clk   : in  std_logic;
+                      signal m2s   : out io_bus_m2s_t;
+                      signal s2m   : in  io_bus_s2m_t;
+                      addr         : natural;
+                      variable data : out word_t) is
+    begin
+        m2s.addr         <= std_logic_vector(to_unsigned(addr, 32));
+        m2s.addr_strobe  <= '1';
+        m2s.write_strobe <= '0';
+        m2s.read_strobe  <= '1';
+        wait until rising_edge(clk);
+        m2s.addr_strobe  <= '0';
+        m2s.read_strobe  <= '0';
+        loop
+            wait until rising_edge(clk);
+            exit when s2m.ready = '1';
+        end loop;
+        data := s2m.read_data;
+    end procedure;
+
+    procedure io_write_block(signal clk : in  std_logic;
+                             signal m2s : out io_bus_m2s_t;
+                             signal s2m : in  io_bus_s2m_t;
+                             addr       : natural;
+                             data       : block_t) is
+    begin
+        for i in 0 to 3 loop
+            io_write(clk, m2s, s2m, addr + 4*i, data(127 - 32*i downto 96 - 32*i));
+        end loop;
+    end procedure;
+
+    procedure io_read_block(signal clk    : in  std_logic;
+                            signal m2s    : out io_bus_m2s_t;
+                            signal s2m    : in  io_bus_s2m_t;
+                            addr          : natural;
+                            variable data : out block_t) is
+        variable w : word_t;
+    begin
+        for i in 0 to 3 loop
+            io_read(clk, m2s, s2m, addr + 4*i, w);
+            data(127 - 32*i downto 96 - 32*i) := w;
+        end loop;
+    end procedure;
+
+    procedure aes_load_key(signal clk : in  std_logic;
+                           signal m2s : out io_bus_m2s_t;
+                           signal s2m : in  io_bus_s2m_t;
+                           slot       : natural;
+                           key        : block_t) is
+    begin
+        io_write_block(clk, m2s, s2m, REG_KEY0, key);
+        io_write(clk, m2s, s2m, REG_KEYLOAD, slot);
+    end procedure;
+
+    procedure aes_setup_ctx(signal clk : in  std_logic;
+                            signal m2s : out io_bus_m2s_t;
+                            signal s2m : in  io_bus_s2m_t;
+                            ctx, mode, kslot, tslot : natural;
+                            load_chain : boolean;
+                            chain      : block_t) is
+        variable setup : natural;
+    begin
+        setup := ctx + 4*mode + 16*kslot + 64*tslot;
+        if load_chain then
+            io_write_block(clk, m2s, s2m, REG_IV0, chain);
+            setup := setup + 256;
+        end if;
+        io_write(clk, m2s, s2m, REG_CTX, setup);
+    end procedure;
+
+    procedure aes_start(signal clk : in  std_logic;
+                        signal m2s : out io_bus_m2s_t;
+                        signal s2m : in  io_bus_s2m_t;
+                        data       : block_t;
+                        ctrl       : natural) is
+    begin
+        io_write_block(clk, m2s, s2m, REG_PT0, data);
+        io_write(clk, m2s, s2m, REG_CTRL, CTRL_START + ctrl);
+    end procedure;
+
+    procedure aes_wait_pop(signal clk    : in  std_logic;
+                           signal m2s    : out io_bus_m2s_t;
+                           signal s2m    : in  io_bus_s2m_t;
+                           variable data : out block_t) is
+        variable status : word_t;
+    begin
+        loop
+            io_read(clk, m2s, s2m, REG_CTRL, status);
+            exit when status(STATUS_CT_VALID) = '1';
+        end loop;
+        io_read_block(clk, m2s, s2m, REG_CT0, data);
+        io_write(clk, m2s, s2m, REG_CTRL, CTRL_CT_POP);
+    end procedure;
+
+end package body io_bus_bfm_pkg;
@@ -0,0 +1,329 @@
+--------------------------------------------------------------------------------
+-- AES-128 Controller Testbench
+--
+-- Drives controller.vhd through the MicroBlaze IO bus functional model:
+--   fips197            FIPS-197 C.1 encrypt and decrypt
+--   modes              SP 800-38A CBC, RFC 4493 CMAC, IEEE 1619 XTS vectors
+--   random_vectors     Random keys and blocks against the software reference,
+--                      each decrypted back
+--   core_latency       Cycles from the start strobe to done_irq
+--   sequential_blocks  One block at a time: write, start, poll, read, pop
+--   stream_ecb         Next block started before the previous is read out
+--   stream_random_keys As stream_ecb with a new key every key_every blocks,
+--                      expanded into the next key slot in the background:
+--                      less the bus time of the key loads, within a cycle
+--                      per block of a plain stream_ecb run in the same test
+--   queue_overflow     Starts pushed past what the controller holds without
+--                      a pop: the extra start is dropped and flagged, not held
+--
+-- Each test appends "test,metric,value" lines to metrics.csv in its VUnit
+-- output directory; run.py collects them into one JSON file.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library std;
+use std.textio.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+library work;
+use work.aes_pkg.all;
+use work.io_bus_bfm_pkg.all;
+use work.aes_ref_pkg.all;
+
+entity tb_controller is
+    generic (
+        runner_cfg     : string;
+        seed           : positive := 1;
+        random_vectors : positive := 100;
+        stream_blocks  : positive := 1000;
+        -- Blocks started ahead of the oldest unread result: at most the 4-entry
+        -- queue plus the two ciphertext buffers, leaving room for a key load,
+        -- or a start that no longer fits is dropped as a queue overflow
+        stream_depth   : positive range 1 to 6 := 2;
+        key_every      : positive := 4     -- Blocks per key in stream_random_keys
+    );
+end entity tb_controller;
+
+architecture sim of tb_controller is
+
+    constant CLK_PERIOD : time := 8 ns;    -- 125 MHz
+
+    signal clk      : std_logic := '0';
+    signal rst      : std_logic := '1';
+    signal m2s      : io_bus_m2s_t := IO_BUS_M2S_IDLE;
+    signal s2m      : io_bus_s2m_t;
+    signal done_irq : std_logic;
+
+    -- Rising edges since time zero
+    signal cycle : natural := 0;
+
+begin
+
+    clk <= not clk after CLK_PERIOD / 2;
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            cycle <= cycle + 1;
+        end if;
+    end process;
+
+    dut : entity work.controller
+        port map (
+            clk             => clk,
+            rst             => rst,
+            io_addr         => m2s.addr,
+            io_write_data   => m2s.write_data,
+            io_read_data    => s2m.read_data,
+            io_addr_strobe  => m2s.addr_strobe,
+            io_write_strobe => m2s.write_strobe,
+            io_read_strobe  => m2s.read_strobe,
+            io_ready        => s2m.ready,
+            done_irq        => done_irq
+        );
+
+    test_runner_watchdog(runner, 100 ms);
+
+    main : process
+        type block_array_t is array (natural range <>) of block_t;
+
+        variable seed1, seed2 : positive;
+        variable key, pt, got : block_t;
+        variable keys         : block_array_t(0 to 3);
+        variable expected     : block_array_t(0 to stream_depth - 1);
+        variable queued       : block_array_t(0 to 7);
+        variable status       : word_t;
+        variable slot         : natural;
+        variable issued       : natural;
+        variable retired      : natural;
+        variable t0           : natural;
+        variable cycles       : natural;
+        variable key_cycles   : natural;
+        variable base_cycles  : natural;
+
+        procedure metric(name : string; value : real) is
+            file f     : text;
+            variable l : line;
+        begin
+            file_open(f, output_path(runner_cfg) & "metrics.csv", append_mode);
+            write(l, running_test_case & "," & name & "," & real'image(value));
+            writeline(f, l);
+            file_close(f);
+        end procedure;
+
+        procedure check_block(actual, exp : block_t; what : string) is
+        begin
+            check(actual = exp, what & ": got " & to_hstring(actual) & ", expected " & to_hstring(exp));
+        end procedure;
+
+        -- stream_blocks blocks kept stream_depth ahead of the oldest unread
+        -- result, with a new key every key_every blocks if change_keys.
+        -- total counts every cycle, key_load those spent on key load writes
+        procedure stream(change_keys : boolean; variable total, key_load : out natural) is
+            variable t, k : natural;
+        begin
+            random_block(seed1, seed2, keys(0));
+            aes_load_key(clk, m2s, s2m, 0, keys(0));
+            slot := 0;
+            issued := 0;
+            retired := 0;
+            k := 0;
+            t0 := cycle;
+            while retired < stream_blocks loop
+                if issued < stream_blocks and issued - retired < stream_depth then
+                    if change_keys and issued > 0 and issued mod key_every = 0 then
+                        slot := (slot + 1) mod 4;
+                        random_block(seed1, seed2, keys(slot));
+                        t := cycle;
+                        aes_load_key(clk, m2s, s2m, slot, keys(slot));
+                        k := k + cycle - t;
+                    end if;
+                    random_block(seed1, seed2, pt);
+                    expected(issued mod stream_depth) := ref_encrypt(keys(slot), pt);
+                    aes_start(clk, m2s, s2m, pt, CTRL_USE_KSLOT + slot*1024);
+                    issued := issued + 1;
+                else
+                    aes_wait_pop(clk, m2s, s2m, got);
+                    check_block(got, expected(retired mod stream_depth), "block " & integer'image(retired));
+                    retired := retired + 1;
+                end if;
+            end loop;
+            total := cycle - t0;
+            key_load := k;
+        end procedure;
+
+    begin
+        test_runner_setup(runner, runner_cfg);
+        seed1 := seed;
+        seed2 := 1 + seed mod 1000;
+
+        rst <= '1';
+        for i in 1 to 4 loop
+            wait until rising_edge(clk);
+        end loop;
+        rst <= '0';
+        wait until rising_edge(clk);
+
+        while test_suite loop
+
+            if run("fips197") then
+                -- Context 0 is ECB on key slot 0 after reset
+                aes_load_key(clk, m2s, s2m, 0, x"000102030405060708090a0b0c0d0e0f");
+                aes_start(clk, m2s, s2m, x"00112233445566778899aabbccddeeff", 0);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"69c4e0d86a7b0430d8cdb78070b4c55a", "encrypt");
+                aes_start(clk, m2s, s2m, got, CTRL_DECRYPT);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"00112233445566778899aabbccddeeff", "decrypt");
+
+            elsif run("modes") then
+                -- SP 800-38A F.2.1/F.2.2: context 1 encrypts, context 2 decrypts
+                aes_load_key(clk, m2s, s2m, 1, x"2b7e151628aed2a6abf7158809cf4f3c");
+                aes_setup_ctx(clk, m2s, s2m, 1, MODE_CBC, 1, 0, true, x"000102030405060708090a0b0c0d0e0f");
+                aes_setup_ctx(clk, m2s, s2m, 2, MODE_CBC, 1, 0, true, x"000102030405060708090a0b0c0d0e0f");
+                aes_start(clk, m2s, s2m, x"6bc1bee22e409f96e93d7e117393172a", 1*256);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"7649abac8119b246cee98e9b12e9197d", "CBC encrypt 1");
+                aes_start(clk, m2s, s2m, x"ae2d8a571e03ac9c9eb76fac45af8e51", 1*256);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"5086cb9b507219ee95db113a917678b2", "CBC encrypt 2");
+                aes_start(clk, m2s, s2m, x"7649abac8119b246cee98e9b12e9197d", CTRL_DECRYPT + 2*256);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"6bc1bee22e409f96e93d7e117393172a", "CBC decrypt 1");
+                aes_start(clk, m2s, s2m, x"5086cb9b507219ee95db113a917678b2", CTRL_DECRYPT + 2*256);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"ae2d8a571e03ac9c9eb76fac45af8e51", "CBC decrypt 2");
+
+                -- RFC 4493 examples 1 (empty message, padded) and 2
+                aes_setup_ctx(clk, m2s, s2m, 3, MODE_CMAC, 1, 0, false, (others => '0'));
+                aes_start(clk, m2s, s2m, x"80000000000000000000000000000000",
+                          CTRL_LAST + CTRL_PARTIAL + 3*256);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"bb1d6929e95937287fa37d129b756746", "CMAC empty");
+                aes_start(clk, m2s, s2m, x"6bc1bee22e409f96e93d7e117393172a", CTRL_LAST + 3*256);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"070a16b46b4d4144f79bdd9dd04a287c", "CMAC one block");
+
+                -- IEEE 1619 vector 1: zero keys, data unit 0, 32 zero bytes
+                aes_load_key(clk, m2s, s2m, 2, (others => '0'));
+                aes_load_key(clk, m2s, s2m, 3, (others => '0'));
+                aes_setup_ctx(clk, m2s, s2m, 0, MODE_XTS, 2, 3, true, (others => '0'));
+                aes_start(clk, m2s, s2m, (others => '0'), 0);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"917cf69ebd68b2ec9b9fe9a3eadda692", "XTS block 1");
+                aes_start(clk, m2s, s2m, (others => '0'), 0);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, x"cd43d2f59598ed858c02c2652fbf922e", "XTS block 2");
+
+            elsif run("random_vectors") then
+                for i in 1 to random_vectors loop
+                    random_block(seed1, seed2, key);
+                    random_block(seed1, seed2, pt);
+                    aes_load_key(clk, m2s, s2m, 0, key);
+                    aes_start(clk, m2s, s2m, pt, 0);
+                    aes_wait_pop(clk, m2s, s2m, got);
+                    check_block(got, ref_encrypt(key, pt), "vector " & integer'image(i) & " encrypt");
+                    aes_start(clk, m2s, s2m, got, CTRL_DECRYPT);
+                    aes_wait_pop(clk, m2s, s2m, got);
+                    check_block(got, pt, "vector " & integer'image(i) & " decrypt");
+                end loop;
+                metric("vectors", real(random_vectors));
+
+            elsif run("core_latency") then
+                random_block(seed1, seed2, key);
+                random_block(seed1, seed2, pt);
+                aes_load_key(clk, m2s, s2m, 0, key);
+                io_write_block(clk, m2s, s2m, REG_PT0, pt);
+                -- The access returns one edge after the strobe was sampled
+                io_write(clk, m2s, s2m, REG_CTRL, CTRL_START + CTRL_IRQ_EN);
+                t0 := cycle;
+                loop
+                    wait until rising_edge(clk);
+                    exit when done_irq = '1';
+                end loop;
+                -- done_irq rose at the edge before this one
+                cycles := cycle - t0;
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, ref_encrypt(key, pt), "block");
+                metric("start_to_done_cycles", real(cycles));
+                metric("take_to_done_cycles", real(cycles - 1));
+
+            elsif run("sequential_blocks") then
+                random_block(seed1, seed2, key);
+                aes_load_key(clk, m2s, s2m, 0, key);
+                t0 := cycle;
+                for i in 1 to stream_blocks loop
+                    random_block(seed1, seed2, pt);
+                    aes_start(clk, m2s, s2m, pt, 0);
+                    aes_wait_pop(clk, m2s, s2m, got);
+                    check_block(got, ref_encrypt(key, pt), "block " & integer'image(i));
+                end loop;
+                cycles := cycle - t0;
+                metric("blocks", real(stream_blocks));
+                metric("cycles", real(cycles));
+                metric("cycles_per_block", real(cycles) / real(stream_blocks));
+                metric("blocks_per_cycle", real(stream_blocks) / real(cycles));
+
+            elsif run("stream_ecb") then
+                stream(false, cycles, key_cycles);
+                metric("blocks", real(stream_blocks));
+                metric("cycles", real(cycles));
+                metric("cycles_per_block", real(cycles) / real(stream_blocks));
+                metric("blocks_per_cycle", real(stream_blocks) / real(cycles));
+
+            elsif run("stream_random_keys") then
+                -- The key loads' bus writes are the only cost background
+                -- expansion leaves: a block waiting on its slot shows up here
+                stream(false, base_cycles, key_cycles);
+                stream(true, cycles, key_cycles);
+                metric("blocks", real(stream_blocks));
+                metric("cycles", real(cycles));
+                metric("cycles_per_block", real(cycles) / real(stream_blocks));
+                metric("blocks_per_cycle", real(stream_blocks) / real(cycles));
+                metric("blocks_per_key", real(key_every));
+                metric("key_load_cycles", real(key_cycles));
+                metric("one_key_cycles_per_block", real(base_cycles) / real(stream_blocks));
+                check(abs(real(cycles - key_cycles) - real(base_cycles)) <= real(stream_blocks),
+                      "cycles per block less key loads: " &
+                      real'image(real(cycles - key_cycles) / real(stream_blocks)) &
+                      ", one key: " & real'image(real(base_cycles) / real(stream_blocks)));
+
+            elsif run("queue_overflow") then
+                -- Both ciphertext buffers, the core in DONE and the queue take
+                -- seven blocks. The eighth start can only be queued after a pop,
+                -- which the bench cannot issue while its write is held
+                random_block(seed1, seed2, key);
+                aes_load_key(clk, m2s, s2m, 0, key);
+                for i in queued'range loop
+                    random_block(seed1, seed2, queued(i));
+                    aes_start(clk, m2s, s2m, queued(i), 0);
+                end loop;
+                io_read(clk, m2s, s2m, REG_CTRL, status);
+                check(status(STATUS_Q_FULL) = '1', "queue full");
+                check(status(STATUS_Q_OVF) = '1', "overflow flagged");
+
+                for i in 0 to 6 loop
+                    aes_wait_pop(clk, m2s, s2m, got);
+                    check_block(got, ref_encrypt(key, queued(i)), "block " & integer'image(i));
+                end loop;
+                for i in 1 to 50 loop
+                    wait until rising_edge(clk);
+                end loop;
+                io_read(clk, m2s, s2m, REG_CTRL, status);
+                check(status(STATUS_CT_VALID) = '0', "dropped block not run");
+                check(status(STATUS_Q_OVF) = '1', "overflow sticky");
+                io_write(clk, m2s, s2m, REG_CTRL, CTRL_CLR_OVF);
+                io_read(clk, m2s, s2m, REG_CTRL, status);
+                check(status(STATUS_Q_OVF) = '0', "overflow cleared");
+
+            end if;
+        end loop;
+
+        test_runner_cleanup(runner);
+    end process;
+
+end architecture sim;
@@ -0,0 +1,474 @@
+--------------------------------------------------------------------------------
+-- Frame Bridge Testbench
+--
+-- Drives aes_bridge.vhd from the host side through the UART bus functional
+-- model, with the MicroBlaze IO bus model enabling the bridge and reading
+-- its counters:
+--   ping              PING answered by the bridge
+--   fips197           FIPS-197 C.1 ECB frame
+--   key_load          KEY_LOAD into slot 2, link handed back with a BRIDGE
+--                     frame, then the slot checked by the MicroBlaze
+--   random_vectors    Random key and plaintext ECB frames against the
+--                     software reference
+--   errors            Bad CRC, bad length, unsupported command and a false
+--                     SOF, then the MicroBlaze statistics registers
+--   stream_ecb        ECB frames sent back to back at stream_baud while the
+--                     responses are checked as they arrive
+--   baud_rates        BAUD to each rate the bridge supports, then a PING and
+--                     an ECB frame at that rate; an unsupported rate NAKed
+--   baud_fallback     A new rate left unconfirmed falls back to mcs_baud
+--                     after baud_timeout_ms; a confirmed one stays
+--
+-- The link starts at mcs_baud (7.8125 Mbaud by default, 16 clock cycles
+-- per bit, to keep the other tests short); each test appends
+-- "test,metric,value" lines to metrics.csv like tb_controller.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library std;
+use std.textio.all;
+
+library vunit_lib;
+context vunit_lib.vunit_context;
+
+library work;
+use work.aes_pkg.all;
+use work.io_bus_bfm_pkg.all;
+use work.aes_ref_pkg.all;
+use work.uart_bfm_pkg.all;
+use work.uart_pkg.all;
+
+entity tb_frame_bridge is
+    generic (
+        runner_cfg     : string;
+        seed            : positive := 1;
+        mcs_baud        : positive := 7812500;
+        baud_timeout_ms : positive := 2;
+        random_vectors  : positive := 20;
+        stream_frames   : positive := 100;
+        stream_baud     : positive := 12000000
+    );
+end entity tb_frame_bridge;
+
+architecture sim of tb_frame_bridge is
+
+    constant CLK_FREQ_HZ : positive := 125000000;
+    constant CLK_PERIOD  : time := 8 ns;
+
+    -- Bridge registers
+    constant REG_BRIDGE      : natural := 16#60#;
+    constant REG_FRAMES      : natural := 16#64#;
+    constant REG_CRC_ERRORS  : natural := 16#68#;
+    constant REG_NAKS        : natural := 16#6C#;
+    constant REG_RX_OVERRUNS : natural := 16#70#;
+    constant REG_LINE_RATE   : natural := 16#74#;
+
+    -- Bridge control bits
+    constant BRIDGE_ENABLE_BIT  : natural := 0;
+    constant BRIDGE_ACTIVE_BIT  : natural := 1;
+    constant BRIDGE_PRESENT_BIT : natural := 31;
+
+    -- ECB request and response sizes on the line, SOF and CRC included
+    constant ECB_REQUEST_BYTES  : natural := 5 + 32 + 2;
+    constant ECB_RESPONSE_BYTES : natural := 5 + 20 + 2;
+
+    -- Header of a frame with an unknown cmd, taken as a false SOF
+    constant FALSE_SOF : byte_array_t(0 to 4) := (FRAME_SOF, x"04", x"55", x"00", x"00");
+
+    signal clk      : std_logic := '0';
+    signal rst      : std_logic := '1';
+    signal m2s      : io_bus_m2s_t := IO_BUS_M2S_IDLE;
+    signal s2m      : io_bus_s2m_t;
+    signal done_irq : std_logic;
+
+    -- Host side of the USB UART and the MCS UART; the host's bit time
+    -- follows the rate negotiated with BAUD
+    signal bit_time : time := 1 sec / mcs_baud;
+    signal host_txd : std_logic := '1';
+    signal host_rxd : std_logic;
+    signal mcs_rxd  : std_logic;
+    signal mcs_txd  : std_logic := '1';
+
+    -- Responses in arrival order
+    type frame_log_t is array (0 to 63) of frame_t;
+    signal resp_log   : frame_log_t;
+    signal resp_count : natural := 0;
+
+    signal cycle : natural := 0;
+
+begin
+
+    clk <= not clk after CLK_PERIOD / 2;
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            cycle <= cycle + 1;
+        end if;
+    end process;
+
+    dut : entity work.aes_bridge
+        generic map (
+            CLK_FREQ_HZ     => CLK_FREQ_HZ,
+            MCS_BAUD        => mcs_baud,
+            BAUD_TIMEOUT_MS => baud_timeout_ms
+        )
+        port map (
+            clk             => clk,
+            rst             => rst,
+            io_addr         => m2s.addr,
+            io_write_data   => m2s.write_data,
+            io_read_data    => s2m.read_data,
+            io_addr_strobe  => m2s.addr_strobe,
+            io_write_strobe => m2s.write_strobe,
+            io_read_strobe  => m2s.read_strobe,
+            io_ready        => s2m.ready,
+            done_irq        => done_irq,
+            uart_rxd        => host_txd,
+            uart_txd        => host_rxd,
+            mcs_uart_rxd    => mcs_rxd,
+            mcs_uart_txd    => mcs_txd
+        );
+
+    host_rx : process
+        variable f : frame_t;
+        variable n : natural := 0;
+    begin
+        loop
+            recv_frame(host_rxd, bit_time, f);
+            resp_log(n mod 64) <= f;
+            n := n + 1;
+            resp_count <= n;
+        end loop;
+    end process;
+
+    test_runner_watchdog(runner, 100 ms);
+
+    main : process
+        type block_array_t is array (natural range <>) of block_t;
+
+        variable seed1, seed2 : positive;
+        variable key, pt, got : block_t;
+        variable expected     : block_array_t(0 to 63);
+        variable f            : frame_t;
+        variable w            : word_t;
+        variable checked      : natural;
+        variable t0           : natural;
+        variable cycles       : natural;
+        variable rate         : natural;
+        variable base         : natural;
+
+        procedure metric(name : string; value : real) is
+            file f     : text;
+            variable l : line;
+        begin
+            file_open(f, output_path(runner_cfg) & "metrics.csv", append_mode);
+            write(l, running_test_case & "," & name & "," & real'image(value));
+            writeline(f, l);
+            file_close(f);
+        end procedure;
+
+        procedure check_block(actual, exp : block_t; what : string) is
+        begin
+            check(actual = exp, what & ": got " & to_hstring(actual) & ", expected " & to_hstring(exp));
+        end procedure;
+
+        -- Wire order: byte 0 is bits 127:120
+        function to_bytes(b : block_t) return byte_array_t is
+            variable r : byte_array_t(0 to 15);
+        begin
+            for i in 0 to 15 loop
+                r(i) := b(127 - 8*i downto 120 - 8*i);
+            end loop;
+            return r;
+        end function;
+
+        function from_bytes(a : byte_array_t; offset : natural) return block_t is
+            variable r : block_t;
+        begin
+            for i in 0 to 15 loop
+                r(127 - 8*i downto 120 - 8*i) := a(offset + i);
+            end loop;
+            return r;
+        end function;
+
+        procedure check_response(f : frame_t; seq, cmd, len : natural; what : string) is
+        begin
+            check(f.crc_ok, what & ": response CRC");
+            check_equal(f.seq, seq mod 256, what & ": seq");
+            check_equal(f.cmd, cmd, what & ": cmd");
+            check_equal(f.len, len, what & ": len");
+        end procedure;
+
+        -- Response number n, waiting for it to arrive
+        procedure wait_response(n : natural; variable f : out frame_t) is
+        begin
+            if resp_count <= n then
+                wait until resp_count > n;
+            end if;
+            f := resp_log(n mod 64);
+        end procedure;
+
+        procedure transact(seq, cmd : natural; payload : byte_array_t;
+                           variable f : out frame_t; corrupt : boolean := false) is
+            variable n : natural;
+        begin
+            n := resp_count;
+            send_frame(host_txd, bit_time, seq, cmd, payload, corrupt);
+            wait_response(n, f);
+        end procedure;
+
+        procedure ecb(seq : natural; key, pt : block_t; variable f : out frame_t) is
+            variable resp : frame_t;
+        begin
+            transact(seq, CMD_ECB, to_bytes(key) & to_bytes(pt), resp);
+            check_response(resp, seq, CMD_ECB + CMD_RESPONSE, 20, "ECB");
+            f := resp;
+        end procedure;
+
+        -- Firmware side: word order for the bridge, then hand it the link
+        procedure bridge_enable is
+            variable status : word_t;
+        begin
+            io_write(clk, m2s, s2m, REG_CFG, 1);
+            io_write(clk, m2s, s2m, REG_BRIDGE, 1);
+            loop
+                io_read(clk, m2s, s2m, REG_BRIDGE, status);
+                exit when status(BRIDGE_ACTIVE_BIT) = '1';
+            end loop;
+            check(status(BRIDGE_PRESENT_BIT) = '1', "bridge present");
+        end procedure;
+
+        procedure check_reg(addr, value : natural; what : string) is
+            variable data : word_t;
+        begin
+            io_read(clk, m2s, s2m, addr, data);
+            check_equal(to_integer(unsigned(data)), value, what);
+        end procedure;
+
+        -- BAUD, then follow the bridge once its response is off the line
+        -- (the last stop bit ends half a bit after it is sampled)
+        procedure set_baud(seq, baud : natural) is
+            variable resp : frame_t;
+        begin
+            transact(seq, CMD_BAUD, u32_bytes(baud), resp);
+            check_response(resp, seq, CMD_BAUD + CMD_RESPONSE, 4, "BAUD");
+            check_equal(get_u32(resp.payload, 0), baud, "BAUD rate");
+            wait for bit_time;
+            bit_time <= 1 sec / baud;
+            wait for 0 ns;
+        end procedure;
+
+    begin
+        test_runner_setup(runner, runner_cfg);
+        seed1 := seed;
+        seed2 := 1 + seed mod 1000;
+
+        rst <= '1';
+        for i in 1 to 4 loop
+            wait until rising_edge(clk);
+        end loop;
+        rst <= '0';
+        wait until rising_edge(clk);
+
+        while test_suite loop
+
+            if run("ping") then
+                bridge_enable;
+                transact(7, CMD_PING, NO_PAYLOAD, f);
+                check_response(f, 7, CMD_PING + CMD_RESPONSE, 1, "PING");
+                check_equal(to_integer(unsigned(f.payload(0))), 2, "protocol version");
+
+            elsif run("fips197") then
+                bridge_enable;
+                ecb(1, x"000102030405060708090a0b0c0d0e0f", x"00112233445566778899aabbccddeeff", f);
+                check_block(from_bytes(f.payload, 0), x"69c4e0d86a7b0430d8cdb78070b4c55a", "ciphertext");
+                check(get_u32(f.payload, 16) > 0, "cycle count");
+                metric("block_cycles", real(get_u32(f.payload, 16)));
+
+            elsif run("key_load") then
+                bridge_enable;
+                random_block(seed1, seed2, key);
+                random_block(seed1, seed2, pt);
+                transact(1, CMD_KEY_LOAD, to_bytes(key) & x"02", f);
+                check_response(f, 1, CMD_KEY_LOAD + CMD_RESPONSE, 4, "KEY_LOAD");
+                metric("key_load_cycles", real(get_u32(f.payload, 0)));
+
+                -- The controller is the bridge's: config reads 0 instead of le_words
+                check_reg(REG_CFG, 0, "config while bridged");
+
+                transact(2, CMD_BRIDGE, (0 => x"00"), f);
+                check_response(f, 2, CMD_BRIDGE + CMD_RESPONSE, 12, "BRIDGE");
+                check_equal(get_u32(f.payload, 0), 2, "frames");
+                check_equal(get_u32(f.payload, 4), 0, "CRC errors");
+                check_equal(get_u32(f.payload, 8), 0, "NAKs");
+                loop
+                    io_read(clk, m2s, s2m, REG_BRIDGE, w);
+                    exit when w(BRIDGE_ACTIVE_BIT) = '0';
+                end loop;
+                check(w(BRIDGE_ENABLE_BIT) = '0', "enable cleared on release");
+
+                -- Pins pass through to the MCS UART again
+                mcs_txd <= '0';
+                host_txd <= '0';
+                wait for 1 ns;
+                check(host_rxd = '0' and mcs_rxd = '0', "UART pass-through");
+                mcs_txd <= '1';
+                host_txd <= '1';
+
+                -- The MicroBlaze uses the slot the bridge loaded
+                check_reg(REG_CFG, 1, "config after release");
+                io_write(clk, m2s, s2m, REG_CFG, 0);
+                aes_start(clk, m2s, s2m, pt, CTRL_USE_KSLOT + 2*1024);
+                aes_wait_pop(clk, m2s, s2m, got);
+                check_block(got, ref_encrypt(key, pt), "block on the bridge's key slot");
+
+            elsif run("random_vectors") then
+                bridge_enable;
+                for i in 1 to random_vectors loop
+                    random_block(seed1, seed2, key);
+                    random_block(seed1, seed2, pt);
+                    ecb(i, key, pt, f);
+                    check_block(from_bytes(f.payload, 0), ref_encrypt(key, pt),
+                                "vector " & integer'image(i));
+                end loop;
+                metric("vectors", real(random_vectors));
+
+            elsif run("errors") then
+                bridge_enable;
+                transact(1, CMD_PING, NO_PAYLOAD, f, corrupt => true);
+                check_response(f, 1, CMD_NAK_RESP, 2, "bad CRC");
+                check_equal(to_integer(unsigned(f.payload(0))), NAK_CRC, "bad CRC reason");
+                check_equal(to_integer(unsigned(f.payload(1))), CMD_PING, "bad CRC cmd");
+
+                transact(2, CMD_ECB, to_bytes(x"000102030405060708090a0b0c0d0e0f"), f);
+                check_response(f, 2, CMD_NAK_RESP, 2, "short ECB");
+                check_equal(to_integer(unsigned(f.payload(0))), NAK_LENGTH, "short ECB reason");
+
+                transact(3, CMD_CTR, (0 to 20 => x"00"), f);
+                check_response(f, 3, CMD_NAK_RESP, 2, "CTR");
+                check_equal(to_integer(unsigned(f.payload(0))), NAK_UNSUPPORTED, "CTR reason");
+                check_equal(to_integer(unsigned(f.payload(1))), CMD_CTR, "CTR cmd");
+
+                transact(4, CMD_KEY_LOAD, to_bytes(x"000102030405060708090a0b0c0d0e0f") & x"04", f);
+                check_response(f, 4, CMD_NAK_RESP, 2, "KEY_LOAD slot 4");
+                check_equal(to_integer(unsigned(f.payload(0))), NAK_PARAM, "KEY_LOAD slot reason");
+
+                -- Noise, then a header with an unknown cmd: both skipped
+                uart_send(host_txd, bit_time, x"00");
+                uart_send(host_txd, bit_time, x"5A");
+                for i in FALSE_SOF'range loop
+                    uart_send(host_txd, bit_time, FALSE_SOF(i));
+                end loop;
+                transact(5, CMD_PING, NO_PAYLOAD, f);
+                check_response(f, 5, CMD_PING + CMD_RESPONSE, 1, "PING after noise");
+
+                check_reg(REG_FRAMES, 4, "frames");
+                check_reg(REG_CRC_ERRORS, 1, "CRC errors");
+                check_reg(REG_NAKS, 4, "NAKs");
+                check_reg(REG_RX_OVERRUNS, 0, "RX overruns");
+
+            elsif run("stream_ecb") then
+                bridge_enable;
+                set_baud(0, stream_baud);
+                transact(1, CMD_PING, NO_PAYLOAD, f);
+                check_response(f, 1, CMD_PING + CMD_RESPONSE, 1, "PING at stream_baud");
+                -- Responses before the stream
+                base := resp_count;
+                random_block(seed1, seed2, key);
+                checked := 0;
+                t0 := cycle;
+                for i in 0 to stream_frames - 1 loop
+                    random_block(seed1, seed2, pt);
+                    expected(i mod 64) := ref_encrypt(key, pt);
+                    send_frame(host_txd, bit_time, i, CMD_ECB, to_bytes(key) & to_bytes(pt));
+                    while base + checked < resp_count loop
+                        f := resp_log((base + checked) mod 64);
+                        check_response(f, checked, CMD_ECB + CMD_RESPONSE, 20, "stream");
+                        check_block(from_bytes(f.payload, 0), expected(checked mod 64),
+                                    "frame " & integer'image(checked));
+                        checked := checked + 1;
+                    end loop;
+                end loop;
+                while checked < stream_frames loop
+                    wait_response(base + checked, f);
+                    check_response(f, checked, CMD_ECB + CMD_RESPONSE, 20, "stream");
+                    check_block(from_bytes(f.payload, 0), expected(checked mod 64),
+                                "frame " & integer'image(checked));
+                    checked := checked + 1;
+                end loop;
+                cycles := cycle - t0;
+                check_reg(REG_RX_OVERRUNS, 0, "RX overruns");
+
+                metric("baud", real(stream_baud));
+                metric("frames", real(stream_frames));
+                metric("cycles", real(cycles));
+                metric("cycles_per_frame", real(cycles) / real(stream_frames));
+                metric("blocks_per_sec", real(stream_frames) * real(CLK_FREQ_HZ) / real(cycles));
+                -- Share of the request line's capacity in use (1.0 = back to back)
+                metric("line_utilisation", real(stream_frames * ECB_REQUEST_BYTES * 10) *
+                                           real(bit_time / 1 ps) /
+                                           (real(cycles) * real(CLK_PERIOD / 1 ps)));
+                metric("response_bytes_per_request_byte",
+                       real(ECB_RESPONSE_BYTES) / real(ECB_REQUEST_BYTES));
+
+            elsif run("baud_rates") then
+                bridge_enable;
+                transact(0, CMD_BAUD, u32_bytes(5000000), f);
+                check_response(f, 0, CMD_NAK_RESP, 2, "unsupported rate");
+                check_equal(to_integer(unsigned(f.payload(0))), NAK_PARAM, "unsupported rate reason");
+                check_reg(REG_LINE_RATE, mcs_baud, "line rate after NAK");
+
+                for i in BAUD_RATES'range loop
+                    rate := BAUD_RATES(i);
+                    set_baud(3*i + 1, rate);
+                    transact(3*i + 2, CMD_PING, NO_PAYLOAD, f);
+                    check_response(f, 3*i + 2, CMD_PING + CMD_RESPONSE, 1,
+                                   "PING at " & integer'image(rate));
+                    check_reg(REG_LINE_RATE, rate, "line rate");
+                    random_block(seed1, seed2, key);
+                    random_block(seed1, seed2, pt);
+                    ecb(3*i + 3, key, pt, f);
+                    check_block(from_bytes(f.payload, 0), ref_encrypt(key, pt),
+                                "ECB at " & integer'image(rate));
+                end loop;
+                check_reg(REG_CRC_ERRORS, 0, "CRC errors");
+                check_reg(REG_RX_OVERRUNS, 0, "RX overruns");
+                metric("rates", real(BAUD_RATES'length));
+
+                -- Handing the link back returns it to the MCS UART rate
+                transact(100, CMD_BRIDGE, (0 => x"00"), f);
+                check_response(f, 100, CMD_BRIDGE + CMD_RESPONSE, 12, "BRIDGE");
+                loop
+                    io_read(clk, m2s, s2m, REG_BRIDGE, w);
+                    exit when w(BRIDGE_ACTIVE_BIT) = '0';
+                end loop;
+                check_reg(REG_LINE_RATE, mcs_baud, "line rate after release");
+
+            elsif run("baud_fallback") then
+                bridge_enable;
+                set_baud(1, 2000000);
+                wait for (baud_timeout_ms + 1) * 1 ms;
+                check_reg(REG_LINE_RATE, mcs_baud, "line rate after timeout");
+                bit_time <= 1 sec / mcs_baud;
+                wait for 0 ns;
+                transact(2, CMD_PING, NO_PAYLOAD, f);
+                check_response(f, 2, CMD_PING + CMD_RESPONSE, 1, "PING after fallback");
+
+                set_baud(3, 1000000);
+                transact(4, CMD_PING, NO_PAYLOAD, f);
+                check_response(f, 4, CMD_PING + CMD_RESPONSE, 1, "PING at 1 Mbaud");
+                wait for (baud_timeout_ms + 1) * 1 ms;
+                check_reg(REG_LINE_RATE, 1000000, "confirmed line rate");
+                transact(5, CMD_PING, NO_PAYLOAD, f);
+                check_response(f, 5, CMD_PING + CMD_RESPONSE, 1, "PING at 1 Mbaud later");
+
+            end if;
+        end loop;
+
+        test_runner_cleanup(runner);
+    end process;
+
+end architecture sim;
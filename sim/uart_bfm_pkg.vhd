@@ -0,0 +1,223 @@
+--------------------------------------------------------------------------------
+-- UART Bus Functional Model and Host Protocol Frames
+--
+-- Plays the host side of the serial link: 8N1 characters at a given bit
+-- time, and version 2 frames ([0xA5][seq][cmd][len16][payload][crc16],
+-- CRC-16/CCITT-FALSE over seq, cmd, len and payload) as in src/main.c.
+-- The receiving procedures take the bit time as a signal and read it at
+-- each start bit, so a receiver left waiting follows a line rate change.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.aes_pkg.all;
+
+package uart_bfm_pkg is
+
+    type byte_array_t is array (natural range <>) of byte_t;
+
+    constant NO_PAYLOAD : byte_array_t(1 to 0) := (others => (others => '0'));
+
+    constant FRAME_SOF    : byte_t := x"A5";
+    constant CMD_PING     : natural := 16#00#;
+    constant CMD_ECB      : natural := 16#01#;
+    constant CMD_KEY_LOAD : natural := 16#02#;
+    constant CMD_CTR      : natural := 16#03#;
+    constant CMD_BRIDGE   : natural := 16#0A#;
+    constant CMD_BAUD     : natural := 16#0B#;
+    constant CMD_RESPONSE : natural := 16#80#;
+    constant CMD_NAK_RESP : natural := 16#FF#;
+
+    constant NAK_CRC         : natural := 1;
+    constant NAK_LENGTH      : natural := 2;
+    constant NAK_PARAM       : natural := 3;
+    constant NAK_UNSUPPORTED : natural := 4;
+
+    -- Received frame; payload bytes past FRAME_MAX_PAYLOAD are counted, not kept
+    constant FRAME_MAX_PAYLOAD : natural := 32;
+    type frame_t is record
+        seq     : natural;
+        cmd     : natural;
+        len     : natural;
+        payload : byte_array_t(0 to FRAME_MAX_PAYLOAD-1);
+        crc_ok  : boolean;
+    end record;
+
+    function crc16_update(crc : std_logic_vector(15 downto 0); byte : byte_t)
+        return std_logic_vector;
+
+    -- Little-endian 32-bit field of a payload
+    function get_u32(payload : byte_array_t; offset : natural) return natural;
+
+    -- Little-endian 32-bit payload field
+    function u32_bytes(value : natural) return byte_array_t;
+
+    procedure uart_send(signal txd : out std_logic;
+                        bit_time   : time;
+                        data       : byte_t);
+
+    -- Wait for a start bit (glitches shorter than half a bit are ignored)
+    procedure uart_recv(signal rxd      : in  std_logic;
+                        signal bit_time : in  time;
+                        variable data   : out byte_t);
+
+    -- Send a request; corrupt flips a CRC bit
+    procedure send_frame(signal txd : out std_logic;
+                         bit_time   : time;
+                         seq, cmd   : natural;
+                         payload    : byte_array_t;
+                         corrupt    : boolean := false);
+
+    -- Skip to the next SOF and receive one frame
+    procedure recv_frame(signal rxd      : in  std_logic;
+                         signal bit_time : in  time;
+                         variable f      : out frame_t);
+
+end package uart_bfm_pkg;
+
+package body uart_bfm_pkg is
+
+    function crc16_update(crc : std_logic_vector(15 downto 0); byte : byte_t)
+        return std_logic_vector is
+        variable c : std_logic_vector(15 downto 0);
+    begin
+        c := crc;
+        for i in 7 downto 0 loop
+            if (c(15) xor byte(i)) = '1' then
+                c := (c(14 downto 0) & '0') xor x"1021";
+            else
+                c := c(14 downto 0) & '0';
+            end if;
+        end loop;
+        return c;
+    end function;
+
+    function get_u32(payload : byte_array_t; offset : natural) return natural is
+        variable v : unsigned(31 downto 0);
+    begin
+        v := unsigned(payload(offset + 3) & payload(offset + 2) &
+                      payload(offset + 1) & payload(offset));
+        -- Counts in the testbenches stay below 2**31
+        return to_integer(v(30 downto 0));
+    end function;
+
+    function u32_bytes(value : natural) return byte_array_t is
+        variable v : unsigned(31 downto 0);
+        variable r : byte_array_t(0 to 3);
+    begin
+        v := to_unsigned(value, 32);
+        for i in r'range loop
+            r(i) := std_logic_vector(v(8*i + 7 downto 8*i));
+        end loop;
+        return r;
+    end function;
+
+    procedure uart_send(signal txd : out std_logic;
+                        bit_time   : time;
+                        data       : byte_t) is
+    begin
+        txd <= '0';
+        wait for bit_time;
+        for i in 0 to 7 loop
+            txd <= data(i);
+            wait for bit_time;
+        end loop;
+        txd <= '1';
+        wait for bit_time;
+    end procedure;
+
+    procedure uart_recv(signal rxd      : in  std_logic;
+                        signal bit_time : in  time;
+                        variable data   : out byte_t) is
+    begin
+        loop
+            if rxd /= '0' then
+                wait until rxd = '0';
+            end if;
+            wait for bit_time / 2;
+            exit when rxd = '0';
+        end loop;
+        for i in 0 to 7 loop
+            wait for bit_time;
+            data(i) := rxd;
+        end loop;
+        wait for bit_time;
+        assert rxd = '1' report "UART stop bit missing" severity error;
+    end procedure;
+
+    procedure send_frame(signal txd : out std_logic;
+                         bit_time   : time;
+                         seq, cmd   : natural;
+                         payload    : byte_array_t;
+                         corrupt    : boolean := false) is
+        variable header : byte_array_t(0 to 3);
+        variable crc    : std_logic_vector(15 downto 0);
+    begin
+        header(0) := std_logic_vector(to_unsigned(seq mod 256, 8));
+        header(1) := std_logic_vector(to_unsigned(cmd, 8));
+        header(2) := std_logic_vector(to_unsigned(payload'length mod 256, 8));
+        header(3) := std_logic_vector(to_unsigned(payload'length / 256, 8));
+
+        crc := x"FFFF";
+        for i in header'range loop
+            crc := crc16_update(crc, header(i));
+        end loop;
+        for i in payload'range loop
+            crc := crc16_update(crc, payload(i));
+        end loop;
+        if corrupt then
+            crc(0) := not crc(0);
+        end if;
+
+        uart_send(txd, bit_time, FRAME_SOF);
+        for i in header'range loop
+            uart_send(txd, bit_time, header(i));
+        end loop;
+        for i in payload'range loop
+            uart_send(txd, bit_time, payload(i));
+        end loop;
+        uart_send(txd, bit_time, crc(7 downto 0));
+        uart_send(txd, bit_time, crc(15 downto 8));
+    end procedure;
+
+    procedure recv_frame(signal rxd      : in  std_logic;
+                         signal bit_time : in  time;
+                         variable f      : out frame_t) is
+        variable b      : byte_t;
+        variable header : byte_array_t(0 to 3);
+        variable crc    : std_logic_vector(15 downto 0);
+        variable rx_crc : std_logic_vector(15 downto 0);
+        variable len    : natural;
+    begin
+        loop
+            uart_recv(rxd, bit_time, b);
+            exit when b = FRAME_SOF;
+        end loop;
+
+        crc := x"FFFF";
+        for i in header'range loop
+            uart_recv(rxd, bit_time, header(i));
+            crc := crc16_update(crc, header(i));
+        end loop;
+        len := to_integer(unsigned(header(3) & header(2)));
+        f.seq := to_integer(unsigned(header(0)));
+        f.cmd := to_integer(unsigned(header(1)));
+        f.len := len;
+        f.payload := (others => (others => '0'));
+
+        for i in 0 to len - 1 loop
+            uart_recv(rxd, bit_time, b);
+            crc := crc16_update(crc, b);
+            if i < FRAME_MAX_PAYLOAD then
+                f.payload(i) := b;
+            end if;
+        end loop;
+
+        uart_recv(rxd, bit_time, rx_crc(7 downto 0));
+        uart_recv(rxd, bit_time, rx_crc(15 downto 8));
+        f.crc_ok := rx_crc = crc;
+    end procedure;
+
+end package body uart_bfm_pkg;
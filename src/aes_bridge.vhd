@@ -0,0 +1,453 @@
+--------------------------------------------------------------------------------
+-- AES-128 Controller with Hardware Frame Bridge
+--
+-- Drop-in replacement for controller.vhd in the block design that adds a
+-- fabric UART and the frame bridge (frame_bridge.vhd), so ECB frames are
+-- parsed, run and answered at line rate with no MicroBlaze involvement. The
+-- MicroBlaze keeps the same IO bus view of the controller and only enables
+-- the bridge and reads its statistics. Unlike the MCS UART, whose rate is
+-- fixed when the block design is built, the fabric UART can be moved to a
+-- multi-megabaud rate with a BAUD frame while the bridge owns the link.
+--
+-- Wiring:
+--   uart_rxd/uart_txd go to the USB UART pins (txd_in/rxd_out), and the MCS
+--   UART is connected through mcs_uart_txd/mcs_uart_rxd. While the bridge
+--   is off the pins pass straight through to the MCS UART; while it owns the
+--   link the MCS UART sees an idle line and its output is not driven out.
+--
+-- Register Map (in addition to the controller's 0x00-0x5C):
+--   0x60      : Bridge control/status
+--               Write: bit0=enable
+--               Read:  bit0=enable, bit1=link_active, bit31=present
+--   0x64      : Frames with a good CRC (read-only)
+--   0x68      : CRC errors (read-only)
+--   0x6C      : NAKs sent (read-only)
+--   0x70      : RX bytes dropped on a full RX FIFO (read-only)
+--   0x74      : Current line rate in baud (read-only)
+--   Counters are cleared when enable is set.
+--
+-- Handover:
+--   Setting enable hands the link to the bridge once the MCS UART output has
+--   been idle for HANDOVER_BITS bit times, so the firmware can queue its
+--   response to the request that enabled the bridge and set enable right
+--   behind it. A BRIDGE frame with enable=0 hands the link back after its
+--   response has left the transmitter and clears enable. Clearing enable from
+--   the MicroBlaze stops the bridge at once, dropping any frame in progress.
+--
+-- Line Rate:
+--   The link starts at MCS_BAUD. A BAUD frame switches the fabric UART to
+--   the new rate once its response has left the transmitter. Unless a frame
+--   with a good CRC arrives at the new rate within BAUD_TIMEOUT_MS (a host
+--   that missed the response, or a cable that cannot carry the rate), the
+--   UART falls back to MCS_BAUD. Whenever the link goes back to the MCS UART
+--   the rate returns to MCS_BAUD as well.
+--
+-- FIFOs:
+--   2**FIFO_DEPTH_LOG2 bytes each way. The default of 1 KB matches the
+--   host library's in-flight limit (DEVICE_RX_RING_SIZE), so a pipelined
+--   host never overruns the RX FIFO.
+--
+-- Controller Access:
+--   While link_active=1 the bridge is the only master of the controller;
+--   MicroBlaze accesses to 0x00-0x5C complete at once, reads return 0 and
+--   writes are dropped. Ownership changes only between accesses.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.uart_pkg.all;
+
+entity aes_bridge is
+    generic (
+        CLK_FREQ_HZ     : positive := 125000000;
+        MCS_BAUD        : positive := 115200;   -- MCS UART rate, also the bridge's initial rate
+        FIFO_DEPTH_LOG2 : positive := 10;
+        HANDOVER_BITS   : positive := 12;
+        BAUD_TIMEOUT_MS : positive := 500
+    );
+    port (
+        clk             : in  std_logic;
+        rst             : in  std_logic;
+        -- MicroBlaze I/O Bus
+        io_addr         : in  std_logic_vector(31 downto 0);
+        io_write_data   : in  std_logic_vector(31 downto 0);
+        io_read_data    : out std_logic_vector(31 downto 0);
+        io_addr_strobe  : in  std_logic;
+        io_write_strobe : in  std_logic;
+        io_read_strobe  : in  std_logic;
+        io_ready        : out std_logic;
+        -- Interrupt output (directly to MicroBlaze external interrupt)
+        done_irq        : out std_logic;
+        -- USB UART pins
+        uart_rxd        : in  std_logic;
+        uart_txd        : out std_logic;
+        -- MCS UART
+        mcs_uart_rxd    : out std_logic;
+        mcs_uart_txd    : in  std_logic
+    );
+end entity aes_bridge;
+
+architecture rtl of aes_bridge is
+
+    constant HANDOVER_CLKS     : positive   := HANDOVER_BITS * (CLK_FREQ_HZ / MCS_BAUD);
+    constant BAUD_TIMEOUT_CLKS : positive   := BAUD_TIMEOUT_MS * (CLK_FREQ_HZ / 1000);
+    constant MCS_BAUD_INC      : baud_inc_t := baud_increment(MCS_BAUD, CLK_FREQ_HZ);
+
+    -- Controller port
+    signal ctl_addr   : std_logic_vector(31 downto 0);
+    signal ctl_wdata  : std_logic_vector(31 downto 0);
+    signal ctl_rdata  : std_logic_vector(31 downto 0);
+    signal ctl_as     : std_logic;
+    signal ctl_ws     : std_logic;
+    signal ctl_rs     : std_logic;
+    signal ctl_ready  : std_logic;
+
+    -- Bridge master
+    signal br_addr    : std_logic_vector(31 downto 0);
+    signal br_wdata   : std_logic_vector(31 downto 0);
+    signal br_as      : std_logic;
+    signal br_ws      : std_logic;
+    signal br_rs      : std_logic;
+    signal br_release : std_logic;
+    signal frames     : unsigned(31 downto 0);
+    signal crc_errors : unsigned(31 downto 0);
+    signal naks       : unsigned(31 downto 0);
+    signal br_baud_set  : std_logic;
+    signal br_baud_inc  : baud_inc_t;
+    signal br_baud_rate : unsigned(31 downto 0);
+
+    -- MicroBlaze side
+    signal mb_local    : std_logic;   -- Access to the bridge registers
+    signal mb_ctl_as   : std_logic;   -- Access passed to the controller
+    signal local_ready : std_logic;
+    signal local_rdata : std_logic_vector(31 downto 0);
+    signal drop_ready  : std_logic;
+
+    -- Link ownership
+    signal bridge_en       : std_logic;
+    signal link_active     : std_logic;
+    signal release_pending : std_logic;
+    signal clear_stats     : std_logic;
+    signal idle_cnt        : integer range 0 to HANDOVER_CLKS;
+    signal mb_ctl_busy     : std_logic;   -- MicroBlaze access awaiting io_ready
+    signal br_ctl_busy     : std_logic;   -- Bridge access awaiting io_ready
+    signal fifo_rst        : std_logic;
+
+    -- Line rate
+    signal line_inc     : baud_inc_t;
+    signal line_rate    : unsigned(31 downto 0);
+    signal baud_pending : std_logic;
+    signal pending_inc  : baud_inc_t;
+    signal pending_rate : unsigned(31 downto 0);
+    signal probation    : std_logic;   -- New rate not yet confirmed by a frame
+    signal probe_cnt    : integer range 0 to BAUD_TIMEOUT_CLKS;
+    signal probe_frames : unsigned(31 downto 0);
+    signal tick         : std_logic;
+
+    -- UART and FIFOs
+    signal rx_byte     : std_logic_vector(7 downto 0);
+    signal rx_strobe   : std_logic;
+    signal rx_full     : std_logic;
+    signal rx_data     : std_logic_vector(7 downto 0);
+    signal rx_valid    : std_logic;
+    signal rx_ready    : std_logic;
+    signal rx_overruns : unsigned(31 downto 0);
+    signal tx_wdata    : std_logic_vector(7 downto 0);
+    signal tx_wvalid   : std_logic;
+    signal tx_full     : std_logic;
+    signal tx_space    : std_logic;
+    signal tx_data     : std_logic_vector(7 downto 0);
+    signal tx_valid    : std_logic;
+    signal tx_ready    : std_logic;
+    signal tx_idle     : std_logic;
+    signal tx_line     : std_logic;
+
+begin
+
+    ---------------------------------------------------------------------------
+    -- Controller and bus routing
+    ---------------------------------------------------------------------------
+
+    ctrl : entity work.controller
+        port map (
+            clk             => clk,
+            rst             => rst,
+            io_addr         => ctl_addr,
+            io_write_data   => ctl_wdata,
+            io_read_data    => ctl_rdata,
+            io_addr_strobe  => ctl_as,
+            io_write_strobe => ctl_ws,
+            io_read_strobe  => ctl_rs,
+            io_ready        => ctl_ready,
+            done_irq        => done_irq
+        );
+
+    mb_local  <= '1' when io_addr(7 downto 5) = "011" else '0';
+    mb_ctl_as <= io_addr_strobe and not mb_local and not link_active;
+
+    ctl_addr  <= br_addr  when link_active = '1' else io_addr;
+    ctl_wdata <= br_wdata when link_active = '1' else io_write_data;
+    ctl_as    <= br_as    when link_active = '1' else mb_ctl_as;
+    ctl_ws    <= br_ws    when link_active = '1' else io_write_strobe and mb_ctl_as;
+    ctl_rs    <= br_rs    when link_active = '1' else io_read_strobe and mb_ctl_as;
+
+    io_ready     <= local_ready or drop_ready or (ctl_ready and not link_active);
+    io_read_data <= local_rdata when local_ready = '1' or drop_ready = '1' else ctl_rdata;
+
+    bridge : entity work.frame_bridge
+        generic map (
+            CLK_FREQ_HZ => CLK_FREQ_HZ,
+            MCS_BAUD    => MCS_BAUD
+        )
+        port map (
+            clk             => clk,
+            rst             => rst,
+            enable          => link_active,
+            rx_data         => rx_data,
+            rx_valid        => rx_valid,
+            rx_ready        => rx_ready,
+            tx_data         => tx_wdata,
+            tx_valid        => tx_wvalid,
+            tx_ready        => tx_space,
+            io_addr         => br_addr,
+            io_write_data   => br_wdata,
+            io_read_data    => ctl_rdata,
+            io_addr_strobe  => br_as,
+            io_write_strobe => br_ws,
+            io_read_strobe  => br_rs,
+            io_ready        => ctl_ready,
+            release         => br_release,
+            baud_set        => br_baud_set,
+            baud_inc        => br_baud_inc,
+            baud_rate       => br_baud_rate,
+            clear_stats     => clear_stats,
+            frames          => frames,
+            crc_errors      => crc_errors,
+            naks            => naks
+        );
+
+    ---------------------------------------------------------------------------
+    -- Bridge registers and link handover
+    ---------------------------------------------------------------------------
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rst = '1' then
+                bridge_en       <= '0';
+                link_active     <= '0';
+                release_pending <= '0';
+                clear_stats     <= '0';
+                idle_cnt        <= 0;
+                mb_ctl_busy     <= '0';
+                br_ctl_busy     <= '0';
+                local_ready     <= '0';
+                drop_ready      <= '0';
+                local_rdata     <= (others => '0');
+            else
+                clear_stats <= '0';
+                local_ready <= '0';
+                drop_ready  <= '0';
+
+                -- Outstanding controller accesses
+                if mb_ctl_as = '1' then
+                    mb_ctl_busy <= '1';
+                elsif ctl_ready = '1' then
+                    mb_ctl_busy <= '0';
+                end if;
+                if br_as = '1' and link_active = '1' then
+                    br_ctl_busy <= '1';
+                elsif ctl_ready = '1' then
+                    br_ctl_busy <= '0';
+                end if;
+
+                -- MicroBlaze accesses to the bridge registers, or to the
+                -- controller while the bridge owns it
+                if io_addr_strobe = '1' and mb_local = '1' then
+                    local_ready <= '1';
+                    if io_write_strobe = '1' then
+                        if to_integer(unsigned(io_addr(4 downto 2))) = 0 then
+                            if io_write_data(0) = '1' and bridge_en = '0' then
+                                clear_stats <= '1';
+                            end if;
+                            bridge_en <= io_write_data(0);
+                        end if;
+                    else
+                        case to_integer(unsigned(io_addr(4 downto 2))) is
+                            when 0 =>
+                                local_rdata <= (31 => '1', 1 => link_active, 0 => bridge_en,
+                                                others => '0');
+                            when 1 => local_rdata <= std_logic_vector(frames);
+                            when 2 => local_rdata <= std_logic_vector(crc_errors);
+                            when 3 => local_rdata <= std_logic_vector(naks);
+                            when 4 => local_rdata <= std_logic_vector(rx_overruns);
+                            when 5 => local_rdata <= std_logic_vector(line_rate);
+                            when others => local_rdata <= (others => '0');
+                        end case;
+                    end if;
+                elsif io_addr_strobe = '1' and link_active = '1' then
+                    drop_ready  <= '1';
+                    local_rdata <= (others => '0');
+                end if;
+
+                -- Hand the link to the bridge once the MCS UART has gone quiet
+                if bridge_en = '0' or mcs_uart_txd = '0' then
+                    idle_cnt <= 0;
+                elsif idle_cnt < HANDOVER_CLKS then
+                    idle_cnt <= idle_cnt + 1;
+                end if;
+
+                if br_release = '1' then
+                    release_pending <= '1';
+                end if;
+
+                if link_active = '0' then
+                    if bridge_en = '1' and idle_cnt = HANDOVER_CLKS and
+                       mb_ctl_busy = '0' and mb_ctl_as = '0' then
+                        link_active <= '1';
+                    end if;
+                elsif br_ctl_busy = '0' and br_as = '0' then
+                    if bridge_en = '0' then
+                        link_active     <= '0';
+                        release_pending <= '0';
+                    elsif release_pending = '1' and tx_valid = '0' and tx_idle = '1' then
+                        -- Response fully sent
+                        link_active     <= '0';
+                        bridge_en       <= '0';
+                        release_pending <= '0';
+                    end if;
+                end if;
+            end if;
+        end if;
+    end process;
+
+    ---------------------------------------------------------------------------
+    -- Line rate
+    ---------------------------------------------------------------------------
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rst = '1' or link_active = '0' then
+                line_inc     <= MCS_BAUD_INC;
+                line_rate    <= to_unsigned(MCS_BAUD, 32);
+                baud_pending <= '0';
+                probation    <= '0';
+                probe_cnt    <= 0;
+            else
+                if br_baud_set = '1' then
+                    baud_pending <= '1';
+                    pending_inc  <= br_baud_inc;
+                    pending_rate <= br_baud_rate;
+                end if;
+
+                -- Switch once the BAUD response is fully sent
+                if baud_pending = '1' and tx_valid = '0' and tx_idle = '1' then
+                    baud_pending <= '0';
+                    line_inc     <= pending_inc;
+                    line_rate    <= pending_rate;
+                    probation    <= '0';
+                    if pending_inc /= MCS_BAUD_INC then
+                        probation    <= '1';
+                        probe_cnt    <= 0;
+                        probe_frames <= frames;
+                    end if;
+                elsif probation = '1' then
+                    if frames /= probe_frames then
+                        probation <= '0';
+                    elsif probe_cnt = BAUD_TIMEOUT_CLKS then
+                        probation <= '0';
+                        line_inc  <= MCS_BAUD_INC;
+                        line_rate <= to_unsigned(MCS_BAUD, 32);
+                    else
+                        probe_cnt <= probe_cnt + 1;
+                    end if;
+                end if;
+            end if;
+        end if;
+    end process;
+
+    baud : entity work.uart_baud
+        port map (
+            clk      => clk,
+            rst      => rst,
+            baud_inc => line_inc,
+            tick     => tick
+        );
+
+    ---------------------------------------------------------------------------
+    -- UART, FIFOs and pin routing
+    ---------------------------------------------------------------------------
+
+    fifo_rst <= rst or not link_active;
+
+    rx : entity work.uart_rx
+        port map (
+            clk         => clk,
+            rst         => rst,
+            tick        => tick,
+            rxd         => uart_rxd,
+            rx_data     => rx_byte,
+            rx_valid    => rx_strobe,
+            frame_error => open
+        );
+
+    rx_fifo : entity work.byte_fifo
+        generic map (DEPTH_LOG2 => FIFO_DEPTH_LOG2)
+        port map (
+            clk      => clk,
+            rst      => fifo_rst,
+            wr_data  => rx_byte,
+            wr_en    => rx_strobe,
+            full     => rx_full,
+            rd_data  => rx_data,
+            rd_valid => rx_valid,
+            rd_en    => rx_ready,
+            level    => open
+        );
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rst = '1' or clear_stats = '1' then
+                rx_overruns <= (others => '0');
+            elsif link_active = '1' and rx_strobe = '1' and rx_full = '1' then
+                rx_overruns <= rx_overruns + 1;
+            end if;
+        end if;
+    end process;
+
+    tx_space <= not tx_full;
+
+    tx_fifo : entity work.byte_fifo
+        generic map (DEPTH_LOG2 => FIFO_DEPTH_LOG2)
+        port map (
+            clk      => clk,
+            rst      => fifo_rst,
+            wr_data  => tx_wdata,
+            wr_en    => tx_wvalid,
+            full     => tx_full,
+            rd_data  => tx_data,
+            rd_valid => tx_valid,
+            rd_en    => tx_ready,
+            level    => open
+        );
+
+    tx : entity work.uart_tx
+        port map (
+            clk      => clk,
+            rst      => rst,
+            tick     => tick,
+            tx_data  => tx_data,
+            tx_valid => tx_valid,
+            tx_ready => tx_ready,
+            idle     => tx_idle,
+            txd      => tx_line
+        );
+
+    uart_txd     <= tx_line when link_active = '1' else mcs_uart_txd;
+    mcs_uart_rxd <= '1'     when link_active = '1' else uart_rxd;
+
+end architecture rtl;
@@ -1,6 +1,6 @@
 --------------------------------------------------------------------------------
 -- AES-128 Package
--- Contains all cryptographic primitives for AES encryption
+-- Contains all cryptographic primitives for AES encryption and decryption
 --------------------------------------------------------------------------------
 library ieee;
 use ieee.std_logic_1164.all;
@@ -34,6 +34,27 @@ package aes_pkg is
         x"8c", x"a1", x"89", x"0d", x"bf", x"e6", x"42", x"68", x"41", x"99", x"2d", x"0f", x"b0", x"54", x"bb", x"16"
     );
 
+    -- GF(2^8) multiplicative inverse (0 maps to 0), shared by SubBytes and
+    -- InvSubBytes: S(x) = A(inv(x)) and S^-1(y) = inv(A^-1(y))
+    constant GF_INV : sbox_t := (
+        x"00", x"01", x"8d", x"f6", x"cb", x"52", x"7b", x"d1", x"e8", x"4f", x"29", x"c0", x"b0", x"e1", x"e5", x"c7",
+        x"74", x"b4", x"aa", x"4b", x"99", x"2b", x"60", x"5f", x"58", x"3f", x"fd", x"cc", x"ff", x"40", x"ee", x"b2",
+        x"3a", x"6e", x"5a", x"f1", x"55", x"4d", x"a8", x"c9", x"c1", x"0a", x"98", x"15", x"30", x"44", x"a2", x"c2",
+        x"2c", x"45", x"92", x"6c", x"f3", x"39", x"66", x"42", x"f2", x"35", x"20", x"6f", x"77", x"bb", x"59", x"19",
+        x"1d", x"fe", x"37", x"67", x"2d", x"31", x"f5", x"69", x"a7", x"64", x"ab", x"13", x"54", x"25", x"e9", x"09",
+        x"ed", x"5c", x"05", x"ca", x"4c", x"24", x"87", x"bf", x"18", x"3e", x"22", x"f0", x"51", x"ec", x"61", x"17",
+        x"16", x"5e", x"af", x"d3", x"49", x"a6", x"36", x"43", x"f4", x"47", x"91", x"df", x"33", x"93", x"21", x"3b",
+        x"79", x"b7", x"97", x"85", x"10", x"b5", x"ba", x"3c", x"b6", x"70", x"d0", x"06", x"a1", x"fa", x"81", x"82",
+        x"83", x"7e", x"7f", x"80", x"96", x"73", x"be", x"56", x"9b", x"9e", x"95", x"d9", x"f7", x"02", x"b9", x"a4",
+        x"de", x"6a", x"32", x"6d", x"d8", x"8a", x"84", x"72", x"2a", x"14", x"9f", x"88", x"f9", x"dc", x"89", x"9a",
+        x"fb", x"7c", x"2e", x"c3", x"8f", x"b8", x"65", x"48", x"26", x"c8", x"12", x"4a", x"ce", x"e7", x"d2", x"62",
+        x"0c", x"e0", x"1f", x"ef", x"11", x"75", x"78", x"71", x"a5", x"8e", x"76", x"3d", x"bd", x"bc", x"86", x"57",
+        x"0b", x"28", x"2f", x"a3", x"da", x"d4", x"e4", x"0f", x"a9", x"27", x"53", x"04", x"1b", x"fc", x"ac", x"e6",
+        x"7a", x"07", x"ae", x"63", x"c5", x"db", x"e2", x"ea", x"94", x"8b", x"c4", x"d5", x"9d", x"f8", x"90", x"6b",
+        x"b1", x"0d", x"d6", x"eb", x"c6", x"0e", x"cf", x"ad", x"08", x"4e", x"d7", x"e3", x"5d", x"50", x"1e", x"b3",
+        x"5b", x"23", x"38", x"34", x"68", x"46", x"03", x"8c", x"dd", x"9c", x"7d", x"a0", x"cd", x"1a", x"41", x"1c"
+    );
+
     -- Round constants for key expansion
     type rcon_t is array (1 to 10) of byte_t;
     constant RCON : rcon_t := (
@@ -53,6 +74,20 @@ package aes_pkg is
     function key_expansion(key : block_t) return key_schedule_t;
     function aes_round(state : block_t; round_key : block_t; is_final : boolean) return block_t;
 
+    -- Shared encrypt/decrypt datapath
+    function affine(b : byte_t) return byte_t;
+    function inv_affine(b : byte_t) return byte_t;
+    function sub_byte_dir(b : byte_t; decrypt : boolean) return byte_t;
+    function sub_bytes_dir(state : block_t; decrypt : boolean) return block_t;
+    function inv_shift_rows(state : block_t) return block_t;
+    function inv_mix_pre(state : block_t) return block_t;
+    function aes_round_dir(state : block_t; round_key : block_t; is_final : boolean;
+                           decrypt : boolean) return block_t;
+
+    -- Mode helpers
+    function gf128_dbl(b : block_t) return block_t;
+    function xts_mul_alpha(b : block_t) return block_t;
+
 end package aes_pkg;
 
 package body aes_pkg is
@@ -255,4 +290,166 @@ package body aes_pkg is
         return temp;
     end function;
 
+    ----------------------------------------------------------------------------
+    -- Affine transform of the S-box: b'(i) = b(i) ^ b(i+4) ^ b(i+5) ^ b(i+6)
+    -- ^ b(i+7) ^ c(i), indices mod 8, c = 0x63
+    ----------------------------------------------------------------------------
+    function affine(b : byte_t) return byte_t is
+        constant C : byte_t := x"63";
+        variable result : byte_t;
+    begin
+        for i in 0 to 7 loop
+            result(i) := b(i) xor b((i + 4) mod 8) xor b((i + 5) mod 8) xor
+                         b((i + 6) mod 8) xor b((i + 7) mod 8) xor C(i);
+        end loop;
+        return result;
+    end function;
+
+    ----------------------------------------------------------------------------
+    -- Inverse affine transform: b'(i) = b(i+2) ^ b(i+5) ^ b(i+7) ^ d(i),
+    -- indices mod 8, d = 0x05
+    ----------------------------------------------------------------------------
+    function inv_affine(b : byte_t) return byte_t is
+        constant D : byte_t := x"05";
+        variable result : byte_t;
+    begin
+        for i in 0 to 7 loop
+            result(i) := b((i + 2) mod 8) xor b((i + 5) mod 8) xor b((i + 7) mod 8) xor D(i);
+        end loop;
+        return result;
+    end function;
+
+    ----------------------------------------------------------------------------
+    -- SubBytes / InvSubBytes through one GF(2^8) inversion table
+    -- Encrypt: affine(inv(b)), decrypt: inv(inv_affine(b))
+    ----------------------------------------------------------------------------
+    function sub_byte_dir(b : byte_t; decrypt : boolean) return byte_t is
+        variable x, y : byte_t;
+    begin
+        x := b;
+        if decrypt then
+            x := inv_affine(b);
+        end if;
+        y := GF_INV(to_integer(unsigned(x)));
+        if not decrypt then
+            y := affine(y);
+        end if;
+        return y;
+    end function;
+
+    function sub_bytes_dir(state : block_t; decrypt : boolean) return block_t is
+        variable result : block_t;
+    begin
+        for i in 0 to 15 loop
+            result(127 - 8*i downto 120 - 8*i) := sub_byte_dir(state(127 - 8*i downto 120 - 8*i), decrypt);
+        end loop;
+        return result;
+    end function;
+
+    ----------------------------------------------------------------------------
+    -- InvShiftRows: Cyclically shift row n right by n positions
+    ----------------------------------------------------------------------------
+    function inv_shift_rows(state : block_t) return block_t is
+        variable result : block_t;
+    begin
+        for col in 0 to 3 loop
+            for row in 0 to 3 loop
+                result(127 - 32*((col + row) mod 4) - 8*row downto 120 - 32*((col + row) mod 4) - 8*row) :=
+                    state(127 - 32*col - 8*row downto 120 - 32*col - 8*row);
+            end loop;
+        end loop;
+        return result;
+    end function;
+
+    ----------------------------------------------------------------------------
+    -- InvMixColumns pre-multiplication: InvMixColumns(s) = MixColumns(pre(s))
+    -- where pre multiplies each column by
+    -- [5 0 4 0]
+    -- [0 5 0 4]
+    -- [4 0 5 0]
+    -- [0 4 0 5]
+    ----------------------------------------------------------------------------
+    function inv_mix_pre(state : block_t) return block_t is
+        variable result : block_t;
+        variable s0, s1, s2, s3 : byte_t;
+        variable u, v : byte_t;
+    begin
+        for i in 0 to 3 loop
+            s0 := state(127 - 32*i downto 120 - 32*i);
+            s1 := state(119 - 32*i downto 112 - 32*i);
+            s2 := state(111 - 32*i downto 104 - 32*i);
+            s3 := state(103 - 32*i downto 96 - 32*i);
+            u := xtime(xtime(s0 xor s2));
+            v := xtime(xtime(s1 xor s3));
+            result(127 - 32*i downto 96 - 32*i) := (s0 xor u) & (s1 xor v) & (s2 xor u) & (s3 xor v);
+        end loop;
+        return result;
+    end function;
+
+    ----------------------------------------------------------------------------
+    -- AES Round, either direction, sharing S-boxes and MixColumns
+    -- Encrypt: SubBytes, ShiftRows, MixColumns, AddRoundKey
+    -- Decrypt: InvSubBytes, InvShiftRows, AddRoundKey, InvMixColumns
+    -- Final round skips (Inv)MixColumns
+    ----------------------------------------------------------------------------
+    function aes_round_dir(state : block_t; round_key : block_t; is_final : boolean;
+                           decrypt : boolean) return block_t is
+        variable temp, mix_in, mixed : block_t;
+    begin
+        temp := sub_bytes_dir(state, decrypt);
+        if decrypt then
+            temp := inv_shift_rows(temp);
+        else
+            temp := shift_rows(temp);
+        end if;
+        if is_final then
+            return add_round_key(temp, round_key);
+        end if;
+
+        if decrypt then
+            mix_in := inv_mix_pre(add_round_key(temp, round_key));
+        else
+            mix_in := temp;
+        end if;
+        mixed := mix_columns(mix_in);
+        if decrypt then
+            return mixed;
+        end if;
+        return add_round_key(mixed, round_key);
+    end function;
+
+    ----------------------------------------------------------------------------
+    -- Doubling in GF(2^128), block read as a big-endian integer (RFC 4493
+    -- subkey generation): shift left 1, reduce with x^128 + x^7 + x^2 + x + 1
+    ----------------------------------------------------------------------------
+    function gf128_dbl(b : block_t) return block_t is
+        variable result : block_t;
+    begin
+        result := b(126 downto 0) & '0';
+        if b(127) = '1' then
+            result(7 downto 0) := result(7 downto 0) xor x"87";
+        end if;
+        return result;
+    end function;
+
+    ----------------------------------------------------------------------------
+    -- Multiply by alpha in GF(2^128), block read as a little-endian integer
+    -- (IEEE 1619 XTS tweak update): byte 0 is least significant, so the shift
+    -- carries from bit 7 of byte n into bit 0 of byte n+1
+    ----------------------------------------------------------------------------
+    function xts_mul_alpha(b : block_t) return block_t is
+        variable result : block_t;
+        variable carry  : std_logic;
+    begin
+        carry := '0';
+        for i in 0 to 15 loop
+            result(127 - 8*i downto 120 - 8*i) := b(126 - 8*i downto 120 - 8*i) & carry;
+            carry := b(127 - 8*i);
+        end loop;
+        if carry = '1' then
+            result(127 downto 120) := result(127 downto 120) xor x"87";
+        end if;
+        return result;
+    end function;
+
 end package body aes_pkg;
@@ -0,0 +1,74 @@
+--------------------------------------------------------------------------------
+-- Byte FIFO
+--
+-- Synchronous first-word-fall-through FIFO of 2**DEPTH_LOG2 bytes in
+-- distributed LUT RAM. The oldest byte is presented on rd_data while
+-- rd_valid is high and is removed by rd_en. A write while full is dropped.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+entity byte_fifo is
+    generic (
+        DEPTH_LOG2 : positive := 6
+    );
+    port (
+        clk      : in  std_logic;
+        rst      : in  std_logic;
+        wr_data  : in  std_logic_vector(7 downto 0);
+        wr_en    : in  std_logic;
+        full     : out std_logic;
+        rd_data  : out std_logic_vector(7 downto 0);
+        rd_valid : out std_logic;
+        rd_en    : in  std_logic;
+        level    : out unsigned(DEPTH_LOG2 downto 0)
+    );
+end entity byte_fifo;
+
+architecture rtl of byte_fifo is
+
+    constant DEPTH : integer := 2**DEPTH_LOG2;
+
+    type mem_t is array (0 to DEPTH-1) of std_logic_vector(7 downto 0);
+    signal mem : mem_t;
+    attribute ram_style : string;
+    attribute ram_style of mem : signal is "distributed";
+
+    -- One extra bit tells full from empty
+    signal wr_ptr : unsigned(DEPTH_LOG2 downto 0);
+    signal rd_ptr : unsigned(DEPTH_LOG2 downto 0);
+    signal count  : unsigned(DEPTH_LOG2 downto 0);
+    signal is_full  : std_logic;
+    signal is_empty : std_logic;
+
+begin
+
+    count    <= wr_ptr - rd_ptr;
+    is_full  <= count(DEPTH_LOG2);
+    is_empty <= '1' when count = 0 else '0';
+
+    full     <= is_full;
+    rd_valid <= not is_empty;
+    rd_data  <= mem(to_integer(rd_ptr(DEPTH_LOG2-1 downto 0)));
+    level    <= count;
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rst = '1' then
+                wr_ptr <= (others => '0');
+                rd_ptr <= (others => '0');
+            else
+                if wr_en = '1' and is_full = '0' then
+                    mem(to_integer(wr_ptr(DEPTH_LOG2-1 downto 0))) <= wr_data;
+                    wr_ptr <= wr_ptr + 1;
+                end if;
+                if rd_en = '1' and is_empty = '0' then
+                    rd_ptr <= rd_ptr + 1;
+                end if;
+            end if;
+        end if;
+    end process;
+
+end architecture rtl;
@@ -1,30 +1,141 @@
 --------------------------------------------------------------------------------
 -- AES-128 Controller with MicroBlaze I/O Bus Interface
 -- 
--- Iterative design with pipelined key expansion
+-- Iterative encrypt/decrypt design with key slots, chaining contexts, a
+-- command queue and a background key expansion engine
 --
 -- Register Map (32-bit aligned, accent via IO Bus):
---   0x00-0x0C : Key[127:0]        (4 words, write-only)
---   0x10-0x1C : Plaintext[127:0]  (4 words, write-only)
---   0x20-0x2C : Ciphertext[127:0] (4 words, read-only)
+--   0x00-0x0C : Key[127:0]        (4 words, write-only, staging for key load)
+--   0x10-0x1C : Plaintext[127:0]  (4 words, write-only; ciphertext when decrypting)
+--   0x20-0x2C : Ciphertext[127:0] (4 words, read-only, presented buffer)
 --   0x30      : Control/Status
---               Write: bit0=start, bit1=clear_done/irq, bit2=irq_enable
---               Read:  bit0=busy, bit1=done, bit2=irq_enable
+--               Write: bit0=start, bit1=clear_done/irq, bit2=irq_enable,
+--                      bit3=ct_pop, bit4=decrypt (direction of this start),
+--                      bit5=last, bit6=partial (CMAC final block of this start),
+--                      bit7=steal (XTS: use the next tweak, keep the current),
+--                      bits9:8=context of this start,
+--                      bits11:10=key slot, bit12=use key slot (instead of the
+--                      context's key slot for this start), bit13=clear_overflow
+--               Read:  bit0=busy, bit1=done, bit2=irq_enable,
+--                      bit3=ct_valid, bit4=ct_sel, bit5=ct_pending,
+--                      bits7:6=ct_ctx, bit8=queue_full, bits11:9=queue_level,
+--                      bit12=key_expanding, bit13=queue_overflow
+--   0x34      : Config (read/write)
+--               bit0=le_words
+--   0x38      : Context setup (write-only, queued)
+--               bits1:0=context, bits3:2=mode (00=ECB, 01=CMAC, 10=XTS, 11=CBC),
+--               bits5:4=key slot, bits7:6=tweak key slot (XTS),
+--               bit8=load chain from 0x50 (CBC IV / XTS data unit number)
+--   0x3C      : Key load (write-only, queued)
+--               bits1:0=key slot; expands Key[127:0] into the slot
+--   0x50-0x5C : IV/Tweak[127:0]   (4 words, write-only, staging for context setup)
+--
+-- Command Queue:
+--   Starts, context setups and key loads are pushed, together with a copy of
+--   the matching staging register, into a 4-entry queue that the core drains
+--   in order. The staging registers can be rewritten right after the push.
+--   A push into a full queue is held (io_ready withheld) until an entry
+--   frees, so firmware can stream commands without polling busy as long as
+--   it keeps no more than the queue, the core and the two ciphertext buffers
+--   can hold. Past that the queue only drains once a result is popped, which
+--   the CPU cannot do while its push is held: such a push is acknowledged
+--   and dropped instead, and sets queue_overflow until a write with
+--   clear_overflow. Firmware that starts further ahead must poll queue_full.
+--
+-- Key Slots:
+--   Four expanded key schedules are kept in the round key RAM. Every block
+--   carries a key slot tag (its context's slot, or the slot given with the
+--   start) and reads its round keys from that slot, so consecutive blocks can
+--   use different keys with no extra cycles.
+--
+-- Key Expansion Engine:
+--   A key load is taken by a separate expansion engine that writes the slot
+--   through the RAM write ports while the round datapath keeps reading other
+--   slots, so loading the next tenant's key overlaps the current block.
+--   A key load waits while the block in flight reads the same slot, and a
+--   block whose slot is being expanded waits until the expansion finishes.
+--
+-- Contexts:
+--   Four chaining contexts each hold a mode, key slot, tweak key slot and a
+--   128-bit chaining register (CBC chain, CMAC chaining value or XTS tweak).
+--   Every start names its context, so blocks of independent serial streams
+--   (CBC encryption, CMAC) can be queued interleaved and run back to back
+--   without firmware saving or reloading chaining values. The presented
+--   result reports the context that produced it (ct_ctx).
+--
+-- Byte Order:
+--   By default word 0 carries block bytes 0..3 in bits 31:24..7:0 (big-endian).
+--   With le_words=1 every key, plaintext, IV/tweak and ciphertext word is
+--   byte-swapped, so byte 0 travels in bits 7:0. A little-endian CPU can then
+--   move received bytes to and from the IO bus as aligned 32-bit words
+--   without repacking.
+--
+-- Ciphertext Double Buffer:
+--   Results alternate between two output buffers. The 0x20-0x2C window
+--   presents buffer ct_sel; ct_valid says it holds an unread result and
+--   ct_pending says the other buffer holds the next one. Writing ct_pop after
+--   reading releases the presented buffer and swaps to the other one, so the
+--   next block can be started as soon as done is seen while the previous
+--   result is still being read out. A block finishing while both buffers are
+--   unread holds in DONE (busy=1) until one is popped.
+--
+-- CBC:
+--   Encryption XORs each block with the context chain before the cipher and
+--   chains the result; decryption XORs the chain after the cipher and chains
+--   the input ciphertext. The IV is loaded with a context setup.
+--
+-- CMAC (RFC 4493):
+--   Each start absorbs one data block into the context chaining value.
+--   Intermediate blocks produce no output and do not set done. The block
+--   started with last=1 is also XORed with subkey K1 (or K2 when partial=1;
+--   firmware applies the 10* padding) and its result, the tag, is retired to
+--   the ciphertext buffer with done; the chain then resets. L = AES_K(0) is
+--   computed in hardware before the first CMAC block after a key load of the
+--   slot (12 extra cycles once per key) and K1/K2 are derived from it. An
+--   N-block message thus costs N data writes plus N starts and one tag read.
+--
+-- XTS (IEEE 1619, XTS-AES-128):
+--   The context key slot holds key 1 and the tweak key slot key 2. A context
+--   setup loading the data unit (sector) number is the per-sector setup:
+--   before the next block the core computes T = AES_K2(sector) in hardware
+--   (12 extra cycles per sector). Each block is then whitened with T before
+--   and after the cipher, in either direction, and T is multiplied by alpha in
+--   GF(2^128) for the next block. For a partial final block (ciphertext
+--   stealing) firmware merges the bytes: encryption needs no change since the
+--   merged block simply takes the next tweak; for decryption the penultimate
+--   block is started with steal=1, which uses T*alpha without advancing T, and
+--   the merged final block then takes T.
 --
 -- Interrupt:
 --   done_irq output is active-high when encryption completes and irq_enable=1
 --   Connect to MicroBlaze external interrupt input
 --   Clear by writing 1 to bit1 of control register
 --
--- Timing: 17 clock cycles from start to done
---   - 5 cycles: key expansion (2 round keys per cycle)
+-- Direction:
+--   Encryption and decryption share one round datapath. SubBytes and
+--   InvSubBytes use the same 16 GF(2^8) inverters with muxed affine
+--   transforms, and InvMixColumns reuses MixColumns after a fixed {04,05}
+--   pre-multiplication. Decryption reads the round keys in reverse order, so
+--   the direction can change on every block with identical timing.
+--
+-- Timing: 12 clock cycles from taking a queued start to done (either direction)
 --   - 1 cycle: initial AddRoundKey (ROUND_0)
 --   - 9 cycles: rounds 1-9
 --   - 1 cycle: round 10 (final)
 --   - 1 cycle: output latching
+--   Key load: 5 cycles of key expansion (2 round keys per cycle), in the
+--   background of block processing
+--
+-- Key Schedule Storage:
+--   Round keys live in two distributed LUT RAM banks (even/odd round number,
+--   8 entries per slot, 6 and 5 used) instead of flip-flops. Each expansion
+--   cycle writes one entry per bank. The read address is round_cnt, which is
+--   registered one state ahead of its use, so the asynchronous LUT RAM read
+--   adds no cycles.
 --
 -- IO Bus Timing:
---   - io_ready asserted 1 cycle after strobe
+--   - io_ready asserted 1 cycle after strobe (later for pushes held behind a
+--     full queue that is still draining)
 --   - io_read_data valid when io_ready is high
 --------------------------------------------------------------------------------
 library ieee;
@@ -53,39 +164,166 @@ end entity controller;
 
 architecture rtl of controller is
 
+    constant KEY_SLOTS : integer := 4;
+    constant CTX_COUNT : integer := 4;
+    constant Q_DEPTH   : integer := 4;
+
     -- State machine
-    type state_t is (IDLE, KEY_EXP_0, KEY_EXP_1, KEY_EXP_2, KEY_EXP_3, KEY_EXP_4,
-                     ROUND_0, ROUNDS_1_9, ROUND_10, DONE);
+    type state_t is (IDLE, ROUND_0, ROUNDS_1_9, ROUND_10, DONE);
     signal state : state_t;
 
     -- Round counter
     signal round_cnt : unsigned(3 downto 0);
 
-    -- Data registers (active write targets)
+    -- Staging registers (active write targets)
     signal key_reg       : block_t;
     signal plaintext_reg : block_t;
-    
+    signal iv_reg        : block_t;  -- CBC IV / XTS data unit number
+
+    -- Modes
+    constant MODE_ECB  : std_logic_vector(1 downto 0) := "00";
+    constant MODE_CMAC : std_logic_vector(1 downto 0) := "01";
+    constant MODE_XTS  : std_logic_vector(1 downto 0) := "10";
+    constant MODE_CBC  : std_logic_vector(1 downto 0) := "11";
+
+    -- Command queue
+    -- Meta: bits11:10=op, bits9:8=context or key slot, bits7:0=arguments
+    --   OP_BLOCK args: bit0=decrypt, bit1=last, bit2=partial, bit3=steal,
+    --                  bit4=use key slot, bits6:5=key slot
+    --   OP_CTX   args: bits1:0=mode, bits3:2=key slot, bits5:4=tweak slot,
+    --                  bit6=load chain
+    constant OP_BLOCK : std_logic_vector(1 downto 0) := "00";
+    constant OP_CTX   : std_logic_vector(1 downto 0) := "01";
+    constant OP_KEY   : std_logic_vector(1 downto 0) := "10";
+
+    subtype meta_t is std_logic_vector(11 downto 0);
+    type q_data_t is array (0 to Q_DEPTH-1) of block_t;
+    type q_meta_t is array (0 to Q_DEPTH-1) of meta_t;
+    signal q_data   : q_data_t;
+    signal q_meta   : q_meta_t;
+    attribute ram_style : string;
+    attribute ram_style of q_data : signal is "distributed";
+    attribute ram_style of q_meta : signal is "distributed";
+    signal q_wr_ptr : unsigned(2 downto 0);   -- Owned by the bus process
+    signal q_rd_ptr : unsigned(2 downto 0);   -- Owned by the state machine
+    signal q_level  : unsigned(2 downto 0);
+    signal q_full   : std_logic;
+    signal q_empty  : std_logic;
+
+    -- Queue head decode
+    signal head_data  : block_t;
+    signal head_meta  : meta_t;
+    signal head_op    : std_logic_vector(1 downto 0);
+    signal head_id    : integer range 0 to 3;
+    signal head_dir   : std_logic;
+    signal head_last  : std_logic;
+    signal head_part  : std_logic;
+    signal head_steal : std_logic;
+    signal head_mode  : std_logic_vector(1 downto 0);  -- Mode of the head's context
+    signal head_slot  : integer range 0 to KEY_SLOTS-1;   -- Key slot tag of the head block
+    signal blk_slot   : integer range 0 to KEY_SLOTS-1;   -- Slot the head block reads first
+
+    -- Contexts
+    type ctx_block_t is array (0 to CTX_COUNT-1) of block_t;
+    type ctx_field_t is array (0 to CTX_COUNT-1) of std_logic_vector(1 downto 0);
+    signal ctx_chain  : ctx_block_t;                        -- CBC/CMAC chain, XTS tweak
+    signal ctx_mode   : ctx_field_t;
+    signal ctx_kslot  : ctx_field_t;
+    signal ctx_tslot  : ctx_field_t;
+    signal ctx_tvalid : std_logic_vector(CTX_COUNT-1 downto 0);  -- XTS T derived
+
+    -- CMAC L = AES_K(0) per key slot
+    type slot_block_t is array (0 to KEY_SLOTS-1) of block_t;
+    signal slot_l       : slot_block_t;
+    signal slot_l_valid : std_logic_vector(KEY_SLOTS-1 downto 0);
+
     -- Latched registers (used during computation)
-    signal key_latched       : block_t;
-    signal plaintext_latched : block_t;
-    
+    signal decrypt_latched : std_logic;
+    signal mode_latched    : std_logic_vector(1 downto 0);
+    signal last_latched    : std_logic;
+    signal derive_latched  : std_logic;  -- Block is a CMAC L / XTS T derivation
+    signal ctx_latched     : integer range 0 to CTX_COUNT-1;
+    signal slot_latched    : integer range 0 to KEY_SLOTS-1;  -- Key slot being read
+    signal post_xor        : block_t;    -- XTS tweak / CBC decrypt chain of the block
+
+    -- Mode input logic
+    signal head_chain  : block_t;
+    signal cmac_l      : block_t;
+    signal cmac_k1     : block_t;
+    signal cmac_k2     : block_t;
+    signal cmac_mask   : block_t;
+    signal xts_tweak   : block_t;    -- Tweak used by an XTS head block
+    signal need_derive : std_logic;
+    signal block_in    : block_t;    -- Data block entering the cipher on take
+    signal cipher_out  : block_t;    -- Result after post-whitening
+
     -- AES state
     signal cipher_state : block_t;
-    signal ciphertext   : block_t;
 
-    -- Key schedule (built incrementally during KEY_EXP states)
-    signal round_keys : key_schedule_t;
+    -- Ciphertext ping-pong buffers
+    type ct_buf_t is array (0 to 1) of block_t;
+    type ct_ctx_t is array (0 to 1) of std_logic_vector(1 downto 0);
+    signal ct_buf    : ct_buf_t;
+    signal ct_ctx    : ct_ctx_t;
+    signal ct_valid  : std_logic_vector(1 downto 0);
+    signal ct_wr_sel : integer range 0 to 1;  -- Buffer receiving the next result
+    signal ct_rd_sel : integer range 0 to 1;  -- Buffer presented at 0x20-0x2C
+
+    -- Key schedule (built incrementally by the expansion engine)
+    -- Entry 8*slot+n: even bank holds round key 2n, odd bank round key 2n+1
+    type rk_ram_t is array (0 to 8*KEY_SLOTS-1) of block_t;
+    signal rk_ram_even : rk_ram_t;
+    signal rk_ram_odd  : rk_ram_t;
+    attribute ram_style of rk_ram_even : signal is "distributed";
+    attribute ram_style of rk_ram_odd  : signal is "distributed";
+
+    signal rk_last     : block_t;                -- Last expanded key (expansion chain)
+    signal kexp_busy   : std_logic;              -- Expansion engine running
+    signal kexp_slot   : integer range 0 to KEY_SLOTS-1;  -- Key slot being written
+    signal kexp_idx    : integer range 0 to 4;   -- Expansion step n -> round keys 2n+1, 2n+2
+    signal rk_exp_odd  : block_t;                -- Round key 2n+1
+    signal rk_exp_even : block_t;                -- Round key 2n+2
+    signal rk_even_we  : std_logic;
+    signal rk_odd_we   : std_logic;
+    signal rk_even_addr : integer range 0 to 8*KEY_SLOTS-1;
+    signal rk_even_data : block_t;
+    signal rk_odd_addr : integer range 0 to 8*KEY_SLOTS-1;
+    signal rk_addr     : unsigned(3 downto 0);   -- round_cnt, or 10 - round_cnt when decrypting
+    signal rk_rd_addr  : integer range 0 to 8*KEY_SLOTS-1;
+    signal round_key   : block_t;                -- Round key addressed by rk_addr
 
     -- Control signals
-    signal start_pulse : std_logic;
+    signal take_key    : std_logic;  -- Head is a key load taken this cycle
+    signal take_block  : std_logic;  -- Head is a block (or its derivation) started this cycle
+    signal take_ctx    : std_logic;  -- Head is a context setup taken this cycle
     signal busy        : std_logic;
     signal done_flag   : std_logic;
     signal irq_enable  : std_logic;
     signal irq_clear   : std_logic;
+    signal ct_pop      : std_logic;
+    signal ct_sel_bit  : std_logic;
+    signal cfg_le_words : std_logic;
+
+    -- Data words after byte-order conversion
+    signal wr_data_word : word_t;
+    signal ct_rd_word   : block_t;
 
     -- Address decoding
     signal addr_word : unsigned(5 downto 0);  -- Word-aligned address (bits 7:2)
-    
+
+    -- Bus request, either a new strobe or a push held behind a full queue
+    signal hold_valid : std_logic;
+    signal hold_addr  : unsigned(5 downto 0);
+    signal hold_data  : word_t;
+    signal req_write  : std_logic;
+    signal req_read   : std_logic;
+    signal req_addr   : unsigned(5 downto 0);
+    signal req_data   : word_t;
+    signal req_push   : std_logic;            -- Write pushes a queue entry
+    signal req_stall  : std_logic;
+    signal q_stuck    : std_logic;            -- Full queue waits for a ct_pop
+    signal q_overflow : std_logic;            -- Sticky: a push was dropped
+
     -- Helper function: expand one round key from previous round key
     -- prev_key = round_keys(n-1), returns round_keys(n)
     function expand_round_key(prev_key : block_t; rcon_idx : integer) return block_t is
@@ -95,21 +333,37 @@ architecture rtl of controller is
     begin
         -- prev_key layout: [127:96]=w0, [95:64]=w1, [63:32]=w2, [31:0]=w3
         w_prev_last := prev_key(31 downto 0);  -- w[i-1] (last word of previous key)
-        
+
         -- w[i] = SubWord(RotWord(w[i-1])) XOR Rcon XOR w[i-4]
         -- RCON is 8 bits, need to pad to 32 bits (Rcon in MSB position)
         temp := sub_word(rot_word(w_prev_last)) xor (RCON(rcon_idx) & x"000000");
         result(127 downto 96) := temp xor prev_key(127 downto 96);
-        
+
         -- w[i+1] = w[i] XOR w[i-3]
         result(95 downto 64) := result(127 downto 96) xor prev_key(95 downto 64);
-        
+
         -- w[i+2] = w[i+1] XOR w[i-2]
         result(63 downto 32) := result(95 downto 64) xor prev_key(63 downto 32);
-        
+
         -- w[i+3] = w[i+2] XOR w[i-1]
         result(31 downto 0) := result(63 downto 32) xor prev_key(31 downto 0);
-        
+
+        return result;
+    end function;
+
+    -- Swap the four bytes of a word (big-endian <-> little-endian layout)
+    function byte_swap(w : word_t) return word_t is
+    begin
+        return w(7 downto 0) & w(15 downto 8) & w(23 downto 16) & w(31 downto 24);
+    end function;
+
+    -- Apply byte_swap to each word of a block
+    function byte_swap_words(b : block_t) return block_t is
+        variable result : block_t;
+    begin
+        for i in 0 to 3 loop
+            result(127 - 32*i downto 96 - 32*i) := byte_swap(b(127 - 32*i downto 96 - 32*i));
+        end loop;
         return result;
     end function;
 
@@ -118,198 +372,473 @@ begin
     -- Address decoding (use bits 7:2 for word address)
     addr_word <= unsigned(io_addr(7 downto 2));
 
+    -- Current bus request (a held write takes precedence; no new strobe can
+    -- arrive before it has been acknowledged)
+    req_write <= (io_addr_strobe and io_write_strobe) or hold_valid;
+    req_read  <= io_addr_strobe and io_read_strobe and not hold_valid;
+    req_addr  <= hold_addr when hold_valid = '1' else addr_word;
+    req_data  <= hold_data when hold_valid = '1' else io_write_data;
+
+    -- Starts, context setups and key loads push a queue entry; hold them
+    -- while the queue is full and will drain on its own
+    req_push  <= '1' when (req_addr = 12 and req_data(0) = '1') or req_addr = 14 or req_addr = 15
+                 else '0';
+    req_stall <= req_push and q_full and not q_stuck;
+
+    -- The queue cannot drain while the core holds a result in DONE with both
+    -- ciphertext buffers unread, unless its head is a key load for another slot
+    q_stuck <= '1' when state = DONE and derive_latched = '0' and
+                        not (mode_latched = MODE_CMAC and last_latched = '0') and
+                        ct_valid(ct_wr_sel) = '1' and
+                        not (head_op = OP_KEY and slot_latched /= head_id) else '0';
+
+    -- Byte-order conversion of staging writes and ciphertext reads
+    wr_data_word <= byte_swap(req_data) when cfg_le_words = '1' else req_data;
+    ct_rd_word   <= byte_swap_words(ct_buf(ct_rd_sel)) when cfg_le_words = '1' else
+                    ct_buf(ct_rd_sel);
+
     ---------------------------------------------------------------------------
     -- Register Write/Read Logic with IO Bus Handshake
     ---------------------------------------------------------------------------
     process(clk)
+        variable wr_idx : integer range 0 to Q_DEPTH-1;
     begin
         if rising_edge(clk) then
             if rst = '1' then
                 key_reg       <= (others => '0');
                 plaintext_reg <= (others => '0');
-                start_pulse   <= '0';
+                iv_reg        <= (others => '0');
+                q_wr_ptr      <= (others => '0');
                 irq_enable    <= '0';
+                cfg_le_words  <= '0';
                 irq_clear     <= '0';
+                ct_pop        <= '0';
+                hold_valid    <= '0';
+                hold_addr     <= (others => '0');
+                hold_data     <= (others => '0');
+                q_overflow    <= '0';
                 io_read_data  <= (others => '0');
                 io_ready      <= '0';
-    
+
             else
-                start_pulse <= '0';  -- Default: clear start pulse
-                irq_clear   <= '0';  -- Default: clear irq_clear pulse
-                
+                irq_clear <= '0';  -- Default: clear irq_clear pulse
+                ct_pop    <= '0';  -- Default: clear ct_pop pulse
+
                 -- io_ready defaults to '0', only asserted for one cycle after strobe
                 io_ready <= '0';
 
-                if io_addr_strobe = '1' then
-                    if io_write_strobe = '1' then
-                        io_ready <= '1';  -- Acknowledge write (1 cycle after strobe)
-                        case to_integer(addr_word) is
+                wr_idx := to_integer(q_wr_ptr(1 downto 0));
+
+                if req_write = '1' then
+                    if req_stall = '1' then
+                        -- Wait for a free queue entry
+                        hold_valid <= '1';
+                        hold_addr  <= req_addr;
+                        hold_data  <= req_data;
+                    else
+                        hold_valid <= '0';
+                        io_ready   <= '1';  -- Acknowledge write (1 cycle after strobe)
+                        case to_integer(req_addr) is
                             -- Key registers (0x00, 0x04, 0x08, 0x0C)
                             when 0 =>
-                                key_reg(127 downto 96) <= io_write_data;
+                                key_reg(127 downto 96) <= wr_data_word;
                             when 1 =>
-                                key_reg(95 downto 64) <= io_write_data;
+                                key_reg(95 downto 64) <= wr_data_word;
                             when 2 =>
-                                key_reg(63 downto 32) <= io_write_data;
+                                key_reg(63 downto 32) <= wr_data_word;
                             when 3 =>
-                                key_reg(31 downto 0) <= io_write_data;
+                                key_reg(31 downto 0) <= wr_data_word;
 
                             -- Plaintext registers (0x10, 0x14, 0x18, 0x1C)
                             when 4 =>
-                                plaintext_reg(127 downto 96) <= io_write_data;
+                                plaintext_reg(127 downto 96) <= wr_data_word;
                             when 5 =>
-                                plaintext_reg(95 downto 64) <= io_write_data;
+                                plaintext_reg(95 downto 64) <= wr_data_word;
                             when 6 =>
-                                plaintext_reg(63 downto 32) <= io_write_data;
+                                plaintext_reg(63 downto 32) <= wr_data_word;
                             when 7 =>
-                                plaintext_reg(31 downto 0) <= io_write_data;
+                                plaintext_reg(31 downto 0) <= wr_data_word;
 
                             -- Control register (0x30)
                             when 12 =>
-                                if io_write_data(0) = '1' and busy = '0' then
-                                    start_pulse <= '1';
+                                if req_data(0) = '1' and q_full = '0' then
+                                    q_data(wr_idx) <= plaintext_reg;
+                                    q_meta(wr_idx) <= OP_BLOCK & req_data(9 downto 8) &
+                                                      '0' & req_data(11 downto 10) & req_data(12) &
+                                                      req_data(7 downto 4);
+                                    q_wr_ptr       <= q_wr_ptr + 1;
                                 end if;
-                                if io_write_data(1) = '1' then
+                                if req_data(1) = '1' then
                                     irq_clear <= '1';
                                 end if;
-                                irq_enable <= io_write_data(2);
+                                irq_enable <= req_data(2);
+                                if req_data(3) = '1' then
+                                    ct_pop <= '1';
+                                end if;
+                                if req_data(13) = '1' then
+                                    q_overflow <= '0';
+                                end if;
+
+                            -- Config register (0x34)
+                            when 13 =>
+                                cfg_le_words <= req_data(0);
+
+                            -- Context setup (0x38)
+                            when 14 =>
+                                if q_full = '0' then
+                                    q_data(wr_idx) <= iv_reg;
+                                    q_meta(wr_idx) <= OP_CTX & req_data(1 downto 0) &
+                                                      '0' & req_data(8 downto 2);
+                                    q_wr_ptr       <= q_wr_ptr + 1;
+                                end if;
+
+                            -- Key load (0x3C)
+                            when 15 =>
+                                if q_full = '0' then
+                                    q_data(wr_idx) <= key_reg;
+                                    q_meta(wr_idx) <= OP_KEY & req_data(1 downto 0) & x"00";
+                                    q_wr_ptr       <= q_wr_ptr + 1;
+                                end if;
+
+                            -- IV/Tweak registers (0x50, 0x54, 0x58, 0x5C)
+                            when 20 =>
+                                iv_reg(127 downto 96) <= wr_data_word;
+                            when 21 =>
+                                iv_reg(95 downto 64) <= wr_data_word;
+                            when 22 =>
+                                iv_reg(63 downto 32) <= wr_data_word;
+                            when 23 =>
+                                iv_reg(31 downto 0) <= wr_data_word;
 
                             when others =>
                                 null;
                         end case;
-                        
-                    elsif io_read_strobe = '1' then
-                        io_ready <= '1';  -- Acknowledge read (1 cycle after strobe)
-                        case to_integer(addr_word) is
-                            -- Ciphertext registers (0x20, 0x24, 0x28, 0x2C)
-                            when 8 =>
-                                io_read_data <= ciphertext(127 downto 96);
-                            when 9 =>
-                                io_read_data <= ciphertext(95 downto 64);
-                            when 10 =>
-                                io_read_data <= ciphertext(63 downto 32);
-                            when 11 =>
-                                io_read_data <= ciphertext(31 downto 0);
-
-                            -- Status register (0x30)
-                            when 12 =>
-                                io_read_data <= (2 => irq_enable, 1 => done_flag, 0 => busy, others => '0');
 
-                            when others =>
-                                io_read_data <= (others => '0');
-                        end case;
+                        if req_push = '1' and q_full = '1' then
+                            -- Stuck behind unread results: drop the push
+                            q_overflow <= '1';
+                        end if;
                     end if;
+
+                elsif req_read = '1' then
+                    io_ready <= '1';  -- Acknowledge read (1 cycle after strobe)
+                    case to_integer(req_addr) is
+                        -- Ciphertext registers (0x20, 0x24, 0x28, 0x2C)
+                        when 8 =>
+                            io_read_data <= ct_rd_word(127 downto 96);
+                        when 9 =>
+                            io_read_data <= ct_rd_word(95 downto 64);
+                        when 10 =>
+                            io_read_data <= ct_rd_word(63 downto 32);
+                        when 11 =>
+                            io_read_data <= ct_rd_word(31 downto 0);
+
+                        -- Status register (0x30)
+                        when 12 =>
+                            io_read_data <= (13 => q_overflow, 12 => kexp_busy,
+                                             11 => q_level(2), 10 => q_level(1), 9 => q_level(0),
+                                             8 => q_full,
+                                             7 => ct_ctx(ct_rd_sel)(1), 6 => ct_ctx(ct_rd_sel)(0),
+                                             5 => ct_valid(1 - ct_rd_sel), 4 => ct_sel_bit,
+                                             3 => ct_valid(ct_rd_sel), 2 => irq_enable,
+                                             1 => done_flag, 0 => busy, others => '0');
+
+                        -- Config register (0x34)
+                        when 13 =>
+                            io_read_data <= (0 => cfg_le_words, others => '0');
+
+                        when others =>
+                            io_read_data <= (others => '0');
+                    end case;
                 end if;
             end if;
         end if;
     end process;
 
     ---------------------------------------------------------------------------
-    -- AES State Machine with Pipelined Key Expansion
+    -- Command Queue Head and Mode Input Logic
+    ---------------------------------------------------------------------------
+    q_level <= q_wr_ptr - q_rd_ptr;
+    q_full  <= q_level(2);
+    q_empty <= '1' when q_wr_ptr = q_rd_ptr else '0';
+
+    head_data  <= q_data(to_integer(q_rd_ptr(1 downto 0)));
+    head_meta  <= q_meta(to_integer(q_rd_ptr(1 downto 0)));
+    head_op    <= head_meta(11 downto 10);
+    head_id    <= to_integer(unsigned(head_meta(9 downto 8)));
+    head_dir   <= head_meta(0);
+    head_last  <= head_meta(1);
+    head_part  <= head_meta(2);
+    head_steal <= head_meta(3);
+    head_mode  <= ctx_mode(head_id);
+    head_slot  <= to_integer(unsigned(head_meta(6 downto 5))) when head_meta(4) = '1' else
+                  to_integer(unsigned(ctx_kslot(head_id)));
+    head_chain <= ctx_chain(head_id);
+
+    -- A block whose context lacks CMAC subkeys or an XTS tweak first runs the
+    -- L = AES_K(0) / T = AES_K2(sector) derivation and stays queued meanwhile
+    need_derive <= '1' when (head_mode = MODE_CMAC and slot_l_valid(head_slot) = '0') or
+                            (head_mode = MODE_XTS and ctx_tvalid(head_id) = '0') else '0';
+
+    blk_slot <= to_integer(unsigned(ctx_tslot(head_id))) when head_mode = MODE_XTS and need_derive = '1'
+                else head_slot;
+
+    -- Dispatch from the queue head. Key loads go to the expansion engine unless
+    -- the block in flight reads that slot; blocks wait for their slot to finish
+    -- expanding. Context setups only run between blocks.
+    take_key   <= '1' when q_empty = '0' and head_op = OP_KEY and kexp_busy = '0' and
+                           not (state /= IDLE and slot_latched = head_id) else '0';
+    take_block <= '1' when state = IDLE and q_empty = '0' and head_op = OP_BLOCK and
+                           not (kexp_busy = '1' and kexp_slot = blk_slot) else '0';
+    take_ctx   <= '1' when state = IDLE and q_empty = '0' and head_op = OP_CTX else '0';
+
+    -- CMAC subkeys: K1 = dbl(L), K2 = dbl(K1)
+    cmac_l    <= slot_l(head_slot);
+    cmac_k1   <= gf128_dbl(cmac_l);
+    cmac_k2   <= gf128_dbl(cmac_k1);
+    cmac_mask <= (others => '0') when head_last = '0' else
+                 cmac_k2 when head_part = '1' else
+                 cmac_k1;
+
+    -- XTS: the stealing block borrows the next tweak
+    xts_tweak <= xts_mul_alpha(head_chain) when head_steal = '1' else head_chain;
+
+    block_in  <= head_data xor head_chain xor cmac_mask when head_mode = MODE_CMAC else
+                 head_data xor xts_tweak when head_mode = MODE_XTS else
+                 head_data xor head_chain when head_mode = MODE_CBC and head_dir = '0' else
+                 head_data;
+
+    cipher_out <= cipher_state xor post_xor;
+
+    ---------------------------------------------------------------------------
+    -- Key Schedule RAM
+    ---------------------------------------------------------------------------
+    -- Key expansion engine: 5 steps, 2 round keys per step
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rst = '1' then
+                kexp_busy <= '0';
+                kexp_slot <= 0;
+                kexp_idx  <= 0;
+                rk_last   <= (others => '0');
+            elsif take_key = '1' then
+                -- Round key 0 is written to the RAM in parallel
+                rk_last   <= head_data;
+                kexp_slot <= head_id;
+                kexp_idx  <= 0;
+                kexp_busy <= '1';
+            elsif kexp_busy = '1' then
+                rk_last <= rk_exp_even;
+                if kexp_idx = 4 then
+                    kexp_busy <= '0';
+                else
+                    kexp_idx <= kexp_idx + 1;
+                end if;
+            end if;
+        end if;
+    end process;
+
+    -- One expansion datapath shared by all steps
+    rk_exp_odd  <= expand_round_key(rk_last, 2*kexp_idx + 1);
+    rk_exp_even <= expand_round_key(rk_exp_odd, 2*kexp_idx + 2);
+
+    -- Round key 0 is written when a key load is taken, round keys 2n+1/2n+2
+    -- during step n
+    rk_odd_we    <= kexp_busy;
+    rk_even_we   <= take_key or kexp_busy;
+    rk_even_addr <= 8*kexp_slot + kexp_idx + 1 when kexp_busy = '1' else 8*head_id;
+    rk_even_data <= rk_exp_even when kexp_busy = '1' else head_data;
+    rk_odd_addr  <= 8*kexp_slot + kexp_idx;
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rk_even_we = '1' then
+                rk_ram_even(rk_even_addr) <= rk_even_data;
+            end if;
+            if rk_odd_we = '1' then
+                rk_ram_odd(rk_odd_addr) <= rk_exp_odd;
+            end if;
+        end if;
+    end process;
+
+    -- Asynchronous read from the registered round_cnt (reversed for decryption)
+    rk_addr    <= to_unsigned(10, 4) - round_cnt when decrypt_latched = '1' else round_cnt;
+    rk_rd_addr <= 8*slot_latched + to_integer(rk_addr(3 downto 1));
+    round_key  <= rk_ram_odd(rk_rd_addr) when rk_addr(0) = '1' else rk_ram_even(rk_rd_addr);
+
+    ---------------------------------------------------------------------------
+    -- AES State Machine
     ---------------------------------------------------------------------------
     process(clk)
-        variable rk_temp : block_t;
     begin
         if rising_edge(clk) then
             if rst = '1' then
                 state            <= IDLE;
                 round_cnt        <= (others => '0');
                 cipher_state     <= (others => '0');
-                ciphertext       <= (others => '0');
+                ct_buf           <= (others => (others => '0'));
+                ct_ctx           <= (others => (others => '0'));
+                ct_valid         <= (others => '0');
+                ct_wr_sel        <= 0;
+                ct_rd_sel        <= 0;
                 done_flag        <= '0';
-                key_latched      <= (others => '0');
-                plaintext_latched <= (others => '0');
-                round_keys       <= (others => (others => '0'));
+                q_rd_ptr         <= (others => '0');
+                decrypt_latched  <= '0';
+                mode_latched     <= MODE_ECB;
+                last_latched     <= '0';
+                derive_latched   <= '0';
+                ctx_latched      <= 0;
+                slot_latched     <= 0;
+                post_xor         <= (others => '0');
+                ctx_chain        <= (others => (others => '0'));
+                ctx_mode         <= (others => MODE_ECB);
+                ctx_kslot        <= (others => "00");
+                ctx_tslot        <= (others => "00");
+                ctx_tvalid       <= (others => '0');
+                slot_l           <= (others => (others => '0'));
+                slot_l_valid     <= (others => '0');
             else
                 -- Handle interrupt clear
                 if irq_clear = '1' then
                     done_flag <= '0';
                 end if;
 
+                -- Release the presented ciphertext buffer and swap to the other one
+                if ct_pop = '1' and ct_valid(ct_rd_sel) = '1' then
+                    ct_valid(ct_rd_sel) <= '0';
+                    ct_rd_sel           <= 1 - ct_rd_sel;
+                end if;
+
+                -- Key loads leave the queue to the expansion engine
+                if take_key = '1' then
+                    slot_l_valid(head_id) <= '0';
+                    q_rd_ptr              <= q_rd_ptr + 1;
+                end if;
+
                 case state is
                     when IDLE =>
-                        if start_pulse = '1' then
-                            -- Latch inputs for computation
-                            key_latched       <= key_reg;
-                            plaintext_latched <= plaintext_reg;
-                            done_flag         <= '0';
-                            -- Round key 0 is the original key
-                            round_keys(0)     <= key_reg;
-                            state             <= KEY_EXP_0;
+                        if take_ctx = '1' then
+                            -- Context setup
+                            ctx_mode(head_id)  <= head_meta(1 downto 0);
+                            ctx_kslot(head_id) <= head_meta(3 downto 2);
+                            ctx_tslot(head_id) <= head_meta(5 downto 4);
+                            if head_meta(6) = '1' then
+                                ctx_chain(head_id) <= head_data;
+                            else
+                                ctx_chain(head_id) <= (others => '0');
+                            end if;
+                            ctx_tvalid(head_id) <= '0';
+                            q_rd_ptr            <= q_rd_ptr + 1;
+
+                        elsif take_block = '1' then
+                            -- Block: latch inputs for computation
+                            ctx_latched  <= head_id;
+                            mode_latched <= head_mode;
+                            slot_latched <= blk_slot;
+                            round_cnt    <= to_unsigned(0, 4);
+                            if need_derive = '1' then
+                                -- CMAC subkey / XTS tweak derivation
+                                -- (CMAC encrypts zero, XTS the sector number in the chain)
+                                if head_mode = MODE_XTS then
+                                    cipher_state <= head_chain;
+                                else
+                                    cipher_state <= (others => '0');
+                                end if;
+                                decrypt_latched <= '0';
+                                derive_latched  <= '1';
+                                post_xor        <= (others => '0');
+                            else
+                                cipher_state   <= block_in;
+                                derive_latched <= '0';
+                                last_latched   <= head_last;
+                                done_flag      <= '0';
+                                q_rd_ptr       <= q_rd_ptr + 1;
+                                if head_mode = MODE_CMAC then
+                                    decrypt_latched <= '0';
+                                else
+                                    decrypt_latched <= head_dir;
+                                end if;
+                                if head_mode = MODE_XTS then
+                                    post_xor <= xts_tweak;
+                                    if head_steal = '0' then
+                                        ctx_chain(head_id) <= xts_mul_alpha(head_chain);
+                                    end if;
+                                elsif head_mode = MODE_CBC and head_dir = '1' then
+                                    post_xor           <= head_chain;
+                                    ctx_chain(head_id) <= head_data;
+                                else
+                                    post_xor <= (others => '0');
+                                end if;
+                            end if;
+                            state <= ROUND_0;
                         end if;
 
-                    -- Key Expansion: 5 cycles, 2 round keys per cycle
-                    when KEY_EXP_0 =>
-                        -- Compute round keys 1 and 2
-                        rk_temp := expand_round_key(round_keys(0), 1);
-                        round_keys(1) <= rk_temp;
-                        round_keys(2) <= expand_round_key(rk_temp, 2);
-                        state <= KEY_EXP_1;
-
-                    when KEY_EXP_1 =>
-                        -- Compute round keys 3 and 4
-                        rk_temp := expand_round_key(round_keys(2), 3);
-                        round_keys(3) <= rk_temp;
-                        round_keys(4) <= expand_round_key(rk_temp, 4);
-                        state <= KEY_EXP_2;
-
-                    when KEY_EXP_2 =>
-                        -- Compute round keys 5 and 6
-                        rk_temp := expand_round_key(round_keys(4), 5);
-                        round_keys(5) <= rk_temp;
-                        round_keys(6) <= expand_round_key(rk_temp, 6);
-                        state <= KEY_EXP_3;
-
-                    when KEY_EXP_3 =>
-                        -- Compute round keys 7 and 8
-                        rk_temp := expand_round_key(round_keys(6), 7);
-                        round_keys(7) <= rk_temp;
-                        round_keys(8) <= expand_round_key(rk_temp, 8);
-                        state <= KEY_EXP_4;
-
-                    when KEY_EXP_4 =>
-                        -- Compute round keys 9 and 10
-                        rk_temp := expand_round_key(round_keys(8), 9);
-                        round_keys(9) <= rk_temp;
-                        round_keys(10) <= expand_round_key(rk_temp, 10);
-                        state <= ROUND_0;
-
-                    -- AES Encryption: 12 cycles
+                    -- AES Encryption/Decryption: 12 cycles
                     when ROUND_0 =>
-                        -- Initial AddRoundKey
-                        cipher_state <= add_round_key(plaintext_latched, round_keys(0));
+                        -- Initial AddRoundKey (round key 0, or 10 when decrypting)
+                        cipher_state <= add_round_key(cipher_state, round_key);
                         round_cnt    <= to_unsigned(1, 4);
                         state        <= ROUNDS_1_9;
 
                     when ROUNDS_1_9 =>
                         -- Rounds 1-9: SubBytes, ShiftRows, MixColumns, AddRoundKey
-                        cipher_state <= aes_round(cipher_state, round_keys(to_integer(round_cnt)), false);
+                        -- (inverse steps when decrypting)
+                        cipher_state <= aes_round_dir(cipher_state, round_key, false, decrypt_latched = '1');
+                        round_cnt    <= round_cnt + 1;
 
                         if round_cnt = 9 then
                             state <= ROUND_10;
-                        else
-                            round_cnt <= round_cnt + 1;
                         end if;
 
                     when ROUND_10 =>
                         -- Final round: SubBytes, ShiftRows, AddRoundKey (no MixColumns)
-                        cipher_state <= aes_round(cipher_state, round_keys(10), true);
+                        cipher_state <= aes_round_dir(cipher_state, round_key, true, decrypt_latched = '1');
                         state        <= DONE;
 
                     when DONE =>
-                        ciphertext <= cipher_state;
-                        done_flag  <= '1';
-                        state      <= IDLE;
+                        if derive_latched = '1' then
+                            -- CMAC L = AES_K(0) or XTS T = AES_K2(sector),
+                            -- the queued block starts next
+                            if mode_latched = MODE_XTS then
+                                ctx_chain(ctx_latched)  <= cipher_state;
+                                ctx_tvalid(ctx_latched) <= '1';
+                            else
+                                slot_l(slot_latched)       <= cipher_state;
+                                slot_l_valid(slot_latched) <= '1';
+                            end if;
+                            state <= IDLE;
+                        elsif mode_latched = MODE_CMAC and last_latched = '0' then
+                            -- Intermediate CMAC block: chain only
+                            ctx_chain(ctx_latched) <= cipher_state;
+                            state                  <= IDLE;
+                        elsif ct_valid(ct_wr_sel) = '0' then
+                            -- Hold until the target buffer has been read out
+                            ct_buf(ct_wr_sel)   <= cipher_out;
+                            ct_ctx(ct_wr_sel)   <= std_logic_vector(to_unsigned(ctx_latched, 2));
+                            ct_valid(ct_wr_sel) <= '1';
+                            ct_wr_sel           <= 1 - ct_wr_sel;
+                            done_flag           <= '1';
+                            if mode_latched = MODE_CMAC then
+                                ctx_chain(ctx_latched) <= (others => '0');
+                            elsif mode_latched = MODE_CBC and decrypt_latched = '0' then
+                                ctx_chain(ctx_latched) <= cipher_out;
+                            end if;
+                            state <= IDLE;
+                        end if;
 
                 end case;
             end if;
         end if;
     end process;
 
-    -- Busy signal: high when not in IDLE
-    busy <= '0' when state = IDLE else '1';
+    -- Busy signal: high when not in IDLE, commands are queued or a key is expanding
+    busy <= '0' when state = IDLE and q_empty = '1' and kexp_busy = '0' else '1';
+
+    ct_sel_bit <= '1' when ct_rd_sel = 1 else '0';
 
     -- Interrupt output: active high when done and interrupts enabled
     done_irq <= done_flag and irq_enable;
 
-end architecture rtl;
\ No newline at end of file
+end architecture rtl;
@@ -0,0 +1,533 @@
+--------------------------------------------------------------------------------
+-- UART-to-AES Frame Bridge
+--
+-- Streaming parser for the version 2 host protocol (see src/main.c) that
+-- runs ECB frames against the controller without the MicroBlaze. Bytes come
+-- from the RX FIFO, responses go to the TX FIFO, and the controller is
+-- driven as an IO bus master with the same accesses the firmware makes.
+--
+-- Frames:
+--   [0xA5 SOF] [seq] [cmd] [len, 2 bytes LE] [len bytes payload]
+--   [CRC-16/CCITT-FALSE, 2 bytes LE over seq, cmd, len and payload]
+--
+--   PING (0x00):     -> [protocol version]
+--   ECB (0x01):      [16B key] + [16B plaintext], key goes to slot 0
+--                    -> [16B ciphertext] + [4B cycle count]
+--   KEY_LOAD (0x02): [16B key] + [key slot] -> [4B cycle count]
+--                    A slot of 4 or more is NAKed with reason 3.
+--   BRIDGE (0x0A):   [enable]
+--                    -> [4B frames] + [4B CRC errors] + [4B NAKs]
+--                    enable=0 hands the link back to the MicroBlaze once
+--                    the response has left the transmitter.
+--   BAUD (0x0B):     [4B baud rate] -> [4B baud rate]
+--                    The rate must be MCS_BAUD or one of BAUD_RATES
+--                    (uart.vhd) the clock can oversample, else NAK reason 3.
+--                    baud_set asks for the switch once the response is
+--                    queued; the host changes rate when it has the response.
+--   Any other known command is answered with NAK reason 4 (unsupported);
+--   bad CRC and bad length give NAK reasons 1 and 2 as in the firmware.
+--
+-- Streaming:
+--   Key and plaintext words are written to the controller's staging
+--   registers as their fourth byte arrives, so when the CRC checks out only
+--   the key load and start remain. The response header is queued while the
+--   block runs, the ciphertext words are read straight into the TX FIFO and
+--   the CRC is computed as the bytes are queued. With the TX FIFO holding a
+--   whole response the parser moves on to the next frame while the previous
+--   response is still on the line.
+--
+-- Byte Order:
+--   Words are packed with byte 0 in bits 7:0, which matches the controller
+--   with le_words=1 as set by the firmware at boot.
+--
+-- Resynchronisation:
+--   A header with an unknown cmd or oversized len is dropped and the parser
+--   looks for the next SOF after it. Unlike the firmware it does not rescan
+--   the four header bytes, which it no longer holds.
+--
+-- Counters (frames with a good CRC, CRC errors, NAKs sent) are cleared by
+-- clear_stats.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.uart_pkg.all;
+
+entity frame_bridge is
+    generic (
+        CLK_FREQ_HZ : positive := 125000000;
+        MCS_BAUD    : positive := 115200
+    );
+    port (
+        clk             : in  std_logic;
+        rst             : in  std_logic;
+        -- Held at SOF search while low
+        enable          : in  std_logic;
+        -- RX FIFO (first-word fall-through)
+        rx_data         : in  std_logic_vector(7 downto 0);
+        rx_valid        : in  std_logic;
+        rx_ready        : out std_logic;
+        -- TX FIFO
+        tx_data         : out std_logic_vector(7 downto 0);
+        tx_valid        : out std_logic;
+        tx_ready        : in  std_logic;
+        -- IO bus master to the controller
+        io_addr         : out std_logic_vector(31 downto 0);
+        io_write_data   : out std_logic_vector(31 downto 0);
+        io_read_data    : in  std_logic_vector(31 downto 0);
+        io_addr_strobe  : out std_logic;
+        io_write_strobe : out std_logic;
+        io_read_strobe  : out std_logic;
+        io_ready        : in  std_logic;
+        -- One-cycle pulse once a BRIDGE enable=0 response is queued
+        release         : out std_logic;
+        -- One-cycle pulse once a BAUD response is queued, with the new rate
+        baud_set        : out std_logic;
+        baud_inc        : out baud_inc_t;
+        baud_rate       : out unsigned(31 downto 0);
+        -- Statistics
+        clear_stats     : in  std_logic;
+        frames          : out unsigned(31 downto 0);
+        crc_errors      : out unsigned(31 downto 0);
+        naks            : out unsigned(31 downto 0)
+    );
+end entity frame_bridge;
+
+architecture rtl of frame_bridge is
+
+    constant FRAME_SOF        : std_logic_vector(7 downto 0) := x"A5";
+    constant PROTOCOL_VERSION : std_logic_vector(7 downto 0) := x"02";
+    constant MAX_PAYLOAD_SIZE : integer := 548;   -- Largest BATCH frame
+
+    constant CMD_PING     : std_logic_vector(7 downto 0) := x"00";
+    constant CMD_ECB      : std_logic_vector(7 downto 0) := x"01";
+    constant CMD_KEY_LOAD : std_logic_vector(7 downto 0) := x"02";
+    constant CMD_BRIDGE   : std_logic_vector(7 downto 0) := x"0A";
+    constant CMD_BAUD     : std_logic_vector(7 downto 0) := x"0B";
+    constant CMD_LAST     : std_logic_vector(7 downto 0) := x"0D";    -- CMAC
+    constant CMD_NAK_RESP : std_logic_vector(7 downto 0) := x"FF";
+
+    constant NAK_CRC         : std_logic_vector(7 downto 0) := x"01";
+    constant NAK_LENGTH      : std_logic_vector(7 downto 0) := x"02";
+    constant NAK_PARAM       : std_logic_vector(7 downto 0) := x"03";
+    constant NAK_UNSUPPORTED : std_logic_vector(7 downto 0) := x"04";
+
+    constant NUM_KEY_SLOTS : natural := 4;
+
+    -- Controller registers and control bits
+    constant REG_CT0        : natural := 16#20#;
+    constant REG_CTRL       : natural := 16#30#;
+    constant REG_KEYLOAD    : natural := 16#3C#;
+    constant CTRL_ECB_SLOT0 : std_logic_vector(31 downto 0) := x"00001001";  -- start, key slot 0
+    constant CTRL_POP_CLEAR : std_logic_vector(31 downto 0) := x"0000000A";  -- ct_pop, clear_done
+    constant STATUS_BUSY     : natural := 0;
+    constant STATUS_CT_VALID : natural := 3;
+
+    constant MCS_BAUD_INC   : baud_inc_t := baud_increment(MCS_BAUD, CLK_FREQ_HZ);
+    constant RATE_INCS      : baud_inc_array_t := baud_inc_table(CLK_FREQ_HZ);
+
+    type state_t is (
+        S_SOF, S_HDR, S_PAYLOAD, S_CRC, S_CHECK,   -- Request
+        S_BUS, S_EMIT,                              -- IO bus access, TX byte queueing
+        R_HDR, R_BODY, R_STATS, R_CRC, R_DONE,      -- Response
+        X_START, X_POLL, X_POLL_CHECK, X_READ, X_READ_EMIT, X_POP, X_COUNT  -- Controller
+    );
+    signal state    : state_t;
+    signal bus_ret  : state_t;
+    signal emit_ret : state_t;
+
+    type kind_t is (K_PING, K_ECB, K_KEYLOAD, K_BRIDGE, K_BAUD, K_NAK);
+    signal kind       : kind_t;
+    signal nak_reason : std_logic_vector(7 downto 0);
+    signal resp_len   : unsigned(15 downto 0);
+
+    -- Request
+    signal hdr_idx : integer range 0 to 3;
+    signal f_seq   : std_logic_vector(7 downto 0);
+    signal f_cmd   : std_logic_vector(7 downto 0);
+    signal f_len   : unsigned(15 downto 0);
+    signal idx     : unsigned(15 downto 0);      -- Payload byte index
+    signal word    : std_logic_vector(31 downto 0);
+    signal param0  : std_logic_vector(7 downto 0);
+    signal param16 : std_logic_vector(7 downto 0);
+    signal crc     : std_logic_vector(15 downto 0);
+    signal rx_crc  : std_logic_vector(15 downto 0);
+    signal crc_idx : integer range 0 to 1;
+
+    -- Response bytes are queued LSB first from out_word
+    signal out_word : std_logic_vector(31 downto 0);
+    signal out_left : integer range 0 to 4;
+    signal out_crc  : std_logic;
+
+    -- Controller access
+    signal bus_addr     : std_logic_vector(31 downto 0);
+    signal bus_wdata    : std_logic_vector(31 downto 0);
+    signal bus_strobe   : std_logic;
+    signal bus_write    : std_logic;
+    signal rd_word      : std_logic_vector(31 downto 0);
+    signal ct_idx       : integer range 0 to 3;
+    signal cnt_idx      : integer range 0 to 2;
+    signal elapsed      : unsigned(31 downto 0);
+    signal count_word   : std_logic_vector(31 downto 0);
+
+    signal release_pending : std_logic;
+    signal new_inc         : baud_inc_t;
+    signal new_rate        : std_logic_vector(31 downto 0);
+    signal frame_cnt : unsigned(31 downto 0);
+    signal crc_cnt   : unsigned(31 downto 0);
+    signal nak_cnt   : unsigned(31 downto 0);
+
+    -- CRC-16/CCITT-FALSE (poly 0x1021, MSB first)
+    function crc16_update(c_in : std_logic_vector(15 downto 0);
+                          byte : std_logic_vector(7 downto 0)) return std_logic_vector is
+        variable c : std_logic_vector(15 downto 0);
+    begin
+        c := c_in xor (byte & x"00");
+        for i in 0 to 7 loop
+            if c(15) = '1' then
+                c := (c(14 downto 0) & '0') xor x"1021";
+            else
+                c := c(14 downto 0) & '0';
+            end if;
+        end loop;
+        return c;
+    end function;
+
+begin
+
+    rx_ready <= '1' when enable = '1' and
+                         (state = S_SOF or state = S_HDR or state = S_PAYLOAD or state = S_CRC)
+                else '0';
+    tx_valid <= '1' when state = S_EMIT else '0';
+    tx_data  <= out_word(7 downto 0);
+
+    io_addr         <= bus_addr;
+    io_write_data   <= bus_wdata;
+    io_addr_strobe  <= bus_strobe;
+    io_write_strobe <= bus_strobe and bus_write;
+    io_read_strobe  <= bus_strobe and not bus_write;
+
+    baud_inc  <= new_inc;
+    baud_rate <= unsigned(new_rate);
+
+    frames     <= frame_cnt;
+    crc_errors <= crc_cnt;
+    naks       <= nak_cnt;
+
+    process(clk)
+        variable len        : unsigned(15 downto 0);
+        variable next_state : state_t;
+        variable inc        : baud_inc_t;
+
+        -- Strobe a controller access; the result is in rd_word at ret
+        procedure bus_access(addr : natural; data : std_logic_vector(31 downto 0);
+                             is_write : std_logic; ret : state_t) is
+        begin
+            bus_addr   <= std_logic_vector(to_unsigned(addr, 32));
+            bus_wdata  <= data;
+            bus_strobe <= '1';
+            bus_write  <= is_write;
+            bus_ret    <= ret;
+            state      <= S_BUS;
+        end procedure;
+
+        -- Queue the low n bytes of data, optionally into the response CRC
+        procedure emit(data : std_logic_vector(31 downto 0); n : positive;
+                       with_crc : std_logic; ret : state_t) is
+        begin
+            out_word <= data;
+            out_left <= n;
+            out_crc  <= with_crc;
+            emit_ret <= ret;
+            state    <= S_EMIT;
+        end procedure;
+
+    begin
+        if rising_edge(clk) then
+            bus_strobe <= '0';
+            release    <= '0';
+            baud_set   <= '0';
+            elapsed    <= elapsed + 1;
+
+            if clear_stats = '1' then
+                frame_cnt <= (others => '0');
+                crc_cnt   <= (others => '0');
+                nak_cnt   <= (others => '0');
+            end if;
+
+            if rst = '1' or enable = '0' then
+                state           <= S_SOF;
+                release_pending <= '0';
+                if rst = '1' then
+                    elapsed   <= (others => '0');
+                    frame_cnt <= (others => '0');
+                    crc_cnt   <= (others => '0');
+                    nak_cnt   <= (others => '0');
+                end if;
+            else
+                case state is
+
+                    -- Request ------------------------------------------------
+
+                    when S_SOF =>
+                        if rx_valid = '1' and rx_data = FRAME_SOF then
+                            crc     <= x"FFFF";
+                            hdr_idx <= 0;
+                            state   <= S_HDR;
+                        end if;
+
+                    when S_HDR =>
+                        if rx_valid = '1' then
+                            crc <= crc16_update(crc, rx_data);
+                            case hdr_idx is
+                                when 0 => f_seq <= rx_data;
+                                when 1 => f_cmd <= rx_data;
+                                when 2 => f_len(7 downto 0) <= rx_data;
+                                when 3 =>
+                                    len := unsigned(rx_data) & f_len(7 downto 0);
+                                    f_len   <= len;
+                                    idx     <= (others => '0');
+                                    crc_idx <= 0;
+                                    if unsigned(f_cmd) > unsigned(CMD_LAST) or len > MAX_PAYLOAD_SIZE then
+                                        state <= S_SOF;        -- False SOF
+                                    elsif len = 0 then
+                                        state <= S_CRC;
+                                    else
+                                        state <= S_PAYLOAD;
+                                    end if;
+                            end case;
+                            if hdr_idx < 3 then
+                                hdr_idx <= hdr_idx + 1;
+                            end if;
+                        end if;
+
+                    -- Key and plaintext words go to the staging registers as
+                    -- they complete (ECB: bytes 0-31 to 0x00-0x1C, KEY_LOAD:
+                    -- bytes 0-15 to 0x00-0x0C)
+                    when S_PAYLOAD =>
+                        if rx_valid = '1' then
+                            crc <= crc16_update(crc, rx_data);
+                            case to_integer(idx(1 downto 0)) is
+                                when 0 => word(7 downto 0)   <= rx_data;
+                                when 1 => word(15 downto 8)  <= rx_data;
+                                when 2 => word(23 downto 16) <= rx_data;
+                                when others => word(31 downto 24) <= rx_data;
+                            end case;
+                            if idx = 0 then
+                                param0 <= rx_data;
+                            end if;
+                            if idx = 16 then
+                                param16 <= rx_data;
+                            end if;
+                            idx <= idx + 1;
+
+                            if idx = f_len - 1 then
+                                next_state := S_CRC;
+                            else
+                                next_state := S_PAYLOAD;
+                            end if;
+
+                            if idx(1 downto 0) = "11" and
+                               ((f_cmd = CMD_ECB and idx < 32) or (f_cmd = CMD_KEY_LOAD and idx < 16)) then
+                                bus_access(to_integer(idx(4 downto 2)) * 4,
+                                           rx_data & word(23 downto 0), '1', next_state);
+                            else
+                                state <= next_state;
+                            end if;
+                        end if;
+
+                    when S_CRC =>
+                        if rx_valid = '1' then
+                            if crc_idx = 0 then
+                                rx_crc(7 downto 0) <= rx_data;
+                                crc_idx <= 1;
+                            else
+                                rx_crc(15 downto 8) <= rx_data;
+                                state <= S_CHECK;
+                            end if;
+                        end if;
+
+                    when S_CHECK =>
+                        kind <= K_NAK;
+                        resp_len <= to_unsigned(2, 16);
+                        if rx_crc /= crc then
+                            crc_cnt    <= crc_cnt + 1;
+                            nak_reason <= NAK_CRC;
+                        else
+                            frame_cnt  <= frame_cnt + 1;
+                            nak_reason <= NAK_LENGTH;
+                            if f_cmd = CMD_PING then
+                                kind     <= K_PING;
+                                resp_len <= to_unsigned(1, 16);
+                            elsif f_cmd = CMD_ECB then
+                                if f_len = 32 then
+                                    kind     <= K_ECB;
+                                    resp_len <= to_unsigned(20, 16);
+                                end if;
+                            elsif f_cmd = CMD_KEY_LOAD then
+                                if f_len = 17 then
+                                    if unsigned(param16) >= NUM_KEY_SLOTS then
+                                        nak_reason <= NAK_PARAM;
+                                    else
+                                        kind     <= K_KEYLOAD;
+                                        resp_len <= to_unsigned(4, 16);
+                                    end if;
+                                end if;
+                            elsif f_cmd = CMD_BRIDGE then
+                                if f_len = 1 then
+                                    kind     <= K_BRIDGE;
+                                    resp_len <= to_unsigned(12, 16);
+                                end if;
+                            elsif f_cmd = CMD_BAUD then
+                                -- The four payload bytes are still in word
+                                if f_len = 4 then
+                                    inc := (others => '0');
+                                    if unsigned(word) = MCS_BAUD then
+                                        inc := MCS_BAUD_INC;
+                                    end if;
+                                    for i in BAUD_RATES'range loop
+                                        if unsigned(word) = BAUD_RATES(i) then
+                                            inc := RATE_INCS(i);
+                                        end if;
+                                    end loop;
+                                    new_inc  <= inc;
+                                    new_rate <= word;
+                                    if inc = 0 then
+                                        nak_reason <= NAK_PARAM;
+                                    else
+                                        kind     <= K_BAUD;
+                                        resp_len <= to_unsigned(4, 16);
+                                    end if;
+                                end if;
+                            else
+                                nak_reason <= NAK_UNSUPPORTED;
+                            end if;
+                        end if;
+                        emit(x"000000" & FRAME_SOF, 1, '0', R_HDR);
+
+                    -- Response -----------------------------------------------
+
+                    when R_HDR =>
+                        crc <= x"FFFF";
+                        if kind = K_NAK then
+                            emit(std_logic_vector(resp_len) & CMD_NAK_RESP & f_seq, 4, '1', R_BODY);
+                        else
+                            emit(std_logic_vector(resp_len) & (f_cmd or x"80") & f_seq, 4, '1', R_BODY);
+                        end if;
+
+                    when R_BODY =>
+                        case kind is
+                            when K_PING =>
+                                emit(x"000000" & PROTOCOL_VERSION, 1, '1', R_CRC);
+                            when K_NAK =>
+                                emit(x"0000" & f_cmd & nak_reason, 2, '1', R_CRC);
+                            when K_BAUD =>
+                                emit(new_rate, 4, '1', R_CRC);
+                            when K_BRIDGE =>
+                                cnt_idx <= 0;
+                                release_pending <= not param0(0);
+                                state <= R_STATS;
+                            when K_ECB =>
+                                bus_access(REG_KEYLOAD, x"00000000", '1', X_START);
+                            when K_KEYLOAD =>
+                                elapsed <= (others => '0');
+                                bus_access(REG_KEYLOAD, x"000000" & "000000" & param16(1 downto 0),
+                                           '1', X_POLL);
+                        end case;
+
+                    when R_STATS =>
+                        case cnt_idx is
+                            when 0 =>
+                                cnt_idx <= 1;
+                                emit(std_logic_vector(frame_cnt), 4, '1', R_STATS);
+                            when 1 =>
+                                cnt_idx <= 2;
+                                emit(std_logic_vector(crc_cnt), 4, '1', R_STATS);
+                            when 2 =>
+                                emit(std_logic_vector(nak_cnt), 4, '1', R_CRC);
+                        end case;
+
+                    when R_CRC =>
+                        emit(x"0000" & crc, 2, '0', R_DONE);
+
+                    when R_DONE =>
+                        if kind = K_NAK then
+                            nak_cnt <= nak_cnt + 1;
+                        end if;
+                        if release_pending = '1' then
+                            release <= '1';
+                            release_pending <= '0';
+                        end if;
+                        if kind = K_BAUD then
+                            baud_set <= '1';
+                        end if;
+                        state <= S_SOF;
+
+                    -- Controller ---------------------------------------------
+
+                    when X_START =>
+                        elapsed <= (others => '0');
+                        bus_access(REG_CTRL, CTRL_ECB_SLOT0, '1', X_POLL);
+
+                    when X_POLL =>
+                        bus_access(REG_CTRL, x"00000000", '0', X_POLL_CHECK);
+
+                    -- ECB waits for the result, KEY_LOAD for the expansion
+                    when X_POLL_CHECK =>
+                        state <= X_POLL;
+                        if kind = K_ECB and rd_word(STATUS_CT_VALID) = '1' then
+                            count_word <= std_logic_vector(elapsed);
+                            ct_idx <= 0;
+                            state  <= X_READ;
+                        elsif kind = K_KEYLOAD and rd_word(STATUS_BUSY) = '0' then
+                            count_word <= std_logic_vector(elapsed);
+                            state  <= X_COUNT;
+                        end if;
+
+                    when X_READ =>
+                        bus_access(REG_CT0 + 4*ct_idx, x"00000000", '0', X_READ_EMIT);
+
+                    when X_READ_EMIT =>
+                        if ct_idx = 3 then
+                            emit(rd_word, 4, '1', X_POP);
+                        else
+                            ct_idx <= ct_idx + 1;
+                            emit(rd_word, 4, '1', X_READ);
+                        end if;
+
+                    when X_POP =>
+                        bus_access(REG_CTRL, CTRL_POP_CLEAR, '1', X_COUNT);
+
+                    when X_COUNT =>
+                        emit(count_word, 4, '1', R_CRC);
+
+                    -- Shared -------------------------------------------------
+
+                    -- The strobe is on the bus for this one cycle
+                    when S_BUS =>
+                        if io_ready = '1' then
+                            rd_word <= io_read_data;
+                            state   <= bus_ret;
+                        end if;
+
+                    when S_EMIT =>
+                        if tx_ready = '1' then
+                            if out_crc = '1' then
+                                crc <= crc16_update(crc, out_word(7 downto 0));
+                            end if;
+                            out_word <= x"00" & out_word(31 downto 8);
+                            if out_left = 1 then
+                                state <= emit_ret;
+                            else
+                                out_left <= out_left - 1;
+                            end if;
+                        end if;
+
+                end case;
+            end if;
+        end if;
+    end process;
+
+end architecture rtl;
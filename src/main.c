@@ -2,25 +2,163 @@
  * MicroBlaze AES-128 Encryption Benchmark
  *
  * UART-controlled AES-128 encryption using custom hardware accelerator.
- * Supports both polled and interrupt-driven modes.
+ * Supports both polled and interrupt-driven modes for the AES core. The UART
+ * is always interrupt-driven through RX/TX ring buffers, so reception,
+ * computation and transmission overlap.
  *
- * Protocol (UART @ 115200 baud):
- *   Input:  [16 bytes key] + [16 bytes plaintext] + [0xFF 0xFF] = 34 bytes
- *   Output: [16 bytes ciphertext] + [4 bytes cycle count] = 20 bytes
+ * Protocol (UART @ 115200 baud, version 2):
+ *   Requests and responses use the same length-prefixed frame:
+ *     [0xA5 SOF] [seq] [cmd] [len, 2 bytes LE] [len bytes payload]
+ *     [CRC-16, 2 bytes LE]
+ *   The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over seq, cmd,
+ *   len and payload. A response echoes the request's seq with cmd | 0x80, so
+ *   the host can keep several requests in flight and match the answers. A
+ *   frame with a bad CRC is answered with NAK; a header with an unknown cmd,
+ *   or a len that cmd never takes, is taken as a false SOF and skipped.
+ *   Either way the parser resumes one byte after the SOF.
+ *
+ *   PING (0x00):     payload none
+ *                    -> [protocol version]
+ *   ECB (0x01):      payload [16B key] + [16B plaintext], key goes to slot 0
+ *                    -> [16B ciphertext] + [4B cycle count]
+ *   KEY_LOAD (0x02): payload [16B key] + [key slot]
+ *                    -> [4B cycle count]
+ *   CTR (0x03):      payload [key slot] + [12B nonce] +
+ *                    [4B initial counter, big-endian] + [4B block count N]
+ *                    -> [N x 16B keystream] + [4B cycle count]
+ *                    Keystream block i is AES_K(nonce || counter + i)
+ *                    (32-bit counter, wrapping); the host XORs it with its
+ *                    data. N is at most CTR_MAX_BLOCKS.
+ *   BATCH (0x04):    payload [mode] + [key slot] + [flags] + [reserved] +
+ *                    [16B IV] + [16B key, if flags bit0] + [N x 16B data]
+ *                    mode: 0=ECB encrypt, 1=ECB decrypt, 2=CBC encrypt,
+ *                          3=CBC decrypt
+ *                    flags: bit0=load the inline key into the slot first
+ *                    -> [N x 16B result] + [4B cycle count]
+ *                    N is at most BATCH_MAX_BLOCKS.
+ *   MCT (0x05):      payload [mode] + [key slot] + [2B iterations] + [16B IV] +
+ *                    [16B key] + [16B text]
+ *                    -> [iterations x ([16B result] + [16B next text])] +
+ *                    [4B cycle count]
+ *                    AESAVS Monte Carlo Test run on the board: each
+ *                    iteration chains MCT_INNER_BLOCKS blocks (ECB: the
+ *                    output is the next input; CBC: the IV, then the output
+ *                    before last), then XORs the last output into the key
+ *                    (and IV for CBC). result is that last output, next text
+ *                    the first input of the following iteration. mode as for
+ *                    BATCH; iterations is at most MCT_MAX_ITERATIONS.
+ *   BENCH (0x06):    payload [4B block count N] + [key slot]
+ *                    -> [BENCH_VARIANTS x 4B cycle count]
+ *                    On-board benchmark with no UART in the loop: N blocks
+ *                    from a BRAM buffer through each variant in turn:
+ *                    0=polled (write, start, poll, read), 1=interrupt
+ *                    (wait for the done interrupt), 2=queued (starts kept
+ *                    ahead through the command queue), 3=plaintext register
+ *                    writes only, 4=ciphertext register reads only.
+ *                    N is at most BENCH_MAX_BLOCKS.
+ *   STATS (0x07):    payload none
+ *                    -> [seq] + [cmd] + [2B valid mask] + [PHASE_COUNT x 4B
+ *                    PIT1 stamps] + [4B frames averaged] +
+ *                    [PHASE_COUNT - 1 x 4B average cycles between phases] +
+ *                    [4B RX overruns]
+ *                    Phase timestamps of the last frame before this one
+ *                    (bit i of the mask set if phase i was stamped), and the
+ *                    average time between consecutive phases over the frames
+ *                    that stamped every phase (ECB frames) since the last
+ *                    STATS. Phases, in ECB order: 0=SOF received, 1=key
+ *                    written, 2=plaintext written, 3=frame verified,
+ *                    4=start, 5=done, 6=ciphertext read, 7=last response
+ *                    byte queued. PIT1 counts down. RX overruns counts
+ *                    the bytes dropped on a full UART RX ring since reset.
+ *   KEY_STORE (0x08): payload [16B key] + [key id]
+ *                    -> [4B cycle count]
+ *                    Stores the key under id (below KEY_CACHE_IDS) in the
+ *                    firmware key table and expands it into a key slot.
+ *   ECB_ID (0x09):   payload [16B plaintext] + [key id]
+ *                    -> [16B ciphertext] + [4B cycle count]
+ *                    ECB block with a stored key. Ids keep the key slots
+ *                    they were expanded into, so a block on a resident id
+ *                    writes no key and waits for no expansion; otherwise the
+ *                    key goes to a free slot or the least recently used id's.
+ *                    Slots loaded by KEY_LOAD, BATCH or MCT are taken last.
+ *   BRIDGE (0x0A):   payload [enable]
+ *                    -> [4B frames] + [4B CRC errors] + [4B NAKs]
+ *                    Counters of the hardware frame bridge's last session.
+ *                    enable=1 then hands the UART link to the bridge, which
+ *                    answers PING, ECB and KEY_LOAD frames in fabric at line
+ *                    rate (see src/aes_bridge.vhd) until a BRIDGE frame with
+ *                    enable=0 hands it back. NAKed with reason 3 when the
+ *                    design has no bridge.
+ *   BAUD (0x0B):     payload [4B baud rate]
+ *                    -> [4B baud rate]
+ *                    Line rate negotiation. The MCS UART rate is fixed by
+ *                    the block design, so the firmware only accepts its own
+ *                    rate (NAK reason 3 otherwise). The frame bridge also
+ *                    accepts rates up to 12 Mbaud and switches once the
+ *                    response is sent; the host follows when it has it.
+ *   XTS (0x0C):      payload [direction] + [key slot] + [tweak key slot] +
+ *                    [reserved] + [16B data unit number] + [L bytes data]
+ *                    -> [L bytes result] + [4B cycle count]
+ *                    IEEE 1619 XTS-AES-128 over one data unit: direction
+ *                    0=encrypt, 1=decrypt; the data unit number is the
+ *                    tweak, little-endian. L is 16 to XTS_MAX_SIZE and need
+ *                    not be whole blocks: a final partial block is handled
+ *                    with ciphertext stealing.
+ *   CMAC (0x0D):     payload [key slot] + [L bytes message]
+ *                    -> [16B tag] + [4B cycle count]
+ *                    RFC 4493 AES-CMAC of the message under the slot's key.
+ *                    L is 0 to CMAC_MAX_SIZE. The core derives the subkeys
+ *                    once per key load; the firmware pads a final partial
+ *                    (or empty) block and marks it so K2 is used.
+ *   NAK (0x7F):      response only (cmd 0xFF), payload [reason] + [request cmd]
+ *                    reason: 1=bad CRC, 2=bad length, 3=bad parameter,
+ *                    4=unsupported (frame bridge only)
+ *
+ *   Multi-byte fields are little-endian unless noted. Cycle counts of CTR,
+ *   BATCH and XTS span the whole request, UART transmission included; the
+ *   MCT, BENCH and CMAC counts cover the on-board loops only.
  *
  * Hardware Register Map (relative to IO_BASE):
- *   0x00-0x0C : Key[127:0]        (4 words, write-only)
+ *   0x00-0x0C : Key[127:0]        (4 words, write-only, staging for key load)
  *   0x10-0x1C : Plaintext[127:0]  (4 words, write-only)
- *   0x20-0x2C : Ciphertext[127:0] (4 words, read-only)
+ *   0x20-0x2C : Ciphertext[127:0] (4 words, read-only, double-buffered)
  *   0x30      : Control/Status
- *               Write: bit0=start, bit1=clear_done, bit2=irq_enable
- *               Read:  bit0=busy, bit1=done, bit2=irq_enable
+ *               Write: bit0=start, bit1=clear_done, bit2=irq_enable,
+ *                      bit3=ct_pop, bit4=decrypt, bit5=last, bit6=partial,
+ *                      bit7=steal, bits9:8=context,
+ *                      bits11:10=key slot, bit12=use key slot,
+ *                      bit13=clear_overflow
+ *               Read:  bit0=busy, bit1=done, bit2=irq_enable,
+ *                      bit3=ct_valid, bit4=ct_sel, bit5=ct_pending,
+ *                      bits7:6=ct_ctx, bit8=queue_full, bits11:9=queue_level,
+ *                      bit12=key_expanding, bit13=queue_overflow
+ *   0x34      : Config
+ *               bit0=le_words (byte-swap data words for little-endian CPUs)
+ *   0x38      : Context setup (queued)
+ *               bits1:0=context, bits3:2=mode (00=ECB, 01=CMAC, 10=XTS, 11=CBC),
+ *               bits5:4=key slot, bits7:6=tweak key slot, bit8=load chain
+ *   0x3C      : Key load (queued), bits1:0=key slot
+ *   0x50-0x5C : IV/Tweak[127:0]   (CBC IV / XTS data unit number, write-only)
+ *   0x60      : Frame bridge control/status (aes_bridge.vhd only)
+ *               Write: bit0=enable
+ *               Read:  bit0=enable, bit1=link_active, bit31=present
+ *   0x64-0x70 : Frame bridge frames, CRC errors, NAKs, RX overruns
+ *   0x74      : Frame bridge line rate in baud
+ *
+ * Starts, context setups and key loads go through a 4-entry command queue;
+ * a push into a full queue is held on the bus until an entry frees, or
+ * dropped with queue_overflow set if the queue can only drain after a
+ * ct_pop. The firmware checks queue_full before every start it keeps ahead.
+ * Key loads expand in the background while blocks on other key slots keep
+ * running.
  */
 
 #include "xiomodule.h"
 #include "xiomodule_l.h"
 #include "xil_printf.h"
 #include "xparameters.h"
+#include "xil_exception.h"
+#include "mb_interface.h"
 #include <stdint.h>
 
 /* ============================================================================
@@ -43,24 +181,193 @@
 #define AES_CT2_OFFSET      0x28
 #define AES_CT3_OFFSET      0x2C
 #define AES_CTRL_OFFSET     0x30
+#define AES_CFG_OFFSET      0x34
+#define AES_CTX_OFFSET      0x38
+#define AES_KEYLOAD_OFFSET  0x3C
+#define AES_IV0_OFFSET      0x50
+#define AES_BRIDGE_OFFSET   0x60
+#define AES_BRIDGE_FRAMES   0x64
+#define AES_BRIDGE_CRC_ERRS 0x68
+#define AES_BRIDGE_NAKS     0x6C
 
 /* Control register bits */
 #define AES_CTRL_START      0x01
 #define AES_CTRL_CLR_DONE   0x02
 #define AES_CTRL_IRQ_EN     0x04
+#define AES_CTRL_CT_POP     0x08
+#define AES_CTRL_DECRYPT    0x10
+#define AES_CTRL_LAST       0x20
+#define AES_CTRL_PARTIAL    0x40
+#define AES_CTRL_STEAL      0x80
+#define AES_CTRL_CTX(n)     ((uint32_t)(n) << 8)
+#define AES_CTRL_KSLOT(n)   (0x1000 | ((uint32_t)(n) << 10))
 #define AES_STATUS_BUSY     0x01
 #define AES_STATUS_DONE     0x02
+#define AES_STATUS_CT_VALID 0x08
+#define AES_STATUS_CT_SEL   0x10
+#define AES_STATUS_CT_PEND  0x20
+#define AES_STATUS_Q_FULL   0x100
+#define AES_STATUS_KEXP     0x1000
+#define AES_BRIDGE_ENABLE   0x01
+#define AES_BRIDGE_PRESENT  0x80000000u
+#define AES_CFG_LE_WORDS    0x01
+#define AES_MODE_ECB        0
+#define AES_MODE_CMAC       1
+#define AES_MODE_XTS        2
+#define AES_MODE_CBC        3
+#define AES_CTX_SETUP(ctx, mode, kslot, tslot) \
+    ((uint32_t)(ctx) | ((uint32_t)(mode) << 2) | ((uint32_t)(kslot) << 4) | \
+     ((uint32_t)(tslot) << 6))
+#define AES_CTX_LOAD_CHAIN  0x100
+#define AES_KEY_SLOT        0   /* Key slot used by the benchmark */
 
 /* Protocol constants */
-#define FRAME_MARKER_LO     0xFF
-#define FRAME_MARKER_HI     0xFF
+#define PROTOCOL_VERSION    2
+#define FRAME_SOF           0xA5
+#define FRAME_HEADER_SIZE   5           /* SOF, seq, cmd, len */
+#define FRAME_CRC_SIZE      2
 #define KEY_SIZE            16
 #define BLOCK_SIZE          16
-#define FRAME_SIZE          (KEY_SIZE + BLOCK_SIZE + 2)  /* 34 bytes */
+
+/* Commands (responses set CMD_RESPONSE) */
+#define CMD_PING            0x00
+#define CMD_ECB             0x01
+#define CMD_KEY_LOAD        0x02
+#define CMD_CTR             0x03
+#define CMD_BATCH           0x04
+#define CMD_MCT             0x05
+#define CMD_BENCH           0x06
+#define CMD_STATS           0x07
+#define CMD_KEY_STORE       0x08
+#define CMD_ECB_ID          0x09
+#define CMD_BRIDGE          0x0A
+#define CMD_BAUD            0x0B
+#define CMD_XTS             0x0C
+#define CMD_CMAC            0x0D
+#define CMD_NAK             0x7F
+#define CMD_RESPONSE        0x80
+
+/* NAK reasons */
+#define NAK_CRC             0x01
+#define NAK_LENGTH          0x02
+#define NAK_PARAM           0x03
+
+/* CTR payload offsets */
+#define CTR_PAYLOAD_SIZE    21
+#define CTR_SLOT_OFFSET     0
+#define CTR_NONCE_OFFSET    1
+#define CTR_COUNTER_OFFSET  13
+#define CTR_COUNT_OFFSET    17
+#define CTR_MAX_BLOCKS      4095        /* Response fits the 16-bit length */
+
+/* Key load payload offsets */
+#define KEYLOAD_PAYLOAD_SIZE (KEY_SIZE + 1)
+#define KEYLOAD_SLOT_OFFSET 16
+
+/* Key cache payloads: KEY_STORE [key] [id], ECB_ID [plaintext] [id] */
+#define KEY_STORE_PAYLOAD_SIZE (KEY_SIZE + 1)
+#define KEY_STORE_ID_OFFSET  16
+#define ECB_ID_PAYLOAD_SIZE  (BLOCK_SIZE + 1)
+#define ECB_ID_ID_OFFSET     16
+#define KEY_CACHE_IDS        16
+#define KEY_OWNER_NONE       0xFF       /* Slot holds no stored key */
+#define KEY_OWNER_HOST       0xFE       /* Slot loaded by KEY_LOAD, BATCH or MCT */
+
+/* Frame bridge payload and response */
+#define BRIDGE_PAYLOAD_SIZE  1
+#define BRIDGE_RESPONSE_SIZE 12
+
+/* Line rate negotiation: BAUD [4B rate] -> [4B rate] */
+#define BAUD_PAYLOAD_SIZE    4
+#define BAUD_RESPONSE_SIZE   4
+#define MCS_UART_BAUD        XPAR_IOMODULE_0_UART_BAUDRATE
+
+/* Batch payload offsets and fields */
+#define BATCH_MODE_OFFSET    0
+#define BATCH_SLOT_OFFSET    1
+#define BATCH_FLAGS_OFFSET   2
+#define BATCH_IV_OFFSET      4
+#define BATCH_HEADER_SIZE    20
+#define BATCH_MODE_ECB_ENC   0
+#define BATCH_MODE_ECB_DEC   1
+#define BATCH_MODE_CBC_ENC   2
+#define BATCH_MODE_CBC_DEC   3
+#define BATCH_FLAG_KEY       0x01
+#define BATCH_MAX_BLOCKS     32
+#define BATCH_CTX            1          /* Context used for batches */
+
+/* MCT payload: [mode] [key slot] [iterations16] [IV] [key] [text] */
+#define MCT_MODE_OFFSET      0
+#define MCT_SLOT_OFFSET      1
+#define MCT_ITER_OFFSET      2
+#define MCT_IV_OFFSET        4
+#define MCT_KEY_OFFSET       20
+#define MCT_TEXT_OFFSET      36
+#define MCT_PAYLOAD_SIZE     52
+#define MCT_MAX_ITERATIONS   100        /* AESAVS outer loop */
+#define MCT_INNER_BLOCKS     1000       /* AESAVS inner loop */
+#define MCT_CTX              2          /* Context used for the MCT */
+
+/* XTS payload: [direction] [key slot] [tweak key slot] [reserved] [tweak] [data] */
+#define XTS_DIR_OFFSET       0
+#define XTS_SLOT_OFFSET      1
+#define XTS_TSLOT_OFFSET     2
+#define XTS_TWEAK_OFFSET     4
+#define XTS_HEADER_SIZE      20
+#define XTS_DIR_ENCRYPT      0
+#define XTS_DIR_DECRYPT      1
+#define XTS_MAX_SIZE         (BATCH_MAX_BLOCKS * BLOCK_SIZE)   /* A 512-byte sector */
+#define XTS_CTX              3          /* Context used for XTS */
+
+/* CMAC payload: [key slot] [message] */
+#define CMAC_SLOT_OFFSET     0
+#define CMAC_MSG_OFFSET      1
+#define CMAC_MAX_SIZE        (BATCH_MAX_BLOCKS * BLOCK_SIZE)
+#define CMAC_PAD             0x80       /* First padding byte, then zeros */
+#define CMAC_CTX             3          /* Context used for CMAC (as XTS) */
+
+/* BENCH payload: [block count32] [key slot] */
+#define BENCH_COUNT_OFFSET   0
+#define BENCH_SLOT_OFFSET    4
+#define BENCH_PAYLOAD_SIZE   5
+#define BENCH_MAX_BLOCKS     (1u << 20)
+#define BENCH_BUFFER_BLOCKS  64         /* BRAM source, encrypted in place */
+#define BENCH_POLLED         0
+#define BENCH_INTERRUPT      1
+#define BENCH_QUEUED         2
+#define BENCH_WRITE_ONLY     3
+#define BENCH_READ_ONLY      4
+#define BENCH_VARIANTS       5
+
+/* Per-frame phase timestamps (STATS) */
+#define PHASE_RX_FIRST       0          /* SOF received (RX ISR) */
+#define PHASE_KEY            1          /* Last key word written */
+#define PHASE_PT             2          /* Last plaintext word written */
+#define PHASE_RX_LAST        3          /* Frame verified */
+#define PHASE_START          4
+#define PHASE_DONE           5
+#define PHASE_CT             6          /* Ciphertext read */
+#define PHASE_TX_LAST        7          /* Last response byte queued */
+#define PHASE_COUNT          8
+#define PHASE_ALL            ((1u << PHASE_COUNT) - 1)
+#define STATS_RESPONSE_SIZE  (4 + PHASE_COUNT * 4 + 4 + (PHASE_COUNT - 1) * 4 + 4)
+#define UART_SOF_STAMPS      8          /* SOF arrival times awaiting the parser */
+
+/* Largest payload accepted (a batch with inline key) */
+#define MAX_PAYLOAD_SIZE    (BATCH_HEADER_SIZE + KEY_SIZE + BATCH_MAX_BLOCKS * BLOCK_SIZE)
+
+#define AES_NUM_KEY_SLOTS   4
 
 /* Mode selection: 0 = polled, 1 = interrupt-driven */
 #define USE_INTERRUPTS      0
 
+/* 1 = take PIT1 timestamps of each frame's phases for STATS */
+#define PHASE_STAMPS        1
+
+/* UART ring buffer sizes (powers of two) */
+#define UART_RX_RING_SIZE   1024        /* Holds a maximum-size frame */
+#define UART_TX_RING_SIZE   1024
+
 /* External interrupt number for AES done signal */
 /* Connect done_irq to INTC external interrupt input 0 (bit 16) */
 #define AES_INTR_ID         XIN_IOMODULE_EXTERNAL_INTERRUPT_INTR
@@ -70,64 +377,125 @@
  * ============================================================================ */
 static XIOModule iomodule;
 static volatile int aes_done_flag = 0;
+/* irq_enable is rewritten by every control write, so keep it in a shadow */
+static uint32_t aes_ctrl_irq_en = 0;
+
+/*
+ * UART rings. Head/tail are free-running; each index is written only by its
+ * producer (RX: ISR head, main tail; TX: main head, ISR tail).
+ */
+static volatile uint8_t uart_rx_ring[UART_RX_RING_SIZE];
+static volatile uint32_t uart_rx_head = 0;
+static volatile uint32_t uart_rx_tail = 0;
+static volatile uint32_t uart_rx_overruns = 0;
+static volatile uint8_t uart_tx_ring[UART_TX_RING_SIZE];
+static volatile uint32_t uart_tx_head = 0;
+static volatile uint32_t uart_tx_tail = 0;
+static volatile int uart_tx_active = 0;  /* A byte is in the transmitter */
+
+/*
+ * Phase timestamps. The RX ISR stamps every SOF byte with its ring position,
+ * so the parser can date a frame's first byte even when it reaches the
+ * frame long after it arrived.
+ */
+#if PHASE_STAMPS
+static volatile uint32_t uart_sof_pos[UART_SOF_STAMPS];
+static volatile uint32_t uart_sof_cycles[UART_SOF_STAMPS];
+static volatile uint32_t uart_sof_count = 0;
+#endif
+static uint32_t phase_cycles[PHASE_COUNT];      /* Frame being handled */
+static uint32_t phase_valid = 0;
+static uint32_t phase_last[PHASE_COUNT];        /* Last completed frame */
+static uint32_t phase_last_valid = 0;
+static uint8_t phase_last_seq = 0;
+static uint8_t phase_last_cmd = 0;
+static uint64_t phase_sum[PHASE_COUNT - 1];     /* Over frames with every phase */
+static uint32_t phase_frames = 0;
+
+/*
+ * Key cache. key_slot_owner[] records the stored id each key slot was
+ * expanded from, so blocks on a resident id skip the key writes and the
+ * expansion; key_slot_used[] orders the slots for eviction.
+ */
+static uint32_t key_cache[KEY_CACHE_IDS][KEY_SIZE / 4];
+static uint32_t key_cache_valid = 0;    /* Bit per stored id */
+static uint8_t key_slot_owner[AES_NUM_KEY_SLOTS] = {
+    KEY_OWNER_NONE, KEY_OWNER_NONE, KEY_OWNER_NONE, KEY_OWNER_NONE
+};
+static uint32_t key_slot_used[AES_NUM_KEY_SLOTS];
+static uint32_t key_slot_clock = 0;
 
 /* ============================================================================
  * AES Hardware Interface Functions
  * ============================================================================ */
 
-static void aes_write_key(const uint8_t *key) {
-    /* AES uses big-endian byte order within words */
-    uint32_t w0 = (key[0]  << 24) | (key[1]  << 16) | (key[2]  << 8) | key[3];
-    uint32_t w1 = (key[4]  << 24) | (key[5]  << 16) | (key[6]  << 8) | key[7];
-    uint32_t w2 = (key[8]  << 24) | (key[9]  << 16) | (key[10] << 8) | key[11];
-    uint32_t w3 = (key[12] << 24) | (key[13] << 16) | (key[14] << 8) | key[15];
+/*
+ * The core runs with le_words set, so a block is exchanged as four native
+ * (little-endian) words holding the bytes in wire order. Buffers passed here
+ * must be 4-byte aligned.
+ */
+static void aes_write_key(const uint32_t *key) {
+    XIOModule_IoWriteWord(&iomodule, AES_KEY0_OFFSET, key[0]);
+    XIOModule_IoWriteWord(&iomodule, AES_KEY1_OFFSET, key[1]);
+    XIOModule_IoWriteWord(&iomodule, AES_KEY2_OFFSET, key[2]);
+    XIOModule_IoWriteWord(&iomodule, AES_KEY3_OFFSET, key[3]);
+}
+
+/* Expand the staged key into a slot; whatever id it held is gone */
+static void aes_load_key(uint32_t slot) {
+    XIOModule_IoWriteWord(&iomodule, AES_KEYLOAD_OFFSET, slot);
+    key_slot_owner[slot] = KEY_OWNER_NONE;
+}
 
-    XIOModule_IoWriteWord(&iomodule, AES_KEY0_OFFSET, w0);
-    XIOModule_IoWriteWord(&iomodule, AES_KEY1_OFFSET, w1);
-    XIOModule_IoWriteWord(&iomodule, AES_KEY2_OFFSET, w2);
-    XIOModule_IoWriteWord(&iomodule, AES_KEY3_OFFSET, w3);
+static void aes_write_plaintext(const uint32_t *pt) {
+    XIOModule_IoWriteWord(&iomodule, AES_PT0_OFFSET, pt[0]);
+    XIOModule_IoWriteWord(&iomodule, AES_PT1_OFFSET, pt[1]);
+    XIOModule_IoWriteWord(&iomodule, AES_PT2_OFFSET, pt[2]);
+    XIOModule_IoWriteWord(&iomodule, AES_PT3_OFFSET, pt[3]);
 }
 
-static void aes_write_plaintext(const uint8_t *pt) {
-    /* AES uses big-endian byte order within words */
-    uint32_t w0 = (pt[0]  << 24) | (pt[1]  << 16) | (pt[2]  << 8) | pt[3];
-    uint32_t w1 = (pt[4]  << 24) | (pt[5]  << 16) | (pt[6]  << 8) | pt[7];
-    uint32_t w2 = (pt[8]  << 24) | (pt[9]  << 16) | (pt[10] << 8) | pt[11];
-    uint32_t w3 = (pt[12] << 24) | (pt[13] << 16) | (pt[14] << 8) | pt[15];
+static void aes_read_ciphertext(uint32_t *ct) {
+    ct[0] = XIOModule_IoReadWord(&iomodule, AES_CT0_OFFSET);
+    ct[1] = XIOModule_IoReadWord(&iomodule, AES_CT1_OFFSET);
+    ct[2] = XIOModule_IoReadWord(&iomodule, AES_CT2_OFFSET);
+    ct[3] = XIOModule_IoReadWord(&iomodule, AES_CT3_OFFSET);
+
+    /* Release the output buffer so the core can retire the next block into it */
+    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, AES_CTRL_CT_POP | aes_ctrl_irq_en);
+}
 
-    XIOModule_IoWriteWord(&iomodule, AES_PT0_OFFSET, w0);
-    XIOModule_IoWriteWord(&iomodule, AES_PT1_OFFSET, w1);
-    XIOModule_IoWriteWord(&iomodule, AES_PT2_OFFSET, w2);
-    XIOModule_IoWriteWord(&iomodule, AES_PT3_OFFSET, w3);
+static void aes_write_iv(const uint32_t *iv) {
+    XIOModule_IoWriteWord(&iomodule, AES_IV0_OFFSET + 0x0, iv[0]);
+    XIOModule_IoWriteWord(&iomodule, AES_IV0_OFFSET + 0x4, iv[1]);
+    XIOModule_IoWriteWord(&iomodule, AES_IV0_OFFSET + 0x8, iv[2]);
+    XIOModule_IoWriteWord(&iomodule, AES_IV0_OFFSET + 0xC, iv[3]);
 }
 
-static void aes_read_ciphertext(uint8_t *ct) {
-    uint32_t w0 = XIOModule_IoReadWord(&iomodule, AES_CT0_OFFSET);
-    uint32_t w1 = XIOModule_IoReadWord(&iomodule, AES_CT1_OFFSET);
-    uint32_t w2 = XIOModule_IoReadWord(&iomodule, AES_CT2_OFFSET);
-    uint32_t w3 = XIOModule_IoReadWord(&iomodule, AES_CT3_OFFSET);
+static void aes_setup_context(uint32_t setup) {
+    XIOModule_IoWriteWord(&iomodule, AES_CTX_OFFSET, setup);
+}
 
-    /* AES uses big-endian byte order within words */
-    ct[0]  = (w0 >> 24) & 0xFF;  ct[1]  = (w0 >> 16) & 0xFF;
-    ct[2]  = (w0 >> 8)  & 0xFF;  ct[3]  = w0 & 0xFF;
-    ct[4]  = (w1 >> 24) & 0xFF;  ct[5]  = (w1 >> 16) & 0xFF;
-    ct[6]  = (w1 >> 8)  & 0xFF;  ct[7]  = w1 & 0xFF;
-    ct[8]  = (w2 >> 24) & 0xFF;  ct[9]  = (w2 >> 16) & 0xFF;
-    ct[10] = (w2 >> 8)  & 0xFF;  ct[11] = w2 & 0xFF;
-    ct[12] = (w3 >> 24) & 0xFF;  ct[13] = (w3 >> 16) & 0xFF;
-    ct[14] = (w3 >> 8)  & 0xFF;  ct[15] = w3 & 0xFF;
+static void aes_set_le_words(void) {
+    XIOModule_IoWriteWord(&iomodule, AES_CFG_OFFSET, AES_CFG_LE_WORDS);
 }
 
-static void aes_start(void) {
-    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, AES_CTRL_START);
+/* Start the block in the plaintext registers; ctrl adds context/key slot bits */
+static void aes_start(uint32_t ctrl) {
+    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, AES_CTRL_START | ctrl | aes_ctrl_irq_en);
 }
 
 static void aes_clear_done(void) {
-    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, AES_CTRL_CLR_DONE);
+    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, AES_CTRL_CLR_DONE | aes_ctrl_irq_en);
 }
 
 static void aes_enable_irq(void) {
-    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, AES_CTRL_IRQ_EN);
+    aes_ctrl_irq_en = AES_CTRL_IRQ_EN;
+    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, aes_ctrl_irq_en);
+}
+
+static void aes_disable_irq(void) {
+    aes_ctrl_irq_en = 0;
+    XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, aes_ctrl_irq_en);
 }
 
 static int aes_is_done(void) {
@@ -140,18 +508,28 @@ static int aes_is_busy(void) {
     return (status & AES_STATUS_BUSY) != 0;
 }
 
+static uint32_t aes_read_status(void) {
+    return XIOModule_IoReadWord(&iomodule, AES_CTRL_OFFSET);
+}
+
+static void copy_block(uint32_t *dst, const uint32_t *src) {
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+    dst[3] = src[3];
+}
+
 /* ============================================================================
  * Interrupt Handler
  * ============================================================================ */
 
-#if USE_INTERRUPTS
+/* Always connected; polled builds enable it only for the BENCH interrupt pass */
 static void aes_isr(void *callback_ref) {
     (void)callback_ref;
     aes_done_flag = 1;
     /* Clear the done flag in hardware */
     aes_clear_done();
 }
-#endif
 
 /* ============================================================================
  * Timer Functions (for benchmarking)
@@ -169,175 +547,1301 @@ static uint32_t timer_get_cycles(void) {
     return XIOModule_GetValue(&iomodule, 0);
 }
 
+/* ============================================================================
+ * Phase Timestamps
+ * ============================================================================ */
+
+#if PHASE_STAMPS
+#define PHASE_MARK(phase)               phase_stamp((phase), timer_get_cycles())
+#define PHASE_MARK_AT(phase, cycles)    phase_stamp((phase), (cycles))
+
+static void phase_stamp(int phase, uint32_t cycles) {
+    phase_cycles[phase] = cycles;
+    phase_valid |= 1u << phase;
+}
+#else
+#define PHASE_MARK(phase)
+#define PHASE_MARK_AT(phase, cycles)    (void)(cycles)
+#endif
+
+/* A frame starts at RX ring position pos: date it from the ISR's SOF stamps */
+static void phase_frame_begin(uint32_t pos) {
+    phase_valid = 0;
+#if PHASE_STAMPS
+    for (int i = 0; i < UART_SOF_STAMPS; i++) {
+        if (uart_sof_pos[i] == pos) {
+            phase_stamp(PHASE_RX_FIRST, uart_sof_cycles[i]);
+            break;
+        }
+    }
+#else
+    (void)pos;
+#endif
+}
+
+/* The frame has been handled: keep its stamps and add it to the averages */
+static void phase_frame_end(uint8_t seq, uint8_t cmd) {
+    if (cmd == CMD_STATS) {
+        return;
+    }
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        phase_last[i] = phase_cycles[i];
+    }
+    phase_last_valid = phase_valid;
+    phase_last_seq = seq;
+    phase_last_cmd = cmd;
+
+    if (phase_valid == PHASE_ALL) {
+        /* Timer counts down, so earlier - later = elapsed */
+        for (int i = 0; i < PHASE_COUNT - 1; i++) {
+            phase_sum[i] += phase_cycles[i] - phase_cycles[i + 1];
+        }
+        phase_frames++;
+    }
+}
+
+/* ============================================================================
+ * Key Cache
+ * ============================================================================ */
+
+/* Slot for a key that is not resident: free, then stored ids, then host slots */
+static uint32_t key_slot_victim(void) {
+    uint32_t victim = 0;
+    int victim_rank = 3;
+
+    for (uint32_t slot = 0; slot < AES_NUM_KEY_SLOTS; slot++) {
+        int rank = key_slot_owner[slot] == KEY_OWNER_NONE ? 0 :
+                   key_slot_owner[slot] == KEY_OWNER_HOST ? 2 : 1;
+        if (rank < victim_rank ||
+            (rank == victim_rank && key_slot_used[slot] < key_slot_used[victim])) {
+            victim = slot;
+            victim_rank = rank;
+        }
+    }
+    return victim;
+}
+
+/*
+ * Slot holding the stored key id, expanding it first if it is not resident.
+ * The expansion is only queued; blocks on the slot wait for it in hardware.
+ */
+static uint32_t key_cache_slot(uint32_t id) {
+    uint32_t slot;
+
+    for (slot = 0; slot < AES_NUM_KEY_SLOTS; slot++) {
+        if (key_slot_owner[slot] == id) {
+            break;
+        }
+    }
+    if (slot == AES_NUM_KEY_SLOTS) {
+        slot = key_slot_victim();
+        aes_write_key(key_cache[id]);
+        aes_load_key(slot);
+        key_slot_owner[slot] = (uint8_t)id;
+    }
+    key_slot_used[slot] = ++key_slot_clock;
+    return slot;
+}
+
 /* ============================================================================
  * UART Helper Functions
  * ============================================================================ */
 
+/* RX interrupt: move received bytes into the RX ring */
+static void uart_rx_isr(void *callback_ref) {
+    (void)callback_ref;
+    while (XIOModule_GetStatusReg(iomodule.BaseAddress) & XUL_SR_RX_FIFO_VALID_DATA) {
+        uint8_t byte = XIOModule_RecvByte(iomodule.BaseAddress);
+        if (uart_rx_head - uart_rx_tail < UART_RX_RING_SIZE) {
+#if PHASE_STAMPS
+            if (byte == FRAME_SOF) {
+                uint32_t i = uart_sof_count++ % UART_SOF_STAMPS;
+                uart_sof_pos[i] = uart_rx_head;
+                uart_sof_cycles[i] = timer_get_cycles();
+            }
+#endif
+            uart_rx_ring[uart_rx_head % UART_RX_RING_SIZE] = byte;
+            uart_rx_head++;
+        } else {
+            uart_rx_overruns++;
+        }
+    }
+}
+
+/* TX interrupt: the transmitter is empty, feed it the next queued byte */
+static void uart_tx_isr(void *callback_ref) {
+    (void)callback_ref;
+    if (uart_tx_tail != uart_tx_head) {
+        XIOModule_SendByte(iomodule.BaseAddress, uart_tx_ring[uart_tx_tail % UART_TX_RING_SIZE]);
+        uart_tx_tail++;
+    } else {
+        uart_tx_active = 0;
+    }
+}
+
+/* Start transmission if the transmitter went idle (the TX ISR keeps it going) */
+static void uart_tx_kick(void) {
+    microblaze_disable_interrupts();
+    if (!uart_tx_active && uart_tx_tail != uart_tx_head) {
+        uart_tx_active = 1;
+        XIOModule_SendByte(iomodule.BaseAddress, uart_tx_ring[uart_tx_tail % UART_TX_RING_SIZE]);
+        uart_tx_tail++;
+    }
+    microblaze_enable_interrupts();
+}
+
+static uint32_t uart_tx_space(void) {
+    return UART_TX_RING_SIZE - (uart_tx_head - uart_tx_tail);
+}
+
+/* Queue bytes for transmission, waiting only while the TX ring is full */
 static void uart_send_bytes(const uint8_t *data, int len) {
     for (int i = 0; i < len; i++) {
-        while (XIOModule_GetStatusReg(iomodule.BaseAddress) & XUL_SR_TX_FIFO_FULL);
-        XIOModule_SendByte(iomodule.BaseAddress, data[i]);
+        while (uart_tx_space() == 0) {
+            uart_tx_kick();
+        }
+        uart_tx_ring[uart_tx_head % UART_TX_RING_SIZE] = data[i];
+        uart_tx_head++;
+    }
+    uart_tx_kick();
+}
+
+/* Wait until every queued byte has been handed to the transmitter */
+static void uart_tx_flush(void) {
+    while (uart_tx_tail != uart_tx_head) {
+        uart_tx_kick();
+    }
+}
+
+static int uart_init_interrupts(void) {
+    int status;
+
+    status = XIOModule_Connect(&iomodule, XIN_IOMODULE_UART_RX_INTR, uart_rx_isr, NULL);
+    if (status != XST_SUCCESS) {
+        return status;
+    }
+    status = XIOModule_Connect(&iomodule, XIN_IOMODULE_UART_TX_INTR, uart_tx_isr, NULL);
+    if (status != XST_SUCCESS) {
+        return status;
+    }
+    XIOModule_Enable(&iomodule, XIN_IOMODULE_UART_RX_INTR);
+    XIOModule_Enable(&iomodule, XIN_IOMODULE_UART_TX_INTR);
+    return XST_SUCCESS;
+}
+
+static uint32_t read_u32_le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t read_u32_be(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/* Native (little-endian) word holding the big-endian bytes of val */
+static uint32_t word_from_be(uint32_t val) {
+    return (val >> 24) | ((val >> 8) & 0xFF00) |
+           ((val << 8) & 0xFF0000) | (val << 24);
+}
+
+/* ============================================================================
+ * Response Frames
+ * ============================================================================ */
+
+/* CRC-16/CCITT-FALSE, one nibble at a time */
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+#define CRC16_INIT          0xFFFF
+
+static uint16_t crc16_update(uint16_t crc, uint8_t byte) {
+    crc = (uint16_t)(crc << 4) ^ crc16_nibble[(crc >> 12) ^ (byte >> 4)];
+    crc = (uint16_t)(crc << 4) ^ crc16_nibble[(crc >> 12) ^ (byte & 0x0F)];
+    return crc;
+}
+
+static uint16_t resp_crc;
+
+static void resp_write(const uint8_t *data, int len) {
+    for (int i = 0; i < len; i++) {
+        resp_crc = crc16_update(resp_crc, data[i]);
     }
+    uart_send_bytes(data, len);
 }
 
-static void uart_send_u32_le(uint32_t val) {
+static void resp_write_u32_le(uint32_t val) {
     uint8_t bytes[4];
     bytes[0] = val & 0xFF;
     bytes[1] = (val >> 8) & 0xFF;
     bytes[2] = (val >> 16) & 0xFF;
     bytes[3] = (val >> 24) & 0xFF;
-    uart_send_bytes(bytes, 4);
+    resp_write(bytes, 4);
+}
+
+/* Send the response header; the payload follows through resp_write() */
+static void resp_begin(uint8_t seq, uint8_t cmd, uint32_t len) {
+    uint8_t sof = FRAME_SOF;
+    uint8_t header[4];
+    header[0] = seq;
+    header[1] = cmd | CMD_RESPONSE;
+    header[2] = len & 0xFF;
+    header[3] = (len >> 8) & 0xFF;
+
+    uart_send_bytes(&sof, 1);
+    resp_crc = CRC16_INIT;
+    resp_write(header, 4);
+}
+
+static void resp_end(void) {
+    uint8_t crc[2];
+    crc[0] = resp_crc & 0xFF;
+    crc[1] = (resp_crc >> 8) & 0xFF;
+    uart_send_bytes(crc, 2);
+    PHASE_MARK(PHASE_TX_LAST);
+}
+
+static void send_nak(uint8_t seq, uint8_t cmd, uint8_t reason) {
+    uint8_t payload[2];
+    payload[0] = reason;
+    payload[1] = cmd;
+    resp_begin(seq, CMD_NAK, 2);
+    resp_write(payload, 2);
+    resp_end();
 }
 
 /* ============================================================================
- * Main
+ * Command Handlers
  * ============================================================================ */
 
-int main(void) {
-    int status;
+static void handle_ping(uint8_t seq) {
+    uint8_t version = PROTOCOL_VERSION;
+    resp_begin(seq, CMD_PING, 1);
+    resp_write(&version, 1);
+    resp_end();
+}
 
-    /* Initialize IOModule */
-    status = XIOModule_Initialize(&iomodule, UART_DEVICE_ID);
-    if (status != XST_SUCCESS) {
-        return -1;
+/* Encrypt the block in the plaintext registers on context 0 and respond */
+static void ecb_run(uint8_t seq, uint8_t cmd, uint32_t ctrl) {
+    /* Wait for any previous operation to complete (safety check) */
+    while (aes_is_busy()) {
+        /* Busy wait */
     }
 
-    /* Initialize GPO1 LED to OFF */
-    XIOModule_DiscreteWrite(&iomodule, 1, 0x00);
+    /* Start timer */
+    uint32_t start_cycles = timer_get_cycles();
+    PHASE_MARK_AT(PHASE_START, start_cycles);
 
-    /* Initialize timer for benchmarking */
-    timer_init();
+    /* Start encryption */
+    aes_start(ctrl);
 
 #if USE_INTERRUPTS
-    /* Setup interrupt handling */
-    status = XIOModule_Connect(&iomodule, AES_INTR_ID, aes_isr, NULL);
-    if (status != XST_SUCCESS) {
-        xil_printf("Failed to connect AES interrupt\r\n");
-        return -1;
+    /* Wait for interrupt */
+    aes_done_flag = 0;
+    while (!aes_done_flag) {
+        /* Could use WFI (wait for interrupt) here */
+    }
+#else
+    /* Poll for completion */
+    while (!aes_is_done()) {
+        /* Busy wait */
     }
-    XIOModule_Enable(&iomodule, AES_INTR_ID);
-    XIOModule_Start(&iomodule);
-    aes_enable_irq();
 #endif
 
-    /* Send startup message */
-    xil_printf("AES-128 Hardware Accelerator Ready\r\n");
-    xil_printf("Protocol: Send 34 bytes = [16B key] + [16B plaintext] + [0xFFFF]\r\n");
-    xil_printf("Response: 20 bytes = [16B ciphertext] + [4B cycles]\r\n");
-#if USE_INTERRUPTS
-    xil_printf("Mode: Interrupt-driven\r\n");
-#else
-    xil_printf("Mode: Polled\r\n");
+    /* Stop timer */
+    uint32_t end_cycles = timer_get_cycles();
+    PHASE_MARK_AT(PHASE_DONE, end_cycles);
+    /* Timer counts down, so start - end = elapsed */
+    uint32_t elapsed_cycles = start_cycles - end_cycles;
+
+    /* Read ciphertext */
+    uint32_t ciphertext[BLOCK_SIZE / 4];
+    aes_read_ciphertext(ciphertext);
+    PHASE_MARK(PHASE_CT);
+
+    /* Clear done flag for polled mode */
+#if !USE_INTERRUPTS
+    aes_clear_done();
 #endif
 
-    /* Receive buffer */
-    uint8_t rx_buffer[FRAME_SIZE];
-    int rx_count = 0;
+    /* Send ciphertext (16 bytes) and cycle count (4 bytes) */
+    resp_begin(seq, cmd, BLOCK_SIZE + 4);
+    resp_write((const uint8_t *)ciphertext, BLOCK_SIZE);
+    resp_write_u32_le(elapsed_cycles);
+    resp_end();
+}
 
-    /* Main loop */
-    while (1) {
-        /* Check for incoming UART data */
-        if (XIOModule_GetStatusReg(iomodule.BaseAddress) & XUL_SR_RX_FIFO_VALID_DATA) {
-            uint8_t byte = XIOModule_RecvByte(iomodule.BaseAddress);
-
-            /* Store byte in buffer */
-            if (rx_count < FRAME_SIZE) {
-                rx_buffer[rx_count] = byte;
-                rx_count++;
+/* ECB block: key and plaintext are already in the core's staging registers */
+static void handle_ecb(uint8_t seq) {
+    /* Context 0 defaults to ECB on key slot 0 */
+    aes_load_key(AES_KEY_SLOT);
+    ecb_run(seq, CMD_ECB, 0);
+}
+
+/* ECB block with a stored key: the plaintext is already in its registers */
+static void handle_ecb_id(uint8_t seq, const uint8_t *payload) {
+    uint32_t id = payload[ECB_ID_ID_OFFSET];
+
+    if (id >= KEY_CACHE_IDS || !(key_cache_valid & (1u << id))) {
+        send_nak(seq, CMD_ECB_ID, NAK_PARAM);
+        return;
+    }
+    ecb_run(seq, CMD_ECB_ID, AES_CTRL_KSLOT(key_cache_slot(id)));
+}
+
+/* Key store: keep a key under an id and expand it into a slot */
+static void handle_key_store(uint8_t seq, const uint32_t *payload_words) {
+    const uint8_t *payload = (const uint8_t *)payload_words;
+    uint32_t id = payload[KEY_STORE_ID_OFFSET];
+
+    if (id >= KEY_CACHE_IDS) {
+        send_nak(seq, CMD_KEY_STORE, NAK_PARAM);
+        return;
+    }
+
+    uint32_t start_cycles = timer_get_cycles();
+    copy_block(key_cache[id], payload_words);
+    key_cache_valid |= 1u << id;
+    /* A slot still expanded from the old key under this id is stale */
+    for (uint32_t slot = 0; slot < AES_NUM_KEY_SLOTS; slot++) {
+        if (key_slot_owner[slot] == id) {
+            key_slot_owner[slot] = KEY_OWNER_NONE;
+        }
+    }
+    key_cache_slot(id);
+    while (aes_is_busy()) {
+        /* Busy wait */
+    }
+    uint32_t end_cycles = timer_get_cycles();
+
+    resp_begin(seq, CMD_KEY_STORE, 4);
+    resp_write_u32_le(start_cycles - end_cycles);
+    resp_end();
+}
+
+/* Key load: expand a key into a slot (the parser already wrote the key) */
+static void handle_key_load(uint8_t seq, const uint8_t *payload) {
+    uint32_t slot = payload[KEYLOAD_SLOT_OFFSET];
+
+    if (slot >= AES_NUM_KEY_SLOTS) {
+        send_nak(seq, CMD_KEY_LOAD, NAK_PARAM);
+        return;
+    }
+
+    uint32_t start_cycles = timer_get_cycles();
+    aes_load_key(slot);
+    key_slot_owner[slot] = KEY_OWNER_HOST;
+    while (aes_is_busy()) {
+        /* Busy wait */
+    }
+    uint32_t end_cycles = timer_get_cycles();
+
+    resp_begin(seq, CMD_KEY_LOAD, 4);
+    resp_write_u32_le(start_cycles - end_cycles);
+    resp_end();
+}
+
+/*
+ * CTR keystream: encrypt counter blocks back to back on the given key slot
+ * and stream the results out. Up to the command queue depth of starts are kept
+ * ahead of the UART, and results are read from the double-buffered output as
+ * soon as they are valid.
+ */
+static void handle_ctr(uint8_t seq, const uint8_t *payload) {
+    uint32_t slot = payload[CTR_SLOT_OFFSET];
+    uint32_t counter = read_u32_be(&payload[CTR_COUNTER_OFFSET]);
+    uint32_t num_blocks = read_u32_le(&payload[CTR_COUNT_OFFSET]);
+    uint32_t issued = 0;
+    uint32_t retired = 0;
+
+    if (slot >= AES_NUM_KEY_SLOTS || num_blocks > CTR_MAX_BLOCKS) {
+        send_nak(seq, CMD_CTR, NAK_PARAM);
+        return;
+    }
+
+    /* Counter block: nonce || counter (words 0-2 are fixed for the stream) */
+    uint32_t ctr_block[BLOCK_SIZE / 4];
+    for (int i = 0; i < 3; i++) {
+        ctr_block[i] = read_u32_le(&payload[CTR_NONCE_OFFSET + 4 * i]);
+    }
+
+    resp_begin(seq, CMD_CTR, num_blocks * BLOCK_SIZE + 4);
+    uint32_t start_cycles = timer_get_cycles();
+
+    while (retired < num_blocks) {
+        uint32_t status = aes_read_status();
+
+        /* Queue the next counter block while there is room */
+        if (issued < num_blocks && !(status & AES_STATUS_Q_FULL)) {
+            ctr_block[3] = word_from_be(counter + issued);
+            aes_write_plaintext(ctr_block);
+            XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET,
+                                  AES_CTRL_START | AES_CTRL_KSLOT(slot) | aes_ctrl_irq_en);
+            issued++;
+        }
+
+        /* Stream out the oldest finished block */
+        if (status & AES_STATUS_CT_VALID) {
+            uint32_t keystream[BLOCK_SIZE / 4];
+            aes_read_ciphertext(keystream);
+            resp_write((const uint8_t *)keystream, BLOCK_SIZE);
+            retired++;
+        }
+    }
+
+    uart_tx_flush();
+    uint32_t end_cycles = timer_get_cycles();
+
+#if !USE_INTERRUPTS
+    aes_clear_done();
+#endif
+
+    /* Timer counts down, so start - end = elapsed */
+    resp_write_u32_le(start_cycles - end_cycles);
+    resp_end();
+}
+
+/* Queue the batch context setup (ECB or CBC on the slot, chain = IV) */
+static void batch_setup_context(const uint32_t *iv, uint8_t mode, uint32_t slot) {
+    aes_write_iv(iv);
+    aes_setup_context(AES_CTX_SETUP(BATCH_CTX,
+                                    mode >= BATCH_MODE_CBC_ENC ? AES_MODE_CBC : AES_MODE_ECB,
+                                    slot, 0) | AES_CTX_LOAD_CHAIN);
+}
+
+/*
+ * Batch: process the N blocks of the payload and return N results. Starts are
+ * kept ahead of the UART through the command queue while earlier results
+ * drain from the TX ring.
+ */
+static void handle_batch(uint8_t seq, const uint32_t *payload_words, uint32_t len) {
+    const uint8_t *payload = (const uint8_t *)payload_words;
+    uint8_t mode = payload[BATCH_MODE_OFFSET];
+    uint32_t slot = payload[BATCH_SLOT_OFFSET];
+    int inline_key = (payload[BATCH_FLAGS_OFFSET] & BATCH_FLAG_KEY) != 0;
+    uint32_t data_offset = BATCH_HEADER_SIZE + (inline_key ? KEY_SIZE : 0);
+    uint32_t issued = 0;
+    uint32_t retired = 0;
+
+    if (len < data_offset) {
+        send_nak(seq, CMD_BATCH, NAK_LENGTH);
+        return;
+    }
+    if (mode > BATCH_MODE_CBC_DEC || slot >= AES_NUM_KEY_SLOTS) {
+        send_nak(seq, CMD_BATCH, NAK_PARAM);
+        return;
+    }
+
+    uint32_t num_blocks = (len - data_offset) / BLOCK_SIZE;
+    const uint32_t *data = &payload_words[data_offset / 4];
+
+    uint32_t ctrl = AES_CTRL_START | AES_CTRL_CTX(BATCH_CTX) | aes_ctrl_irq_en;
+    if (mode == BATCH_MODE_ECB_DEC || mode == BATCH_MODE_CBC_DEC) {
+        ctrl |= AES_CTRL_DECRYPT;
+    }
+
+    resp_begin(seq, CMD_BATCH, num_blocks * BLOCK_SIZE + 4);
+    uint32_t start_cycles = timer_get_cycles();
+
+    /* The queue orders the context setup after an inline key load */
+    if (inline_key) {
+        aes_write_key(&payload_words[BATCH_HEADER_SIZE / 4]);
+        aes_load_key(slot);
+        key_slot_owner[slot] = KEY_OWNER_HOST;
+    }
+    batch_setup_context(&payload_words[BATCH_IV_OFFSET / 4], mode, slot);
+
+    while (retired < num_blocks) {
+        uint32_t status = aes_read_status();
+
+        if (issued < num_blocks && !(status & AES_STATUS_Q_FULL)) {
+            aes_write_plaintext(&data[issued * (BLOCK_SIZE / 4)]);
+            XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, ctrl);
+            issued++;
+        }
+
+        if (status & AES_STATUS_CT_VALID) {
+            uint32_t result[BLOCK_SIZE / 4];
+            aes_read_ciphertext(result);
+            resp_write((const uint8_t *)result, BLOCK_SIZE);
+            retired++;
+        }
+    }
+
+    uart_tx_flush();
+    uint32_t end_cycles = timer_get_cycles();
+
+#if !USE_INTERRUPTS
+    aes_clear_done();
+#endif
+
+    /* Timer counts down, so start - end = elapsed */
+    resp_write_u32_le(start_cycles - end_cycles);
+    resp_end();
+}
+
+/*
+ * Monte Carlo Test: every block depends on the one before, so blocks run one
+ * at a time and only the checkpoints cross the UART. Each iteration reloads
+ * the key slot (and the CBC chain), which the queue orders ahead of its first
+ * block. Checkpoints are buffered and sent after the loop so the UART does
+ * not stall it.
+ */
+static uint32_t mct_checkpoints[MCT_MAX_ITERATIONS * 2 * (BLOCK_SIZE / 4)];
+
+static void handle_mct(uint8_t seq, const uint32_t *payload_words) {
+    const uint8_t *payload = (const uint8_t *)payload_words;
+    uint8_t mode = payload[MCT_MODE_OFFSET];
+    uint32_t slot = payload[MCT_SLOT_OFFSET];
+    uint32_t iterations = payload[MCT_ITER_OFFSET] | ((uint32_t)payload[MCT_ITER_OFFSET + 1] << 8);
+    int cbc = mode == BATCH_MODE_CBC_ENC || mode == BATCH_MODE_CBC_DEC;
+
+    if (mode > BATCH_MODE_CBC_DEC || slot >= AES_NUM_KEY_SLOTS ||
+        iterations == 0 || iterations > MCT_MAX_ITERATIONS) {
+        send_nak(seq, CMD_MCT, NAK_PARAM);
+        return;
+    }
+
+    uint32_t key[BLOCK_SIZE / 4];
+    uint32_t iv[BLOCK_SIZE / 4];
+    uint32_t block[BLOCK_SIZE / 4];     /* Next input */
+    uint32_t prev[BLOCK_SIZE / 4];      /* Previous output (CBC) */
+    uint32_t out[BLOCK_SIZE / 4];
+    copy_block(iv, &payload_words[MCT_IV_OFFSET / 4]);
+    copy_block(key, &payload_words[MCT_KEY_OFFSET / 4]);
+    copy_block(block, &payload_words[MCT_TEXT_OFFSET / 4]);
+
+    uint32_t ctrl = AES_CTRL_START | AES_CTRL_CTX(MCT_CTX) | aes_ctrl_irq_en;
+    if (mode == BATCH_MODE_ECB_DEC || mode == BATCH_MODE_CBC_DEC) {
+        ctrl |= AES_CTRL_DECRYPT;
+    }
+
+    uint32_t start_cycles = timer_get_cycles();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        aes_write_key(key);
+        aes_load_key(slot);
+        key_slot_owner[slot] = KEY_OWNER_HOST;
+        if (cbc) {
+            aes_write_iv(iv);
+            aes_setup_context(AES_CTX_SETUP(MCT_CTX, AES_MODE_CBC, slot, 0) | AES_CTX_LOAD_CHAIN);
+        } else {
+            aes_setup_context(AES_CTX_SETUP(MCT_CTX, AES_MODE_ECB, slot, 0));
+        }
+
+        for (uint32_t j = 0; j < MCT_INNER_BLOCKS; j++) {
+            aes_write_plaintext(block);
+            XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, ctrl);
+            while (!(aes_read_status() & AES_STATUS_CT_VALID)) {
+                /* Busy wait */
             }
+            aes_read_ciphertext(out);
 
-            /* Check if we have a complete frame */
-            if (rx_count >= FRAME_SIZE) {
-                /* Check for marker */
-                if (rx_buffer[KEY_SIZE + BLOCK_SIZE] == FRAME_MARKER_LO &&
-                    rx_buffer[KEY_SIZE + BLOCK_SIZE + 1] == FRAME_MARKER_HI) {
+            if (cbc) {
+                copy_block(block, j == 0 ? iv : prev);
+                copy_block(prev, out);
+            } else {
+                copy_block(block, out);
+            }
+        }
 
-                    /* Turn ON LED */
-                    XIOModule_DiscreteWrite(&iomodule, 1, 0x01);
+        /* block now holds the first input of the next iteration */
+        for (int w = 0; w < BLOCK_SIZE / 4; w++) {
+            key[w] ^= out[w];
+        }
+        if (cbc) {
+            copy_block(iv, out);
+        }
+        copy_block(&mct_checkpoints[i * 8], out);
+        copy_block(&mct_checkpoints[i * 8 + 4], block);
+    }
 
-                    /* Extract key and plaintext */
-                    uint8_t *key = &rx_buffer[0];
-                    uint8_t *plaintext = &rx_buffer[KEY_SIZE];
+    uint32_t end_cycles = timer_get_cycles();
 
-                    /* Write key and plaintext to AES controller */
-                    aes_write_key(key);
-                    aes_write_plaintext(plaintext);
+#if !USE_INTERRUPTS
+    aes_clear_done();
+#endif
 
-                    /* Wait for any previous operation to complete (safety check) */
-                    while (aes_is_busy()) {
-                        /* Busy wait */
-                    }
+    resp_begin(seq, CMD_MCT, iterations * 2 * BLOCK_SIZE + 4);
+    resp_write((const uint8_t *)mct_checkpoints, iterations * 2 * BLOCK_SIZE);
+    /* Timer counts down, so start - end = elapsed */
+    resp_write_u32_le(start_cycles - end_cycles);
+    resp_end();
+}
 
-                    /* Start timer */
-                    uint32_t start_cycles = timer_get_cycles();
+/*
+ * XTS data unit: the tweak is derived once from the data unit number on the
+ * tweak key slot, then the blocks stream through the command queue as for a
+ * batch. A data unit ending in a partial block is finished with ciphertext
+ * stealing: the last full block's result is held back, its tail fills out
+ * the partial block and that merged block runs last. Decryption needs the
+ * tweaks of those two blocks swapped, so its last full block is started
+ * with the steal bit (next tweak, chain not advanced).
+ */
+static void handle_xts(uint8_t seq, const uint32_t *payload_words, uint32_t len) {
+    const uint8_t *payload = (const uint8_t *)payload_words;
+    uint8_t dir = payload[XTS_DIR_OFFSET];
+    uint32_t slot = payload[XTS_SLOT_OFFSET];
+    uint32_t tslot = payload[XTS_TSLOT_OFFSET];
+    uint32_t issued = 0;
+    uint32_t retired = 0;
 
-                    /* Start encryption */
-                    aes_start();
+    if (dir > XTS_DIR_DECRYPT || slot >= AES_NUM_KEY_SLOTS || tslot >= AES_NUM_KEY_SLOTS) {
+        send_nak(seq, CMD_XTS, NAK_PARAM);
+        return;
+    }
 
-#if USE_INTERRUPTS
-                    /* Wait for interrupt */
-                    aes_done_flag = 0;
-                    while (!aes_done_flag) {
-                        /* Could use WFI (wait for interrupt) here */
-                    }
-#else
-                    /* Poll for completion */
-                    while (!aes_is_done()) {
-                        /* Busy wait */
-                    }
+    uint32_t data_len = len - XTS_HEADER_SIZE;
+    uint32_t num_blocks = data_len / BLOCK_SIZE;    /* Full blocks */
+    uint32_t tail = data_len % BLOCK_SIZE;          /* Bytes of the partial block */
+    const uint32_t *data = &payload_words[XTS_HEADER_SIZE / 4];
+    uint32_t held[BLOCK_SIZE / 4];                  /* Last full block's result */
+
+    uint32_t ctrl = AES_CTRL_START | AES_CTRL_CTX(XTS_CTX) | aes_ctrl_irq_en;
+    uint32_t steal = 0;
+    if (dir == XTS_DIR_DECRYPT) {
+        ctrl |= AES_CTRL_DECRYPT;
+        steal = tail ? AES_CTRL_STEAL : 0;
+    }
+
+    resp_begin(seq, CMD_XTS, data_len + 4);
+    uint32_t start_cycles = timer_get_cycles();
+
+    aes_write_iv(&payload_words[XTS_TWEAK_OFFSET / 4]);
+    aes_setup_context(AES_CTX_SETUP(XTS_CTX, AES_MODE_XTS, slot, tslot) | AES_CTX_LOAD_CHAIN);
+
+    while (retired < num_blocks) {
+        uint32_t status = aes_read_status();
+
+        if (issued < num_blocks && !(status & AES_STATUS_Q_FULL)) {
+            aes_write_plaintext(&data[issued * (BLOCK_SIZE / 4)]);
+            XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET,
+                                  issued == num_blocks - 1 ? ctrl | steal : ctrl);
+            issued++;
+        }
+
+        if (status & AES_STATUS_CT_VALID) {
+            if (tail && retired == num_blocks - 1) {
+                aes_read_ciphertext(held);
+            } else {
+                uint32_t result[BLOCK_SIZE / 4];
+                aes_read_ciphertext(result);
+                resp_write((const uint8_t *)result, BLOCK_SIZE);
+            }
+            retired++;
+        }
+    }
+
+    if (tail) {
+        /* The partial block completed with the held result's last bytes */
+        uint32_t merged[BLOCK_SIZE / 4];
+        const uint8_t *partial = (const uint8_t *)&data[num_blocks * (BLOCK_SIZE / 4)];
+        copy_block(merged, held);
+        for (uint32_t i = 0; i < tail; i++) {
+            ((uint8_t *)merged)[i] = partial[i];
+        }
+        aes_write_plaintext(merged);
+        XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, ctrl);
+        while (!(aes_read_status() & AES_STATUS_CT_VALID)) {
+            /* Busy wait */
+        }
+        aes_read_ciphertext(merged);
+        resp_write((const uint8_t *)merged, BLOCK_SIZE);
+        resp_write((const uint8_t *)held, tail);
+    }
+
+    uart_tx_flush();
+    uint32_t end_cycles = timer_get_cycles();
+
+#if !USE_INTERRUPTS
+    aes_clear_done();
 #endif
 
-                    /* Stop timer */
-                    uint32_t end_cycles = timer_get_cycles();
-                    /* Timer counts down, so start - end = elapsed */
-                    uint32_t elapsed_cycles = start_cycles - end_cycles;
+    /* Timer counts down, so start - end = elapsed */
+    resp_write_u32_le(start_cycles - end_cycles);
+    resp_end();
+}
 
-                    /* Read ciphertext */
-                    uint8_t ciphertext[BLOCK_SIZE];
-                    aes_read_ciphertext(ciphertext);
+/*
+ * CMAC: every block chains into the next inside the core and only the last
+ * one produces a result, so the blocks are pushed as fast as the queue takes
+ * them and only the tag is read back. The context setup clears the chain.
+ */
+static void handle_cmac(uint8_t seq, const uint8_t *payload, uint32_t len) {
+    uint32_t slot = payload[CMAC_SLOT_OFFSET];
+
+    if (slot >= AES_NUM_KEY_SLOTS) {
+        send_nak(seq, CMD_CMAC, NAK_PARAM);
+        return;
+    }
+
+    const uint8_t *msg = &payload[CMAC_MSG_OFFSET];
+    uint32_t msg_len = len - CMAC_MSG_OFFSET;
+    /* An empty message is one padded block */
+    uint32_t num_blocks = msg_len ? (msg_len + BLOCK_SIZE - 1) / BLOCK_SIZE : 1;
+    uint32_t ctrl = AES_CTRL_START | AES_CTRL_CTX(CMAC_CTX) | aes_ctrl_irq_en;
+    uint32_t block[BLOCK_SIZE / 4];
+    uint8_t *bytes = (uint8_t *)block;
+
+    uint32_t start_cycles = timer_get_cycles();
+    aes_setup_context(AES_CTX_SETUP(CMAC_CTX, AES_MODE_CMAC, slot, 0));
+
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        uint32_t n = msg_len - i * BLOCK_SIZE;
+        uint32_t flags = 0;
+
+        if (n > BLOCK_SIZE) {
+            n = BLOCK_SIZE;
+        }
+        for (uint32_t j = 0; j < BLOCK_SIZE; j++) {
+            bytes[j] = j < n ? msg[i * BLOCK_SIZE + j] : (j == n ? CMAC_PAD : 0);
+        }
+        if (i == num_blocks - 1) {
+            flags = AES_CTRL_LAST | (n < BLOCK_SIZE ? AES_CTRL_PARTIAL : 0);
+        }
+
+        while (aes_read_status() & AES_STATUS_Q_FULL) {
+            /* Busy wait */
+        }
+        aes_write_plaintext(block);
+        XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, ctrl | flags);
+    }
+
+    while (!(aes_read_status() & AES_STATUS_CT_VALID)) {
+        /* Busy wait */
+    }
+    aes_read_ciphertext(block);
+    uint32_t end_cycles = timer_get_cycles();
 
-                    /* Clear done flag for polled mode */
 #if !USE_INTERRUPTS
-                    aes_clear_done();
+    aes_clear_done();
 #endif
 
-                    /* Send ciphertext (16 bytes) */
-                    uart_send_bytes(ciphertext, BLOCK_SIZE);
+    resp_begin(seq, CMD_CMAC, BLOCK_SIZE + 4);
+    resp_write((const uint8_t *)block, BLOCK_SIZE);
+    /* Timer counts down, so start - end = elapsed */
+    resp_write_u32_le(start_cycles - end_cycles);
+    resp_end();
+}
 
-                    /* Send cycle count (4 bytes, little-endian) */
-                    uart_send_u32_le(elapsed_cycles);
+/*
+ * On-board benchmark: the same N blocks through each access pattern with
+ * the UART out of the loop, so the results bound what the MicroBlaze and the
+ * IO bus can sustain. Blocks are encrypted in place in a BRAM buffer that
+ * wraps every BENCH_BUFFER_BLOCKS.
+ */
+static uint32_t bench_buffer[BENCH_BUFFER_BLOCKS * (BLOCK_SIZE / 4)];
 
-                    /* Turn OFF LED */
-                    XIOModule_DiscreteWrite(&iomodule, 1, 0x00);
+static uint32_t *bench_block(uint32_t i) {
+    return &bench_buffer[(i % BENCH_BUFFER_BLOCKS) * (BLOCK_SIZE / 4)];
+}
 
-                    /* Reset for next frame */
-                    rx_count = 0;
+static uint32_t bench_polled(uint32_t num_blocks, uint32_t ctrl) {
+    uint32_t start_cycles = timer_get_cycles();
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        uint32_t *block = bench_block(i);
+        aes_write_plaintext(block);
+        XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, ctrl | aes_ctrl_irq_en);
+        while (!(aes_read_status() & AES_STATUS_CT_VALID)) {
+            /* Busy wait */
+        }
+        aes_read_ciphertext(block);
+    }
+    return start_cycles - timer_get_cycles();
+}
 
-                } else {
-                    /* Marker not found - try to resync */
-                    int found = -1;
-                    for (int i = 0; i < rx_count - 1; i++) {
-                        if (rx_buffer[i] == FRAME_MARKER_LO &&
-                            rx_buffer[i+1] == FRAME_MARKER_HI) {
-                            found = i;
-                            break;
-                        }
-                    }
+static uint32_t bench_interrupt(uint32_t num_blocks, uint32_t ctrl) {
+    uint32_t saved_irq_en = aes_ctrl_irq_en;
+    /* Drop a done left by the polled pass so it does not fire first */
+    aes_clear_done();
+    aes_enable_irq();
+    XIOModule_Enable(&iomodule, AES_INTR_ID);
+
+    uint32_t start_cycles = timer_get_cycles();
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        uint32_t *block = bench_block(i);
+        aes_done_flag = 0;
+        aes_write_plaintext(block);
+        XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, ctrl | aes_ctrl_irq_en);
+        while (!aes_done_flag) {
+            /* Busy wait */
+        }
+        aes_read_ciphertext(block);
+    }
+    uint32_t elapsed = start_cycles - timer_get_cycles();
+
+    if (!saved_irq_en) {
+        XIOModule_Disable(&iomodule, AES_INTR_ID);
+        aes_disable_irq();
+    }
+    return elapsed;
+}
+
+static uint32_t bench_queued(uint32_t num_blocks, uint32_t ctrl) {
+    uint32_t issued = 0;
+    uint32_t retired = 0;
+    uint32_t start_cycles = timer_get_cycles();
+    while (retired < num_blocks) {
+        uint32_t status = aes_read_status();
+        if (issued < num_blocks && !(status & AES_STATUS_Q_FULL)) {
+            aes_write_plaintext(bench_block(issued));
+            XIOModule_IoWriteWord(&iomodule, AES_CTRL_OFFSET, ctrl | aes_ctrl_irq_en);
+            issued++;
+        }
+        if (status & AES_STATUS_CT_VALID) {
+            aes_read_ciphertext(bench_block(retired));
+            retired++;
+        }
+    }
+    return start_cycles - timer_get_cycles();
+}
+
+static uint32_t bench_write_only(uint32_t num_blocks) {
+    uint32_t start_cycles = timer_get_cycles();
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        aes_write_plaintext(bench_block(i));
+    }
+    return start_cycles - timer_get_cycles();
+}
+
+static uint32_t bench_read_only(uint32_t num_blocks) {
+    uint32_t start_cycles = timer_get_cycles();
+    for (uint32_t i = 0; i < num_blocks; i++) {
+        uint32_t *block = bench_block(i);
+        block[0] = XIOModule_IoReadWord(&iomodule, AES_CT0_OFFSET);
+        block[1] = XIOModule_IoReadWord(&iomodule, AES_CT1_OFFSET);
+        block[2] = XIOModule_IoReadWord(&iomodule, AES_CT2_OFFSET);
+        block[3] = XIOModule_IoReadWord(&iomodule, AES_CT3_OFFSET);
+    }
+    return start_cycles - timer_get_cycles();
+}
+
+static void handle_bench(uint8_t seq, const uint8_t *payload) {
+    uint32_t num_blocks = read_u32_le(&payload[BENCH_COUNT_OFFSET]);
+    uint32_t slot = payload[BENCH_SLOT_OFFSET];
+    uint32_t ctrl = AES_CTRL_START | AES_CTRL_KSLOT(slot);
+    uint32_t cycles[BENCH_VARIANTS];
+
+    if (slot >= AES_NUM_KEY_SLOTS || num_blocks > BENCH_MAX_BLOCKS) {
+        send_nak(seq, CMD_BENCH, NAK_PARAM);
+        return;
+    }
+
+    for (uint32_t i = 0; i < BENCH_BUFFER_BLOCKS * (BLOCK_SIZE / 4); i++) {
+        bench_buffer[i] = i * 0x9E3779B9u;
+    }
+
+    cycles[BENCH_POLLED] = bench_polled(num_blocks, ctrl);
+    cycles[BENCH_INTERRUPT] = bench_interrupt(num_blocks, ctrl);
+    cycles[BENCH_QUEUED] = bench_queued(num_blocks, ctrl);
+    cycles[BENCH_WRITE_ONLY] = bench_write_only(num_blocks);
+    cycles[BENCH_READ_ONLY] = bench_read_only(num_blocks);
+
+#if !USE_INTERRUPTS
+    aes_clear_done();
+#endif
+
+    resp_begin(seq, CMD_BENCH, BENCH_VARIANTS * 4);
+    for (int i = 0; i < BENCH_VARIANTS; i++) {
+        resp_write_u32_le(cycles[i]);
+    }
+    resp_end();
+}
+
+/*
+ * Phase timestamps of the previous frame, the averages since the last call
+ * and the UART RX overrun count
+ */
+static void handle_stats(uint8_t seq) {
+    uint8_t header[4];
+    header[0] = phase_last_seq;
+    header[1] = phase_last_cmd;
+    header[2] = phase_last_valid & 0xFF;
+    header[3] = (phase_last_valid >> 8) & 0xFF;
+
+    resp_begin(seq, CMD_STATS, STATS_RESPONSE_SIZE);
+    resp_write(header, 4);
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        resp_write_u32_le(phase_last[i]);
+    }
+    resp_write_u32_le(phase_frames);
+    for (int i = 0; i < PHASE_COUNT - 1; i++) {
+        resp_write_u32_le(phase_frames ? (uint32_t)(phase_sum[i] / phase_frames) : 0);
+        phase_sum[i] = 0;
+    }
+    phase_frames = 0;
+    resp_write_u32_le(uart_rx_overruns);
+    resp_end();
+}
+
+/*
+ * Frame bridge: report the counters of its last session and, with enable set,
+ * hand it the link. The bridge takes over once this response has left the
+ * MCS UART, so the TX ring is drained before enabling it.
+ */
+static void handle_bridge(uint8_t seq, const uint8_t *payload) {
+    if (!(XIOModule_IoReadWord(&iomodule, AES_BRIDGE_OFFSET) & AES_BRIDGE_PRESENT)) {
+        send_nak(seq, CMD_BRIDGE, NAK_PARAM);
+        return;
+    }
+
+    resp_begin(seq, CMD_BRIDGE, BRIDGE_RESPONSE_SIZE);
+    resp_write_u32_le(XIOModule_IoReadWord(&iomodule, AES_BRIDGE_FRAMES));
+    resp_write_u32_le(XIOModule_IoReadWord(&iomodule, AES_BRIDGE_CRC_ERRS));
+    resp_write_u32_le(XIOModule_IoReadWord(&iomodule, AES_BRIDGE_NAKS));
+    resp_end();
+
+    if (payload[0] & AES_BRIDGE_ENABLE) {
+        uart_tx_flush();
+        /* The bridge's KEY_LOAD and ECB frames may overwrite any slot */
+        for (uint32_t slot = 0; slot < AES_NUM_KEY_SLOTS; slot++) {
+            key_slot_owner[slot] = KEY_OWNER_NONE;
+        }
+        XIOModule_IoWriteWord(&iomodule, AES_BRIDGE_OFFSET, AES_BRIDGE_ENABLE);
+    }
+}
+
+/*
+ * Line rate negotiation while the MCS UART owns the link: its rate is set
+ * in the block design, so only that rate is confirmed. Higher rates are
+ * negotiated with the frame bridge after BRIDGE.
+ */
+static void handle_baud(uint8_t seq, const uint8_t *payload) {
+    uint32_t rate = read_u32_le(payload);
 
-                    if (found >= 0) {
-                        /* Found marker, shift buffer */
-                        int new_count = rx_count - found - 2;
-                        for (int i = 0; i < new_count; i++) {
-                            rx_buffer[i] = rx_buffer[found + 2 + i];
-                        }
-                        rx_count = new_count;
-                    } else {
-                        /* Keep last byte in case it's start of marker */
-                        rx_buffer[0] = rx_buffer[rx_count - 1];
-                        rx_count = 1;
+    if (rate != MCS_UART_BAUD) {
+        send_nak(seq, CMD_BAUD, NAK_PARAM);
+        return;
+    }
+    resp_begin(seq, CMD_BAUD, BAUD_RESPONSE_SIZE);
+    resp_write_u32_le(rate);
+    resp_end();
+}
+
+/* ============================================================================
+ * Frame Parser
+ * ============================================================================ */
+
+/*
+ * Ring-buffer frame parser. Bytes are examined in place in the RX ring and
+ * only released once a frame has passed its CRC, so a false SOF (one whose
+ * header is implausible or whose CRC fails) is recovered from by dropping
+ * that single byte and rescanning from the next one: resync is a constant-
+ * time cursor reset and never loses a real frame that overlapped the false
+ * one. A header is implausible when its command is unknown or its length is
+ * not one that command takes, so a false SOF rarely holds up the frames
+ * behind it waiting for a payload that never comes. The RX ring must hold
+ * one maximum-size frame.
+ *
+ * Payload bytes are copied into an aligned buffer as they are scanned. For
+ * ECB and KEY_LOAD the first 32 bytes are also packed into words and written
+ * straight to the key and plaintext registers, so the core is loaded the
+ * moment the frame is verified. Both are staging registers copied into the
+ * command queue on use, so writes from a frame that is later rejected are
+ * harmless.
+ */
+typedef enum {
+    PARSE_SOF,          /* Looking for the SOF byte */
+    PARSE_SEQ,
+    PARSE_CMD,
+    PARSE_LEN_LO,
+    PARSE_LEN_HI,
+    PARSE_PAYLOAD,      /* Receiving payload byte parse_index */
+    PARSE_CRC_LO,
+    PARSE_CRC_HI
+} parse_state_t;
+
+static parse_state_t parse_state = PARSE_SOF;
+static uint32_t parse_pos = 0;      /* Next RX ring position to examine */
+static uint32_t parse_sof = 0;      /* RX ring position of the current SOF */
+static uint32_t parse_index = 0;
+static uint32_t parse_word = 0;
+static uint16_t parse_crc = 0;
+static uint16_t parse_rx_crc = 0;
+static uint8_t frame_seq = 0;
+static uint8_t frame_cmd = 0;
+static uint32_t frame_len = 0;
+static uint32_t frame_payload_words[(MAX_PAYLOAD_SIZE + 3) / 4];
+
+/* Whether cmd takes a payload of len bytes (BATCH's key flag is checked later) */
+static int frame_len_valid(uint8_t cmd, uint32_t len) {
+    switch (cmd) {
+    case CMD_PING:
+    case CMD_STATS:
+        return len == 0;
+    case CMD_ECB:
+        return len == KEY_SIZE + BLOCK_SIZE;
+    case CMD_KEY_LOAD:
+        return len == KEYLOAD_PAYLOAD_SIZE;
+    case CMD_CTR:
+        return len == CTR_PAYLOAD_SIZE;
+    case CMD_BATCH:
+        /* The inline key is a block long, so either way the data is whole blocks */
+        return len >= BATCH_HEADER_SIZE && len <= MAX_PAYLOAD_SIZE &&
+               (len - BATCH_HEADER_SIZE) % BLOCK_SIZE == 0;
+    case CMD_MCT:
+        return len == MCT_PAYLOAD_SIZE;
+    case CMD_BENCH:
+        return len == BENCH_PAYLOAD_SIZE;
+    case CMD_KEY_STORE:
+        return len == KEY_STORE_PAYLOAD_SIZE;
+    case CMD_ECB_ID:
+        return len == ECB_ID_PAYLOAD_SIZE;
+    case CMD_BRIDGE:
+        return len == BRIDGE_PAYLOAD_SIZE;
+    case CMD_BAUD:
+        return len == BAUD_PAYLOAD_SIZE;
+    case CMD_XTS:
+        return len >= XTS_HEADER_SIZE + BLOCK_SIZE && len <= XTS_HEADER_SIZE + XTS_MAX_SIZE;
+    case CMD_CMAC:
+        return len >= CMAC_MSG_OFFSET && len <= CMAC_MSG_OFFSET + CMAC_MAX_SIZE;
+    default:
+        return 0;
+    }
+}
+
+/* Drop the SOF byte and rescan from the byte after it */
+static void frame_parser_resync(void) {
+    parse_pos = parse_sof + 1;
+    uart_rx_tail = parse_pos;
+    parse_state = PARSE_SOF;
+}
+
+/* Scan received bytes; returns 1 once a frame with a valid CRC is available */
+static int frame_parser_poll(void) {
+    uint8_t *payload = (uint8_t *)frame_payload_words;
+
+    while (parse_pos != uart_rx_head) {
+        uint8_t byte = uart_rx_ring[parse_pos % UART_RX_RING_SIZE];
+        parse_pos++;
+
+        switch (parse_state) {
+        case PARSE_SOF:
+            if (byte == FRAME_SOF) {
+                parse_sof = parse_pos - 1;
+                phase_frame_begin(parse_sof);
+                parse_crc = CRC16_INIT;
+                parse_state = PARSE_SEQ;
+            } else {
+                uart_rx_tail = parse_pos;
+            }
+            break;
+
+        case PARSE_SEQ:
+            frame_seq = byte;
+            parse_crc = crc16_update(parse_crc, byte);
+            parse_state = PARSE_CMD;
+            break;
+
+        case PARSE_CMD:
+            frame_cmd = byte;
+            parse_crc = crc16_update(parse_crc, byte);
+            parse_state = PARSE_LEN_LO;
+            break;
+
+        case PARSE_LEN_LO:
+            frame_len = byte;
+            parse_crc = crc16_update(parse_crc, byte);
+            parse_state = PARSE_LEN_HI;
+            break;
+
+        case PARSE_LEN_HI:
+            frame_len |= (uint32_t)byte << 8;
+            parse_crc = crc16_update(parse_crc, byte);
+            if (!frame_len_valid(frame_cmd, frame_len)) {
+                frame_parser_resync();
+                break;
+            }
+            parse_index = 0;
+            parse_state = frame_len ? PARSE_PAYLOAD : PARSE_CRC_LO;
+            break;
+
+        case PARSE_PAYLOAD:
+            payload[parse_index] = byte;
+            parse_crc = crc16_update(parse_crc, byte);
+            if ((frame_cmd == CMD_ECB || frame_cmd == CMD_KEY_LOAD) &&
+                parse_index < KEY_SIZE + BLOCK_SIZE) {
+                /* Little-endian word assembly, matching the core's le_words layout */
+                parse_word = (parse_word >> 8) | ((uint32_t)byte << 24);
+                if ((parse_index & 3) == 3) {
+                    XIOModule_IoWriteWord(&iomodule, AES_KEY0_OFFSET + (parse_index & ~3u),
+                                          parse_word);
+                    if (parse_index == KEY_SIZE - 1) {
+                        PHASE_MARK(PHASE_KEY);
+                    } else if (parse_index == KEY_SIZE + BLOCK_SIZE - 1) {
+                        PHASE_MARK(PHASE_PT);
+                    }
+                }
+            } else if (frame_cmd == CMD_ECB_ID && parse_index < BLOCK_SIZE) {
+                parse_word = (parse_word >> 8) | ((uint32_t)byte << 24);
+                if ((parse_index & 3) == 3) {
+                    XIOModule_IoWriteWord(&iomodule, AES_PT0_OFFSET + (parse_index & ~3u),
+                                          parse_word);
+                    if (parse_index == BLOCK_SIZE - 1) {
+                        PHASE_MARK(PHASE_PT);
                     }
                 }
             }
+            if (++parse_index == frame_len) {
+                parse_state = PARSE_CRC_LO;
+            }
+            break;
+
+        case PARSE_CRC_LO:
+            parse_rx_crc = byte;
+            parse_state = PARSE_CRC_HI;
+            break;
+
+        case PARSE_CRC_HI:
+            parse_rx_crc |= (uint16_t)byte << 8;
+            if (parse_rx_crc == parse_crc) {
+                /* Frame accepted: release its bytes */
+                PHASE_MARK(PHASE_RX_LAST);
+                uart_rx_tail = parse_pos;
+                parse_state = PARSE_SOF;
+                return 1;
+            }
+            send_nak(frame_seq, frame_cmd, NAK_CRC);
+            frame_parser_resync();
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* Run the command of the frame the parser just accepted (its length fits) */
+static void frame_dispatch(void) {
+    const uint8_t *payload = (const uint8_t *)frame_payload_words;
+
+    switch (frame_cmd) {
+    case CMD_PING:
+        handle_ping(frame_seq);
+        break;
+
+    case CMD_ECB:
+        handle_ecb(frame_seq);
+        break;
+
+    case CMD_KEY_LOAD:
+        handle_key_load(frame_seq, payload);
+        break;
+
+    case CMD_CTR:
+        handle_ctr(frame_seq, payload);
+        break;
+
+    case CMD_BATCH:
+        handle_batch(frame_seq, frame_payload_words, frame_len);
+        break;
+
+    case CMD_MCT:
+        handle_mct(frame_seq, frame_payload_words);
+        break;
+
+    case CMD_BENCH:
+        handle_bench(frame_seq, payload);
+        break;
+
+    case CMD_STATS:
+        handle_stats(frame_seq);
+        break;
+
+    case CMD_KEY_STORE:
+        handle_key_store(frame_seq, frame_payload_words);
+        break;
+
+    case CMD_ECB_ID:
+        handle_ecb_id(frame_seq, payload);
+        break;
+
+    case CMD_BRIDGE:
+        handle_bridge(frame_seq, payload);
+        break;
+
+    case CMD_BAUD:
+        handle_baud(frame_seq, payload);
+        break;
+
+    case CMD_XTS:
+        handle_xts(frame_seq, frame_payload_words, frame_len);
+        break;
+
+    case CMD_CMAC:
+        handle_cmac(frame_seq, payload, frame_len);
+        break;
+    }
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    int status;
+
+    /* Initialize IOModule */
+    status = XIOModule_Initialize(&iomodule, UART_DEVICE_ID);
+    if (status != XST_SUCCESS) {
+        return -1;
+    }
+
+    /* Initialize GPO1 LED to OFF */
+    XIOModule_DiscreteWrite(&iomodule, 1, 0x00);
+
+    /* Initialize timer for benchmarking */
+    timer_init();
+
+    /* Exchange data words in native byte order (no per-byte packing) */
+    aes_set_le_words();
+
+    /* Send startup message (polled, before the UART interrupts take over) */
+    xil_printf("AES-128 Hardware Accelerator Ready\r\n");
+    xil_printf("Protocol v%d: [0xA5][seq][cmd][len16][payload][crc16]\r\n", PROTOCOL_VERSION);
+#if USE_INTERRUPTS
+    xil_printf("Mode: Interrupt-driven\r\n");
+#else
+    xil_printf("Mode: Polled\r\n");
+#endif
+
+    /* Setup interrupt handling */
+    status = uart_init_interrupts();
+    if (status != XST_SUCCESS) {
+        xil_printf("Failed to connect UART interrupts\r\n");
+        return -1;
+    }
+    status = XIOModule_Connect(&iomodule, AES_INTR_ID, aes_isr, NULL);
+    if (status != XST_SUCCESS) {
+        xil_printf("Failed to connect AES interrupt\r\n");
+        return -1;
+    }
+#if USE_INTERRUPTS
+    XIOModule_Enable(&iomodule, AES_INTR_ID);
+#endif
+    XIOModule_Start(&iomodule);
+    Xil_ExceptionInit();
+    Xil_ExceptionRegisterHandler(XIL_EXCEPTION_ID_INT,
+                                 (Xil_ExceptionHandler)XIOModule_DeviceInterruptHandler,
+                                 (void *)UART_DEVICE_ID);
+    Xil_ExceptionEnable();
+#if USE_INTERRUPTS
+    aes_enable_irq();
+#endif
+
+    /* Main loop */
+    while (1) {
+        /* Handle each frame once it has arrived complete and verified */
+        if (frame_parser_poll()) {
+            /* Turn ON LED */
+            XIOModule_DiscreteWrite(&iomodule, 1, 0x01);
+
+            frame_dispatch();
+            phase_frame_end(frame_seq, frame_cmd);
+
+            /* Turn OFF LED */
+            XIOModule_DiscreteWrite(&iomodule, 1, 0x00);
         }
     }
 
@@ -0,0 +1,305 @@
+--------------------------------------------------------------------------------
+-- Fabric UART (8N1)
+--
+-- uart_baud, uart_rx and uart_tx for the frame bridge, with the line rate
+-- set at run time up to the 12 Mbaud the FT2232H on the CMOD-A7 can carry.
+--
+-- Baud Generator:
+--   A 16-bit phase accumulator advanced by baud_inc every clock gives a
+--   one-cycle tick at OVERSAMPLE (8) times the baud rate, so rates that do
+--   not divide the clock are still exact on average; each tick is off by at
+--   most one clock cycle. baud_increment(rate, clk_hz) gives the increment,
+--   e.g. 483 for 115200 baud and 50332 for 12 Mbaud at 125 MHz. The receiver
+--   and transmitter share the tick.
+--
+-- Receiver:
+--   The line is synchronised through two flip-flops and sampled on every
+--   tick. A low sample starts a character; each bit is then the majority of
+--   its samples 3, 4 and 5, around the middle of the bit. A start bit that
+--   is not low by majority is taken as a glitch. A character with a good
+--   stop bit is presented on rx_data with a one-cycle rx_valid half way
+--   through the stop bit, so the next start bit is seen even from a slightly
+--   fast sender; a bad stop bit gives a one-cycle frame_error, the character
+--   is dropped and the receiver waits for the line to return high.
+--
+-- Transmitter:
+--   A byte is taken when tx_valid and tx_ready are both high and shifted out
+--   LSB first between a start and a stop bit, OVERSAMPLE ticks per bit.
+--   tx_ready is only high on a tick with the line free or on the tick that
+--   ends a stop bit, so every bit lasts exactly OVERSAMPLE ticks and
+--   characters follow back to back. idle is low from a byte being taken to
+--   the end of its stop bit.
+--------------------------------------------------------------------------------
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use ieee.math_real.all;
+
+package uart_pkg is
+
+    constant OVERSAMPLE     : positive := 8;
+    constant BAUD_FRAC_BITS : positive := 16;
+
+    subtype baud_inc_t is unsigned(BAUD_FRAC_BITS-1 downto 0);
+    type baud_inc_array_t is array (natural range <>) of baud_inc_t;
+    type baud_rate_array_t is array (natural range <>) of natural;
+
+    -- Rates the frame bridge accepts besides the MCS UART rate; all are
+    -- 12 MHz / n for the FT2232H's divider, 921600 to within 0.2%
+    constant BAUD_RATES : baud_rate_array_t := (
+        115200, 921600, 1000000, 2000000, 3000000, 4000000, 6000000, 8000000, 12000000
+    );
+
+    -- Accumulator increment for rate, or 0 when the clock cannot oversample it
+    function baud_increment(rate, clk_hz : natural) return baud_inc_t;
+
+    -- baud_increment for each of BAUD_RATES
+    function baud_inc_table(clk_hz : natural) return baud_inc_array_t;
+
+end package uart_pkg;
+
+package body uart_pkg is
+
+    function baud_increment(rate, clk_hz : natural) return baud_inc_t is
+    begin
+        if rate = 0 or OVERSAMPLE * rate >= clk_hz then
+            return to_unsigned(0, BAUD_FRAC_BITS);
+        end if;
+        return to_unsigned(integer(round(real(OVERSAMPLE) * real(rate) * 2.0**BAUD_FRAC_BITS /
+                                         real(clk_hz))), BAUD_FRAC_BITS);
+    end function;
+
+    function baud_inc_table(clk_hz : natural) return baud_inc_array_t is
+        variable t : baud_inc_array_t(BAUD_RATES'range);
+    begin
+        for i in BAUD_RATES'range loop
+            t(i) := baud_increment(BAUD_RATES(i), clk_hz);
+        end loop;
+        return t;
+    end function;
+
+end package body uart_pkg;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.uart_pkg.all;
+
+entity uart_baud is
+    port (
+        clk      : in  std_logic;
+        rst      : in  std_logic;
+        baud_inc : in  baud_inc_t;
+        tick     : out std_logic
+    );
+end entity uart_baud;
+
+architecture rtl of uart_baud is
+
+    signal acc : unsigned(BAUD_FRAC_BITS downto 0);
+
+begin
+
+    tick <= acc(BAUD_FRAC_BITS);
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rst = '1' then
+                acc <= (others => '0');
+            else
+                acc <= ('0' & acc(BAUD_FRAC_BITS-1 downto 0)) + baud_inc;
+            end if;
+        end if;
+    end process;
+
+end architecture rtl;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.uart_pkg.all;
+
+entity uart_rx is
+    port (
+        clk         : in  std_logic;
+        rst         : in  std_logic;
+        tick        : in  std_logic;
+        rxd         : in  std_logic;
+        rx_data     : out std_logic_vector(7 downto 0);
+        rx_valid    : out std_logic;
+        frame_error : out std_logic
+    );
+end entity uart_rx;
+
+architecture rtl of uart_rx is
+
+    type state_t is (IDLE, START, DATA, STOP, WAIT_HIGH);
+    signal state : state_t;
+
+    signal rxd_meta : std_logic;
+    signal rxd_sync : std_logic;
+
+    -- Sample within the bit, and the two samples before this one
+    signal sample_cnt : unsigned(2 downto 0);
+    signal history    : std_logic_vector(1 downto 0);
+    signal bit_cnt    : integer range 0 to 7;
+    signal shift      : std_logic_vector(7 downto 0);
+
+    -- Sample the bit value is taken at (the third of the three voted)
+    constant VOTE_SAMPLE : unsigned(2 downto 0) := to_unsigned(OVERSAMPLE/2 + 1, 3);
+
+begin
+
+    process(clk)
+        variable votes : std_logic_vector(2 downto 0);
+        variable value : std_logic;
+    begin
+        if rising_edge(clk) then
+            rxd_meta <= rxd;
+            rxd_sync <= rxd_meta;
+
+            if rst = '1' then
+                rxd_meta    <= '1';
+                rxd_sync    <= '1';
+                state       <= IDLE;
+                sample_cnt  <= (others => '0');
+                history     <= (others => '1');
+                bit_cnt     <= 0;
+                rx_valid    <= '0';
+                frame_error <= '0';
+            else
+                rx_valid    <= '0';
+                frame_error <= '0';
+
+                if tick = '1' then
+                    history    <= history(0) & rxd_sync;
+                    sample_cnt <= sample_cnt + 1;
+
+                    votes := history & rxd_sync;
+                    value := (votes(2) and votes(1)) or (votes(2) and votes(0)) or
+                             (votes(1) and votes(0));
+
+                    case state is
+                        when IDLE =>
+                            if rxd_sync = '0' then
+                                sample_cnt <= to_unsigned(1, 3);    -- This was sample 0
+                                state      <= START;
+                            end if;
+
+                        when START =>
+                            if sample_cnt = VOTE_SAMPLE then
+                                bit_cnt <= 0;
+                                if value = '0' then
+                                    state <= DATA;
+                                else
+                                    state <= IDLE;                  -- Glitch
+                                end if;
+                            end if;
+
+                        when DATA =>
+                            if sample_cnt = VOTE_SAMPLE then
+                                shift <= value & shift(7 downto 1);
+                                if bit_cnt = 7 then
+                                    state <= STOP;
+                                else
+                                    bit_cnt <= bit_cnt + 1;
+                                end if;
+                            end if;
+
+                        when STOP =>
+                            if sample_cnt = VOTE_SAMPLE then
+                                if value = '1' then
+                                    rx_data  <= shift;
+                                    rx_valid <= '1';
+                                    state    <= IDLE;
+                                else
+                                    frame_error <= '1';
+                                    state       <= WAIT_HIGH;
+                                end if;
+                            end if;
+
+                        -- Framing error or break: wait for the line to go high
+                        when WAIT_HIGH =>
+                            if rxd_sync = '1' then
+                                state <= IDLE;
+                            end if;
+
+                    end case;
+                end if;
+            end if;
+        end if;
+    end process;
+
+end architecture rtl;
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+library work;
+use work.uart_pkg.all;
+
+entity uart_tx is
+    port (
+        clk      : in  std_logic;
+        rst      : in  std_logic;
+        tick     : in  std_logic;
+        tx_data  : in  std_logic_vector(7 downto 0);
+        tx_valid : in  std_logic;
+        tx_ready : out std_logic;
+        idle     : out std_logic;
+        txd      : out std_logic
+    );
+end entity uart_tx;
+
+architecture rtl of uart_tx is
+
+    signal active     : std_logic;
+    signal sample_cnt : unsigned(2 downto 0);
+    signal bit_cnt    : integer range 0 to 9;
+    -- Stop bit, data LSB first, start bit; shifted out from bit 0
+    signal shift      : std_logic_vector(9 downto 0);
+    signal take       : std_logic;
+
+begin
+
+    take <= tick when active = '0' or (sample_cnt = OVERSAMPLE - 1 and bit_cnt = 9) else '0';
+
+    -- The shift register idles at all ones, so the line is driven by a flop
+    tx_ready <= take;
+    idle     <= not active;
+    txd      <= shift(0);
+
+    process(clk)
+    begin
+        if rising_edge(clk) then
+            if rst = '1' then
+                active     <= '0';
+                sample_cnt <= (others => '0');
+                bit_cnt    <= 0;
+                shift      <= (others => '1');
+            elsif take = '1' and tx_valid = '1' then
+                shift      <= '1' & tx_data & '0';
+                sample_cnt <= (others => '0');
+                bit_cnt    <= 0;
+                active     <= '1';
+            elsif active = '1' and tick = '1' then
+                sample_cnt <= sample_cnt + 1;
+                if sample_cnt = OVERSAMPLE - 1 then
+                    shift <= '1' & shift(9 downto 1);
+                    if bit_cnt = 9 then
+                        active <= '0';
+                    else
+                        bit_cnt <= bit_cnt + 1;
+                    end if;
+                end if;
+            end if;
+        end if;
+    end process;
+
+end architecture rtl;